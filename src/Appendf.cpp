@@ -0,0 +1,19 @@
+#include <Appendf.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+void appendf(char *pszBuf, size_t nBufLen, size_t &nPos, const char *pszFormat, ...)
+{
+  if (nPos < nBufLen)
+  {
+    va_list args;
+    va_start(args, pszFormat);
+    int nWritten = vsnprintf(pszBuf + nPos, nBufLen - nPos, pszFormat, args);
+    va_end(args);
+
+    if (nWritten > 0)
+    {
+      nPos = (nPos + (size_t)nWritten < nBufLen) ? nPos + (size_t)nWritten : nBufLen;
+    }
+  }
+}
@@ -0,0 +1,11 @@
+#ifndef __APPENDF_H__
+#define __APPENDF_H__
+
+#include <stddef.h>
+
+// snprintf that appends at nPos and never runs past the buffer. Once the
+// output has been cut short nPos is nBufLen, which JSON writers check to
+// return 0.
+void appendf(char *pszBuf, size_t nBufLen, size_t &nPos, const char *pszFormat, ...);
+
+#endif // #ifndef __APPENDF_H__
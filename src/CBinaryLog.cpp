@@ -0,0 +1,80 @@
+#include <CBinaryLog.h>
+#include <Hal.h>
+
+// Copies committed records from *pnSeq on, oldest first, and advances
+// *pnSeq past them. A *pnSeq older than the ring starts at the oldest
+// record still held, one from the future (e.g. from before a reboot) at
+// the oldest too. Stops early at a record that's still being written so a
+// later read picks it up.
+size_t CBinaryLog::read(uint32_t *pnSeq, BinaryLogRecord *arrRecords, size_t nMaxRecords, uint32_t *pnLost /* = 0*/)
+{
+  size_t nReturn = 0;
+  uint32_t nLost = 0;
+
+  if ((pnSeq != NULL) && (arrRecords != NULL))
+  {
+    uint32_t nNext = m_nNextSeq;
+    uint32_t nOldest = nNext - ((nNext < BINARY_LOG_SLOTS) ? nNext : BINARY_LOG_SLOTS);
+    uint32_t nSeq = *pnSeq;
+    int32_t nBehind = (int32_t)(nNext - nSeq);
+
+    if (nBehind < 0)
+    {
+      nSeq = nOldest;
+    }
+    else if (nBehind > BINARY_LOG_SLOTS)
+    {
+      nLost += nBehind - BINARY_LOG_SLOTS;
+      nSeq = nOldest;
+    }
+
+    bool bPending = false;
+    while ((nSeq != nNext) && (nReturn < nMaxRecords) && !bPending)
+    {
+      const BinaryLogRecord *pSlot = &m_arrRecords[nSeq & (BINARY_LOG_SLOTS - 1)];
+      uint32_t nBefore = *(volatile const uint32_t *)&pSlot->nSeq;
+      __sync_synchronize();
+      arrRecords[nReturn] = *pSlot;
+      __sync_synchronize();
+      uint32_t nAfter = *(volatile const uint32_t *)&pSlot->nSeq;
+
+      if ((nBefore == nSeq + 1) && (nAfter == nSeq + 1))
+      {
+        arrRecords[nReturn].nSeq = nSeq;
+        nReturn++;
+        nSeq++;
+      }
+      else if (nBefore == 0)
+      {
+        bPending = true;
+      }
+      else
+      {
+        nLost++;
+        nSeq++;
+      }
+    }
+
+    *pnSeq = nSeq;
+  }
+
+  if (pnLost != NULL)
+  {
+    *pnLost = nLost;
+  }
+
+  return nReturn;
+}
+
+// Count of log calls so far, and the sequence the next one will get
+uint32_t CBinaryLog::getNextSeq()
+{
+  return m_nNextSeq;
+}
+
+uint32_t CBinaryLog::getMicros()
+{
+  return halMicros();
+}
+
+CBinaryLog BinaryLog;
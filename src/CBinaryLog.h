@@ -0,0 +1,115 @@
+#ifndef __CBINARYLOG_H__
+#define __CBINARYLOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+#define BINARY_LOG_SLOTS 128 // power of 2
+#define BINARY_LOG_MAX_ARGS 8
+#define BINARY_LOG_MAGIC 0x474f4c42 // "BLOG"
+#define BINARY_LOG_VERSION 1
+
+// FNV-1a of a format string. BLOG() evaluates it at compile time, and
+// tools/blog/gen_blog_table.py computes the same hash from the sources to
+// build the ID -> format table the host decoder uses.
+constexpr uint32_t binaryLogHash(const char *pszFormat, uint32_t nHash = 2166136261u)
+{
+  return (*pszFormat == 0) ? nHash : binaryLogHash(pszFormat + 1, (nHash ^ (uint8_t)*pszFormat) * 16777619u);
+}
+
+// Records a log line without formatting it: BLOG("fan %u: %.2fF", nFan, fTemp)
+// stores the format's ID, a timestamp and the raw argument bits. The format
+// has to be a string literal; it isn't stored in the firmware at all.
+#define BLOG(pszFormat, ...) BinaryLog.log(std::integral_constant<uint32_t, binaryLogHash(pszFormat)>::value, ##__VA_ARGS__)
+
+// One log call. Every argument takes 4 bytes: integers as their low 32
+// bits, floating point as float. The decoder picks the type back out of
+// the format's conversion.
+typedef struct BinaryLogRecord
+{
+  uint32_t nSeq; // sequence + 1 once committed, 0 while being written
+  uint32_t nId;
+  uint32_t nMicros;
+  uint8_t nNumArgs;
+  uint8_t arrReserved[3];
+  uint32_t arrArgs[BINARY_LOG_MAX_ARGS];
+} BinaryLogRecord;
+
+// Flight recorder for BLOG(): the newest BINARY_LOG_SLOTS records in
+// fixed size slots.
+//
+// A call claims a sequence number with one atomic add and fills that
+// sequence's slot, clearing the slot's commit word first and setting it
+// last. No locks, so it's safe from any task on either core. read() copies
+// slots out and keeps only those whose commit word matched the expected
+// sequence before and after the copy; anything overwritten or half written
+// is counted as lost instead.
+class CBinaryLog
+{
+public:
+  template <typename... Args>
+  void log(uint32_t nId, Args... args)
+  {
+    static_assert(sizeof...(Args) <= BINARY_LOG_MAX_ARGS, "too many binary log arguments");
+
+    uint32_t nSeq = __atomic_fetch_add(&m_nNextSeq, 1, __ATOMIC_RELAXED);
+    BinaryLogRecord *pRecord = &m_arrRecords[nSeq & (BINARY_LOG_SLOTS - 1)];
+
+    pRecord->nSeq = 0;
+    __sync_synchronize();
+
+    pRecord->nId = nId;
+    pRecord->nMicros = getMicros();
+    pRecord->nNumArgs = sizeof...(Args);
+    packArgs(pRecord->arrArgs, args...);
+
+    __sync_synchronize();
+    pRecord->nSeq = nSeq + 1;
+  }
+
+  size_t read(uint32_t *pnSeq, BinaryLogRecord *arrRecords, size_t nMaxRecords, uint32_t *pnLost = 0);
+  uint32_t getNextSeq();
+
+  static uint32_t getMicros();
+
+private:
+  static void packArgs(uint32_t *)
+  {
+  }
+
+  template <typename T, typename... Rest>
+  static void packArgs(uint32_t *pArgs, T value, Rest... rest)
+  {
+    *pArgs = packArg(value);
+    packArgs(pArgs + 1, rest...);
+  }
+
+  static uint32_t packArg(float fValue)
+  {
+    uint32_t nBits = 0;
+    memcpy(&nBits, &fValue, sizeof(nBits));
+    return nBits;
+  }
+
+  static uint32_t packArg(double fValue)
+  {
+    return packArg((float)fValue);
+  }
+
+  template <typename T>
+  static uint32_t packArg(T value)
+  {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "binary log arguments must be numbers");
+    static_assert(sizeof(T) <= 4, "binary log integers are 32 bit");
+    return (uint32_t)value;
+  }
+
+  BinaryLogRecord m_arrRecords[BINARY_LOG_SLOTS] = {};
+  volatile uint32_t m_nNextSeq = 0;
+};
+
+extern CBinaryLog BinaryLog;
+
+#endif // #ifndef __CBINARYLOG_H__
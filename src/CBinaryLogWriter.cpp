@@ -0,0 +1,39 @@
+#include <CBinaryLogWriter.h>
+
+CBinaryLogWriter::CBinaryLogWriter(CBinaryLog *pLog, uint32_t nSinceSeq)
+    : CLineWriter(m_arrStage)
+{
+  m_pLog = pLog;
+  m_nSeq = nSinceSeq;
+  m_nEndSeq = (pLog != NULL) ? pLog->getNextSeq() : 0;
+}
+
+bool CBinaryLogWriter::renderNext()
+{
+  m_nLineLen = 0;
+  m_nLineOffset = 0;
+
+  if (!m_bHeaderSent)
+  {
+    uint32_t nMagic = BINARY_LOG_MAGIC;
+    uint16_t nVersion = BINARY_LOG_VERSION;
+    uint16_t nRecordSize = sizeof(BinaryLogRecord);
+    memcpy(m_arrStage, &nMagic, 4);
+    memcpy(m_arrStage + 4, &nVersion, 2);
+    memcpy(m_arrStage + 6, &nRecordSize, 2);
+    memcpy(m_arrStage + 8, &m_nEndSeq, 4);
+    m_nLineLen = 12;
+    m_bHeaderSent = true;
+  }
+  else if ((m_pLog != NULL) && ((int32_t)(m_nEndSeq - m_nSeq) > 0))
+  {
+    BinaryLogRecord record;
+    if (m_pLog->read(&m_nSeq, &record, 1) == 1)
+    {
+      memcpy(m_arrStage, &record, sizeof(record));
+      m_nLineLen = sizeof(record);
+    }
+  }
+
+  return (m_nLineLen > 0);
+}
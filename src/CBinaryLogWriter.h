@@ -0,0 +1,30 @@
+#ifndef __CBINARYLOGWRITER_H__
+#define __CBINARYLOGWRITER_H__
+
+#include <Arduino.h>
+#include <CBinaryLog.h>
+#include <CLineWriter.h>
+
+// Streams binary log records for tools/blog/blog_decode through
+// CLineWriter::fill(), the header and each record as one line:
+//   magic (4) | version (2) | record size (2) | next sequence (4)
+// then each committed record from the requested sequence up to the one
+// that was next when the response started, as raw BinaryLogRecords with
+// nSeq holding the sequence number. Gaps in the sequence are lost records.
+class CBinaryLogWriter : public CLineWriter
+{
+public:
+  CBinaryLogWriter(CBinaryLog *pLog, uint32_t nSinceSeq);
+
+private:
+  bool renderNext();
+
+  CBinaryLog *m_pLog = NULL;
+  uint32_t m_nSeq = 0;
+  uint32_t m_nEndSeq = 0;
+  bool m_bHeaderSent = false;
+
+  uint8_t m_arrStage[sizeof(BinaryLogRecord)] = {};
+};
+
+#endif // #ifndef __CBINARYLOGWRITER_H__
@@ -0,0 +1,116 @@
+#ifndef __CCBORWRITER_H__
+#define __CCBORWRITER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal CBOR (RFC 8949) encoder for the handful of types telemetry
+// needs: integers and definite length arrays and maps. Writes straight
+// into a caller buffer; once anything doesn't fit the writer stops and
+// reports overflow instead of emitting a truncated item.
+class CCborWriter
+{
+public:
+  CCborWriter(uint8_t *pBuf, size_t nBufLen)
+      : m_pBuf(pBuf),
+        m_nBufLen(pBuf != NULL ? nBufLen : 0)
+  {
+  }
+
+  void writeUnsigned(uint64_t nValue)
+  {
+    writeHead(0, nValue);
+  }
+
+  void writeInt(int64_t nValue)
+  {
+    if (nValue >= 0)
+    {
+      writeHead(0, (uint64_t)nValue);
+    }
+    else
+    {
+      // Major type 1 encodes -1 - n
+      writeHead(1, (uint64_t)(-1 - nValue));
+    }
+  }
+
+  void beginArray(size_t nItems)
+  {
+    writeHead(4, nItems);
+  }
+
+  void beginMap(size_t nPairs)
+  {
+    writeHead(5, nPairs);
+  }
+
+  size_t getLength() const
+  {
+    return m_bOverflow ? 0 : m_nPos;
+  }
+
+  bool isOverflow() const
+  {
+    return m_bOverflow;
+  }
+
+private:
+  void writeHead(uint8_t nMajor, uint64_t nValue)
+  {
+    uint8_t nMajorBits = (uint8_t)(nMajor << 5);
+
+    if (nValue < 24)
+    {
+      writeByte(nMajorBits | (uint8_t)nValue);
+    }
+    else if (nValue <= 0xFF)
+    {
+      writeByte(nMajorBits | 24);
+      writeBigEndian(nValue, 1);
+    }
+    else if (nValue <= 0xFFFF)
+    {
+      writeByte(nMajorBits | 25);
+      writeBigEndian(nValue, 2);
+    }
+    else if (nValue <= 0xFFFFFFFFUL)
+    {
+      writeByte(nMajorBits | 26);
+      writeBigEndian(nValue, 4);
+    }
+    else
+    {
+      writeByte(nMajorBits | 27);
+      writeBigEndian(nValue, 8);
+    }
+  }
+
+  void writeBigEndian(uint64_t nValue, uint8_t nBytes)
+  {
+    while (nBytes > 0)
+    {
+      nBytes--;
+      writeByte((uint8_t)(nValue >> (nBytes * 8)));
+    }
+  }
+
+  void writeByte(uint8_t nByte)
+  {
+    if (m_nPos < m_nBufLen)
+    {
+      m_pBuf[m_nPos++] = nByte;
+    }
+    else
+    {
+      m_bOverflow = true;
+    }
+  }
+
+  uint8_t *m_pBuf = NULL;
+  size_t m_nBufLen = 0;
+  size_t m_nPos = 0;
+  bool m_bOverflow = false;
+};
+
+#endif // #ifndef __CCBORWRITER_H__
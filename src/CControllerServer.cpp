@@ -1,9 +1,99 @@
 #include <CControllerServer.h>
+#include <CMetricsWriter.h>
+#include <CHistoryWriter.h>
+#include <CFlashLogCsvWriter.h>
+#include <CBinaryLogWriter.h>
+#include <CSettingsStore.h>
 #include <AsyncJson.h>
-#include <ArduinoJson.h>
+#include <memory>
+#include <stddef.h>
+
+// Send a full frame at least this often so clients that missed a delta
+// resynchronize
+#define TELEMETRY_KEYFRAME_INTERVAL 30
+
+// Default /history window. Range checks use wrapping differences, which
+// hold for anything under ~24 days.
+#define HISTORY_MAX_SPAN_MS (24UL * 60 * 60 * 1000)
+
+// Largest POST /settings body accepted
+#define SETTINGS_MAX_BODY 2048
+
+enum SettingsFieldType
+{
+  SETTINGS_FIELD_DOUBLE,
+  SETTINGS_FIELD_FLAG,
+  SETTINGS_FIELD_UINT32
+};
+
+// The FanSettings members /settings exposes, by their JSON names. Both the
+// GET rendering and the POST parsing are driven from this table.
+typedef struct SettingsField
+{
+  const char *pszName;
+  SettingsFieldType type;
+  size_t nOffset;
+} SettingsField;
+
+static const SettingsField s_arrSettingsFields[] = {
+    {"setpoint", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fPidSetpoint)},
+    {"kp", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fPidKp)},
+    {"ki", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fPidKi)},
+    {"kd", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fPidKd)},
+    {"fullSpeedTemp", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fFullSpeedTemp)},
+    {"minDutyPercent", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fMinFanDutyCyclePercent)},
+    {"offDutyPercent", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fFanOffDutyCyclePercent)},
+    {"allowOff", SETTINGS_FIELD_FLAG, offsetof(FanSettings, bAllowOff)},
+    {"minRuntimeMs", SETTINGS_FIELD_UINT32, offsetof(FanSettings, nFanMinRuntimeMs)},
+    {"rampUpPercentPerSec", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fRampUpPercentPerSec)},
+    {"rampDownPercentPerSec", SETTINGS_FIELD_DOUBLE, offsetof(FanSettings, fRampDownPercentPerSec)}};
+
+#define NUM_SETTINGS_FIELDS (sizeof(s_arrSettingsFields) / sizeof(s_arrSettingsFields[0]))
+
+// Sets one field from a JSON value, checking only its type; ranges are
+// left to CSettingsStore::validate()
+static bool setSettingsField(FanSettings *pFan, const char *pszName, JsonVariant value)
+{
+  bool bReturn = false;
+
+  for (size_t nField = 0; nField < NUM_SETTINGS_FIELDS; nField++)
+  {
+    const SettingsField *pField = &s_arrSettingsFields[nField];
+    if (strcmp(pField->pszName, pszName) == 0)
+    {
+      uint8_t *pValue = (uint8_t *)pFan + pField->nOffset;
+
+      if ((pField->type == SETTINGS_FIELD_DOUBLE) && value.is<double>())
+      {
+        *(double *)pValue = value.as<double>();
+        bReturn = true;
+      }
+      else if ((pField->type == SETTINGS_FIELD_FLAG) && value.is<bool>())
+      {
+        *pValue = value.as<bool>() ? 1 : 0;
+        bReturn = true;
+      }
+      else if ((pField->type == SETTINGS_FIELD_FLAG) && value.is<unsigned int>())
+      {
+        // Out of range values are kept so validation reports them
+        *pValue = (uint8_t)min(value.as<unsigned int>(), 255U);
+        bReturn = true;
+      }
+      else if ((pField->type == SETTINGS_FIELD_UINT32) && value.is<uint32_t>())
+      {
+        *(uint32_t *)pValue = value.as<uint32_t>();
+        bReturn = true;
+      }
+      break;
+    }
+  }
+
+  return bReturn;
+}
 
 CControllerServer::CControllerServer(uint8_t nPort /*= 80*/)
-    : m_server(nPort)
+    : m_server(nPort),
+      m_events("/events")
 {
 }
 
@@ -35,7 +125,471 @@ void CControllerServer::begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTem
     onReqStatus(pRequest);
   });
 
+  m_server.on("/metrics", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqMetrics(pRequest);
+  });
+
+  m_server.on("/history", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqHistory(pRequest);
+  });
+
+  m_server.on("/log", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqLog(pRequest);
+  });
+
+  m_server.on("/blog", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqBinaryLog(pRequest);
+  });
+
+  m_server.on("/settings", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqGetSettings(pRequest);
+  });
+
+  m_server.on("/bench", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqBench(pRequest);
+  });
+
+  m_server.on("/debug/perf", HTTP_GET, [this](AsyncWebServerRequest *pRequest) {
+    onReqPerf(pRequest);
+  });
+
+  // POST with a JSON body; the handler buffers and parses it
+  AsyncCallbackJsonWebHandler *pSettingsHandler = new AsyncCallbackJsonWebHandler("/settings", [this](AsyncWebServerRequest *pRequest, JsonVariant &json) {
+    onReqPostSettings(pRequest, json);
+  });
+  pSettingsHandler->setMethod(HTTP_POST);
+  pSettingsHandler->setMaxContentLength(SETTINGS_MAX_BODY);
+  m_server.addHandler(pSettingsHandler);
+
+  m_telemetry.begin(m_arrFanCtrl, m_nNumFans, m_pTempSensors);
+  m_statusTelemetry.begin(m_arrFanCtrl, m_nNumFans, m_pTempSensors);
+
+  // Generations restart at boot, so salt the ETag to keep clients from
+  // matching a body cached before a reboot
+  m_nEtagSalt = esp_random();
+
+  m_events.onConnect([this](AsyncEventSourceClient *pClient) {
+    onEventsConnect(pClient);
+  });
+  m_server.addHandler(&m_events);
+
   m_server.begin();
+
+  xTaskCreatePinnedToCore(
+      CControllerServer::taskTelemetry, // Function that should be called
+      "taskTelemetry",                  // Name of the task (for debugging)
+      4096,                             // Stack size (bytes)
+      this,                             // Parameter to pass
+      1,                                // Task priority
+      &m_hTelemetryTask,                // Task handle
+      0                                 // Core you want to run the task on (0 or 1)
+  );
+
+  if (m_pTempSensors != NULL)
+  {
+    m_pTempSensors->addSampleListener(m_hTelemetryTask);
+  }
+}
+
+void CControllerServer::taskTelemetry(void *pvParam)
+{
+  CControllerServer *pThis = (CControllerServer *)pvParam;
+
+  for (;;)
+  {
+    // Woken once per published temperature sample
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    pThis->broadcastTelemetry();
+  }
+
+  vTaskDelete(NULL);
+}
+
+void CControllerServer::setFanScheduler(CFanScheduler *pFanScheduler)
+{
+  m_pFanScheduler = pFanScheduler;
+}
+
+// pBootResults, if given, is a CHotPathBench::runAll() from before the
+// control tasks started; /bench includes it as "boot"
+void CControllerServer::setHotPathBench(CHotPathBench *pHotPathBench, CMicroBench *pBootResults /* = 0*/)
+{
+  m_pHotPathBench = pHotPathBench;
+  m_pBootBenchResults = pBootResults;
+}
+
+void CControllerServer::setPerfMonitor(CPerfMonitor *pPerfMonitor)
+{
+  m_pPerfMonitor = pPerfMonitor;
+}
+
+void CControllerServer::onReqMetrics(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    // The writer is the only per-scrape allocation and its size doesn't
+    // depend on how many fans or sensors there are. It lives as long as
+    // the filler, which the response frees once the last chunk is sent.
+    std::shared_ptr<CMetricsWriter> pWriter(new CMetricsWriter(m_arrFanCtrl, m_nNumFans, m_pTempSensors, m_pFanScheduler));
+
+    AsyncWebServerResponse *pResponse = pRequest->beginChunkedResponse("text/plain; version=0.0.4; charset=utf-8",
+                                                                       [pWriter](uint8_t *pBuf, size_t nMaxLen, size_t nIndex) -> size_t {
+                                                                         return pWriter->fill(pBuf, nMaxLen);
+                                                                       });
+    setReponseHeaders(pResponse);
+    pRequest->send(pResponse);
+  }
+}
+
+void CControllerServer::setHistory(CHistoryRecorder *pHistory)
+{
+  m_pHistory = pHistory;
+}
+
+// /history?from=&to=&step= with times in millis(). Negative from / to are
+// relative to now, so from=-3600000 is the last hour. Defaults to
+// everything recorded, unaveraged.
+void CControllerServer::onReqHistory(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    if (m_pHistory == NULL)
+    {
+      pRequest->send(404);
+    }
+    else
+    {
+      uint32_t nNowMs = millis();
+      uint32_t nFromMs = nNowMs - HISTORY_MAX_SPAN_MS;
+      uint32_t nToMs = nNowMs;
+      uint32_t nStepMs = 0;
+
+      if (pRequest->hasParam("from"))
+      {
+        long nValue = strtol(pRequest->getParam("from")->value().c_str(), NULL, 10);
+        nFromMs = (nValue < 0) ? nNowMs + nValue : (uint32_t)nValue;
+      }
+      if (pRequest->hasParam("to"))
+      {
+        long nValue = strtol(pRequest->getParam("to")->value().c_str(), NULL, 10);
+        nToMs = (nValue < 0) ? nNowMs + nValue : (uint32_t)nValue;
+      }
+      if (pRequest->hasParam("step"))
+      {
+        long nValue = strtol(pRequest->getParam("step")->value().c_str(), NULL, 10);
+        nStepMs = (nValue > 0) ? (uint32_t)nValue : 0;
+      }
+
+      std::shared_ptr<CHistoryWriter> pWriter(new CHistoryWriter(m_pHistory, nFromMs, nToMs, nStepMs));
+
+      AsyncWebServerResponse *pResponse = pRequest->beginChunkedResponse("application/json",
+                                                                         [pWriter](uint8_t *pBuf, size_t nMaxLen, size_t nIndex) -> size_t {
+                                                                           return pWriter->fill(pBuf, nMaxLen);
+                                                                         });
+      setReponseHeaders(pResponse);
+      pRequest->send(pResponse);
+    }
+  }
+}
+
+void CControllerServer::setFlashLogStorage(CLogStorage *pLogStorage)
+{
+  m_pLogStorage = pLogStorage;
+}
+
+// Downloads the persistent log as CSV, straight off flash
+void CControllerServer::onReqLog(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    if (m_pLogStorage == NULL)
+    {
+      pRequest->send(404);
+    }
+    else
+    {
+      std::shared_ptr<CFlashLogCsvWriter> pWriter(new CFlashLogCsvWriter(m_pLogStorage));
+
+      AsyncWebServerResponse *pResponse = pRequest->beginChunkedResponse("text/csv",
+                                                                         [pWriter](uint8_t *pBuf, size_t nMaxLen, size_t nIndex) -> size_t {
+                                                                           return pWriter->fill(pBuf, nMaxLen);
+                                                                         });
+      setReponseHeaders(pResponse);
+      pResponse->addHeader("Content-Disposition", "attachment; filename=\"fanlog.csv\"");
+      pRequest->send(pResponse);
+    }
+  }
+}
+
+// /blog?since=<seq> streams the binary log records from seq on, for
+// tools/blog/blog_decode. Without since, everything the ring still holds.
+void CControllerServer::onReqBinaryLog(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    uint32_t nSinceSeq = 0;
+    if (pRequest->hasParam("since"))
+    {
+      nSinceSeq = strtoul(pRequest->getParam("since")->value().c_str(), NULL, 10);
+    }
+
+    std::shared_ptr<CBinaryLogWriter> pWriter(new CBinaryLogWriter(&BinaryLog, nSinceSeq));
+
+    AsyncWebServerResponse *pResponse = pRequest->beginChunkedResponse("application/octet-stream",
+                                                                       [pWriter](uint8_t *pBuf, size_t nMaxLen, size_t nIndex) -> size_t {
+                                                                         return pWriter->fill(pBuf, nMaxLen);
+                                                                       });
+    setReponseHeaders(pResponse);
+    pRequest->send(pResponse);
+  }
+}
+
+// {"generation":n,"applied":n,"fans":[{"index":0,"setpoint":105,...},...]}
+// Reports what has been published; "applied" catching up with
+// "generation" means the control loop has picked it up.
+void CControllerServer::onReqGetSettings(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    if (m_pFanScheduler == NULL)
+    {
+      sendJsonError(pRequest, 503, "no fan scheduler");
+    }
+    else
+    {
+      AsyncResponseStream *pResponse = pRequest->beginResponseStream("application/json");
+
+      pResponse->printf("{\"generation\":%u,\"applied\":%u,\"fans\":[", m_pFanScheduler->getSettingsGeneration(), m_pFanScheduler->getSettingsApplied());
+
+      bool bFirst = true;
+      for (size_t nIndex = 0; nIndex < m_pFanScheduler->getNumFans(); nIndex++)
+      {
+        FanSettings fan;
+        if (m_pFanScheduler->getFanSettings(nIndex, &fan))
+        {
+          pResponse->printf("%s{\"index\":%u", bFirst ? "" : ",", (unsigned int)nIndex);
+          for (size_t nField = 0; nField < NUM_SETTINGS_FIELDS; nField++)
+          {
+            const SettingsField *pField = &s_arrSettingsFields[nField];
+            const uint8_t *pValue = (const uint8_t *)&fan + pField->nOffset;
+
+            if (pField->type == SETTINGS_FIELD_DOUBLE)
+            {
+              pResponse->printf(",\"%s\":%.6g", pField->pszName, *(const double *)pValue);
+            }
+            else if (pField->type == SETTINGS_FIELD_FLAG)
+            {
+              pResponse->printf(",\"%s\":%s", pField->pszName, (*pValue != 0) ? "true" : "false");
+            }
+            else
+            {
+              pResponse->printf(",\"%s\":%u", pField->pszName, *(const uint32_t *)pValue);
+            }
+          }
+          pResponse->print("}");
+          bFirst = false;
+        }
+      }
+
+      pResponse->print("]}");
+      setReponseHeaders(pResponse);
+      pRequest->send(pResponse);
+    }
+  }
+}
+
+// Body is one fan, {"index":0,"setpoint":100}, or several,
+// {"fans":[{"index":0,...},{"index":1,...}]}. Fields left out keep their
+// current values. Every fan is validated before any is published, so a
+// request applies completely or not at all. Publishing only swaps a
+// buffer; the control loop applies it on its next tick, and main persists
+// it from there.
+void CControllerServer::onReqPostSettings(AsyncWebServerRequest *pRequest, JsonVariant &json)
+{
+  if ((pRequest != NULL) && (m_pFanScheduler == NULL))
+  {
+    sendJsonError(pRequest, 503, "no fan scheduler");
+  }
+  else if (pRequest != NULL)
+  {
+    const char *pszError = NULL;
+    size_t nNumFans = min(m_pFanScheduler->getNumFans(), (size_t)MAX_FANS);
+    FanSettings arrFans[MAX_FANS];
+    bool arrChanged[MAX_FANS] = {};
+
+    for (size_t nIndex = 0; nIndex < nNumFans; nIndex++)
+    {
+      m_pFanScheduler->getFanSettings(nIndex, &arrFans[nIndex]);
+    }
+
+    // Both shapes go through the same per-fan parsing
+    JsonArray arrFanJson = json["fans"].as<JsonArray>();
+    size_t nNumObjects = arrFanJson.isNull() ? 1 : arrFanJson.size();
+
+    for (size_t nObject = 0; (nObject < nNumObjects) && (pszError == NULL); nObject++)
+    {
+      JsonObject fanJson = arrFanJson.isNull() ? json.as<JsonObject>() : arrFanJson[nObject].as<JsonObject>();
+      JsonVariant index = fanJson["index"];
+
+      if (fanJson.isNull() || !index.is<unsigned int>())
+      {
+        pszError = "each fan needs an index";
+      }
+      else if (index.as<unsigned int>() >= nNumFans)
+      {
+        pszError = "no such fan";
+      }
+      else
+      {
+        size_t nIndex = index.as<unsigned int>();
+        for (JsonPair field : fanJson)
+        {
+          if ((pszError == NULL) &&
+              (strcmp(field.key().c_str(), "index") != 0) &&
+              !setSettingsField(&arrFans[nIndex], field.key().c_str(), field.value()))
+          {
+            pszError = "unknown field or wrong type";
+          }
+        }
+        arrChanged[nIndex] = true;
+      }
+    }
+
+    for (size_t nIndex = 0; (nIndex < nNumFans) && (pszError == NULL); nIndex++)
+    {
+      if (arrChanged[nIndex])
+      {
+        CSettingsStore::validate(&arrFans[nIndex], &pszError);
+      }
+    }
+
+    if (pszError != NULL)
+    {
+      sendJsonError(pRequest, 400, pszError);
+    }
+    else
+    {
+      for (size_t nIndex = 0; nIndex < nNumFans; nIndex++)
+      {
+        if (arrChanged[nIndex])
+        {
+          m_pFanScheduler->publishFanSettings(nIndex, arrFans[nIndex]);
+        }
+      }
+
+      onReqGetSettings(pRequest);
+    }
+  }
+}
+
+void CControllerServer::sendJsonError(AsyncWebServerRequest *pRequest, int nCode, const char *pszError)
+{
+  AsyncResponseStream *pResponse = pRequest->beginResponseStream("application/json");
+  pResponse->setCode(nCode);
+  pResponse->printf("{\"error\":\"%s\"}", pszError);
+  setReponseHeaders(pResponse);
+  pRequest->send(pResponse);
+}
+
+// Runs the live hot path suite and returns it with the boot results:
+//   {"live":{CMicroBench JSON},"boot":{CMicroBench JSON} or null}
+// Takes tens of ms on the web server task, so it's for debugging only.
+void CControllerServer::onReqBench(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    if (m_pHotPathBench == NULL)
+    {
+      sendJsonError(pRequest, 503, "no benchmark");
+    }
+    else
+    {
+      m_bench.clear();
+      m_pHotPathBench->runLive(&m_bench);
+
+      AsyncResponseStream *pResponse = pRequest->beginResponseStream("application/json");
+
+      m_bench.writeJson(m_szBenchJson, sizeof(m_szBenchJson));
+      pResponse->printf("{\"live\":%s,\"boot\":", m_szBenchJson);
+
+      if ((m_pBootBenchResults != NULL) && (m_pBootBenchResults->getNumResults() > 0))
+      {
+        m_pBootBenchResults->writeJson(m_szBenchJson, sizeof(m_szBenchJson));
+        pResponse->print(m_szBenchJson);
+      }
+      else
+      {
+        pResponse->print("null");
+      }
+
+      pResponse->print("}");
+      setReponseHeaders(pResponse);
+      pRequest->send(pResponse);
+    }
+  }
+}
+
+// CPerfMonitor figures (see CPerfMonitor::writeJson()). ?reset=1 returns
+// them and then clears each task's timing at its next loop.
+void CControllerServer::onReqPerf(AsyncWebServerRequest *pRequest)
+{
+  if (pRequest != NULL)
+  {
+    if (m_pPerfMonitor == NULL)
+    {
+      sendJsonError(pRequest, 503, "no perf monitor");
+    }
+    else if (m_pPerfMonitor->writeJson(m_szPerfJson, sizeof(m_szPerfJson)) == 0)
+    {
+      sendJsonError(pRequest, 500, "perf too large");
+    }
+    else
+    {
+      if (pRequest->hasParam("reset") && (strtoul(pRequest->getParam("reset")->value().c_str(), NULL, 10) != 0))
+      {
+        m_pPerfMonitor->reset();
+      }
+
+      AsyncResponseStream *pResponse = pRequest->beginResponseStream("application/json");
+      pResponse->print(m_szPerfJson);
+      setReponseHeaders(pResponse);
+      pRequest->send(pResponse);
+    }
+  }
+}
+
+// New subscribers get a full frame with the next sample
+void CControllerServer::onEventsConnect(AsyncEventSourceClient *pClient)
+{
+  m_bForceKeyframe = true;
+}
+
+void CControllerServer::broadcastTelemetry()
+{
+  if (m_events.count() == 0)
+  {
+    m_bForceKeyframe = true;
+  }
+  else
+  {
+    m_telemetry.sample();
+
+    uint32_t nGeneration = m_telemetry.getGeneration();
+    if (m_bForceKeyframe || ((nGeneration % TELEMETRY_KEYFRAME_INTERVAL) == 0))
+    {
+      m_bForceKeyframe = false;
+      if (m_telemetry.writeFull(m_szTelemetryFrame, sizeof(m_szTelemetryFrame)) > 0)
+      {
+        m_events.send(m_szTelemetryFrame, "status", nGeneration);
+      }
+    }
+    else if (m_telemetry.writeDelta(m_szTelemetryFrame, sizeof(m_szTelemetryFrame)) > 0)
+    {
+      m_events.send(m_szTelemetryFrame, "delta", nGeneration);
+    }
+
+    m_telemetry.commit();
+  }
 }
 
 CPwmFanControl *CControllerServer::getFanCtrl(uint8_t nIndex /* = 0*/)
@@ -50,14 +604,23 @@ CPwmFanControl *CControllerServer::getFanCtrl(uint8_t nIndex /* = 0*/)
   return pReturn;
 }
 
-void CControllerServer::setReponseHeaders(AsyncWebServerResponse *pResponse)
+void CControllerServer::setReponseHeaders(AsyncWebServerResponse *pResponse, bool bRevalidate /* = false*/)
 {
   if (pResponse != NULL)
   {
-    // Add no cache headers
-    pResponse->addHeader("Cache-Control", "private, no-cache, no-store, must-revalidate, no-transform");
-    pResponse->addHeader("Expires", "Thu, 01 Jan 1970 00:00:00 GMT");
-    pResponse->addHeader("Pragma", "no-cache");
+    if (bRevalidate)
+    {
+      // Let clients keep the body but check the ETag every time
+      pResponse->addHeader("Cache-Control", "private, no-cache, no-transform");
+      pResponse->addHeader("Access-Control-Expose-Headers", "ETag");
+    }
+    else
+    {
+      // Add no cache headers
+      pResponse->addHeader("Cache-Control", "private, no-cache, no-store, must-revalidate, no-transform");
+      pResponse->addHeader("Expires", "Thu, 01 Jan 1970 00:00:00 GMT");
+      pResponse->addHeader("Pragma", "no-cache");
+    }
     // Add CORS headers
     pResponse->addHeader("Access-Control-Allow-Credentials", "true");
     pResponse->addHeader("Access-Control-Allow-Headers", "*");
@@ -67,45 +630,118 @@ void CControllerServer::setReponseHeaders(AsyncWebServerResponse *pResponse)
   }
 }
 
+void CControllerServer::refreshStatusBody(bool bCbor)
+{
+  uint32_t nGeneration = (m_pTempSensors != NULL) ? m_pTempSensors->getGeneration() : 0;
+
+  if (!m_bHaveStatusSample || (nGeneration != m_nStatusGeneration))
+  {
+    m_statusTelemetry.sample();
+    m_nStatusGeneration = m_statusTelemetry.getGeneration();
+    m_bHaveStatusSample = true;
+    m_bStatusJsonValid = false;
+    m_bStatusCborValid = false;
+  }
+
+  if (bCbor && !m_bStatusCborValid)
+  {
+    m_nStatusCborLen = m_statusTelemetry.writeCbor(m_arrStatusCbor, sizeof(m_arrStatusCbor));
+    m_bStatusCborValid = true;
+  }
+  else if (!bCbor && !m_bStatusJsonValid)
+  {
+    m_nStatusBodyLen = m_statusTelemetry.writeFull(m_szStatusBody, sizeof(m_szStatusBody));
+    m_bStatusJsonValid = true;
+  }
+}
+
 void CControllerServer::onReqStatus(AsyncWebServerRequest *pRequest)
 {
   if (pRequest != NULL)
   {
-    AsyncJsonResponse *pResponse = new AsyncJsonResponse();
+    uint32_t nStartMicros = micros();
 
-    setReponseHeaders(pResponse);
+    AsyncWebHeader *pAccept = pRequest->getHeader("Accept");
+    bool bCbor = (pAccept != NULL) && (strstr(pAccept->value().c_str(), "application/cbor") != NULL);
+
+    refreshStatusBody(bCbor);
+
+    // Each encoding is its own representation, so they get distinct ETags
+    char szEtag[32];
+    snprintf(szEtag, sizeof(szEtag), "\"%08x-%u%s\"", m_nEtagSalt, m_nStatusGeneration, bCbor ? "-c" : "");
 
-    // Create response JSON
-    const JsonObject &root = pResponse->getRoot();
-    const JsonArray &arrFans = root.createNestedArray("fans");
-    for (uint8_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+    const uint8_t *pBody = bCbor ? m_arrStatusCbor : (const uint8_t *)m_szStatusBody;
+    size_t nBodyLen = bCbor ? m_nStatusCborLen : m_nStatusBodyLen;
+
+    if (nBodyLen == 0)
     {
-      CPwmFanControl *pFanCtrl = getFanCtrl(nIndex);
-      if (pFanCtrl != NULL)
-      {
-        const JsonObject &objFan1 = arrFans.createNestedObject();
-        objFan1["rpm"] = pFanCtrl->getFanRpms();
-        objFan1["duty"] = pFanCtrl->getLastDutyCyclePercent();
-      }
+      // The encoder ran out of buffer; nothing here a client should cache
+      sendJsonError(pRequest, 500, "status body truncated");
     }
-    const JsonObject &objTempSensors = root.createNestedObject("tempSensors");
-    objTempSensors["maxTempF"] = -999.0;
-    objTempSensors["maxTempC"] = -999.0;
-    const JsonArray &arrTempSensors = objTempSensors.createNestedArray("sensors");
-    if (m_pTempSensors != NULL)
+    else
     {
-      objTempSensors["maxTempF"] = m_pTempSensors->getMaxTempF();
-      objTempSensors["maxTempC"] = m_pTempSensors->getMaxTempC();
-      uint8_t nNumTempSensors = m_pTempSensors->getNumSensors();
-      for (int nIndex = 0; nIndex < nNumTempSensors; nIndex++)
+      AsyncWebServerResponse *pResponse = NULL;
+
+      AsyncWebHeader *pIfNoneMatch = pRequest->getHeader("If-None-Match");
+      if ((pIfNoneMatch != NULL) && (strcmp(pIfNoneMatch->value().c_str(), szEtag) == 0))
       {
-        const JsonObject &objTemp = arrTempSensors.createNestedObject();
-        objTemp["tempF"] = m_pTempSensors->getTempF(nIndex);
-        objTemp["tempC"] = m_pTempSensors->getTempC(nIndex);
+        pResponse = pRequest->beginResponse(304);
+        m_nStatusNotModified++;
       }
+      else
+      {
+        // Copied into the response, which may outlive this generation's
+        // buffer, but no JSON tree and no re-serializing
+        AsyncResponseStream *pStream = pRequest->beginResponseStream(bCbor ? "application/cbor" : "application/json", nBodyLen);
+        pStream->write(pBody, nBodyLen);
+        pResponse = pStream;
+      }
+
+      setReponseHeaders(pResponse, true);
+      pResponse->addHeader("ETag", szEtag);
+      pResponse->addHeader("Vary", "Accept");
+      pRequest->send(pResponse);
     }
 
-    pResponse->setLength();
-    pRequest->send(pResponse);
+    uint32_t nHandlerMicros = micros() - nStartMicros;
+    m_nLastStatusHandlerMicros = nHandlerMicros;
+    if (nHandlerMicros > m_nMaxStatusHandlerMicros)
+    {
+      m_nMaxStatusHandlerMicros = nHandlerMicros;
+    }
+    if (m_nStatusRequests == 0)
+    {
+      m_fAvgStatusHandlerMicros = nHandlerMicros;
+    }
+    else
+    {
+      m_fAvgStatusHandlerMicros = m_fAvgStatusHandlerMicros + ((float)nHandlerMicros - m_fAvgStatusHandlerMicros) / 16.0;
+    }
+    m_nStatusRequests++;
   }
 }
+
+uint32_t CControllerServer::getStatusRequests()
+{
+  return m_nStatusRequests;
+}
+
+uint32_t CControllerServer::getStatusNotModified()
+{
+  return m_nStatusNotModified;
+}
+
+uint32_t CControllerServer::getLastStatusHandlerMicros()
+{
+  return m_nLastStatusHandlerMicros;
+}
+
+uint32_t CControllerServer::getMaxStatusHandlerMicros()
+{
+  return m_nMaxStatusHandlerMicros;
+}
+
+float CControllerServer::getAvgStatusHandlerMicros()
+{
+  return m_fAvgStatusHandlerMicros;
+}
@@ -3,8 +3,16 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
 #include <CPwmFanControl.h>
 #include <CTempSensors.h>
+#include <CTelemetry.h>
+#include <CFanScheduler.h>
+#include <CHistoryRecorder.h>
+#include <CLogStorage.h>
+#include <CHotPathBench.h>
+#include <CMicroBench.h>
+#include <CPerfMonitor.h>
 
 class CControllerServer
 {
@@ -13,11 +21,36 @@ public:
   ~CControllerServer();
 
   void begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors);
+  void setFanScheduler(CFanScheduler *pFanScheduler);
+  void setHistory(CHistoryRecorder *pHistory);
+  void setFlashLogStorage(CLogStorage *pLogStorage);
+  void setHotPathBench(CHotPathBench *pHotPathBench, CMicroBench *pBootResults = 0);
+  void setPerfMonitor(CPerfMonitor *pPerfMonitor);
+
+  uint32_t getStatusRequests();
+  uint32_t getStatusNotModified();
+  uint32_t getLastStatusHandlerMicros();
+  uint32_t getMaxStatusHandlerMicros();
+  float getAvgStatusHandlerMicros();
 
 protected:
   void onReqStatus(AsyncWebServerRequest *pRequest);
+  void onReqMetrics(AsyncWebServerRequest *pRequest);
+  void onReqHistory(AsyncWebServerRequest *pRequest);
+  void onReqLog(AsyncWebServerRequest *pRequest);
+  void onReqBinaryLog(AsyncWebServerRequest *pRequest);
+  void onReqGetSettings(AsyncWebServerRequest *pRequest);
+  void onReqPostSettings(AsyncWebServerRequest *pRequest, JsonVariant &json);
+  void onReqBench(AsyncWebServerRequest *pRequest);
+  void onReqPerf(AsyncWebServerRequest *pRequest);
+  void onEventsConnect(AsyncEventSourceClient *pClient);
+
+  static void taskTelemetry(void *pvParam);
+  void broadcastTelemetry();
 
-  void setReponseHeaders(AsyncWebServerResponse *pResponse);
+  void setReponseHeaders(AsyncWebServerResponse *pResponse, bool bRevalidate = false);
+  void refreshStatusBody(bool bCbor);
+  void sendJsonError(AsyncWebServerRequest *pRequest, int nCode, const char *pszError);
 
   CPwmFanControl *getFanCtrl(uint8_t nIndex = 0);
 
@@ -25,7 +58,46 @@ private:
   CPwmFanControl **m_arrFanCtrl = NULL;
   size_t m_nNumFans = 0;
   CTempSensors *m_pTempSensors = NULL;
+  CFanScheduler *m_pFanScheduler = NULL;
+  CHistoryRecorder *m_pHistory = NULL;
+  CLogStorage *m_pLogStorage = NULL;
   AsyncWebServer m_server;
+
+  // /bench runs the live suite into m_bench on each request
+  CHotPathBench *m_pHotPathBench = NULL;
+  CMicroBench *m_pBootBenchResults = NULL;
+  CMicroBench m_bench;
+  char m_szBenchJson[2048] = {};
+
+  CPerfMonitor *m_pPerfMonitor = NULL;
+  char m_szPerfJson[4096] = {};
+
+  // Server-Sent Events telemetry push on /events. One frame is serialized
+  // per sample generation and fanned out to every subscriber.
+  AsyncEventSource m_events;
+  CTelemetry m_telemetry;
+  TaskHandle_t m_hTelemetryTask = NULL;
+  volatile bool m_bForceKeyframe = true;
+  char m_szTelemetryFrame[1024] = {};
+
+  // /status bodies, serialized at most once per sample generation and
+  // only in the encodings actually requested. Each response gets its own
+  // copy, so a slow client never sees a body overwritten under it.
+  CTelemetry m_statusTelemetry;
+  char m_szStatusBody[1024] = {};
+  size_t m_nStatusBodyLen = 0;
+  uint8_t m_arrStatusCbor[256] = {};
+  size_t m_nStatusCborLen = 0;
+  bool m_bHaveStatusSample = false;
+  bool m_bStatusJsonValid = false;
+  bool m_bStatusCborValid = false;
+  uint32_t m_nStatusGeneration = 0;
+  uint32_t m_nEtagSalt = 0;
+  volatile uint32_t m_nStatusRequests = 0;
+  volatile uint32_t m_nStatusNotModified = 0;
+  volatile uint32_t m_nLastStatusHandlerMicros = 0;
+  volatile uint32_t m_nMaxStatusHandlerMicros = 0;
+  volatile float m_fAvgStatusHandlerMicros = 0.0;
 };
 
 #endif // #ifndef __CCONTROLLERSERVER_H__
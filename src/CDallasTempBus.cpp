@@ -0,0 +1,126 @@
+#include <CDallasTempBus.h>
+
+CDallasTempBus::CDallasTempBus(OneWire *pOneWire)
+    : m_sensors(pOneWire)
+{
+  m_pOneWire = pOneWire;
+}
+
+bool CDallasTempBus::begin()
+{
+  m_sensors.begin();
+
+  return true;
+}
+
+uint8_t CDallasTempBus::discover(DeviceAddress *arrAddresses, const uint8_t nMaxAddresses)
+{
+  uint8_t nReturn = 0;
+
+  DeviceAddress deviceAddress = {};
+
+  memset(deviceAddress, 0, sizeof(deviceAddress));
+  m_pOneWire->reset_search();
+  m_pOneWire->search(deviceAddress);
+  m_pOneWire->reset_search();
+
+  while (nReturn < nMaxAddresses && m_pOneWire->search(deviceAddress))
+  {
+    if (m_sensors.validAddress(deviceAddress))
+    {
+      if (m_sensors.validFamily(deviceAddress))
+      {
+        memcpy(arrAddresses[nReturn++], deviceAddress, sizeof(deviceAddress));
+      }
+    }
+
+    memset(deviceAddress, 0, sizeof(deviceAddress));
+  }
+
+  return nReturn;
+}
+
+bool CDallasTempBus::setResolution(const uint8_t *pAddress, const uint8_t nBits)
+{
+  return m_sensors.setResolution(pAddress, nBits, true);
+}
+
+uint32_t CDallasTempBus::getConversionTimeMs(const uint8_t nBits)
+{
+  return m_sensors.millisToWaitForConversion(nBits);
+}
+
+void CDallasTempBus::setWaitForConversion(const bool bWait)
+{
+  m_sensors.setWaitForConversion(bWait);
+}
+
+void CDallasTempBus::requestTemperatures()
+{
+  uint32_t nStart = micros();
+  m_sensors.requestTemperatures();
+  recordTiming(&m_stats.convert, micros() - nStart);
+}
+
+void CDallasTempBus::requestTemperature(const uint8_t *pAddress)
+{
+  uint32_t nStart = micros();
+  m_sensors.requestTemperaturesByAddress(pAddress);
+  recordTiming(&m_stats.convert, micros() - nStart);
+}
+
+int32_t CDallasTempBus::getTempRaw(const uint8_t *pAddress)
+{
+  uint32_t nStart = micros();
+  int32_t nReturn = m_sensors.getTemp(pAddress);
+  recordTiming(&m_stats.read, micros() - nStart);
+
+  // DallasTemperature reports a bad CRC and a silent bus alike; a reset
+  // tells them apart (only on this path, so good reads cost nothing extra)
+  if (nReturn == DEVICE_DISCONNECTED_RAW)
+  {
+    if (m_pOneWire->reset())
+    {
+      m_stats.nCrcErrors++;
+    }
+    else
+    {
+      m_stats.nNoPresence++;
+    }
+  }
+
+  return nReturn;
+}
+
+bool CDallasTempBus::isParasitePowered()
+{
+  return m_sensors.isParasitePowerMode();
+}
+
+// Written by the temperature task only; readers may see one record torn
+bool CDallasTempBus::getStats(TempBusStats *pStats)
+{
+  *pStats = m_stats;
+
+  return true;
+}
+
+void CDallasTempBus::recordTiming(TempBusTiming *pTiming, uint32_t nMicros)
+{
+  pTiming->nLastMicros = nMicros;
+  if (nMicros > pTiming->nMaxMicros)
+  {
+    pTiming->nMaxMicros = nMicros;
+  }
+
+  if (pTiming->nCount == 0)
+  {
+    pTiming->fAvgMicros = nMicros;
+  }
+  else
+  {
+    pTiming->fAvgMicros = pTiming->fAvgMicros + ((float)nMicros - pTiming->fAvgMicros) / 16.0f;
+  }
+
+  pTiming->nCount++;
+}
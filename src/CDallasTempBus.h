@@ -0,0 +1,33 @@
+#ifndef __CDALLASTEMPBUS_H__
+#define __CDALLASTEMPBUS_H__
+
+#include <Arduino.h>
+#include <DallasTemperature.h>
+#include <CTempBus.h>
+
+// DS18B20 sensors on a OneWire bus, through DallasTemperature
+class CDallasTempBus : public CTempBus
+{
+public:
+  CDallasTempBus(OneWire *pOneWire);
+
+  bool begin();
+  uint8_t discover(DeviceAddress *arrAddresses, const uint8_t nMaxAddresses);
+  bool setResolution(const uint8_t *pAddress, const uint8_t nBits);
+  uint32_t getConversionTimeMs(const uint8_t nBits);
+  void setWaitForConversion(const bool bWait);
+  void requestTemperatures();
+  void requestTemperature(const uint8_t *pAddress);
+  int32_t getTempRaw(const uint8_t *pAddress);
+  bool isParasitePowered();
+  bool getStats(TempBusStats *pStats);
+
+private:
+  static void recordTiming(TempBusTiming *pTiming, uint32_t nMicros);
+
+  OneWire *m_pOneWire = NULL;
+  DallasTemperature m_sensors;
+  TempBusStats m_stats = {};
+};
+
+#endif // #ifndef __CDALLASTEMPBUS_H__
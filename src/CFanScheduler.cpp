@@ -0,0 +1,475 @@
+#include <CFanScheduler.h>
+#include <CBinaryLog.h>
+
+// Longest gap, in nominal tick periods, the PID integrates over in one tick
+#define FAN_SCHEDULER_MAX_DT_PERIODS 4
+
+CFanScheduler::CFanScheduler(FanControlSettings *arrFanControls, size_t nNumFans, uint32_t nWatchdogMs /* = 2000*/)
+    : m_taskPerf("taskFanScheduler"),
+      m_periodicTick("taskFanScheduler")
+{
+  m_arrFanControls = arrFanControls;
+  m_nNumFans = (arrFanControls != NULL) ? nNumFans : 0;
+  m_nWatchdogMs = nWatchdogMs;
+}
+
+CFanScheduler::~CFanScheduler()
+{
+  if (m_arrFanStates != NULL)
+  {
+    for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+    {
+      delete m_arrFanStates[nIndex].pPid;
+    }
+    delete[] m_arrFanStates;
+    m_arrFanStates = NULL;
+  }
+}
+
+// A non-zero period ticks at that fixed rate instead of on new samples.
+// Call before begin() or init().
+// The temperature task's period, which adds a guard to the conversion time
+void CFanScheduler::setSamplePeriodMs(const uint32_t nSamplePeriodMs)
+{
+  m_nSamplePeriodMs = nSamplePeriodMs;
+}
+
+void CFanScheduler::setTickPeriodMs(const uint32_t nTickPeriodMs)
+{
+  m_nTickPeriodMs = nTickPeriodMs;
+  if (nTickPeriodMs > 0)
+  {
+    m_periodicTick.setPeriodMs(nTickPeriodMs);
+  }
+}
+
+void CFanScheduler::begin(const int nCore, const uint32_t nPriority /* = 0*/, const uint32_t nStackSize /* = 3000*/)
+{
+  init();
+
+  halTaskCreate(
+      CFanScheduler::taskFanScheduler, // Function that should be called
+      "taskFanScheduler",              // Name of the task (for debugging)
+      nStackSize,                      // Stack size (bytes)
+      this,                            // Parameter to pass
+      nPriority,                       // Task priority
+      &m_hTask,                        // Task handle
+      nCore                            // Core you want to run the task on (0 or 1)
+  );
+
+  // Subscribe to every temperature source the table uses
+  for (size_t nIndex = 0; (m_nTickPeriodMs == 0) && (nIndex < m_nNumFans); nIndex++)
+  {
+    CTempSensors *pTempSensors = m_arrFanControls[nIndex].pTempSensors;
+
+    bool bSubscribed = false;
+    for (size_t nPrev = 0; nPrev < nIndex; nPrev++)
+    {
+      bSubscribed = bSubscribed || (m_arrFanControls[nPrev].pTempSensors == pTempSensors);
+    }
+
+    if ((pTempSensors != NULL) && !bSubscribed)
+    {
+      pTempSensors->addSampleListener(m_hTask);
+    }
+  }
+}
+
+// Sets up every fan in the table without starting the task, for callers
+// that drive tick() themselves (the native simulation). begin() calls it.
+void CFanScheduler::init()
+{
+  if (m_arrFanStates == NULL)
+  {
+    if (m_nTickPeriodMs > 0)
+    {
+      m_nNominalDtMicros = m_nTickPeriodMs * 1000;
+    }
+    else if (m_nSamplePeriodMs > 0)
+    {
+      m_nNominalDtMicros = max(m_nSamplePeriodMs, (uint32_t)100) * 1000;
+    }
+    else if ((m_nNumFans > 0) && (m_arrFanControls[0].pTempSensors != NULL))
+    {
+      m_nNominalDtMicros = max(m_arrFanControls[0].pTempSensors->getConversionTimeMs(), (uint32_t)100) * 1000;
+    }
+    m_fDtSec = (float)m_nNominalDtMicros / 1000000.0f;
+
+    m_arrFanStates = new FanControlState[m_nNumFans]{};
+    for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+    {
+      initFan(nIndex);
+    }
+  }
+}
+
+void CFanScheduler::taskFanScheduler(void *pvParam)
+{
+  CFanScheduler *pThis = (CFanScheduler *)pvParam;
+
+  pThis->m_taskPerf.attach();
+
+  for (;;)
+  {
+    if (pThis->m_nTickPeriodMs > 0)
+    {
+      pThis->m_periodicTick.wait();
+      pThis->m_taskPerf.loopStart();
+      pThis->tick();
+      pThis->measureLatency();
+    }
+    else if (halTaskNotifyTake(pThis->m_nWatchdogMs) > 0)
+    {
+      pThis->m_taskPerf.loopStart();
+      pThis->tick();
+      pThis->measureLatency();
+    }
+    else
+    {
+      pThis->m_taskPerf.loopStart();
+      pThis->m_nWatchdogTimeouts++;
+      pThis->tick();
+    }
+    pThis->m_taskPerf.loopEnd();
+  }
+
+  halTaskDeleteSelf();
+}
+
+void CFanScheduler::initFan(size_t nIndex)
+{
+  FanControlSettings *pSettings = &m_arrFanControls[nIndex];
+  FanControlState *pState = &m_arrFanStates[nIndex];
+
+  if (pSettings->pFanSettings != NULL &&
+      pSettings->pFanCtrl != NULL &&
+      pSettings->pTempSensors != NULL)
+  {
+    // The table's settings are generation 0; later ones are published
+    pState->active = *pSettings->pFanSettings;
+    pState->arrSlots[0] = pState->active;
+    pState->nPublished = 0;
+    pState->nAppliedGeneration = 0;
+
+    // Ramps are fed one segment per tick, and ticks follow temperature
+    // samples unless there's a fixed tick period. A segment shorter than the
+    // tick would leave the fan idle at the end of each one.
+    uint32_t nTickMs = m_nTickPeriodMs;
+    if (nTickMs == 0)
+    {
+      nTickMs = (m_nSamplePeriodMs > 0) ? m_nSamplePeriodMs : pSettings->pTempSensors->getConversionTimeMs();
+    }
+    pSettings->pFanCtrl->setFadeSegmentMs(nTickMs);
+
+    // Ticks pass their measured dt; the sample time is only the default
+    pState->pPid = new CPidController(pState->active.fPidKp,
+                                      pState->active.fPidKi,
+                                      pState->active.fPidKd,
+                                      PID_DIRECTION_REVERSE,
+                                      max(nTickMs, (uint32_t)100));
+
+    // Output is in percent so the gains don't depend on the PWM resolution
+    pState->pPid->setOutputLimits(0.0f, 100.0f);
+
+    applyFanSettings(nIndex);
+  }
+}
+
+// Pushes the fan's active settings into its controller and PID. Only
+// called from initFan() and the scheduler task, so nothing else touches
+// either while it runs.
+void CFanScheduler::applyFanSettings(size_t nIndex)
+{
+  FanControlSettings *pSettings = &m_arrFanControls[nIndex];
+  FanControlState *pState = &m_arrFanStates[nIndex];
+  const FanSettings *pActive = &pState->active;
+
+  pSettings->pFanCtrl->setMinFanDutyCyclePercent(pActive->fMinFanDutyCyclePercent);
+  pSettings->pFanCtrl->setFanOffDutyCyclePercent(pActive->fFanOffDutyCyclePercent);
+  pSettings->pFanCtrl->setAllowOff(pActive->bAllowOff);
+  pSettings->pFanCtrl->setFanMinRuntimeMs(pActive->nFanMinRuntimeMs);
+  pSettings->pFanCtrl->setRampRates(pActive->fRampUpPercentPerSec, pActive->fRampDownPercentPerSec);
+
+  // Both are bumpless: the integral takes up the step in proportional
+  // action from new gains or a new setpoint, and the derivative is on the
+  // measurement so a setpoint step doesn't kick through it either
+  pState->pPid->setTunings(pActive->fPidKp, pActive->fPidKi, pActive->fPidKd);
+  pState->pPid->setSetpoint(pActive->fPidSetpoint);
+}
+
+// Copies the fan's published settings. Same protocol as the temperature
+// snapshots: the writer only fills the idle slot, so a copy can only tear
+// if the published word changes while it's being made.
+void CFanScheduler::readPublished(FanControlState *pState, FanSettings *pSettings, uint32_t *pnPublished)
+{
+  uint32_t nPublished = 0;
+
+  do
+  {
+    nPublished = pState->nPublished;
+    __sync_synchronize();
+    *pSettings = pState->arrSlots[nPublished & 1];
+    __sync_synchronize();
+  } while (pState->nPublished != nPublished);
+
+  if (pnPublished != NULL)
+  {
+    *pnPublished = nPublished;
+  }
+}
+
+void CFanScheduler::controlFan(size_t nIndex)
+{
+  FanControlSettings *pSettings = &m_arrFanControls[nIndex];
+  FanControlState *pState = &m_arrFanStates[nIndex];
+
+  if (pState->pPid != NULL)
+  {
+    // Pick up newly published settings before computing with them
+    if ((pState->nPublished >> 1) != pState->nAppliedGeneration)
+    {
+      uint32_t nPublished = 0;
+      readPublished(pState, &pState->active, &nPublished);
+      pState->nAppliedGeneration = nPublished >> 1;
+      applyFanSettings(nIndex);
+      m_nSettingsApplied++;
+      BLOG("fan %u: settings generation %u applied", (uint32_t)nIndex, pState->nAppliedGeneration);
+    }
+
+    float fTemp = 0.0;
+    if (pSettings->bUseMaxTemp)
+    {
+      fTemp = pSettings->pTempSensors->getMaxTempF();
+    }
+    else
+    {
+      fTemp = pSettings->pTempSensors->getTempF(pSettings->nTempSensorIndex);
+    }
+
+    // Start from the first real reading so the derivative doesn't kick
+    if (!pState->pPid->isAutomatic())
+    {
+      pState->pPid->setAutomatic(true, fTemp, 0.0f);
+    }
+
+    float fOutputDutyPercent = pState->pPid->compute(fTemp, m_fDtSec);
+
+    bool bFullSpeed = (fTemp >= pState->active.fFullSpeedTemp);
+    if (bFullSpeed)
+    {
+      pSettings->pFanCtrl->setFullSpeed();
+    }
+    else
+    {
+      pSettings->pFanCtrl->setFanDutyCyclePercent(fOutputDutyPercent);
+    }
+
+    // Every tick goes to the flight recorder; it's a few stores, not a printf
+    BLOG("fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", (uint32_t)nIndex, fTemp, fOutputDutyPercent, pSettings->pFanCtrl->getLastDutyCyclePercent(), (uint32_t)bFullSpeed);
+  }
+}
+
+void CFanScheduler::tick()
+{
+  uint32_t nStartMicros = halMicros();
+
+  // The PID integrates over the time since the previous tick as measured.
+  // The first tick uses the nominal period, and a long stall is capped so
+  // one tick can't wind the integral up by minutes.
+  uint32_t nDtMicros = m_nNominalDtMicros;
+  if (m_nTickCount > 0)
+  {
+    nDtMicros = min(nStartMicros - m_nLastTickStartMicros, m_nNominalDtMicros * FAN_SCHEDULER_MAX_DT_PERIODS);
+  }
+  m_nLastTickStartMicros = nStartMicros;
+  m_fDtSec = (float)nDtMicros / 1000000.0f;
+
+  m_nLastDtMicros = nDtMicros;
+  if (nDtMicros > m_nMaxDtMicros)
+  {
+    m_nMaxDtMicros = nDtMicros;
+  }
+
+  for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    controlFan(nIndex);
+  }
+
+  uint32_t nTickMicros = halMicros() - nStartMicros;
+
+  m_nLastTickMicros = nTickMicros;
+  if (nTickMicros > m_nMaxTickMicros)
+  {
+    m_nMaxTickMicros = nTickMicros;
+  }
+
+  // Exponential moving average, 1/16 weight for the newest tick
+  if (m_nTickCount == 0)
+  {
+    m_fAvgTickMicros = nTickMicros;
+  }
+  else
+  {
+    m_fAvgTickMicros = m_fAvgTickMicros + ((float)nTickMicros - m_fAvgTickMicros) / 16.0;
+  }
+
+  m_nTickCount++;
+}
+
+// Time from the temperature sample being published to the duty cycles
+// derived from it being written
+void CFanScheduler::measureLatency()
+{
+  if (m_nNumFans > 0 && m_arrFanControls[0].pTempSensors != NULL)
+  {
+    uint32_t nLatencyMicros = halMicros() - m_arrFanControls[0].pTempSensors->getLastSampleMicros();
+
+    m_nLastLatencyMicros = nLatencyMicros;
+    if (nLatencyMicros > m_nMaxLatencyMicros)
+    {
+      m_nMaxLatencyMicros = nLatencyMicros;
+    }
+
+    if (m_nLatencySamples == 0)
+    {
+      m_fAvgLatencyMicros = nLatencyMicros;
+    }
+    else
+    {
+      m_fAvgLatencyMicros = m_fAvgLatencyMicros + ((float)nLatencyMicros - m_fAvgLatencyMicros) / 16.0;
+    }
+
+    m_nLatencySamples++;
+  }
+}
+
+size_t CFanScheduler::getNumFans()
+{
+  return m_nNumFans;
+}
+
+FanControlSettings *CFanScheduler::getFanControl(size_t nIndex)
+{
+  FanControlSettings *pReturn = NULL;
+
+  if (nIndex < m_nNumFans)
+  {
+    pReturn = &m_arrFanControls[nIndex];
+  }
+
+  return pReturn;
+}
+
+// Validate before publishing; this only copies. Returns false if the fan
+// isn't running under the scheduler.
+bool CFanScheduler::publishFanSettings(size_t nIndex, const FanSettings &settings)
+{
+  bool bReturn = false;
+
+  if ((m_arrFanStates != NULL) && (nIndex < m_nNumFans) && (m_arrFanStates[nIndex].pPid != NULL))
+  {
+    FanControlState *pState = &m_arrFanStates[nIndex];
+    uint32_t nPublished = pState->nPublished;
+    uint8_t nNext = (nPublished & 1) ^ 1;
+
+    pState->arrSlots[nNext] = settings;
+
+    // The slot has to land before the word that publishes it
+    __sync_synchronize();
+    pState->nPublished = ((((nPublished >> 1) + 1) << 1) | nNext);
+    m_nSettingsGeneration++;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+// The most recently published settings, which the scheduler may not have
+// picked up yet
+bool CFanScheduler::getFanSettings(size_t nIndex, FanSettings *pSettings)
+{
+  bool bReturn = false;
+
+  if ((pSettings != NULL) && (m_arrFanStates != NULL) && (nIndex < m_nNumFans) && (m_arrFanStates[nIndex].pPid != NULL))
+  {
+    readPublished(&m_arrFanStates[nIndex], pSettings, NULL);
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+// Bumped by every publish, across all fans
+uint32_t CFanScheduler::getSettingsGeneration()
+{
+  return m_nSettingsGeneration;
+}
+
+// Count of publishes the scheduler has applied
+uint32_t CFanScheduler::getSettingsApplied()
+{
+  return m_nSettingsApplied;
+}
+
+uint32_t CFanScheduler::getTickCount()
+{
+  return m_nTickCount;
+}
+
+uint32_t CFanScheduler::getLastTickMicros()
+{
+  return m_nLastTickMicros;
+}
+
+uint32_t CFanScheduler::getMaxTickMicros()
+{
+  return m_nMaxTickMicros;
+}
+
+float CFanScheduler::getAvgTickMicros()
+{
+  return m_fAvgTickMicros;
+}
+
+uint32_t CFanScheduler::getWatchdogTimeouts()
+{
+  return m_nWatchdogTimeouts;
+}
+
+uint32_t CFanScheduler::getLastLatencyMicros()
+{
+  return m_nLastLatencyMicros;
+}
+
+uint32_t CFanScheduler::getMaxLatencyMicros()
+{
+  return m_nMaxLatencyMicros;
+}
+
+float CFanScheduler::getAvgLatencyMicros()
+{
+  return m_fAvgLatencyMicros;
+}
+
+// Time the PID integrated over on the last tick
+uint32_t CFanScheduler::getLastDtMicros()
+{
+  return m_nLastDtMicros;
+}
+
+uint32_t CFanScheduler::getMaxDtMicros()
+{
+  return m_nMaxDtMicros;
+}
+
+// Loop timing of the scheduler task, for CPerfMonitor
+CTaskPerf *CFanScheduler::getTaskPerf()
+{
+  return &m_taskPerf;
+}
+
+// Only ticks with setTickPeriodMs()
+CPeriodicTick *CFanScheduler::getPeriodicTick()
+{
+  return &m_periodicTick;
+}
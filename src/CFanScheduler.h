@@ -0,0 +1,107 @@
+#ifndef __CFANSCHEDULER_H__
+#define __CFANSCHEDULER_H__
+
+#include <Hal.h>
+#include <CPidController.h>
+#include <CPwmFanControl.h>
+#include <CTempSensors.h>
+#include <CTaskPerf.h>
+#include <CPeriodicTick.h>
+#include <FanSettings.h>
+
+// Runs the PID loops for every fan in a FanControlSettings table from a
+// single task, one pass over the table per tick. Ticks are driven by new
+// temperature samples; if none arrive within the watchdog timeout the
+// scheduler ticks anyway so the full speed and min runtime logic still run.
+// setSamplePeriodMs() tells it how often samples arrive when that's longer
+// than the conversion time. setTickPeriodMs() switches to ticking at a
+// fixed rate on a CPeriodicTick instead. Either way the PID integrates over the measured time since the
+// previous tick, not an assumed interval.
+//
+// Settings can be replaced while it runs. publishFanSettings() copies into
+// the fan's idle slot and then flips a generation word; the next tick sees
+// the new generation, copies the slot and applies it (PID tuning and
+// setpoint changes are bumpless). Neither side waits on the other, so a publish never stalls the
+// loop and takes effect within one control period. Publishing is meant for
+// a single writer task at a time.
+class CFanScheduler
+{
+public:
+  CFanScheduler(FanControlSettings *arrFanControls, size_t nNumFans, uint32_t nWatchdogMs = 2000);
+  ~CFanScheduler();
+
+  void setSamplePeriodMs(const uint32_t nSamplePeriodMs);
+  void setTickPeriodMs(const uint32_t nTickPeriodMs);
+  void begin(const int nCore, const uint32_t nPriority = 0, const uint32_t nStackSize = 3000);
+  void init();
+  void tick();
+
+  size_t getNumFans();
+  FanControlSettings *getFanControl(size_t nIndex);
+
+  bool publishFanSettings(size_t nIndex, const FanSettings &settings);
+  bool getFanSettings(size_t nIndex, FanSettings *pSettings);
+  uint32_t getSettingsGeneration();
+  uint32_t getSettingsApplied();
+
+  uint32_t getTickCount();
+  uint32_t getLastTickMicros();
+  uint32_t getMaxTickMicros();
+  float getAvgTickMicros();
+  uint32_t getLastDtMicros();
+  uint32_t getMaxDtMicros();
+
+  uint32_t getWatchdogTimeouts();
+  uint32_t getLastLatencyMicros();
+  uint32_t getMaxLatencyMicros();
+  float getAvgLatencyMicros();
+
+  CTaskPerf *getTaskPerf();
+  CPeriodicTick *getPeriodicTick();
+
+private:
+  typedef struct FanControlState
+  {
+    CPidController *pPid;
+    // Published settings: (generation << 1) | slot
+    FanSettings arrSlots[2];
+    volatile uint32_t nPublished;
+    uint32_t nAppliedGeneration;
+    FanSettings active;
+  } FanControlState;
+
+  static void taskFanScheduler(void *pvParam);
+  void initFan(size_t nIndex);
+  void controlFan(size_t nIndex);
+  void readPublished(FanControlState *pState, FanSettings *pSettings, uint32_t *pnPublished);
+  void applyFanSettings(size_t nIndex);
+  void measureLatency();
+
+  FanControlSettings *m_arrFanControls = NULL;
+  FanControlState *m_arrFanStates = NULL;
+  size_t m_nNumFans = 0;
+  uint32_t m_nWatchdogMs = 2000;
+  HalTaskHandle m_hTask = NULL;
+  CTaskPerf m_taskPerf;
+  uint32_t m_nSamplePeriodMs = 0; // 0 = the conversion time
+  uint32_t m_nTickPeriodMs = 0;   // 0 = tick on new temperature samples
+  CPeriodicTick m_periodicTick;
+  uint32_t m_nNominalDtMicros = 100000;
+  uint32_t m_nLastTickStartMicros = 0;
+  float m_fDtSec = 0.1f;
+  volatile uint32_t m_nLastDtMicros = 0;
+  volatile uint32_t m_nMaxDtMicros = 0;
+  volatile uint32_t m_nTickCount = 0;
+  volatile uint32_t m_nLastTickMicros = 0;
+  volatile uint32_t m_nMaxTickMicros = 0;
+  volatile float m_fAvgTickMicros = 0.0;
+  volatile uint32_t m_nWatchdogTimeouts = 0;
+  volatile uint32_t m_nSettingsGeneration = 0;
+  volatile uint32_t m_nSettingsApplied = 0;
+  volatile uint32_t m_nLatencySamples = 0;
+  volatile uint32_t m_nLastLatencyMicros = 0;
+  volatile uint32_t m_nMaxLatencyMicros = 0;
+  volatile float m_fAvgLatencyMicros = 0.0;
+};
+
+#endif // #ifndef __CFANSCHEDULER_H__
@@ -0,0 +1,97 @@
+#include <CFileLogStorage.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+CFileLogStorage::CFileLogStorage(const char *pszDir, uint8_t nNumSegments /* = 16*/, uint32_t nSegmentSize /* = 32768*/)
+    : m_nNumSegments(nNumSegments),
+      m_nSegmentSize(nSegmentSize)
+{
+  snprintf(m_szDir, sizeof(m_szDir), "%s", (pszDir != NULL) ? pszDir : ".");
+}
+
+bool CFileLogStorage::begin()
+{
+  struct stat info;
+
+  if (stat(m_szDir, &info) != 0)
+  {
+    mkdir(m_szDir, 0755);
+  }
+
+  return (stat(m_szDir, &info) == 0) && S_ISDIR(info.st_mode);
+}
+
+uint8_t CFileLogStorage::getNumSegments()
+{
+  return m_nNumSegments;
+}
+
+uint32_t CFileLogStorage::getSegmentSize()
+{
+  return m_nSegmentSize;
+}
+
+void CFileLogStorage::getSegmentPath(uint8_t nSegment, char *pszPath, size_t nPathLen)
+{
+  snprintf(pszPath, nPathLen, "%s/seg%02u.log", m_szDir, nSegment);
+}
+
+uint32_t CFileLogStorage::getSegmentLength(uint8_t nSegment)
+{
+  uint32_t nReturn = 0;
+  char szPath[64];
+  struct stat info;
+
+  getSegmentPath(nSegment, szPath, sizeof(szPath));
+  if (stat(szPath, &info) == 0)
+  {
+    nReturn = (uint32_t)info.st_size;
+  }
+
+  return nReturn;
+}
+
+size_t CFileLogStorage::read(uint8_t nSegment, uint32_t nOffset, uint8_t *pBuf, size_t nLen)
+{
+  size_t nReturn = 0;
+  char szPath[64];
+
+  getSegmentPath(nSegment, szPath, sizeof(szPath));
+  FILE *pFile = fopen(szPath, "rb");
+  if (pFile != NULL)
+  {
+    if (fseek(pFile, nOffset, SEEK_SET) == 0)
+    {
+      nReturn = fread(pBuf, 1, nLen, pFile);
+    }
+    fclose(pFile);
+  }
+
+  return nReturn;
+}
+
+bool CFileLogStorage::append(uint8_t nSegment, const uint8_t *pBuf, size_t nLen)
+{
+  bool bReturn = false;
+  char szPath[64];
+
+  getSegmentPath(nSegment, szPath, sizeof(szPath));
+  FILE *pFile = fopen(szPath, "ab");
+  if (pFile != NULL)
+  {
+    bReturn = (fwrite(pBuf, 1, nLen, pFile) == nLen);
+    bReturn = (fclose(pFile) == 0) && bReturn;
+  }
+
+  return bReturn;
+}
+
+bool CFileLogStorage::erase(uint8_t nSegment)
+{
+  char szPath[64];
+
+  getSegmentPath(nSegment, szPath, sizeof(szPath));
+  return (remove(szPath) == 0) || (errno == ENOENT);
+}
@@ -0,0 +1,34 @@
+#ifndef __CFILELOGSTORAGE_H__
+#define __CFILELOGSTORAGE_H__
+
+#include <CLogStorage.h>
+
+// One file per segment under a directory, through stdio. On the ESP32
+// point it at a mounted LittleFS (e.g. "/littlefs/log"); on a host any
+// directory works, which is how the log is exercised on Linux.
+//
+// Every append opens, writes and closes the file so the data is committed
+// when append() returns.
+class CFileLogStorage : public CLogStorage
+{
+public:
+  CFileLogStorage(const char *pszDir, uint8_t nNumSegments = 16, uint32_t nSegmentSize = 32768);
+
+  virtual bool begin();
+  virtual uint8_t getNumSegments();
+  virtual uint32_t getSegmentSize();
+
+  virtual uint32_t getSegmentLength(uint8_t nSegment);
+  virtual size_t read(uint8_t nSegment, uint32_t nOffset, uint8_t *pBuf, size_t nLen);
+  virtual bool append(uint8_t nSegment, const uint8_t *pBuf, size_t nLen);
+  virtual bool erase(uint8_t nSegment);
+
+private:
+  void getSegmentPath(uint8_t nSegment, char *pszPath, size_t nPathLen);
+
+  char m_szDir[48] = {};
+  uint8_t m_nNumSegments = 16;
+  uint32_t m_nSegmentSize = 32768;
+};
+
+#endif // #ifndef __CFILELOGSTORAGE_H__
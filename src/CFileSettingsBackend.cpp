@@ -0,0 +1,59 @@
+#include <CFileSettingsBackend.h>
+#include <stdio.h>
+
+CFileSettingsBackend::CFileSettingsBackend(const char *pszPath)
+{
+  snprintf(m_szPath, sizeof(m_szPath), "%s", (pszPath != NULL) ? pszPath : "settings.bin");
+}
+
+bool CFileSettingsBackend::begin()
+{
+  return true;
+}
+
+size_t CFileSettingsBackend::read(uint8_t *pBuf, size_t nBufLen)
+{
+  size_t nReturn = 0;
+
+  FILE *pFile = fopen(m_szPath, "rb");
+  if (pFile != NULL)
+  {
+    nReturn = fread(pBuf, 1, nBufLen, pFile);
+
+    // Larger than the caller's buffer can't be a valid blob
+    if ((nReturn == nBufLen) && (fgetc(pFile) != EOF))
+    {
+      nReturn = 0;
+    }
+    fclose(pFile);
+  }
+
+  return nReturn;
+}
+
+bool CFileSettingsBackend::write(const uint8_t *pBuf, size_t nLen)
+{
+  bool bReturn = false;
+  char szTempPath[136];
+
+  snprintf(szTempPath, sizeof(szTempPath), "%s.tmp", m_szPath);
+  FILE *pFile = fopen(szTempPath, "wb");
+  if (pFile != NULL)
+  {
+    bReturn = (fwrite(pBuf, 1, nLen, pFile) == nLen);
+    bReturn = (fclose(pFile) == 0) && bReturn;
+    bReturn = bReturn && (rename(szTempPath, m_szPath) == 0);
+  }
+
+  if (bReturn)
+  {
+    m_nWriteCount++;
+  }
+
+  return bReturn;
+}
+
+uint32_t CFileSettingsBackend::getWriteCount()
+{
+  return m_nWriteCount;
+}
@@ -0,0 +1,24 @@
+#ifndef __CFILESETTINGSBACKEND_H__
+#define __CFILESETTINGSBACKEND_H__
+
+#include <CSettingsBackend.h>
+
+// Settings blob in a plain file, replaced through a temp file and a
+// rename. Used on the host to exercise CSettingsStore.
+class CFileSettingsBackend : public CSettingsBackend
+{
+public:
+  CFileSettingsBackend(const char *pszPath);
+
+  virtual bool begin();
+  virtual size_t read(uint8_t *pBuf, size_t nBufLen);
+  virtual bool write(const uint8_t *pBuf, size_t nLen);
+
+  uint32_t getWriteCount();
+
+private:
+  char m_szPath[128] = {};
+  uint32_t m_nWriteCount = 0;
+};
+
+#endif // #ifndef __CFILESETTINGSBACKEND_H__
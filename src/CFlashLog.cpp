@@ -0,0 +1,391 @@
+#include <CFlashLog.h>
+#include <Crc32.h>
+#include <string.h>
+
+#define FLASH_LOG_FRAME_OVERHEAD 8 // type, reserved, length, crc
+
+CFlashLog::CFlashLog(CLogStorage *pStorage, uint16_t nBatchBytes /* = 512*/)
+    : m_pStorage(pStorage),
+      m_nBatchBytes(nBatchBytes)
+{
+}
+
+CFlashLog::~CFlashLog()
+{
+  if (m_pBatch != NULL)
+  {
+    delete[] m_pBatch;
+    m_pBatch = NULL;
+  }
+}
+
+// Recovers the log and starts a new boot with a boot record
+bool CFlashLog::begin(uint32_t nResetReason /* = 0*/)
+{
+  bool bReturn = false;
+
+  if ((m_pStorage != NULL) && m_pStorage->begin() &&
+      (m_pStorage->getNumSegments() > 0) && (m_pStorage->getNumSegments() <= FLASH_LOG_MAX_SEGMENTS))
+  {
+    // A batch always has to fit in an empty segment
+    uint32_t nMaxBatch = m_pStorage->getSegmentSize() - sizeof(FlashLogSegmentHeader);
+    if (m_nBatchBytes > nMaxBatch)
+    {
+      m_nBatchBytes = (uint16_t)nMaxBatch;
+    }
+    if (m_pBatch == NULL)
+    {
+      m_pBatch = new uint8_t[m_nBatchBytes];
+    }
+
+    recover();
+    m_nBootId++;
+
+    uint8_t arrPayload[8];
+    memcpy(arrPayload, &m_nBootId, 4);
+    memcpy(arrPayload + 4, &nResetReason, 4);
+    bReturn = appendRecord(FLASH_LOG_RECORD_BOOT, arrPayload, sizeof(arrPayload)) && flush();
+  }
+
+  return bReturn;
+}
+
+bool CFlashLog::recover()
+{
+  FlashLogSegmentHeader header;
+
+  m_bHaveSegment = false;
+  for (uint8_t nSegment = 0; nSegment < m_pStorage->getNumSegments(); nSegment++)
+  {
+    if (CFlashLogReader::readHeader(m_pStorage, nSegment, &header) &&
+        (!m_bHaveSegment || ((int32_t)(header.nSeq - m_nSegmentSeq) > 0)))
+    {
+      m_nSegment = nSegment;
+      m_nSegmentSeq = header.nSeq;
+      m_nBootId = header.nBootId;
+      m_bHaveSegment = true;
+    }
+  }
+
+  if (m_bHaveSegment)
+  {
+    CFlashLogReader reader(m_pStorage);
+    FlashLogRecord record;
+
+    reader.openSegment(m_nSegment, &header);
+    while (reader.nextInSegment(&record))
+    {
+      if ((record.nType == FLASH_LOG_RECORD_BOOT) && (record.nLen >= 4))
+      {
+        memcpy(&m_nBootId, record.arrPayload, 4);
+      }
+      m_nRecoveredRecords++;
+    }
+
+    m_nSegmentLength = m_pStorage->getSegmentLength(m_nSegment);
+    m_bRotatePending = (reader.getOffset() != m_nSegmentLength);
+  }
+
+  return m_bHaveSegment;
+}
+
+bool CFlashLog::rotate()
+{
+  bool bReturn = false;
+  uint8_t nNextSegment = m_bHaveSegment ? (m_nSegment + 1) % m_pStorage->getNumSegments() : 0;
+  FlashLogSegmentHeader header;
+
+  header.nMagic = FLASH_LOG_MAGIC;
+  header.nVersion = FLASH_LOG_VERSION;
+  header.nHeaderLen = sizeof(FlashLogSegmentHeader);
+  header.nSeq = m_bHaveSegment ? m_nSegmentSeq + 1 : 1;
+  header.nBootId = m_nBootId;
+  header.nCrc = computeCrc32((const uint8_t *)&header, offsetof(FlashLogSegmentHeader, nCrc));
+
+  if (m_pStorage->erase(nNextSegment) &&
+      m_pStorage->append(nNextSegment, (const uint8_t *)&header, sizeof(header)))
+  {
+    m_nSegment = nNextSegment;
+    m_nSegmentSeq = header.nSeq;
+    m_nSegmentLength = sizeof(header);
+    m_bHaveSegment = true;
+    m_bRotatePending = false;
+    m_nRotationCount++;
+    bReturn = true;
+  }
+  else
+  {
+    m_nWriteErrors++;
+  }
+
+  return bReturn;
+}
+
+bool CFlashLog::appendRecord(uint8_t nType, const uint8_t *pPayload, uint16_t nLen)
+{
+  bool bReturn = false;
+  uint16_t nFrameLen = nLen + FLASH_LOG_FRAME_OVERHEAD;
+
+  if ((m_pBatch != NULL) && (nLen <= FLASH_LOG_MAX_PAYLOAD) && ((pPayload != NULL) || (nLen == 0)) && (nFrameLen <= m_nBatchBytes))
+  {
+    if (m_nPending + nFrameLen > m_nBatchBytes)
+    {
+      flush();
+    }
+
+    uint8_t *pFrame = m_pBatch + m_nPending;
+    pFrame[0] = nType;
+    pFrame[1] = 0;
+    memcpy(pFrame + 2, &nLen, 2);
+    if (nLen > 0)
+    {
+      memcpy(pFrame + 4, pPayload, nLen);
+    }
+    uint32_t nCrc = computeCrc32(pFrame, 4 + nLen);
+    memcpy(pFrame + 4 + nLen, &nCrc, 4);
+
+    m_nPending += nFrameLen;
+    bReturn = true;
+  }
+  else
+  {
+    m_nDroppedRecords++;
+  }
+
+  return bReturn;
+}
+
+bool CFlashLog::appendSample(uint32_t nTimeMs, const int32_t *arrValues, uint8_t nNumValues)
+{
+  uint8_t arrPayload[FLASH_LOG_MAX_PAYLOAD];
+  uint8_t nMaxValues = (FLASH_LOG_MAX_PAYLOAD - 4) / 4;
+
+  if (nNumValues > nMaxValues)
+  {
+    nNumValues = nMaxValues;
+  }
+
+  memcpy(arrPayload, &nTimeMs, 4);
+  if (nNumValues > 0)
+  {
+    memcpy(arrPayload + 4, arrValues, 4 * nNumValues);
+  }
+
+  return appendRecord(FLASH_LOG_RECORD_SAMPLE, arrPayload, 4 + 4 * nNumValues);
+}
+
+// Writes the pending batch. A batch that can't be written is dropped so
+// a failing flash can't wedge the logger.
+bool CFlashLog::flush()
+{
+  bool bReturn = true;
+
+  if ((m_pStorage != NULL) && (m_nPending > 0))
+  {
+    if (!m_bHaveSegment || m_bRotatePending || (m_nSegmentLength + m_nPending > m_pStorage->getSegmentSize()))
+    {
+      bReturn = rotate();
+    }
+
+    if (bReturn && m_pStorage->append(m_nSegment, m_pBatch, m_nPending))
+    {
+      m_nSegmentLength += m_nPending;
+      m_nFlushCount++;
+    }
+    else
+    {
+      // Whatever may have landed is now untrusted, start clean next time
+      m_bRotatePending = true;
+      m_nWriteErrors++;
+      bReturn = false;
+    }
+
+    m_nPending = 0;
+  }
+
+  return bReturn;
+}
+
+uint32_t CFlashLog::getBootId()
+{
+  return m_nBootId;
+}
+
+uint32_t CFlashLog::getSegmentSeq()
+{
+  return m_nSegmentSeq;
+}
+
+uint8_t CFlashLog::getSegment()
+{
+  return m_nSegment;
+}
+
+uint16_t CFlashLog::getPendingBytes()
+{
+  return m_nPending;
+}
+
+uint32_t CFlashLog::getFlushCount()
+{
+  return m_nFlushCount;
+}
+
+uint32_t CFlashLog::getRotationCount()
+{
+  return m_nRotationCount;
+}
+
+uint32_t CFlashLog::getWriteErrors()
+{
+  return m_nWriteErrors;
+}
+
+uint32_t CFlashLog::getDroppedRecords()
+{
+  return m_nDroppedRecords;
+}
+
+uint32_t CFlashLog::getRecoveredRecords()
+{
+  return m_nRecoveredRecords;
+}
+
+CFlashLogReader::CFlashLogReader(CLogStorage *pStorage)
+    : m_pStorage(pStorage)
+{
+  FlashLogSegmentHeader header;
+  uint32_t arrSeqs[FLASH_LOG_MAX_SEGMENTS];
+
+  if (m_pStorage != NULL)
+  {
+    uint8_t nNumSegments = m_pStorage->getNumSegments();
+    if (nNumSegments > FLASH_LOG_MAX_SEGMENTS)
+    {
+      nNumSegments = FLASH_LOG_MAX_SEGMENTS;
+    }
+
+    // Insertion sort by sequence, there are only a handful of segments
+    for (uint8_t nSegment = 0; nSegment < nNumSegments; nSegment++)
+    {
+      if (readHeader(m_pStorage, nSegment, &header))
+      {
+        uint8_t nPos = m_nNumOrdered;
+        while ((nPos > 0) && ((int32_t)(arrSeqs[nPos - 1] - header.nSeq) > 0))
+        {
+          arrSeqs[nPos] = arrSeqs[nPos - 1];
+          m_arrOrder[nPos] = m_arrOrder[nPos - 1];
+          nPos--;
+        }
+        arrSeqs[nPos] = header.nSeq;
+        m_arrOrder[nPos] = nSegment;
+        m_nNumOrdered++;
+      }
+    }
+  }
+}
+
+bool CFlashLogReader::readHeader(CLogStorage *pStorage, uint8_t nSegment, FlashLogSegmentHeader *pHeader)
+{
+  return (pStorage->read(nSegment, 0, (uint8_t *)pHeader, sizeof(FlashLogSegmentHeader)) == sizeof(FlashLogSegmentHeader)) &&
+         (pHeader->nMagic == FLASH_LOG_MAGIC) &&
+         (pHeader->nVersion == FLASH_LOG_VERSION) &&
+         (pHeader->nHeaderLen == sizeof(FlashLogSegmentHeader)) &&
+         (pHeader->nCrc == computeCrc32((const uint8_t *)pHeader, offsetof(FlashLogSegmentHeader, nCrc)));
+}
+
+bool CFlashLogReader::openSegment(uint8_t nSegment, FlashLogSegmentHeader *pHeader)
+{
+  m_bSegmentOpen = (m_pStorage != NULL) && readHeader(m_pStorage, nSegment, pHeader);
+  m_nSegment = nSegment;
+  m_nSegmentSeq = pHeader->nSeq;
+  m_nOffset = m_bSegmentOpen ? pHeader->nHeaderLen : 0;
+  m_nBufLen = 0;
+
+  return m_bSegmentOpen;
+}
+
+// Makes [nOffset, nOffset + nLen) available in the buffer
+bool CFlashLogReader::ensure(uint32_t nOffset, uint16_t nLen)
+{
+  if ((nOffset < m_nBufOffset) || (nOffset + nLen > m_nBufOffset + m_nBufLen))
+  {
+    m_nBufOffset = nOffset;
+    m_nBufLen = (uint16_t)m_pStorage->read(m_nSegment, nOffset, m_arrBuf, sizeof(m_arrBuf));
+  }
+
+  return (nLen <= sizeof(m_arrBuf)) && (nOffset + nLen <= m_nBufOffset + m_nBufLen);
+}
+
+// Stops at the end of the segment or the first frame that doesn't check out
+bool CFlashLogReader::nextInSegment(FlashLogRecord *pRecord)
+{
+  bool bReturn = false;
+
+  if (m_bSegmentOpen && (pRecord != NULL) && ensure(m_nOffset, 4))
+  {
+    const uint8_t *pFrame = m_arrBuf + (m_nOffset - m_nBufOffset);
+    uint16_t nLen = 0;
+    memcpy(&nLen, pFrame + 2, 2);
+
+    if ((nLen <= FLASH_LOG_MAX_PAYLOAD) && ensure(m_nOffset, nLen + FLASH_LOG_FRAME_OVERHEAD))
+    {
+      pFrame = m_arrBuf + (m_nOffset - m_nBufOffset);
+      uint32_t nCrc = 0;
+      memcpy(&nCrc, pFrame + 4 + nLen, 4);
+
+      if (nCrc == computeCrc32(pFrame, 4 + nLen))
+      {
+        pRecord->nSegmentSeq = m_nSegmentSeq;
+        pRecord->nType = pFrame[0];
+        pRecord->nLen = nLen;
+        memcpy(pRecord->arrPayload, pFrame + 4, nLen);
+        m_nOffset += nLen + FLASH_LOG_FRAME_OVERHEAD;
+        bReturn = true;
+      }
+    }
+  }
+
+  if (!bReturn)
+  {
+    m_bSegmentOpen = false;
+  }
+
+  return bReturn;
+}
+
+bool CFlashLogReader::next(FlashLogRecord *pRecord)
+{
+  bool bReturn = false;
+  FlashLogSegmentHeader header;
+
+  while (!bReturn && (m_bSegmentOpen || (m_nOrderIndex < m_nNumOrdered)))
+  {
+    if (!m_bSegmentOpen)
+    {
+      uint8_t nSegment = m_arrOrder[m_nOrderIndex++];
+      openSegment(nSegment, &header);
+    }
+    else
+    {
+      uint32_t nSeq = m_nSegmentSeq;
+      bReturn = nextInSegment(pRecord);
+
+      // The writer may have recycled this segment under us; anything read
+      // after that point would be from a newer segment, out of order
+      if (bReturn && (m_nBufOffset == m_nOffset - pRecord->nLen - FLASH_LOG_FRAME_OVERHEAD) &&
+          (!readHeader(m_pStorage, m_nSegment, &header) || (header.nSeq != nSeq)))
+      {
+        m_bSegmentOpen = false;
+        bReturn = false;
+      }
+    }
+  }
+
+  return bReturn;
+}
+
+uint32_t CFlashLogReader::getOffset()
+{
+  return m_nOffset;
+}
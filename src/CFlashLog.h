@@ -0,0 +1,133 @@
+#ifndef __CFLASHLOG_H__
+#define __CFLASHLOG_H__
+
+#include <CLogStorage.h>
+
+#define FLASH_LOG_MAGIC 0x474F4C46 // "FLOG"
+#define FLASH_LOG_VERSION 1
+#define FLASH_LOG_MAX_PAYLOAD 128
+#define FLASH_LOG_MAX_SEGMENTS 64
+
+enum FlashLogRecordType
+{
+  FLASH_LOG_RECORD_BOOT = 1,   // uint32 boot id, uint32 reset reason
+  FLASH_LOG_RECORD_SAMPLE = 2  // uint32 millis, int32 values[]
+};
+
+// Written at the start of every segment. Recovery reads only these to
+// find the newest segment.
+typedef struct FlashLogSegmentHeader
+{
+  uint32_t nMagic;
+  uint16_t nVersion;
+  uint16_t nHeaderLen;
+  uint32_t nSeq;
+  uint32_t nBootId;
+  uint32_t nCrc; // over the fields above
+} FlashLogSegmentHeader;
+
+typedef struct FlashLogRecord
+{
+  uint32_t nSegmentSeq;
+  uint8_t nType;
+  uint16_t nLen;
+  uint8_t arrPayload[FLASH_LOG_MAX_PAYLOAD];
+} FlashLogRecord;
+
+// Append-only telemetry log spread over the segments of a CLogStorage.
+//
+// Records are framed as type (1), reserved (1), length (2), payload and a
+// CRC-32 over all of it. They're collected in a RAM batch and written to
+// flash a batch at a time, so one write carries many samples and no
+// record ever spans two segments. When a segment fills up the log moves to
+// the next one round robin, erasing it first, so every segment sees the
+// same number of erase cycles.
+//
+// begin() reads the segment headers to find the newest segment, then
+// validates only that segment's records to find the boot id and a clean
+// place to append. A torn tail from a power cut makes it rotate to a
+// fresh segment rather than append after the damage.
+//
+// Plain C++ with no locking: appends and flushes must come from one task.
+// Readers open their own CFlashLogReader and may run concurrently.
+class CFlashLog
+{
+public:
+  CFlashLog(CLogStorage *pStorage, uint16_t nBatchBytes = 512);
+  ~CFlashLog();
+
+  bool begin(uint32_t nResetReason = 0);
+
+  bool appendRecord(uint8_t nType, const uint8_t *pPayload, uint16_t nLen);
+  bool appendSample(uint32_t nTimeMs, const int32_t *arrValues, uint8_t nNumValues);
+  bool flush();
+
+  uint32_t getBootId();
+  uint32_t getSegmentSeq();
+  uint8_t getSegment();
+  uint16_t getPendingBytes();
+  uint32_t getFlushCount();
+  uint32_t getRotationCount();
+  uint32_t getWriteErrors();
+  uint32_t getDroppedRecords();
+  uint32_t getRecoveredRecords();
+
+private:
+  bool recover();
+  bool rotate();
+
+  CLogStorage *m_pStorage = NULL;
+  uint8_t *m_pBatch = NULL;
+  uint16_t m_nBatchBytes = 512;
+  uint16_t m_nPending = 0;
+
+  bool m_bHaveSegment = false;
+  bool m_bRotatePending = false;
+  uint8_t m_nSegment = 0;
+  uint32_t m_nSegmentSeq = 0;
+  uint32_t m_nSegmentLength = 0;
+  uint32_t m_nBootId = 0;
+
+  uint32_t m_nFlushCount = 0;
+  uint32_t m_nRotationCount = 0;
+  uint32_t m_nWriteErrors = 0;
+  uint32_t m_nDroppedRecords = 0;
+  uint32_t m_nRecoveredRecords = 0;
+};
+
+// Walks every valid record, oldest segment first. Reads go through a small
+// buffer so each storage read covers many records. A segment that gets
+// rotated out while it's being read is abandoned at that point.
+class CFlashLogReader
+{
+public:
+  CFlashLogReader(CLogStorage *pStorage);
+
+  bool next(FlashLogRecord *pRecord);
+
+  // Single segment access, used by recovery
+  bool openSegment(uint8_t nSegment, FlashLogSegmentHeader *pHeader);
+  bool nextInSegment(FlashLogRecord *pRecord);
+  uint32_t getOffset();
+
+  static bool readHeader(CLogStorage *pStorage, uint8_t nSegment, FlashLogSegmentHeader *pHeader);
+
+private:
+  bool ensure(uint32_t nOffset, uint16_t nLen);
+
+  CLogStorage *m_pStorage = NULL;
+  uint8_t m_arrOrder[FLASH_LOG_MAX_SEGMENTS] = {};
+  uint8_t m_nNumOrdered = 0;
+  uint8_t m_nOrderIndex = 0;
+  bool m_bSegmentOpen = false;
+
+  uint8_t m_nSegment = 0;
+  uint32_t m_nSegmentSeq = 0;
+  uint32_t m_nOffset = 0;
+
+  uint8_t m_arrBuf[512] = {};
+  uint32_t m_nBufOffset = 0;
+  uint16_t m_nBufLen = 0;
+};
+
+#endif // #ifndef __CFLASHLOG_H__
@@ -0,0 +1,51 @@
+#include <CFlashLogCsvWriter.h>
+
+CFlashLogCsvWriter::CFlashLogCsvWriter(CLogStorage *pStorage)
+    : CLineWriter(m_szLine),
+      m_reader(pStorage)
+{
+}
+
+bool CFlashLogCsvWriter::renderNext()
+{
+  m_nLineLen = 0;
+  m_nLineOffset = 0;
+
+  while (!m_bDone && (m_nLineLen == 0))
+  {
+    if (!m_reader.next(&m_record))
+    {
+      m_bDone = true;
+    }
+    else if ((m_record.nType == FLASH_LOG_RECORD_BOOT) && (m_record.nLen >= 8))
+    {
+      uint32_t nResetReason = 0;
+      memcpy(&m_nBootId, m_record.arrPayload, 4);
+      memcpy(&nResetReason, m_record.arrPayload + 4, 4);
+      m_nLineLen = snprintf(m_szLine, sizeof(m_szLine), "boot,%u,%u\n", m_nBootId, nResetReason);
+    }
+    else if ((m_record.nType == FLASH_LOG_RECORD_SAMPLE) && (m_record.nLen >= 4))
+    {
+      uint32_t nTimeMs = 0;
+      memcpy(&nTimeMs, m_record.arrPayload, 4);
+      int nWritten = snprintf(m_szLine, sizeof(m_szLine), "sample,%u,%u", m_nBootId, nTimeMs);
+      size_t nPos = (nWritten > 0) ? (size_t)nWritten : 0;
+
+      for (uint16_t nOffset = 4; (nOffset + 4 <= m_record.nLen) && (nPos < sizeof(m_szLine)); nOffset += 4)
+      {
+        int32_t nValue = 0;
+        memcpy(&nValue, m_record.arrPayload + nOffset, 4);
+        nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, ",%d", nValue);
+        nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+      }
+      if (nPos < sizeof(m_szLine))
+      {
+        nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, "\n");
+        nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+      }
+      m_nLineLen = min(nPos, sizeof(m_szLine) - 1);
+    }
+  }
+
+  return (m_nLineLen > 0);
+}
@@ -0,0 +1,29 @@
+#ifndef __CFLASHLOGCSVWRITER_H__
+#define __CFLASHLOGCSVWRITER_H__
+
+#include <Arduino.h>
+#include <CFlashLog.h>
+#include <CLineWriter.h>
+
+// Streams the flash log as CSV through CLineWriter::fill(), one record
+// per line, oldest first:
+//   boot,<bootId>,<resetReason>
+//   sample,<bootId>,<millis>,<v0>,<v1>,...
+// Sample values use the CHistoryRecorder channel layout.
+class CFlashLogCsvWriter : public CLineWriter
+{
+public:
+  CFlashLogCsvWriter(CLogStorage *pStorage);
+
+private:
+  bool renderNext();
+
+  CFlashLogReader m_reader;
+  FlashLogRecord m_record = {};
+  uint32_t m_nBootId = 0;
+  bool m_bDone = false;
+
+  char m_szLine[400] = {};
+};
+
+#endif // #ifndef __CFLASHLOGCSVWRITER_H__
@@ -0,0 +1,205 @@
+#include <CHistoryRecorder.h>
+
+CHistoryRecorder::CHistoryRecorder()
+{
+}
+
+CHistoryRecorder::~CHistoryRecorder()
+{
+  if (m_pRing != NULL)
+  {
+    delete m_pRing;
+    m_pRing = NULL;
+  }
+  if (m_hMutex != NULL)
+  {
+    vSemaphoreDelete(m_hMutex);
+    m_hMutex = NULL;
+  }
+}
+
+// Call after pTempSensors->begin() so the sensor count is known
+bool CHistoryRecorder::begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors,
+                             uint32_t nIntervalMs /* = 2000*/, uint16_t nNumBlocks /* = 64*/, uint16_t nBlockBytes /* = 512*/)
+{
+  m_pTempSensors = pTempSensors;
+  m_nNumSensors = (m_pTempSensors != NULL) ? min(m_pTempSensors->getNumSensors(), (uint8_t)TEMP_SENSORS_MAX) : 0;
+
+  // Sensors get first claim on the channels, each fan takes two
+  m_nNumFans = (arrFanCtrl != NULL) ? min(nNumFans, (size_t)(HISTORY_MAX_CHANNELS - m_nNumSensors) / 2) : 0;
+  for (uint8_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    m_arrFanCtrl[nIndex] = arrFanCtrl[nIndex];
+  }
+
+  m_nIntervalMs = max(nIntervalMs, (uint32_t)1);
+
+  if (m_hMutex == NULL)
+  {
+    m_hMutex = xSemaphoreCreateMutex();
+  }
+  if (m_pRing == NULL)
+  {
+    m_pRing = new CHistoryRing(getNumChannels(), nNumBlocks, nBlockBytes);
+  }
+
+  return (m_hMutex != NULL) && (m_pRing != NULL);
+}
+
+// Call after every temperature sample; at most one sample per interval is
+// kept. Each sample is snapped to the grid the previous one set, rounding,
+// so a sample read a little early or late neither doubles up nor leaves a
+// gap when the interval matches the sample period.
+void CHistoryRecorder::record()
+{
+  if ((m_pRing != NULL) && (m_hMutex != NULL))
+  {
+    TempSnapshot temps = {};
+    if (m_pTempSensors != NULL)
+    {
+      m_pTempSensors->getSnapshot(&temps);
+    }
+
+    uint32_t nNowMs = (temps.nTimestampMs != 0) ? temps.nTimestampMs : millis();
+    uint32_t nSlotMs = nNowMs - (nNowMs % m_nIntervalMs);
+    if (m_bHaveSample)
+    {
+      nSlotMs = m_nLastSlotMs + (nNowMs - m_nLastSlotMs + m_nIntervalMs / 2) / m_nIntervalMs * m_nIntervalMs;
+    }
+
+    if (!m_bHaveSample || (nSlotMs != m_nLastSlotMs))
+    {
+      int32_t arrValues[HISTORY_MAX_CHANNELS] = {};
+      uint8_t nChannel = 0;
+
+      for (uint8_t nIndex = 0; nIndex < m_nNumSensors; nIndex++)
+      {
+        arrValues[nChannel++] = (nIndex < temps.nNumSensors) ? lroundf(temps.arrRawTemps[nIndex]) : 0;
+      }
+      for (uint8_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+      {
+        CPwmFanControl *pFanCtrl = m_arrFanCtrl[nIndex];
+        arrValues[nChannel++] = (pFanCtrl != NULL) ? lroundf(pFanCtrl->getLastDutyCyclePercent() * 1000.0f) : 0;
+        arrValues[nChannel++] = (pFanCtrl != NULL) ? pFanCtrl->getFanRpms() : 0;
+      }
+
+      xSemaphoreTake(m_hMutex, portMAX_DELAY);
+      m_pRing->append(nSlotMs, arrValues);
+      memcpy(m_arrLastValues, arrValues, sizeof(m_arrLastValues));
+      xSemaphoreGive(m_hMutex);
+
+      m_nLastSlotMs = nSlotMs;
+      m_bHaveSample = true;
+    }
+  }
+}
+
+// Copies the most recent sample. Returns the number of channels, or 0 if
+// nothing has been recorded yet.
+uint8_t CHistoryRecorder::getLastSample(uint32_t *pnTimeMs, int32_t *arrValues)
+{
+  uint8_t nReturn = 0;
+
+  if ((m_hMutex != NULL) && m_bHaveSample && (pnTimeMs != NULL) && (arrValues != NULL))
+  {
+    xSemaphoreTake(m_hMutex, portMAX_DELAY);
+    *pnTimeMs = m_nLastSlotMs;
+    memcpy(arrValues, m_arrLastValues, sizeof(int32_t) * getNumChannels());
+    xSemaphoreGive(m_hMutex);
+    nReturn = getNumChannels();
+  }
+
+  return nReturn;
+}
+
+uint8_t CHistoryRecorder::getNumSensors()
+{
+  return m_nNumSensors;
+}
+
+uint8_t CHistoryRecorder::getNumFans()
+{
+  return m_nNumFans;
+}
+
+uint8_t CHistoryRecorder::getNumChannels()
+{
+  return m_nNumSensors + m_nNumFans * 2;
+}
+
+uint32_t CHistoryRecorder::getIntervalMs()
+{
+  return m_nIntervalMs;
+}
+
+uint16_t CHistoryRecorder::getBlockBytes()
+{
+  return (m_pRing != NULL) ? m_pRing->getBlockBytes() : 0;
+}
+
+uint32_t CHistoryRecorder::getFirstSeq()
+{
+  uint32_t nReturn = 0;
+
+  if ((m_pRing != NULL) && (m_hMutex != NULL))
+  {
+    xSemaphoreTake(m_hMutex, portMAX_DELAY);
+    nReturn = m_pRing->getFirstSeq();
+    xSemaphoreGive(m_hMutex);
+  }
+
+  return nReturn;
+}
+
+uint32_t CHistoryRecorder::getNextSeq()
+{
+  uint32_t nReturn = 0;
+
+  if ((m_pRing != NULL) && (m_hMutex != NULL))
+  {
+    xSemaphoreTake(m_hMutex, portMAX_DELAY);
+    nReturn = m_pRing->getNextSeq();
+    xSemaphoreGive(m_hMutex);
+  }
+
+  return nReturn;
+}
+
+// Only the copy is done under the lock; decoding happens on the caller's copy
+bool CHistoryRecorder::copyBlock(uint32_t nSeq, HistoryBlockHeader *pHeader, uint8_t *pData, size_t nDataLen)
+{
+  bool bReturn = false;
+
+  if ((m_pRing != NULL) && (m_hMutex != NULL))
+  {
+    xSemaphoreTake(m_hMutex, portMAX_DELAY);
+    bReturn = m_pRing->copyBlock(nSeq, pHeader, pData, nDataLen);
+    xSemaphoreGive(m_hMutex);
+  }
+
+  return bReturn;
+}
+
+uint32_t CHistoryRecorder::getSampleCount()
+{
+  return (m_pRing != NULL) ? m_pRing->getSampleCount() : 0;
+}
+
+size_t CHistoryRecorder::getBytesUsed()
+{
+  size_t nReturn = 0;
+
+  if ((m_pRing != NULL) && (m_hMutex != NULL))
+  {
+    xSemaphoreTake(m_hMutex, portMAX_DELAY);
+    nReturn = m_pRing->getBytesUsed();
+    xSemaphoreGive(m_hMutex);
+  }
+
+  return nReturn;
+}
+
+size_t CHistoryRecorder::getCapacityBytes()
+{
+  return (m_pRing != NULL) ? m_pRing->getCapacityBytes() : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __CHISTORYRECORDER_H__
+#define __CHISTORYRECORDER_H__
+
+#include <Arduino.h>
+#include <CHistoryRing.h>
+#include <CPwmFanControl.h>
+#include <CTempSensors.h>
+
+// Records temperatures, fan duty and RPM into a CHistoryRing. Channels
+// are every sensor's raw temperature (1/128 C) followed by each fan's
+// duty (milli-percent) and RPM. Timestamps are millis() snapped to the
+// recording interval, so a steady cadence costs a single bit per sample.
+//
+// The firmware records every temperature sample (800 ms). A 2 sensor,
+// 2 fan trace takes about 3.7 bytes a sample (tools/history_codec), so
+// 4500 samples an hour are 16.7 KB and 48 KB of blocks hold close to 3 h.
+class CHistoryRecorder
+{
+public:
+  CHistoryRecorder();
+  ~CHistoryRecorder();
+
+  bool begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors,
+             uint32_t nIntervalMs = 2000, uint16_t nNumBlocks = 64, uint16_t nBlockBytes = 512);
+  void record();
+  uint8_t getLastSample(uint32_t *pnTimeMs, int32_t *arrValues);
+
+  uint8_t getNumSensors();
+  uint8_t getNumFans();
+  uint8_t getNumChannels();
+  uint32_t getIntervalMs();
+  uint16_t getBlockBytes();
+
+  uint32_t getFirstSeq();
+  uint32_t getNextSeq();
+  bool copyBlock(uint32_t nSeq, HistoryBlockHeader *pHeader, uint8_t *pData, size_t nDataLen);
+
+  uint32_t getSampleCount();
+  size_t getBytesUsed();
+  size_t getCapacityBytes();
+
+private:
+  CPwmFanControl *m_arrFanCtrl[HISTORY_MAX_CHANNELS / 2] = {};
+  uint8_t m_nNumFans = 0;
+  uint8_t m_nNumSensors = 0;
+  CTempSensors *m_pTempSensors = NULL;
+  uint32_t m_nIntervalMs = 2000;
+  uint32_t m_nLastSlotMs = 0;
+  bool m_bHaveSample = false;
+  int32_t m_arrLastValues[HISTORY_MAX_CHANNELS] = {};
+  CHistoryRing *m_pRing = NULL;
+  SemaphoreHandle_t m_hMutex = NULL;
+};
+
+#endif // #ifndef __CHISTORYRECORDER_H__
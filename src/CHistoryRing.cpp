@@ -0,0 +1,401 @@
+#include <CHistoryRing.h>
+#include <string.h>
+
+// Timestamp delta-of-delta fields: prefix, then payload bits
+//   0                  0
+//   10   + 7 bits      zigzag < 128
+//   110  + 9 bits      zigzag < 512
+//   1110 + 12 bits     zigzag < 4096
+//   1111 + 32 bits     anything else
+//
+// Value delta fields:
+//   0                  0
+//   10  + 6 bits       zigzag < 64
+//   110 + 12 bits      zigzag < 4096
+//   111 + 32 bits      anything else
+//
+// All arithmetic is modulo 2^32 so millis() rollover and large jumps
+// round trip exactly.
+
+static inline uint32_t zigzag(uint32_t nValue)
+{
+  return (nValue << 1) ^ (uint32_t)((int32_t)nValue >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t nValue)
+{
+  return (nValue >> 1) ^ (0 - (nValue & 1));
+}
+
+static inline uint8_t timeFieldBits(uint32_t nZigzag)
+{
+  return (nZigzag == 0) ? 1 : (nZigzag < 128) ? 9 : (nZigzag < 512) ? 12 : (nZigzag < 4096) ? 16 : 36;
+}
+
+static inline uint8_t valueFieldBits(uint32_t nZigzag)
+{
+  return (nZigzag == 0) ? 1 : (nZigzag < 64) ? 8 : (nZigzag < 4096) ? 15 : 35;
+}
+
+// MSB first
+static void writeBits(uint8_t *pData, uint32_t &nBitPos, uint32_t nValue, uint8_t nBits)
+{
+  while (nBits > 0)
+  {
+    nBits--;
+    uint8_t nMask = 0x80 >> (nBitPos & 7);
+    if ((nValue >> nBits) & 1)
+    {
+      pData[nBitPos >> 3] |= nMask;
+    }
+    else
+    {
+      pData[nBitPos >> 3] &= ~nMask;
+    }
+    nBitPos++;
+  }
+}
+
+static void writeTimeField(uint8_t *pData, uint32_t &nBitPos, uint32_t nZigzag)
+{
+  if (nZigzag == 0)
+  {
+    writeBits(pData, nBitPos, 0, 1);
+  }
+  else if (nZigzag < 128)
+  {
+    writeBits(pData, nBitPos, 0x2, 2);
+    writeBits(pData, nBitPos, nZigzag, 7);
+  }
+  else if (nZigzag < 512)
+  {
+    writeBits(pData, nBitPos, 0x6, 3);
+    writeBits(pData, nBitPos, nZigzag, 9);
+  }
+  else if (nZigzag < 4096)
+  {
+    writeBits(pData, nBitPos, 0xE, 4);
+    writeBits(pData, nBitPos, nZigzag, 12);
+  }
+  else
+  {
+    writeBits(pData, nBitPos, 0xF, 4);
+    writeBits(pData, nBitPos, nZigzag, 32);
+  }
+}
+
+static void writeValueField(uint8_t *pData, uint32_t &nBitPos, uint32_t nZigzag)
+{
+  if (nZigzag == 0)
+  {
+    writeBits(pData, nBitPos, 0, 1);
+  }
+  else if (nZigzag < 64)
+  {
+    writeBits(pData, nBitPos, 0x2, 2);
+    writeBits(pData, nBitPos, nZigzag, 6);
+  }
+  else if (nZigzag < 4096)
+  {
+    writeBits(pData, nBitPos, 0x6, 3);
+    writeBits(pData, nBitPos, nZigzag, 12);
+  }
+  else
+  {
+    writeBits(pData, nBitPos, 0x7, 3);
+    writeBits(pData, nBitPos, nZigzag, 32);
+  }
+}
+
+CHistoryRing::CHistoryRing(uint8_t nNumChannels, uint16_t nNumBlocks /* = 64*/, uint16_t nBlockBytes /* = 512*/)
+{
+  m_nNumChannels = (nNumChannels < HISTORY_MAX_CHANNELS) ? nNumChannels : HISTORY_MAX_CHANNELS;
+  m_nNumBlocks = (nNumBlocks > 0) ? nNumBlocks : 1;
+
+  // A block must at least hold its verbatim first sample plus one more,
+  // and its bit count has to fit the 16 bit header field
+  uint16_t nMinBlockBytes = (uint16_t)((1 + m_nNumChannels) * 4 * 2);
+  m_nBlockBytes = (nBlockBytes < nMinBlockBytes) ? nMinBlockBytes : nBlockBytes;
+  if (m_nBlockBytes > 8191)
+  {
+    m_nBlockBytes = 8191;
+  }
+
+  m_pStorage = new uint8_t[(size_t)m_nNumBlocks * m_nBlockBytes];
+  m_arrHeaders = new HistoryBlockHeader[m_nNumBlocks];
+  memset(m_arrHeaders, 0, sizeof(HistoryBlockHeader) * m_nNumBlocks);
+}
+
+CHistoryRing::~CHistoryRing()
+{
+  if (m_pStorage != NULL)
+  {
+    delete[] m_pStorage;
+    m_pStorage = NULL;
+  }
+  if (m_arrHeaders != NULL)
+  {
+    delete[] m_arrHeaders;
+    m_arrHeaders = NULL;
+  }
+}
+
+void CHistoryRing::startBlock()
+{
+  uint32_t nSeq = m_nNextSeq++;
+  m_pCurrent = &m_arrHeaders[nSeq % m_nNumBlocks];
+  m_pCurrent->nSeq = nSeq;
+  m_pCurrent->nFirstTimeMs = 0;
+  m_pCurrent->nLastTimeMs = 0;
+  m_pCurrent->nSamples = 0;
+  m_pCurrent->nBits = 0;
+  m_nPrevDelta = 0;
+}
+
+uint32_t CHistoryRing::getEncodedBits(uint32_t nDeltaOfDelta, const int32_t *arrValues)
+{
+  uint32_t nReturn = timeFieldBits(zigzag(nDeltaOfDelta));
+
+  for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+  {
+    nReturn += valueFieldBits(zigzag((uint32_t)arrValues[nChannel] - (uint32_t)m_arrPrevValues[nChannel]));
+  }
+
+  return nReturn;
+}
+
+bool CHistoryRing::append(uint32_t nTimeMs, const int32_t *arrValues)
+{
+  bool bReturn = false;
+
+  if ((m_pStorage != NULL) && (m_arrHeaders != NULL) && (arrValues != NULL))
+  {
+    uint32_t nDelta = 0;
+    uint32_t nDeltaOfDelta = 0;
+
+    if (m_pCurrent != NULL)
+    {
+      nDelta = nTimeMs - m_pCurrent->nLastTimeMs;
+      nDeltaOfDelta = nDelta - m_nPrevDelta;
+      if ((uint32_t)m_pCurrent->nBits + getEncodedBits(nDeltaOfDelta, arrValues) > (uint32_t)m_nBlockBytes * 8)
+      {
+        m_pCurrent = NULL;
+      }
+    }
+
+    if (m_pCurrent == NULL)
+    {
+      startBlock();
+    }
+
+    uint8_t *pData = m_pStorage + (size_t)(m_pCurrent->nSeq % m_nNumBlocks) * m_nBlockBytes;
+    uint32_t nBitPos = m_pCurrent->nBits;
+
+    if (m_pCurrent->nSamples == 0)
+    {
+      writeBits(pData, nBitPos, nTimeMs, 32);
+      for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+      {
+        writeBits(pData, nBitPos, (uint32_t)arrValues[nChannel], 32);
+      }
+      m_pCurrent->nFirstTimeMs = nTimeMs;
+    }
+    else
+    {
+      writeTimeField(pData, nBitPos, zigzag(nDeltaOfDelta));
+      for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+      {
+        writeValueField(pData, nBitPos, zigzag((uint32_t)arrValues[nChannel] - (uint32_t)m_arrPrevValues[nChannel]));
+      }
+      m_nPrevDelta = nDelta;
+    }
+
+    memcpy(m_arrPrevValues, arrValues, sizeof(int32_t) * m_nNumChannels);
+    m_pCurrent->nLastTimeMs = nTimeMs;
+    m_pCurrent->nBits = (uint16_t)nBitPos;
+    m_pCurrent->nSamples++;
+    m_nSampleCount++;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+uint32_t CHistoryRing::getFirstSeq()
+{
+  return (m_nNextSeq > m_nNumBlocks) ? m_nNextSeq - m_nNumBlocks : 0;
+}
+
+uint32_t CHistoryRing::getNextSeq()
+{
+  return m_nNextSeq;
+}
+
+// pData must hold getBlockBytes(). Returns false if the block has already
+// been evicted or doesn't exist yet.
+bool CHistoryRing::copyBlock(uint32_t nSeq, HistoryBlockHeader *pHeader, uint8_t *pData, size_t nDataLen)
+{
+  bool bReturn = false;
+
+  if ((pHeader != NULL) && (pData != NULL) && (nDataLen >= m_nBlockBytes) &&
+      (nSeq >= getFirstSeq()) && (nSeq < m_nNextSeq))
+  {
+    uint16_t nIndex = nSeq % m_nNumBlocks;
+    memcpy(pHeader, &m_arrHeaders[nIndex], sizeof(HistoryBlockHeader));
+    memcpy(pData, m_pStorage + (size_t)nIndex * m_nBlockBytes, (pHeader->nBits + 7) / 8);
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+uint8_t CHistoryRing::getNumChannels()
+{
+  return m_nNumChannels;
+}
+
+uint16_t CHistoryRing::getBlockBytes()
+{
+  return m_nBlockBytes;
+}
+
+size_t CHistoryRing::getCapacityBytes()
+{
+  return (size_t)m_nNumBlocks * m_nBlockBytes;
+}
+
+size_t CHistoryRing::getBytesUsed()
+{
+  size_t nReturn = 0;
+
+  for (uint32_t nSeq = getFirstSeq(); nSeq < m_nNextSeq; nSeq++)
+  {
+    nReturn += (m_arrHeaders[nSeq % m_nNumBlocks].nBits + 7) / 8;
+  }
+
+  return nReturn;
+}
+
+uint32_t CHistoryRing::getSampleCount()
+{
+  return m_nSampleCount;
+}
+
+CHistoryBlockDecoder::CHistoryBlockDecoder()
+{
+}
+
+void CHistoryBlockDecoder::reset(const HistoryBlockHeader *pHeader, const uint8_t *pData, uint8_t nNumChannels)
+{
+  m_pData = pData;
+  m_nBitPos = 0;
+  m_nBits = (pHeader != NULL) ? pHeader->nBits : 0;
+  m_nSamplesLeft = ((pHeader != NULL) && (pData != NULL)) ? pHeader->nSamples : 0;
+  m_nSamplesRead = 0;
+  m_nNumChannels = (nNumChannels < HISTORY_MAX_CHANNELS) ? nNumChannels : HISTORY_MAX_CHANNELS;
+  m_nPrevDelta = 0;
+}
+
+// Reads past the end return zeros rather than touching memory outside the block
+uint32_t CHistoryBlockDecoder::readBits(uint8_t nBits)
+{
+  uint32_t nReturn = 0;
+
+  while (nBits > 0)
+  {
+    nBits--;
+    uint32_t nBit = 0;
+    if (m_nBitPos < m_nBits)
+    {
+      nBit = (m_pData[m_nBitPos >> 3] >> (7 - (m_nBitPos & 7))) & 1;
+    }
+    nReturn = (nReturn << 1) | nBit;
+    m_nBitPos++;
+  }
+
+  return nReturn;
+}
+
+uint32_t CHistoryBlockDecoder::readTimeField()
+{
+  uint32_t nReturn = 0;
+
+  if (readBits(1) != 0)
+  {
+    if (readBits(1) == 0)
+    {
+      nReturn = readBits(7);
+    }
+    else if (readBits(1) == 0)
+    {
+      nReturn = readBits(9);
+    }
+    else if (readBits(1) == 0)
+    {
+      nReturn = readBits(12);
+    }
+    else
+    {
+      nReturn = readBits(32);
+    }
+  }
+
+  return unzigzag(nReturn);
+}
+
+uint32_t CHistoryBlockDecoder::readValueField()
+{
+  uint32_t nReturn = 0;
+
+  if (readBits(1) != 0)
+  {
+    if (readBits(1) == 0)
+    {
+      nReturn = readBits(6);
+    }
+    else if (readBits(1) == 0)
+    {
+      nReturn = readBits(12);
+    }
+    else
+    {
+      nReturn = readBits(32);
+    }
+  }
+
+  return unzigzag(nReturn);
+}
+
+bool CHistoryBlockDecoder::next(uint32_t *pnTimeMs, int32_t *arrValues)
+{
+  bool bReturn = false;
+
+  if ((m_nSamplesLeft > 0) && (pnTimeMs != NULL) && (arrValues != NULL))
+  {
+    if (m_nSamplesRead == 0)
+    {
+      m_nPrevTimeMs = readBits(32);
+      for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+      {
+        m_arrPrevValues[nChannel] = (int32_t)readBits(32);
+      }
+    }
+    else
+    {
+      m_nPrevDelta += readTimeField();
+      m_nPrevTimeMs += m_nPrevDelta;
+      for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+      {
+        m_arrPrevValues[nChannel] = (int32_t)((uint32_t)m_arrPrevValues[nChannel] + readValueField());
+      }
+    }
+
+    *pnTimeMs = m_nPrevTimeMs;
+    memcpy(arrValues, m_arrPrevValues, sizeof(int32_t) * m_nNumChannels);
+    m_nSamplesLeft--;
+    m_nSamplesRead++;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
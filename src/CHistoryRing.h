@@ -0,0 +1,93 @@
+#ifndef __CHISTORYRING_H__
+#define __CHISTORYRING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_MAX_CHANNELS 24
+
+// One block of the ring. Samples inside a block depend on the one before,
+// so a block is the unit of eviction and of decoding.
+typedef struct HistoryBlockHeader
+{
+  uint32_t nSeq;
+  uint32_t nFirstTimeMs;
+  uint32_t nLastTimeMs;
+  uint16_t nSamples;
+  uint16_t nBits;
+} HistoryBlockHeader;
+
+// Compressed ring of (time, int32 x channels) samples split into fixed
+// size blocks; when the ring is full the oldest block is dropped.
+//
+// The first sample of a block is stored verbatim. After that timestamps
+// are stored as delta-of-delta and values as deltas from the previous
+// sample, both zigzagged into small variable length bit fields, so a
+// steady 1 Hz sample with unchanged values costs one bit per channel plus
+// one for the timestamp.
+//
+// Plain C++ with no locking: the owner must serialize append() against
+// copyBlock().
+class CHistoryRing
+{
+public:
+  CHistoryRing(uint8_t nNumChannels, uint16_t nNumBlocks = 64, uint16_t nBlockBytes = 512);
+  ~CHistoryRing();
+
+  bool append(uint32_t nTimeMs, const int32_t *arrValues);
+
+  // Blocks [getFirstSeq(), getNextSeq()) are available
+  uint32_t getFirstSeq();
+  uint32_t getNextSeq();
+  bool copyBlock(uint32_t nSeq, HistoryBlockHeader *pHeader, uint8_t *pData, size_t nDataLen);
+
+  uint8_t getNumChannels();
+  uint16_t getBlockBytes();
+  size_t getCapacityBytes();
+  size_t getBytesUsed();
+  uint32_t getSampleCount();
+
+private:
+  void startBlock();
+  uint32_t getEncodedBits(uint32_t nDeltaOfDelta, const int32_t *arrValues);
+
+  uint8_t m_nNumChannels = 0;
+  uint16_t m_nNumBlocks = 0;
+  uint16_t m_nBlockBytes = 0;
+  uint8_t *m_pStorage = NULL;
+  HistoryBlockHeader *m_arrHeaders = NULL;
+  uint32_t m_nNextSeq = 0;
+  uint32_t m_nSampleCount = 0;
+
+  // Encoder state for the block being filled
+  HistoryBlockHeader *m_pCurrent = NULL;
+  uint32_t m_nPrevDelta = 0;
+  int32_t m_arrPrevValues[HISTORY_MAX_CHANNELS] = {};
+};
+
+// Decodes the samples of one block copied out with copyBlock()
+class CHistoryBlockDecoder
+{
+public:
+  CHistoryBlockDecoder();
+
+  void reset(const HistoryBlockHeader *pHeader, const uint8_t *pData, uint8_t nNumChannels);
+  bool next(uint32_t *pnTimeMs, int32_t *arrValues);
+
+private:
+  uint32_t readBits(uint8_t nBits);
+  uint32_t readTimeField();
+  uint32_t readValueField();
+
+  const uint8_t *m_pData = NULL;
+  uint32_t m_nBitPos = 0;
+  uint32_t m_nBits = 0;
+  uint16_t m_nSamplesLeft = 0;
+  uint16_t m_nSamplesRead = 0;
+  uint8_t m_nNumChannels = 0;
+  uint32_t m_nPrevTimeMs = 0;
+  uint32_t m_nPrevDelta = 0;
+  int32_t m_arrPrevValues[HISTORY_MAX_CHANNELS] = {};
+};
+
+#endif // #ifndef __CHISTORYRING_H__
@@ -0,0 +1,228 @@
+#include <CHistoryWriter.h>
+
+CHistoryWriter::CHistoryWriter(CHistoryRecorder *pRecorder, uint32_t nFromMs, uint32_t nToMs, uint32_t nStepMs)
+    : CLineWriter(m_szLine),
+      m_pRecorder(pRecorder),
+      m_nNowMs(millis()),
+      m_nFromMs(nFromMs),
+      m_nToMs(nToMs),
+      m_nStepMs(nStepMs)
+{
+  if (m_pRecorder != NULL)
+  {
+    m_nNumChannels = m_pRecorder->getNumChannels();
+    m_nSeq = m_pRecorder->getFirstSeq();
+    m_nEndSeq = m_pRecorder->getNextSeq();
+    m_nBlockLen = m_pRecorder->getBlockBytes();
+    m_pBlock = new uint8_t[m_nBlockLen];
+  }
+}
+
+CHistoryWriter::~CHistoryWriter()
+{
+  if (m_pBlock != NULL)
+  {
+    delete[] m_pBlock;
+    m_pBlock = NULL;
+  }
+}
+
+bool CHistoryWriter::renderNext()
+{
+  m_nLineLen = 0;
+  m_nLineOffset = 0;
+
+  while ((m_state != STATE_DONE) && (m_nLineLen == 0))
+  {
+    switch (m_state)
+    {
+    case STATE_HEADER:
+      renderHeader();
+      m_state = STATE_POINTS;
+      break;
+
+    case STATE_POINTS:
+      if (!nextPoint())
+      {
+        m_state = STATE_FLUSH;
+      }
+      break;
+
+    case STATE_FLUSH:
+      if (m_bHaveBucket)
+      {
+        renderBucket();
+        m_bHaveBucket = false;
+      }
+      m_state = STATE_FOOTER;
+      break;
+
+    case STATE_FOOTER:
+      m_nLineLen = snprintf(m_szLine, sizeof(m_szLine), "]}\n");
+      m_state = STATE_DONE;
+      break;
+
+    default:
+      m_state = STATE_DONE;
+      break;
+    }
+  }
+
+  return (m_nLineLen > 0);
+}
+
+void CHistoryWriter::renderHeader()
+{
+  int nWritten = snprintf(m_szLine, sizeof(m_szLine),
+                          "{\"now\":%u,\"from\":%u,\"to\":%u,\"step\":%u,\"intervalMs\":%u,\"channels\":[",
+                          m_nNowMs, m_nFromMs, m_nToMs, m_nStepMs,
+                          (m_pRecorder != NULL) ? m_pRecorder->getIntervalMs() : 0);
+  size_t nPos = (nWritten > 0) ? (size_t)nWritten : 0;
+  uint8_t nNumSensors = (m_pRecorder != NULL) ? m_pRecorder->getNumSensors() : 0;
+
+  for (uint8_t nChannel = 0; (nChannel < m_nNumChannels) && (nPos < sizeof(m_szLine)); nChannel++)
+  {
+    const char *pszSeparator = (nChannel > 0) ? "," : "";
+    if (nChannel < nNumSensors)
+    {
+      nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, "%s\"temp%uRaw\"", pszSeparator, nChannel);
+    }
+    else
+    {
+      uint8_t nFanChannel = nChannel - nNumSensors;
+      nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, "%s\"fan%u%s\"",
+                          pszSeparator, nFanChannel / 2, (nFanChannel & 1) ? "Rpm" : "DutyMilli");
+    }
+    nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+  }
+
+  if (nPos < sizeof(m_szLine))
+  {
+    nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, "],\"points\":[");
+    nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+  }
+
+  m_nLineLen = min(nPos, sizeof(m_szLine) - 1);
+}
+
+bool CHistoryWriter::isInRange(uint32_t nTimeMs)
+{
+  // Differences rather than comparisons so millis() rollover is harmless
+  return ((int32_t)(nTimeMs - m_nFromMs) >= 0) && ((int32_t)(m_nToMs - nTimeMs) >= 0);
+}
+
+// Moves to the next block that overlaps the range, skipping any that were
+// evicted while the response was streaming
+bool CHistoryWriter::loadNextBlock()
+{
+  bool bReturn = false;
+
+  while (!bReturn && (m_pRecorder != NULL) && (m_pBlock != NULL) && (m_nSeq < m_nEndSeq))
+  {
+    uint32_t nFirstSeq = m_pRecorder->getFirstSeq();
+    if (m_nSeq < nFirstSeq)
+    {
+      m_nSeq = nFirstSeq;
+    }
+    else if (m_pRecorder->copyBlock(m_nSeq++, &m_blockHeader, m_pBlock, m_nBlockLen))
+    {
+      if ((int32_t)(m_blockHeader.nFirstTimeMs - m_nToMs) > 0)
+      {
+        // Everything after this is newer still
+        m_nSeq = m_nEndSeq;
+      }
+      else if ((int32_t)(m_blockHeader.nLastTimeMs - m_nFromMs) >= 0)
+      {
+        m_decoder.reset(&m_blockHeader, m_pBlock, m_nNumChannels);
+        bReturn = true;
+      }
+    }
+  }
+
+  return bReturn;
+}
+
+// Decodes until a line is ready. Returns false when the range is exhausted.
+bool CHistoryWriter::nextPoint()
+{
+  bool bReturn = true;
+  uint32_t nTimeMs = 0;
+  int32_t arrValues[HISTORY_MAX_CHANNELS];
+
+  while (bReturn && (m_nLineLen == 0))
+  {
+    if (!m_decoder.next(&nTimeMs, arrValues))
+    {
+      bReturn = loadNextBlock();
+    }
+    else if ((int32_t)(nTimeMs - m_nToMs) > 0)
+    {
+      m_nSeq = m_nEndSeq;
+      bReturn = false;
+    }
+    else if (isInRange(nTimeMs))
+    {
+      if (m_nStepMs == 0)
+      {
+        renderPoint(nTimeMs, arrValues);
+      }
+      else
+      {
+        uint32_t nBucketMs = m_nFromMs + ((nTimeMs - m_nFromMs) / m_nStepMs) * m_nStepMs;
+        if (m_bHaveBucket && (nBucketMs != m_nBucketMs))
+        {
+          renderBucket();
+          m_bHaveBucket = false;
+        }
+        if (!m_bHaveBucket)
+        {
+          m_nBucketMs = nBucketMs;
+          m_nBucketCount = 0;
+          memset(m_arrBucketSums, 0, sizeof(m_arrBucketSums));
+          m_bHaveBucket = true;
+        }
+        for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+        {
+          m_arrBucketSums[nChannel] += arrValues[nChannel];
+        }
+        m_nBucketCount++;
+      }
+    }
+  }
+
+  return bReturn;
+}
+
+void CHistoryWriter::renderPoint(uint32_t nTimeMs, const int32_t *arrValues)
+{
+  int nWritten = snprintf(m_szLine, sizeof(m_szLine), "%s[%u", m_bFirstPoint ? "" : ",", nTimeMs);
+  size_t nPos = (nWritten > 0) ? (size_t)nWritten : 0;
+
+  for (uint8_t nChannel = 0; (nChannel < m_nNumChannels) && (nPos < sizeof(m_szLine)); nChannel++)
+  {
+    nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, ",%d", arrValues[nChannel]);
+    nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+  }
+  if (nPos < sizeof(m_szLine))
+  {
+    nWritten = snprintf(m_szLine + nPos, sizeof(m_szLine) - nPos, "]");
+    nPos += (nWritten > 0) ? (size_t)nWritten : 0;
+  }
+
+  m_nLineLen = min(nPos, sizeof(m_szLine) - 1);
+  m_bFirstPoint = false;
+}
+
+void CHistoryWriter::renderBucket()
+{
+  int32_t arrValues[HISTORY_MAX_CHANNELS];
+  int64_t nHalf = m_nBucketCount / 2;
+
+  for (uint8_t nChannel = 0; nChannel < m_nNumChannels; nChannel++)
+  {
+    int64_t nSum = m_arrBucketSums[nChannel];
+    arrValues[nChannel] = (int32_t)((nSum >= 0) ? (nSum + nHalf) / m_nBucketCount : (nSum - nHalf) / m_nBucketCount);
+  }
+
+  renderPoint(m_nBucketMs, arrValues);
+}
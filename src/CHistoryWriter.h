@@ -0,0 +1,66 @@
+#ifndef __CHISTORYWRITER_H__
+#define __CHISTORYWRITER_H__
+
+#include <Arduino.h>
+#include <CHistoryRecorder.h>
+#include <CLineWriter.h>
+
+// Streams a time range of the recorded history as JSON through
+// CLineWriter::fill(), decoding one block at a time. With a step every point inside each step
+// is averaged into one; without one the raw points are sent.
+//
+//   {"now":N,"from":F,"to":T,"step":S,"intervalMs":I,
+//    "channels":["temp0Raw",...,"fan0DutyMilli","fan0Rpm",...],
+//    "points":[[t,v0,v1,...],...]}
+//
+// Times are millis(). Temperatures are raw 1/128 C, duty is milli-percent.
+class CHistoryWriter : public CLineWriter
+{
+public:
+  CHistoryWriter(CHistoryRecorder *pRecorder, uint32_t nFromMs, uint32_t nToMs, uint32_t nStepMs);
+  ~CHistoryWriter();
+
+private:
+  enum WriterState
+  {
+    STATE_HEADER = 0,
+    STATE_POINTS,
+    STATE_FLUSH,
+    STATE_FOOTER,
+    STATE_DONE
+  };
+
+  bool renderNext();
+  void renderHeader();
+  bool loadNextBlock();
+  bool nextPoint();
+  void renderPoint(uint32_t nTimeMs, const int32_t *arrValues);
+  void renderBucket();
+  bool isInRange(uint32_t nTimeMs);
+
+  CHistoryRecorder *m_pRecorder = NULL;
+  uint32_t m_nNowMs = 0;
+  uint32_t m_nFromMs = 0;
+  uint32_t m_nToMs = 0;
+  uint32_t m_nStepMs = 0;
+  uint8_t m_nNumChannels = 0;
+  WriterState m_state = STATE_HEADER;
+  bool m_bFirstPoint = true;
+
+  uint32_t m_nSeq = 0;
+  uint32_t m_nEndSeq = 0;
+  HistoryBlockHeader m_blockHeader = {};
+  uint8_t *m_pBlock = NULL;
+  size_t m_nBlockLen = 0;
+  CHistoryBlockDecoder m_decoder;
+
+  // Downsampling bucket
+  bool m_bHaveBucket = false;
+  uint32_t m_nBucketMs = 0;
+  uint32_t m_nBucketCount = 0;
+  int64_t m_arrBucketSums[HISTORY_MAX_CHANNELS] = {};
+
+  char m_szLine[512] = {};
+};
+
+#endif // #ifndef __CHISTORYWRITER_H__
@@ -0,0 +1,103 @@
+#include <CHotPathBench.h>
+
+void CHotPathBench::begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors)
+{
+  m_nNumFans = (arrFanCtrl != NULL) ? min(nNumFans, (size_t)MAX_FANS) : 0;
+  for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    m_arrFanCtrl[nIndex] = arrFanCtrl[nIndex];
+  }
+
+  m_pTempSensors = pTempSensors;
+
+  m_telemetry.begin(m_arrFanCtrl, m_nNumFans, m_pTempSensors);
+}
+
+void CHotPathBench::runLive(CMicroBench *pBench)
+{
+  if (pBench != NULL)
+  {
+    if (m_pTempSensors != NULL)
+    {
+      pBench->run("CTempSensors::getTempF", 101, 64, [this]() {
+        m_fSink = m_pTempSensors->getTempF(0);
+      });
+    }
+
+    if (m_nNumFans > 0)
+    {
+      pBench->run("CPwmFanControl::getFanRpms", 101, 64, [this]() {
+        m_nSink = m_arrFanCtrl[0]->getFanRpms();
+      });
+
+      // The conversion setFanDutyCyclePercent() makes for every PID output
+      pBench->run("CPwmFanControl::percentToDuty", 101, 256, [this]() {
+        m_nSink = m_arrFanCtrl[0]->percentToDuty(m_fPercent);
+      });
+    }
+
+    // What /status does for a new sample generation: capture the values,
+    // then render the body
+    pBench->run("/status JSON", 101, 1, [this]() {
+      m_telemetry.sample();
+      m_nSink = m_telemetry.writeFull(m_szFrame, sizeof(m_szFrame));
+    });
+
+    pBench->run("/status CBOR", 101, 1, [this]() {
+      m_telemetry.sample();
+      m_nSink = m_telemetry.writeCbor(m_arrCbor, sizeof(m_arrCbor));
+    });
+
+    // What every instrumented task loop pays (on a scratch CTaskPerf)
+    pBench->run("CTaskPerf::loopStart+loopEnd", 101, 16, [this]() {
+      m_taskPerf.loopStart();
+      m_taskPerf.loopEnd();
+    });
+  }
+}
+
+void CHotPathBench::runAll(CMicroBench *pBench)
+{
+  if (pBench != NULL)
+  {
+    runLive(pBench);
+
+    if ((m_pTempSensors != NULL) && m_pTempSensors->isAsyncConversion())
+    {
+      // Start a conversion so the timed calls only see it pending
+      m_pTempSensors->update();
+      pBench->run("CTempSensors::update (pending)", 101, 16, [this]() {
+        m_nSink = m_pTempSensors->update();
+      });
+
+      // Each sample waits out a conversion first, so every timed call
+      // reads the sensors and starts the next conversion
+      pBench->run(
+          "CTempSensors::update (read)", 9, 1, [this]() {
+            m_nSink = m_pTempSensors->update();
+          },
+          [this]() {
+            halDelayMs(m_pTempSensors->getConversionTimeMs());
+          });
+    }
+    else if (m_pTempSensors != NULL)
+    {
+      pBench->run("CTempSensors::update (blocking)", 5, 1, [this]() {
+        m_nSink = m_pTempSensors->update();
+      });
+    }
+
+    if (m_nNumFans > 0)
+    {
+      // What the scheduler calls with each PID output. Alternate between two
+      // duties so every call changes the output.
+      uint32_t nCall = 0;
+      float arrPercents[2] = {60.0f, 80.0f};
+      uint32_t nRestoreDutyCycle = m_arrFanCtrl[0]->getLastSpecDutyCycle();
+      pBench->run("CPwmFanControl::setFanDutyCyclePercent", 101, 16, [this, &nCall, &arrPercents]() {
+        m_arrFanCtrl[0]->setFanDutyCyclePercent(arrPercents[nCall++ & 1]);
+      });
+      m_arrFanCtrl[0]->setFanDutyCycle(nRestoreDutyCycle);
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef __CHOTPATHBENCH_H__
+#define __CHOTPATHBENCH_H__
+
+#include <Hal.h>
+#include <CMicroBench.h>
+#include <CPwmFanControl.h>
+#include <CTempSensors.h>
+#include <CTelemetry.h>
+#include <CTaskPerf.h>
+
+// The firmware's hot paths as a CMicroBench suite, the same code on the
+// ESP32 and on the host (tools/microbench, against simulated parts).
+//
+// runLive() only reads, so it's safe while the control tasks run and is
+// what /bench reports. runAll() also times CTempSensors::update() and
+// CPwmFanControl::setFanDutyCyclePercent(), which belong to the temperature task
+// and the fan scheduler; run it before those tasks start.
+class CHotPathBench
+{
+public:
+  void begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors);
+
+  void runLive(CMicroBench *pBench);
+  void runAll(CMicroBench *pBench);
+
+private:
+  CPwmFanControl *m_arrFanCtrl[MAX_FANS] = {};
+  size_t m_nNumFans = 0;
+  CTempSensors *m_pTempSensors = NULL;
+  CTelemetry m_telemetry;
+  CTaskPerf m_taskPerf{"bench"};
+  char m_szFrame[1024] = {};
+  uint8_t m_arrCbor[512] = {};
+
+  // Results go here so the compiler can't drop the calls
+  volatile uint32_t m_nSink = 0;
+  volatile float m_fSink = 0.0f;
+  volatile float m_fPercent = 42.5f;
+};
+
+#endif // #ifndef __CHOTPATHBENCH_H__
@@ -0,0 +1,56 @@
+#include <CIsrTachCounter.h>
+
+CIsrTachCounter::CIsrTachCounter(const uint8_t nPinFanTach)
+    : m_muxFanIrqCounter(portMUX_INITIALIZER_UNLOCKED)
+{
+  m_nPinFanTach = nPinFanTach;
+}
+
+bool CIsrTachCounter::begin()
+{
+  m_muxFanIrqCounter = portMUX_INITIALIZER_UNLOCKED;
+
+  pinMode(m_nPinFanTach, INPUT_PULLUP);
+  attachInterruptArg(digitalPinToInterrupt(m_nPinFanTach),
+                     CIsrTachCounter::isrFanTach,
+                     this,
+                     FALLING);
+
+  return true;
+}
+
+void IRAM_ATTR CIsrTachCounter::isrFanTach(void *pArg)
+{
+  CIsrTachCounter *pThis = (CIsrTachCounter *)pArg;
+
+  pThis->m_edgeRing.push(micros());
+
+  portENTER_CRITICAL_ISR(&pThis->m_muxFanIrqCounter);
+  {
+    pThis->m_nFanTackIrqCounter++;
+  }
+  portEXIT_CRITICAL_ISR(&pThis->m_muxFanIrqCounter);
+}
+
+uint32_t CIsrTachCounter::getPulseCount()
+{
+  uint32_t nReturn = 0;
+
+  portENTER_CRITICAL(&m_muxFanIrqCounter);
+  {
+    nReturn = m_nFanTackIrqCounter;
+  }
+  portEXIT_CRITICAL(&m_muxFanIrqCounter);
+
+  return nReturn;
+}
+
+const CTachEdgeRing *CIsrTachCounter::getEdgeRing()
+{
+  return &m_edgeRing;
+}
+
+bool CIsrTachCounter::isInterruptPerEdge()
+{
+  return true;
+}
@@ -0,0 +1,28 @@
+#ifndef __CISRTACHCOUNTER_H__
+#define __CISRTACHCOUNTER_H__
+
+#include <Arduino.h>
+#include <CTachCounter.h>
+
+// Counts tach edges with a GPIO interrupt per falling edge, and timestamps
+// each edge for the period based RPM estimator
+class CIsrTachCounter : public CTachCounter
+{
+public:
+  CIsrTachCounter(const uint8_t nPinFanTach);
+
+  bool begin();
+  uint32_t getPulseCount();
+  const CTachEdgeRing *getEdgeRing();
+  bool isInterruptPerEdge();
+
+private:
+  static void IRAM_ATTR isrFanTach(void *pArg);
+
+  portMUX_TYPE m_muxFanIrqCounter = portMUX_INITIALIZER_UNLOCKED;
+  volatile uint32_t m_nFanTackIrqCounter = 0;
+  CTachEdgeRing m_edgeRing;
+  uint8_t m_nPinFanTach = 0;
+};
+
+#endif // #ifndef __CISRTACHCOUNTER_H__
@@ -0,0 +1,73 @@
+#include <CLedcPwmChannel.h>
+#include <driver/ledc.h>
+
+// Arduino LEDC channels 0-7 are the high speed group, 8-15 the low speed one
+#define LEDC_SPEED_MODE(nChannel) (((nChannel) < 8) ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE)
+#define LEDC_GROUP_CHANNEL(nChannel) ((ledc_channel_t)((nChannel) % 8))
+
+// ledc_set_duty() waits for an in-flight fade to finish. Where the driver
+// has no ledc_fade_stop() to cut one short, fades are capped at this
+// length so a write never waits longer than that.
+#if !defined(SOC_LEDC_SUPPORT_FADE_STOP) || !SOC_LEDC_SUPPORT_FADE_STOP
+#define LEDC_MAX_UNSTOPPABLE_FADE_MS 100
+#endif
+
+static bool s_bLedcFadeInstalled = false;
+
+CLedcPwmChannel::CLedcPwmChannel(const uint8_t nPwmChannel, const uint8_t nPinPwm)
+{
+  m_nPwmChannel = nPwmChannel;
+  m_nPinPwm = nPinPwm;
+}
+
+bool CLedcPwmChannel::begin(const uint32_t nFrequency, const uint8_t nResolution)
+{
+  bool bReturn = (ledcSetup(m_nPwmChannel, nFrequency, nResolution) != 0);
+
+  ledcWrite(m_nPwmChannel, 0);
+  ledcAttachPin(m_nPinPwm, m_nPwmChannel);
+
+  return bReturn;
+}
+
+void CLedcPwmChannel::write(const uint32_t nDutyCycle)
+{
+  ledcWrite(m_nPwmChannel, nDutyCycle);
+}
+
+uint32_t CLedcPwmChannel::read()
+{
+  return ledc_get_duty(LEDC_SPEED_MODE(m_nPwmChannel), LEDC_GROUP_CHANNEL(m_nPwmChannel));
+}
+
+// The fade engine blocks until an in-flight fade completes, so callers
+// only start a fade once the last one is done, or stop it first. A capped
+// fade reaches its target early and holds it for the rest of the segment.
+bool CLedcPwmChannel::fade(const uint32_t nDutyCycle, const uint32_t nFadeMs)
+{
+  uint32_t nTmpFadeMs = nFadeMs;
+#ifdef LEDC_MAX_UNSTOPPABLE_FADE_MS
+  nTmpFadeMs = min(nTmpFadeMs, (uint32_t)LEDC_MAX_UNSTOPPABLE_FADE_MS);
+#endif
+
+  if (!s_bLedcFadeInstalled)
+  {
+    s_bLedcFadeInstalled = (ledc_fade_func_install(0) == ESP_OK);
+  }
+
+  return s_bLedcFadeInstalled &&
+         (ledc_set_fade_with_time(LEDC_SPEED_MODE(m_nPwmChannel), LEDC_GROUP_CHANNEL(m_nPwmChannel), nDutyCycle, nTmpFadeMs) == ESP_OK) &&
+         (ledc_fade_start(LEDC_SPEED_MODE(m_nPwmChannel), LEDC_GROUP_CHANNEL(m_nPwmChannel), LEDC_FADE_NO_WAIT) == ESP_OK);
+}
+
+bool CLedcPwmChannel::stopFade()
+{
+  bool bReturn = false;
+
+#ifndef LEDC_MAX_UNSTOPPABLE_FADE_MS
+  bReturn = !s_bLedcFadeInstalled ||
+            (ledc_fade_stop(LEDC_SPEED_MODE(m_nPwmChannel), LEDC_GROUP_CHANNEL(m_nPwmChannel)) == ESP_OK);
+#endif
+
+  return bReturn;
+}
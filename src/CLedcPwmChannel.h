@@ -0,0 +1,24 @@
+#ifndef __CLEDCPWMCHANNEL_H__
+#define __CLEDCPWMCHANNEL_H__
+
+#include <Arduino.h>
+#include <CPwmChannel.h>
+
+// PWM on an ESP32 LEDC channel, with fades run by the LEDC fade engine
+class CLedcPwmChannel : public CPwmChannel
+{
+public:
+  CLedcPwmChannel(const uint8_t nPwmChannel, const uint8_t nPinPwm);
+
+  bool begin(const uint32_t nFrequency, const uint8_t nResolution);
+  void write(const uint32_t nDutyCycle);
+  uint32_t read();
+  bool fade(const uint32_t nDutyCycle, const uint32_t nFadeMs);
+  bool stopFade();
+
+private:
+  uint8_t m_nPwmChannel = 0; // this variable is used to select the channel number
+  uint8_t m_nPinPwm = 0;     // GPIO to which we want to attach this channel signal
+};
+
+#endif // #ifndef __CLEDCPWMCHANNEL_H__
@@ -0,0 +1,38 @@
+#include <CLineWriter.h>
+#include <string.h>
+
+CLineWriter::CLineWriter(const void *pLine)
+{
+  m_pLine = (const uint8_t *)pLine;
+}
+
+// Copies as much of the response as fits in pBuf. Returns 0 once
+// everything has been written.
+size_t CLineWriter::fill(uint8_t *pBuf, size_t nMaxLen)
+{
+  size_t nPos = 0;
+
+  while (nPos < nMaxLen)
+  {
+    if (isLineSent() && !renderNext())
+    {
+      break;
+    }
+
+    size_t nCopy = m_nLineLen - m_nLineOffset;
+    if (nCopy > nMaxLen - nPos)
+    {
+      nCopy = nMaxLen - nPos;
+    }
+    memcpy(pBuf + nPos, m_pLine + m_nLineOffset, nCopy);
+    m_nLineOffset += nCopy;
+    nPos += nCopy;
+  }
+
+  return nPos;
+}
+
+bool CLineWriter::isLineSent()
+{
+  return (m_nLineOffset >= m_nLineLen);
+}
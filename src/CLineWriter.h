@@ -0,0 +1,36 @@
+#ifndef __CLINEWRITER_H__
+#define __CLINEWRITER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Base of the streaming response writers. A subclass renders one line at a
+// time into its own buffer (given to the constructor), setting m_nLineLen
+// in renderNext(); fill() hands lines out across as many calls as the
+// buffer space a chunked response offers needs, so a response of any size
+// is never held in RAM. A "line" is whatever unit the writer renders: a
+// text line, or a whole record for a binary format.
+class CLineWriter
+{
+public:
+  virtual ~CLineWriter() {}
+
+  size_t fill(uint8_t *pBuf, size_t nMaxLen);
+
+protected:
+  CLineWriter(const void *pLine);
+
+  // Renders the next line and returns true, or returns false once there is
+  // nothing left. Starts by resetting m_nLineLen and m_nLineOffset.
+  virtual bool renderNext() = 0;
+
+  bool isLineSent();
+
+  size_t m_nLineLen = 0;
+  size_t m_nLineOffset = 0;
+
+private:
+  const uint8_t *m_pLine = NULL;
+};
+
+#endif // #ifndef __CLINEWRITER_H__
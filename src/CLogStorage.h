@@ -0,0 +1,25 @@
+#ifndef __CLOGSTORAGE_H__
+#define __CLOGSTORAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed set of append-only segments backing CFlashLog. A segment is only
+// ever appended to or erased as a whole.
+class CLogStorage
+{
+public:
+  virtual ~CLogStorage() {}
+
+  virtual bool begin() = 0;
+  virtual uint8_t getNumSegments() = 0;
+  virtual uint32_t getSegmentSize() = 0;
+
+  // Bytes currently in the segment, 0 if it's empty or missing
+  virtual uint32_t getSegmentLength(uint8_t nSegment) = 0;
+  virtual size_t read(uint8_t nSegment, uint32_t nOffset, uint8_t *pBuf, size_t nLen) = 0;
+  virtual bool append(uint8_t nSegment, const uint8_t *pBuf, size_t nLen) = 0;
+  virtual bool erase(uint8_t nSegment) = 0;
+};
+
+#endif // #ifndef __CLOGSTORAGE_H__
@@ -0,0 +1,233 @@
+#include <CMetricsWriter.h>
+
+#define METRICS_PREFIX "tempfan_"
+
+typedef struct MetricInfo
+{
+  const char *pszName;
+  const char *pszType;
+  const char *pszHelp;
+} MetricInfo;
+
+// Indexed by CMetricsWriter::MetricFamily
+static const MetricInfo s_arrMetricInfo[] = {
+    {"fan_rpm", "gauge", "Fan speed in revolutions per minute."},
+    {"fan_duty_percent", "gauge", "Duty cycle currently applied to the fan."},
+    {"fan_spec_duty_percent", "gauge", "Last duty cycle requested by the controller, before min/off clamping."},
+    {"fan_stalled", "gauge", "1 if the fan is driven but its tach has stopped."},
+    {"fan_runtime_seconds", "gauge", "Time the fan has been running since it last switched on."},
+    {"temperature_celsius", "gauge", "Temperature reported by each sensor."},
+    {"temperature_max_celsius", "gauge", "Highest temperature across all sensors."},
+    {"temperature_samples_total", "counter", "Temperature samples published."},
+    {"temperature_samples_per_second", "gauge", "Recent temperature sample rate."},
+    {"control_ticks_total", "counter", "Fan scheduler ticks."},
+    {"control_tick_seconds", "gauge", "Time spent in one fan scheduler tick."},
+    {"control_latency_seconds", "gauge", "Delay from a temperature sample to the tick that used it."},
+    {"control_watchdog_timeouts_total", "counter", "Fan scheduler ticks forced by the watchdog."},
+    {"heap_free_bytes", "gauge", "Free heap."},
+    {"heap_min_free_bytes", "gauge", "Lowest free heap since boot."},
+    {"heap_largest_block_bytes", "gauge", "Largest allocatable heap block."},
+    {"uptime_seconds", "counter", "Time since boot."}};
+
+static const char *s_arrStatNames[] = {"last", "avg", "max"};
+
+CMetricsWriter::CMetricsWriter(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors, CFanScheduler *pFanScheduler)
+    : CLineWriter(m_szLine),
+      m_arrFanCtrl(arrFanCtrl),
+      m_nNumFans((arrFanCtrl != NULL) ? nNumFans : 0),
+      m_pTempSensors(pTempSensors),
+      m_pFanScheduler(pFanScheduler)
+{
+  if (m_pTempSensors != NULL)
+  {
+    m_pTempSensors->getSnapshot(&m_temps);
+  }
+}
+
+// Advances the cursor and renders the next line into m_szLine
+bool CMetricsWriter::renderNext()
+{
+  m_nLineLen = 0;
+  m_nLineOffset = 0;
+
+  while (!m_bDone && (m_nLineLen == 0))
+  {
+    uint8_t nSamples = (m_nFamily < METRIC_FAMILY_COUNT) ? getSampleCount(m_nFamily) : 0;
+
+    if (m_nFamily >= METRIC_FAMILY_COUNT)
+    {
+      m_bDone = true;
+    }
+    else if ((m_nSample >= nSamples) || (nSamples == 0))
+    {
+      // Families with no samples (no fans, no scheduler) are left out entirely
+      m_nFamily++;
+      m_nSample = -1;
+    }
+    else
+    {
+      if (m_nSample < 0)
+      {
+        const MetricInfo &info = s_arrMetricInfo[m_nFamily];
+        int nWritten = snprintf(m_szLine, sizeof(m_szLine),
+                                "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n",
+                                info.pszName, info.pszHelp, info.pszName, info.pszType);
+        m_nLineLen = (nWritten > 0) ? min((size_t)nWritten, sizeof(m_szLine) - 1) : 0;
+      }
+      else
+      {
+        m_nLineLen = renderSample(m_nFamily, m_nSample, m_szLine, sizeof(m_szLine));
+      }
+      m_nSample++;
+    }
+  }
+
+  return (m_nLineLen > 0);
+}
+
+uint8_t CMetricsWriter::getSampleCount(uint8_t nFamily)
+{
+  uint8_t nReturn = 0;
+
+  switch (nFamily)
+  {
+  case METRIC_FAN_RPM:
+  case METRIC_FAN_DUTY:
+  case METRIC_FAN_SPEC_DUTY:
+  case METRIC_FAN_STALLED:
+  case METRIC_FAN_RUNTIME:
+    nReturn = m_nNumFans;
+    break;
+
+  case METRIC_TEMP:
+    nReturn = m_temps.nNumSensors;
+    break;
+
+  case METRIC_TEMP_MAX:
+  case METRIC_TEMP_SAMPLES:
+  case METRIC_TEMP_SAMPLE_RATE:
+    nReturn = (m_pTempSensors != NULL) ? 1 : 0;
+    break;
+
+  case METRIC_CONTROL_TICKS:
+  case METRIC_CONTROL_WATCHDOG:
+    nReturn = (m_pFanScheduler != NULL) ? 1 : 0;
+    break;
+
+  case METRIC_CONTROL_TICK_TIME:
+  case METRIC_CONTROL_LATENCY:
+    nReturn = (m_pFanScheduler != NULL) ? 3 : 0;
+    break;
+
+  default:
+    nReturn = 1;
+    break;
+  }
+
+  return nReturn;
+}
+
+size_t CMetricsWriter::renderSample(uint8_t nFamily, uint8_t nSample, char *pszBuf, size_t nBufLen)
+{
+  const char *pszName = s_arrMetricInfo[nFamily].pszName;
+  CPwmFanControl *pFanCtrl = ((nSample < m_nNumFans) && (m_arrFanCtrl != NULL)) ? m_arrFanCtrl[nSample] : NULL;
+  int nWritten = 0;
+
+  switch (nFamily)
+  {
+  case METRIC_FAN_RPM:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{fan=\"%u\"} %u\n", pszName, nSample, (pFanCtrl != NULL) ? pFanCtrl->getFanRpms() : 0);
+    break;
+
+  case METRIC_FAN_DUTY:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{fan=\"%u\"} %.3f\n", pszName, nSample, (pFanCtrl != NULL) ? pFanCtrl->getLastDutyCyclePercent() : 0.0);
+    break;
+
+  case METRIC_FAN_SPEC_DUTY:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{fan=\"%u\"} %.3f\n", pszName, nSample, (pFanCtrl != NULL) ? pFanCtrl->getLastSpecDutyCyclePercent() : 0.0);
+    break;
+
+  case METRIC_FAN_STALLED:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{fan=\"%u\"} %u\n", pszName, nSample, ((pFanCtrl != NULL) && pFanCtrl->isStalled()) ? 1 : 0);
+    break;
+
+  case METRIC_FAN_RUNTIME:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{fan=\"%u\"} %.3f\n", pszName, nSample, (pFanCtrl != NULL) ? pFanCtrl->getRuntimeMs() / 1000.0 : 0.0);
+    break;
+
+  case METRIC_TEMP:
+  {
+    char szAddress[24] = "";
+    DeviceAddress *arrAddresses = m_pTempSensors->getSensorAddresses();
+    if (arrAddresses != NULL)
+    {
+      CTempSensors::addressToString(arrAddresses[nSample], szAddress, sizeof(szAddress));
+    }
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{sensor=\"%u\",address=\"%s\"} %.4f\n",
+                        pszName, nSample, szAddress, CTempSensors::rawToCelsius(m_temps.arrRawTemps[nSample]));
+    break;
+  }
+
+  case METRIC_TEMP_MAX:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %.4f\n", pszName, CTempSensors::rawToCelsius(m_temps.fMaxRawTemp));
+    break;
+
+  case METRIC_TEMP_SAMPLES:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, m_pTempSensors->getSampleCount());
+    break;
+
+  case METRIC_TEMP_SAMPLE_RATE:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %.3f\n", pszName, m_pTempSensors->getSamplesPerSec());
+    break;
+
+  case METRIC_CONTROL_TICKS:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, m_pFanScheduler->getTickCount());
+    break;
+
+  case METRIC_CONTROL_TICK_TIME:
+  case METRIC_CONTROL_LATENCY:
+  {
+    bool bTick = (nFamily == METRIC_CONTROL_TICK_TIME);
+    float fMicros = 0.0;
+    switch (nSample)
+    {
+    case 0:
+      fMicros = bTick ? m_pFanScheduler->getLastTickMicros() : m_pFanScheduler->getLastLatencyMicros();
+      break;
+    case 1:
+      fMicros = bTick ? m_pFanScheduler->getAvgTickMicros() : m_pFanScheduler->getAvgLatencyMicros();
+      break;
+    default:
+      fMicros = bTick ? m_pFanScheduler->getMaxTickMicros() : m_pFanScheduler->getMaxLatencyMicros();
+      break;
+    }
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s{stat=\"%s\"} %.6f\n", pszName, s_arrStatNames[nSample], fMicros / 1000000.0);
+    break;
+  }
+
+  case METRIC_CONTROL_WATCHDOG:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, m_pFanScheduler->getWatchdogTimeouts());
+    break;
+
+  case METRIC_HEAP_FREE:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, ESP.getFreeHeap());
+    break;
+
+  case METRIC_HEAP_MIN_FREE:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, ESP.getMinFreeHeap());
+    break;
+
+  case METRIC_HEAP_LARGEST_BLOCK:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %u\n", pszName, ESP.getMaxAllocHeap());
+    break;
+
+  case METRIC_UPTIME:
+    nWritten = snprintf(pszBuf, nBufLen, METRICS_PREFIX "%s %.3f\n", pszName, millis() / 1000.0);
+    break;
+
+  default:
+    break;
+  }
+
+  return (nWritten > 0) ? min((size_t)nWritten, nBufLen - 1) : 0;
+}
@@ -0,0 +1,61 @@
+#ifndef __CMETRICSWRITER_H__
+#define __CMETRICSWRITER_H__
+
+#include <Arduino.h>
+#include <CPwmFanControl.h>
+#include <CTempSensors.h>
+#include <CFanScheduler.h>
+#include <CLineWriter.h>
+
+// Renders the Prometheus text exposition format one line at a time through
+// CLineWriter::fill().
+//
+// Temperatures are captured once when the writer is created so every
+// sensor line in a scrape comes from the same sample generation.
+class CMetricsWriter : public CLineWriter
+{
+public:
+  CMetricsWriter(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors, CFanScheduler *pFanScheduler);
+
+private:
+  enum MetricFamily
+  {
+    METRIC_FAN_RPM = 0,
+    METRIC_FAN_DUTY,
+    METRIC_FAN_SPEC_DUTY,
+    METRIC_FAN_STALLED,
+    METRIC_FAN_RUNTIME,
+    METRIC_TEMP,
+    METRIC_TEMP_MAX,
+    METRIC_TEMP_SAMPLES,
+    METRIC_TEMP_SAMPLE_RATE,
+    METRIC_CONTROL_TICKS,
+    METRIC_CONTROL_TICK_TIME,
+    METRIC_CONTROL_LATENCY,
+    METRIC_CONTROL_WATCHDOG,
+    METRIC_HEAP_FREE,
+    METRIC_HEAP_MIN_FREE,
+    METRIC_HEAP_LARGEST_BLOCK,
+    METRIC_UPTIME,
+    METRIC_FAMILY_COUNT
+  };
+
+  bool renderNext();
+  uint8_t getSampleCount(uint8_t nFamily);
+  size_t renderSample(uint8_t nFamily, uint8_t nSample, char *pszBuf, size_t nBufLen);
+
+  CPwmFanControl **m_arrFanCtrl = NULL;
+  size_t m_nNumFans = 0;
+  CTempSensors *m_pTempSensors = NULL;
+  CFanScheduler *m_pFanScheduler = NULL;
+  TempSnapshot m_temps = {};
+
+  // Cursor: family, then sample within it (-1 is the HELP/TYPE header)
+  uint8_t m_nFamily = 0;
+  int16_t m_nSample = -1;
+  bool m_bDone = false;
+
+  char m_szLine[256] = {};
+};
+
+#endif // #ifndef __CMETRICSWRITER_H__
@@ -0,0 +1,88 @@
+#include <CMicroBench.h>
+#include <Appendf.h>
+#include <algorithm>
+
+CMicroBench::CMicroBench()
+{
+  calibrate();
+}
+
+void CMicroBench::clear()
+{
+  m_nNumResults = 0;
+}
+
+// Cost of the two clock reads around an empty sample, taken as the
+// fastest of a few tries
+void CMicroBench::calibrate()
+{
+  uint32_t nMinCycles = 0xffffffff;
+
+  for (uint8_t nTry = 0; nTry < 32; nTry++)
+  {
+    uint32_t nStartCycles = halCycleCount();
+    uint32_t nCycles = halCycleCount() - nStartCycles;
+    nMinCycles = min(nMinCycles, nCycles);
+  }
+
+  m_nOverheadCycles = nMinCycles;
+}
+
+bool CMicroBench::addResult(const char *pszName, uint16_t nSamples, uint16_t nBatch)
+{
+  bool bReturn = false;
+
+  if (m_nNumResults < MICRO_BENCH_MAX_RESULTS)
+  {
+    std::sort(m_arrSamples, m_arrSamples + nSamples);
+
+    // Nearest rank: the smallest sample at or above 99% of them
+    uint16_t nP99 = (uint16_t)(((uint32_t)nSamples * 99 + 99) / 100) - 1;
+    float fNsPerCycle = 1000.0f / (float)halCyclesPerMicro() / (float)nBatch;
+
+    MicroBenchResult *pResult = &m_arrResults[m_nNumResults++];
+    pResult->pszName = pszName;
+    pResult->nSamples = nSamples;
+    pResult->nBatch = nBatch;
+    pResult->fMinNs = m_arrSamples[0] * fNsPerCycle;
+    pResult->fMedianNs = m_arrSamples[nSamples / 2] * fNsPerCycle;
+    pResult->fP99Ns = m_arrSamples[nP99] * fNsPerCycle;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+size_t CMicroBench::getNumResults()
+{
+  return m_nNumResults;
+}
+
+const MicroBenchResult *CMicroBench::getResult(size_t nIndex)
+{
+  return (nIndex < m_nNumResults) ? &m_arrResults[nIndex] : NULL;
+}
+
+// {"cyclesPerUs":N,"results":[{"name":S,"samples":N,"batch":N,"minNs":F,"medianNs":F,"p99Ns":F},...]}
+// Returns the length written, or 0 if it didn't fit
+size_t CMicroBench::writeJson(char *pszBuf, size_t nBufLen)
+{
+  size_t nPos = 0;
+
+  appendf(pszBuf, nBufLen, nPos, "{\"cyclesPerUs\":%u,\"results\":[", halCyclesPerMicro());
+  for (size_t nIndex = 0; nIndex < m_nNumResults; nIndex++)
+  {
+    const MicroBenchResult *pResult = &m_arrResults[nIndex];
+    appendf(pszBuf, nBufLen, nPos, "%s{\"name\":\"%s\",\"samples\":%u,\"batch\":%u,\"minNs\":%.1f,\"medianNs\":%.1f,\"p99Ns\":%.1f}",
+            (nIndex > 0) ? "," : "",
+            pResult->pszName,
+            pResult->nSamples,
+            pResult->nBatch,
+            pResult->fMinNs,
+            pResult->fMedianNs,
+            pResult->fP99Ns);
+  }
+  appendf(pszBuf, nBufLen, nPos, "]}");
+
+  return (nPos < nBufLen) ? nPos : 0;
+}
@@ -0,0 +1,80 @@
+#ifndef __CMICROBENCH_H__
+#define __CMICROBENCH_H__
+
+#include <Hal.h>
+
+#define MICRO_BENCH_MAX_SAMPLES 128
+#define MICRO_BENCH_MAX_RESULTS 16
+
+// Per call cost of one operation, from nSamples timed batches of nBatch
+// calls each
+typedef struct MicroBenchResult
+{
+  const char *pszName;
+  uint16_t nSamples;
+  uint16_t nBatch;
+  float fMinNs;
+  float fMedianNs;
+  float fP99Ns;
+} MicroBenchResult;
+
+// Times operations with halCycleCount(): CPU cycles on the ESP32, a
+// nanosecond clock on the host. Each sample times a batch of calls, less
+// the cost of reading the clock, so calls shorter than the clock's
+// resolution still register. Results hold min, median and p99 per call.
+//
+// The operation is a callable; anything it computes should go to a
+// volatile so the compiler can't drop the call. An optional prepare
+// callable runs before each sample, outside the timed region.
+class CMicroBench
+{
+public:
+  CMicroBench();
+
+  void clear();
+
+  template <typename Operation, typename Prepare>
+  bool run(const char *pszName, uint16_t nSamples, uint16_t nBatch, Operation operation, Prepare prepare)
+  {
+    nSamples = constrain(nSamples, (uint16_t)1, (uint16_t)MICRO_BENCH_MAX_SAMPLES);
+    nBatch = max(nBatch, (uint16_t)1);
+
+    for (uint16_t nSample = 0; nSample < nSamples; nSample++)
+    {
+      prepare();
+
+      uint32_t nStartCycles = halCycleCount();
+      for (uint16_t nCall = 0; nCall < nBatch; nCall++)
+      {
+        operation();
+      }
+      uint32_t nCycles = halCycleCount() - nStartCycles;
+
+      m_arrSamples[nSample] = (nCycles > m_nOverheadCycles) ? (nCycles - m_nOverheadCycles) : 0;
+    }
+
+    return addResult(pszName, nSamples, nBatch);
+  }
+
+  template <typename Operation>
+  bool run(const char *pszName, uint16_t nSamples, uint16_t nBatch, Operation operation)
+  {
+    return run(pszName, nSamples, nBatch, operation, []() {});
+  }
+
+  size_t getNumResults();
+  const MicroBenchResult *getResult(size_t nIndex);
+
+  size_t writeJson(char *pszBuf, size_t nBufLen);
+
+private:
+  void calibrate();
+  bool addResult(const char *pszName, uint16_t nSamples, uint16_t nBatch);
+
+  uint32_t m_arrSamples[MICRO_BENCH_MAX_SAMPLES] = {};
+  MicroBenchResult m_arrResults[MICRO_BENCH_MAX_RESULTS] = {};
+  size_t m_nNumResults = 0;
+  uint32_t m_nOverheadCycles = 0;
+};
+
+#endif // #ifndef __CMICROBENCH_H__
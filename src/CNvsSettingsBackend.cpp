@@ -0,0 +1,46 @@
+#include <CNvsSettingsBackend.h>
+
+CNvsSettingsBackend::CNvsSettingsBackend(const char *pszNamespace /* = "fanctl"*/, const char *pszKey /* = "settings"*/)
+    : m_pszNamespace(pszNamespace),
+      m_pszKey(pszKey)
+{
+}
+
+CNvsSettingsBackend::~CNvsSettingsBackend()
+{
+  if (m_bOpen)
+  {
+    nvs_close(m_hNvs);
+    m_bOpen = false;
+  }
+}
+
+// The Arduino core has already run nvs_flash_init() by the time setup() runs
+bool CNvsSettingsBackend::begin()
+{
+  if (!m_bOpen)
+  {
+    m_bOpen = (nvs_open(m_pszNamespace, NVS_READWRITE, &m_hNvs) == ESP_OK);
+  }
+
+  return m_bOpen;
+}
+
+size_t CNvsSettingsBackend::read(uint8_t *pBuf, size_t nBufLen)
+{
+  size_t nLen = nBufLen;
+
+  if (!m_bOpen || (nvs_get_blob(m_hNvs, m_pszKey, pBuf, &nLen) != ESP_OK))
+  {
+    nLen = 0;
+  }
+
+  return nLen;
+}
+
+bool CNvsSettingsBackend::write(const uint8_t *pBuf, size_t nLen)
+{
+  return m_bOpen &&
+         (nvs_set_blob(m_hNvs, m_pszKey, pBuf, nLen) == ESP_OK) &&
+         (nvs_commit(m_hNvs) == ESP_OK);
+}
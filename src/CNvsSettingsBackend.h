@@ -0,0 +1,27 @@
+#ifndef __CNVSSETTINGSBACKEND_H__
+#define __CNVSSETTINGSBACKEND_H__
+
+#include <Arduino.h>
+#include <nvs.h>
+#include <CSettingsBackend.h>
+
+// Keeps the settings blob as a single NVS blob entry. NVS commits a blob
+// atomically and spreads its writes over the partition itself.
+class CNvsSettingsBackend : public CSettingsBackend
+{
+public:
+  CNvsSettingsBackend(const char *pszNamespace = "fanctl", const char *pszKey = "settings");
+  virtual ~CNvsSettingsBackend();
+
+  virtual bool begin();
+  virtual size_t read(uint8_t *pBuf, size_t nBufLen);
+  virtual bool write(const uint8_t *pBuf, size_t nLen);
+
+private:
+  const char *m_pszNamespace = NULL;
+  const char *m_pszKey = NULL;
+  nvs_handle m_hNvs = 0;
+  bool m_bOpen = false;
+};
+
+#endif // #ifndef __CNVSSETTINGSBACKEND_H__
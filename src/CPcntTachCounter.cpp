@@ -0,0 +1,105 @@
+#include <CPcntTachCounter.h>
+
+const int16_t CPcntTachCounter::PCNT_HIGH_LIMIT = 32767;
+
+// The filter is specified in APB clock cycles (80 MHz) and is 10 bits wide
+#define PCNT_APB_CYCLES_PER_US 80
+#define PCNT_MAX_FILTER_CYCLES 1023
+
+static uint8_t s_nNextPcntUnit = PCNT_UNIT_0;
+
+CPcntTachCounter::CPcntTachCounter(const uint8_t nPinFanTach,
+                                   const pcnt_unit_t nPcntUnit /*= PCNT_UNIT_MAX*/,
+                                   const uint32_t nGlitchFilterNs /*= 12000*/)
+    : m_muxPulseCount(portMUX_INITIALIZER_UNLOCKED)
+{
+  m_nPinFanTach = nPinFanTach;
+  m_nPcntUnit = nPcntUnit;
+  m_nGlitchFilterNs = nGlitchFilterNs;
+}
+
+bool CPcntTachCounter::begin()
+{
+  m_muxPulseCount = portMUX_INITIALIZER_UNLOCKED;
+
+  // Hand out units in order if one wasn't specified
+  if (m_nPcntUnit >= PCNT_UNIT_MAX)
+  {
+    if (s_nNextPcntUnit >= PCNT_UNIT_MAX)
+    {
+      return false;
+    }
+    m_nPcntUnit = (pcnt_unit_t)s_nNextPcntUnit++;
+  }
+
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = m_nPinFanTach; // pcnt_unit_config() enables the pull-up
+  config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.pos_mode = PCNT_COUNT_DIS; // count falling edges only, same as the ISR
+  config.neg_mode = PCNT_COUNT_INC;
+  config.counter_h_lim = PCNT_HIGH_LIMIT;
+  config.counter_l_lim = 0;
+  config.unit = m_nPcntUnit;
+  config.channel = PCNT_CHANNEL_0;
+
+  if (pcnt_unit_config(&config) != ESP_OK)
+  {
+    return false;
+  }
+
+  uint32_t nFilterCycles = (m_nGlitchFilterNs * PCNT_APB_CYCLES_PER_US) / 1000;
+  if (nFilterCycles > PCNT_MAX_FILTER_CYCLES)
+  {
+    nFilterCycles = PCNT_MAX_FILTER_CYCLES;
+  }
+
+  if (nFilterCycles > 0)
+  {
+    pcnt_set_filter_value(m_nPcntUnit, nFilterCycles);
+    pcnt_filter_enable(m_nPcntUnit);
+  }
+
+  pcnt_counter_pause(m_nPcntUnit);
+  pcnt_counter_clear(m_nPcntUnit);
+  pcnt_counter_resume(m_nPcntUnit);
+
+  m_nLastRawCount = 0;
+  m_nPulseCount = 0;
+
+  return true;
+}
+
+uint32_t CPcntTachCounter::getPulseCount()
+{
+  uint32_t nReturn = 0;
+
+  portENTER_CRITICAL(&m_muxPulseCount);
+  {
+    int16_t nRawCount = 0;
+    if ((m_nPcntUnit < PCNT_UNIT_MAX) && (pcnt_get_counter_value(m_nPcntUnit, &nRawCount) == ESP_OK))
+    {
+      // The hardware counter resets to zero when it reaches the high limit
+      if (nRawCount >= m_nLastRawCount)
+      {
+        m_nPulseCount += nRawCount - m_nLastRawCount;
+      }
+      else
+      {
+        m_nPulseCount += (PCNT_HIGH_LIMIT - m_nLastRawCount) + nRawCount;
+      }
+      m_nLastRawCount = nRawCount;
+    }
+
+    nReturn = m_nPulseCount;
+  }
+  portEXIT_CRITICAL(&m_muxPulseCount);
+
+  return nReturn;
+}
+
+pcnt_unit_t CPcntTachCounter::getPcntUnit()
+{
+  return m_nPcntUnit;
+}
@@ -0,0 +1,35 @@
+#ifndef __CPCNTTACHCOUNTER_H__
+#define __CPCNTTACHCOUNTER_H__
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+#include <CTachCounter.h>
+
+// Counts tach edges in the ESP32 pulse counter (PCNT) peripheral. No
+// interrupts are taken; the 16 bit hardware counter is folded into a 32 bit
+// total on every read, so getPulseCount() must be called at least once per
+// PCNT_HIGH_LIMIT edges (over a minute and a half at 10000 RPM).
+class CPcntTachCounter : public CTachCounter
+{
+public:
+  CPcntTachCounter(const uint8_t nPinFanTach,
+                   const pcnt_unit_t nPcntUnit = PCNT_UNIT_MAX,
+                   const uint32_t nGlitchFilterNs = 12000);
+
+  bool begin();
+  uint32_t getPulseCount();
+
+  pcnt_unit_t getPcntUnit();
+
+  static const int16_t PCNT_HIGH_LIMIT;
+
+private:
+  portMUX_TYPE m_muxPulseCount = portMUX_INITIALIZER_UNLOCKED;
+  uint8_t m_nPinFanTach = 0;
+  pcnt_unit_t m_nPcntUnit = PCNT_UNIT_MAX;
+  uint32_t m_nGlitchFilterNs = 0;
+  int16_t m_nLastRawCount = 0;
+  uint32_t m_nPulseCount = 0;
+};
+
+#endif // #ifndef __CPCNTTACHCOUNTER_H__
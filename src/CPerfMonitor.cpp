@@ -0,0 +1,205 @@
+#include <CPerfMonitor.h>
+#include <Appendf.h>
+#include <algorithm>
+
+void CPerfMonitor::begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempBus *pTempBus)
+{
+  m_nNumFans = (arrFanCtrl != NULL) ? min(nNumFans, (size_t)PERF_MONITOR_MAX_FANS) : 0;
+  for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    m_arrFanCtrl[nIndex] = arrFanCtrl[nIndex];
+  }
+
+  m_pTempBus = pTempBus;
+
+  calibrate();
+}
+
+bool CPerfMonitor::addTask(CTaskPerf *pTaskPerf)
+{
+  bool bReturn = false;
+
+  if ((pTaskPerf != NULL) && (m_nNumTasks < PERF_MONITOR_MAX_TASKS))
+  {
+    m_arrTasks[m_nNumTasks++] = pTaskPerf;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+bool CPerfMonitor::addTick(CPeriodicTick *pTick)
+{
+  bool bReturn = false;
+
+  if ((pTick != NULL) && (m_nNumTicks < PERF_MONITOR_MAX_TICKS))
+  {
+    m_arrTicks[m_nNumTicks++] = pTick;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+// Each task clears its own figures at its next loop
+void CPerfMonitor::reset()
+{
+  for (size_t nIndex = 0; nIndex < m_nNumTasks; nIndex++)
+  {
+    m_arrTasks[nIndex]->reset();
+  }
+}
+
+size_t CPerfMonitor::getNumTasks()
+{
+  return m_nNumTasks;
+}
+
+CTaskPerf *CPerfMonitor::getTask(size_t nIndex)
+{
+  return (nIndex < m_nNumTasks) ? m_arrTasks[nIndex] : NULL;
+}
+
+// Median cost of one loopStart()/loopEnd() pair
+uint32_t CPerfMonitor::getOverheadNs()
+{
+  return m_nOverheadNs;
+}
+
+// Share of one CPU the registered tasks spend in CTaskPerf, in parts per
+// million, at their current average loop rates
+float CPerfMonitor::getOverheadPpm()
+{
+  float fReturn = 0.0f;
+
+  for (size_t nIndex = 0; nIndex < m_nNumTasks; nIndex++)
+  {
+    float fAvgPeriodMicros = m_arrTasks[nIndex]->getPeriod()->fAvgMicros;
+    if (fAvgPeriodMicros > 0.0f)
+    {
+      fReturn += (float)m_nOverheadNs / fAvgPeriodMicros * 1000.0f;
+    }
+  }
+
+  return fReturn;
+}
+
+// Times loopStart()/loopEnd() on a scratch CTaskPerf, less the cost of the
+// clock reads around it
+void CPerfMonitor::calibrate()
+{
+  const uint8_t nTries = 31;
+
+  CTaskPerf taskPerf("calibrate");
+  uint32_t arrCycles[nTries];
+  uint32_t nClockCycles = 0xffffffff;
+
+  for (uint8_t nTry = 0; nTry < nTries; nTry++)
+  {
+    uint32_t nStartCycles = halCycleCount();
+    nClockCycles = min(nClockCycles, halCycleCount() - nStartCycles);
+  }
+
+  for (uint8_t nTry = 0; nTry < nTries; nTry++)
+  {
+    uint32_t nStartCycles = halCycleCount();
+    taskPerf.loopStart();
+    taskPerf.loopEnd();
+    uint32_t nCycles = halCycleCount() - nStartCycles;
+
+    arrCycles[nTry] = (nCycles > nClockCycles) ? (nCycles - nClockCycles) : 0;
+  }
+
+  std::sort(arrCycles, arrCycles + nTries);
+  m_nOverheadNs = (uint32_t)((uint64_t)arrCycles[nTries / 2] * 1000 / halCyclesPerMicro());
+}
+
+// {"lastUs":N,"avgUs":F,"maxUs":N,"hist":[N,...]}, the histogram cut after
+// its last non-zero bucket
+static void appendTiming(char *pszBuf, size_t nBufLen, size_t &nPos, const char *pszName, const TaskPerfTiming *pTiming)
+{
+  uint8_t nNumBuckets = TASK_PERF_BUCKETS;
+  while ((nNumBuckets > 0) && (pTiming->arrHistogram[nNumBuckets - 1] == 0))
+  {
+    nNumBuckets--;
+  }
+
+  appendf(pszBuf, nBufLen, nPos, "\"%s\":{\"lastUs\":%u,\"avgUs\":%.1f,\"maxUs\":%u,\"hist\":[", pszName, pTiming->nLastMicros, pTiming->fAvgMicros, pTiming->nMaxMicros);
+  for (uint8_t nBucket = 0; nBucket < nNumBuckets; nBucket++)
+  {
+    appendf(pszBuf, nBufLen, nPos, (nBucket > 0) ? ",%u" : "%u", pTiming->arrHistogram[nBucket]);
+  }
+  appendf(pszBuf, nBufLen, nPos, "]}");
+}
+
+static void appendBusTiming(char *pszBuf, size_t nBufLen, size_t &nPos, const char *pszName, const TempBusTiming *pTiming)
+{
+  appendf(pszBuf, nBufLen, nPos, "\"%s\":{\"count\":%u,\"lastUs\":%u,\"avgUs\":%.1f,\"maxUs\":%u}", pszName, pTiming->nCount, pTiming->nLastMicros, pTiming->fAvgMicros, pTiming->nMaxMicros);
+}
+
+// {"uptimeMs":N,
+//  "overhead":{"loopNs":N,"cpuPpm":F},
+//  "heap":{"free":N,"minFree":N,"largestBlock":N},
+//  "tasks":[{"name":S,"loops":N,"stackFree":N,"period":{..},"jitter":{..},"exec":{..}},...],
+//  "ticks":[{"name":S,"periodMs":N,"ticks":N,"overruns":N,"skipped":N,
+//            "latenessUs":{"last":N,"avg":F,"max":N},"dtUs":{"min":N,"max":N}},...],
+//  "tach":[{"edgesPerSec":F,"isr":B},...],
+//  "tempBus":{"convert":{..},"read":{..},"crcErrors":N,"noPresence":N} or null}
+// Histogram bucket 0 counts 0 us, bucket k [2^(k-1), 2^k) us. Returns the
+// length written, or 0 if it didn't fit
+size_t CPerfMonitor::writeJson(char *pszBuf, size_t nBufLen)
+{
+  size_t nPos = 0;
+
+  HalHeapStats heapStats;
+  halGetHeapStats(&heapStats);
+
+  appendf(pszBuf, nBufLen, nPos, "{\"uptimeMs\":%u,\"overhead\":{\"loopNs\":%u,\"cpuPpm\":%.2f},", halMillis(), m_nOverheadNs, getOverheadPpm());
+  appendf(pszBuf, nBufLen, nPos, "\"heap\":{\"free\":%u,\"minFree\":%u,\"largestBlock\":%u},", heapStats.nFree, heapStats.nMinFree, heapStats.nLargestBlock);
+
+  appendf(pszBuf, nBufLen, nPos, "\"tasks\":[");
+  for (size_t nIndex = 0; nIndex < m_nNumTasks; nIndex++)
+  {
+    CTaskPerf *pTaskPerf = m_arrTasks[nIndex];
+    appendf(pszBuf, nBufLen, nPos, "%s{\"name\":\"%s\",\"loops\":%u,\"stackFree\":%u,", (nIndex > 0) ? "," : "", pTaskPerf->getName(), pTaskPerf->getLoopCount(), pTaskPerf->getStackHighWater());
+    appendTiming(pszBuf, nBufLen, nPos, "period", pTaskPerf->getPeriod());
+    appendf(pszBuf, nBufLen, nPos, ",");
+    appendTiming(pszBuf, nBufLen, nPos, "jitter", pTaskPerf->getJitter());
+    appendf(pszBuf, nBufLen, nPos, ",");
+    appendTiming(pszBuf, nBufLen, nPos, "exec", pTaskPerf->getExec());
+    appendf(pszBuf, nBufLen, nPos, "}");
+  }
+  appendf(pszBuf, nBufLen, nPos, "],");
+
+  appendf(pszBuf, nBufLen, nPos, "\"ticks\":[");
+  for (size_t nIndex = 0; nIndex < m_nNumTicks; nIndex++)
+  {
+    CPeriodicTick *pTick = m_arrTicks[nIndex];
+    appendf(pszBuf, nBufLen, nPos, "%s{\"name\":\"%s\",\"periodMs\":%u,\"ticks\":%u,\"overruns\":%u,\"skipped\":%u,", (nIndex > 0) ? "," : "", pTick->getName(), pTick->getPeriodMs(), pTick->getTickCount(), pTick->getOverruns(), pTick->getSkippedTicks());
+    appendf(pszBuf, nBufLen, nPos, "\"latenessUs\":{\"last\":%u,\"avg\":%.1f,\"max\":%u},\"dtUs\":{\"min\":%u,\"max\":%u}}", pTick->getLastLatenessMicros(), pTick->getAvgLatenessMicros(), pTick->getMaxLatenessMicros(), pTick->getMinDtMicros(), pTick->getMaxDtMicros());
+  }
+  appendf(pszBuf, nBufLen, nPos, "],");
+
+  appendf(pszBuf, nBufLen, nPos, "\"tach\":[");
+  for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    appendf(pszBuf, nBufLen, nPos, "%s{\"edgesPerSec\":%.1f,\"isr\":%s}", (nIndex > 0) ? "," : "", m_arrFanCtrl[nIndex]->getTachEdgeRate(), m_arrFanCtrl[nIndex]->isTachInterruptPerEdge() ? "true" : "false");
+  }
+  appendf(pszBuf, nBufLen, nPos, "],");
+
+  TempBusStats busStats;
+  if ((m_pTempBus != NULL) && m_pTempBus->getStats(&busStats))
+  {
+    appendf(pszBuf, nBufLen, nPos, "\"tempBus\":{");
+    appendBusTiming(pszBuf, nBufLen, nPos, "convert", &busStats.convert);
+    appendf(pszBuf, nBufLen, nPos, ",");
+    appendBusTiming(pszBuf, nBufLen, nPos, "read", &busStats.read);
+    appendf(pszBuf, nBufLen, nPos, ",\"crcErrors\":%u,\"noPresence\":%u}}", busStats.nCrcErrors, busStats.nNoPresence);
+  }
+  else
+  {
+    appendf(pszBuf, nBufLen, nPos, "\"tempBus\":null}");
+  }
+
+  return (nPos < nBufLen) ? nPos : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef __CPERFMONITOR_H__
+#define __CPERFMONITOR_H__
+
+#include <Hal.h>
+#include <CTaskPerf.h>
+#include <CPeriodicTick.h>
+#include <CPwmFanControl.h>
+#include <CTempBus.h>
+
+#define PERF_MONITOR_MAX_TASKS 8
+#define PERF_MONITOR_MAX_FANS 4
+#define PERF_MONITOR_MAX_TICKS 4
+
+// Collects the always on instrumentation for /debug/perf and the console:
+// loop timing and stack high water of each registered task (CTaskPerf),
+// overruns and lateness of each periodic tick (CPeriodicTick), tach edge
+// rates, temperature bus transaction times and failures, and heap figures.
+//
+// Nothing here runs on the instrumented paths; figures are gathered when
+// written. begin() times one CTaskPerf loopStart()/loopEnd() pair, and
+// getOverheadPpm() scales that by each task's loop rate, so the cost of
+// the instrumentation is reported along with what it measures.
+class CPerfMonitor
+{
+public:
+  void begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempBus *pTempBus);
+  bool addTask(CTaskPerf *pTaskPerf);
+  bool addTick(CPeriodicTick *pTick);
+  void reset();
+
+  size_t getNumTasks();
+  CTaskPerf *getTask(size_t nIndex);
+
+  uint32_t getOverheadNs();
+  float getOverheadPpm();
+
+  size_t writeJson(char *pszBuf, size_t nBufLen);
+
+private:
+  void calibrate();
+
+  CTaskPerf *m_arrTasks[PERF_MONITOR_MAX_TASKS] = {};
+  size_t m_nNumTasks = 0;
+  CPeriodicTick *m_arrTicks[PERF_MONITOR_MAX_TICKS] = {};
+  size_t m_nNumTicks = 0;
+  CPwmFanControl *m_arrFanCtrl[PERF_MONITOR_MAX_FANS] = {};
+  size_t m_nNumFans = 0;
+  CTempBus *m_pTempBus = NULL;
+  uint32_t m_nOverheadNs = 0;
+};
+
+#endif // #ifndef __CPERFMONITOR_H__
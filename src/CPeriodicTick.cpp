@@ -0,0 +1,148 @@
+#include <CPeriodicTick.h>
+
+CPeriodicTick::CPeriodicTick(const char *pszName, uint32_t nPeriodMs /* = 1000*/)
+{
+  m_pszName = pszName;
+  setPeriodMs(nPeriodMs);
+}
+
+// Takes effect from the next deadline
+void CPeriodicTick::setPeriodMs(uint32_t nPeriodMs)
+{
+  m_nPeriodMicros = max(nPeriodMs, (uint32_t)1) * 1000;
+}
+
+uint32_t CPeriodicTick::getPeriodMs()
+{
+  return m_nPeriodMicros / 1000;
+}
+
+// Sleeps until the next deadline; the first call returns at once and sets
+// the schedule's phase. Returns the number of deadlines dropped because the
+// loop overran them, normally 0.
+uint32_t CPeriodicTick::wait()
+{
+  uint32_t nReturn = 0;
+
+  if (m_nTickCount == 0)
+  {
+    m_nDeadlineMicros = halMicros();
+  }
+  else
+  {
+    m_nDeadlineMicros += m_nPeriodMicros;
+
+    // Signed difference, so halMicros() rollover doesn't matter
+    int32_t nRemainingMicros = (int32_t)(m_nDeadlineMicros - halMicros());
+    if (nRemainingMicros > 0)
+    {
+      halDelayMs(((uint32_t)nRemainingMicros + 999) / 1000);
+    }
+    else if (nRemainingMicros < 0)
+    {
+      m_nOverruns++;
+
+      // Missed whole periods are dropped, not caught up on
+      nReturn = (uint32_t)(-nRemainingMicros) / m_nPeriodMicros;
+      m_nDeadlineMicros += nReturn * m_nPeriodMicros;
+      m_nSkippedTicks += nReturn;
+    }
+  }
+
+  uint32_t nWakeMicros = halMicros();
+
+  int32_t nLatenessMicros = (int32_t)(nWakeMicros - m_nDeadlineMicros);
+  uint32_t nAbsLatenessMicros = (nLatenessMicros >= 0) ? (uint32_t)nLatenessMicros : (uint32_t)(-nLatenessMicros);
+  m_nLastLatenessMicros = nAbsLatenessMicros;
+  if (nAbsLatenessMicros > m_nMaxLatenessMicros)
+  {
+    m_nMaxLatenessMicros = nAbsLatenessMicros;
+  }
+
+  if (m_nTickCount == 0)
+  {
+    m_fAvgLatenessMicros = nAbsLatenessMicros;
+    m_nLastDtMicros = m_nPeriodMicros;
+    m_nMinDtMicros = m_nPeriodMicros;
+    m_nMaxDtMicros = m_nPeriodMicros;
+  }
+  else
+  {
+    // Exponential moving average, 1/16 weight for the newest tick
+    m_fAvgLatenessMicros = m_fAvgLatenessMicros + ((float)nAbsLatenessMicros - m_fAvgLatenessMicros) / 16.0f;
+
+    uint32_t nDtMicros = nWakeMicros - m_nLastWakeMicros;
+    m_nLastDtMicros = nDtMicros;
+    if (nDtMicros < m_nMinDtMicros)
+    {
+      m_nMinDtMicros = nDtMicros;
+    }
+    if (nDtMicros > m_nMaxDtMicros)
+    {
+      m_nMaxDtMicros = nDtMicros;
+    }
+  }
+
+  m_nLastWakeMicros = nWakeMicros;
+  m_nTickCount++;
+
+  return nReturn;
+}
+
+const char *CPeriodicTick::getName()
+{
+  return m_pszName;
+}
+
+// Time between the last two wakeups; one period before the second
+float CPeriodicTick::getDtSec()
+{
+  return (float)m_nLastDtMicros / 1000000.0f;
+}
+
+uint32_t CPeriodicTick::getLastDtMicros()
+{
+  return m_nLastDtMicros;
+}
+
+uint32_t CPeriodicTick::getMinDtMicros()
+{
+  return m_nMinDtMicros;
+}
+
+uint32_t CPeriodicTick::getMaxDtMicros()
+{
+  return m_nMaxDtMicros;
+}
+
+uint32_t CPeriodicTick::getTickCount()
+{
+  return m_nTickCount;
+}
+
+// Wakeups that found their deadline already past
+uint32_t CPeriodicTick::getOverruns()
+{
+  return m_nOverruns;
+}
+
+// Deadlines dropped by overruns
+uint32_t CPeriodicTick::getSkippedTicks()
+{
+  return m_nSkippedTicks;
+}
+
+uint32_t CPeriodicTick::getLastLatenessMicros()
+{
+  return m_nLastLatenessMicros;
+}
+
+uint32_t CPeriodicTick::getMaxLatenessMicros()
+{
+  return m_nMaxLatenessMicros;
+}
+
+float CPeriodicTick::getAvgLatenessMicros()
+{
+  return m_fAvgLatenessMicros;
+}
@@ -0,0 +1,59 @@
+#ifndef __CPERIODICTICK_H__
+#define __CPERIODICTICK_H__
+
+#include <Hal.h>
+
+// Fixed rate wakeups for a task loop:
+//   for (;;) { tick.wait(); ...work... }
+// Deadlines are absolute (each one period after the last), so the time the
+// work takes, however much it varies, doesn't move the schedule.
+//
+// A loop that runs past its next deadline is an overrun: wait() returns at
+// once instead of sleeping, and if whole periods were missed it drops them
+// rather than running them back to back, so the loop keeps its phase and
+// runs at most once per period. getDtSec() is the measured time between
+// the last two wakeups, for code that integrates over time.
+//
+// Sleeps are whole milliseconds on the HAL clock; getLatenessMicros()
+// shows how far past each deadline the loop actually woke.
+class CPeriodicTick
+{
+public:
+  CPeriodicTick(const char *pszName, uint32_t nPeriodMs = 1000);
+
+  void setPeriodMs(uint32_t nPeriodMs);
+  uint32_t getPeriodMs();
+
+  uint32_t wait();
+
+  const char *getName();
+  float getDtSec();
+  uint32_t getLastDtMicros();
+  uint32_t getMinDtMicros();
+  uint32_t getMaxDtMicros();
+
+  uint32_t getTickCount();
+  uint32_t getOverruns();
+  uint32_t getSkippedTicks();
+
+  uint32_t getLastLatenessMicros();
+  uint32_t getMaxLatenessMicros();
+  float getAvgLatenessMicros();
+
+private:
+  const char *m_pszName = NULL;
+  uint32_t m_nPeriodMicros = 1000000;
+  uint32_t m_nDeadlineMicros = 0;
+  uint32_t m_nLastWakeMicros = 0;
+  volatile uint32_t m_nTickCount = 0;
+  volatile uint32_t m_nOverruns = 0;
+  volatile uint32_t m_nSkippedTicks = 0;
+  volatile uint32_t m_nLastDtMicros = 0;
+  volatile uint32_t m_nMinDtMicros = 0;
+  volatile uint32_t m_nMaxDtMicros = 0;
+  volatile uint32_t m_nLastLatenessMicros = 0;
+  volatile uint32_t m_nMaxLatenessMicros = 0;
+  volatile float m_fAvgLatenessMicros = 0.0f;
+};
+
+#endif // #ifndef __CPERIODICTICK_H__
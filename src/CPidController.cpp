@@ -0,0 +1,157 @@
+#include <CPidController.h>
+
+CPidController::CPidController(const float fKp,
+                               const float fKi,
+                               const float fKd,
+                               const PidDirection direction /* = PID_DIRECTION_DIRECT*/,
+                               const uint32_t nSampleTimeMs /* = 100*/)
+{
+  m_direction = direction;
+  setSampleTimeMs(nSampleTimeMs);
+  setTunings(fKp, fKi, fKd);
+}
+
+void CPidController::setTunings(const float fKp, const float fKi, const float fKd)
+{
+  if ((fKp >= 0.0f) && (fKi >= 0.0f) && (fKd >= 0.0f))
+  {
+    // Fold the change in proportional action into the integral so the
+    // output doesn't jump. Ki is applied per step, so changing it is
+    // already bumpless.
+    if (m_bInitialized)
+    {
+      float fSign = (m_direction == PID_DIRECTION_REVERSE) ? -1.0f : 1.0f;
+      m_fIntegral = clamp(m_fIntegral + fSign * (m_fKp - fKp) * m_fLastError);
+    }
+
+    m_fKp = fKp;
+    m_fKi = fKi;
+    m_fKd = fKd;
+  }
+}
+
+void CPidController::setDirection(const PidDirection direction)
+{
+  m_direction = direction;
+}
+
+void CPidController::setSampleTimeMs(const uint32_t nSampleTimeMs)
+{
+  if (nSampleTimeMs > 0)
+  {
+    m_fSampleTimeSec = (float)nSampleTimeMs / 1000.0f;
+  }
+}
+
+void CPidController::setOutputLimits(const float fMin, const float fMax)
+{
+  if (fMin < fMax)
+  {
+    m_fOutMin = fMin;
+    m_fOutMax = fMax;
+    m_fIntegral = clamp(m_fIntegral);
+    m_fOutput = clamp(m_fOutput);
+  }
+}
+
+// Same as a Kp change: the step in proportional action goes into the
+// integral, as far as the output limits allow
+void CPidController::setSetpoint(const float fSetpoint)
+{
+  if (m_bInitialized)
+  {
+    float fSign = (m_direction == PID_DIRECTION_REVERSE) ? -1.0f : 1.0f;
+    m_fIntegral = clamp(m_fIntegral + fSign * m_fKp * (m_fSetpoint - fSetpoint));
+    m_fLastError += fSetpoint - m_fSetpoint;
+  }
+
+  m_fSetpoint = fSetpoint;
+}
+
+// Switching to automatic picks up from the current output and input, so
+// the first computed output continues where manual control left off
+void CPidController::setAutomatic(const bool bAutomatic, const float fInput, const float fOutput)
+{
+  if (bAutomatic && !m_bAutomatic)
+  {
+    m_fIntegral = clamp(fOutput);
+    m_fOutput = m_fIntegral;
+    m_fLastInput = fInput;
+    m_fLastError = m_fSetpoint - fInput;
+    m_bInitialized = true;
+  }
+
+  m_bAutomatic = bAutomatic;
+}
+
+float CPidController::compute(const float fInput)
+{
+  return compute(fInput, m_fSampleTimeSec);
+}
+
+float CPidController::compute(const float fInput, const float fDtSec)
+{
+  if (m_bAutomatic && (fDtSec > 0.0f))
+  {
+    float fSign = (m_direction == PID_DIRECTION_REVERSE) ? -1.0f : 1.0f;
+    float fError = m_fSetpoint - fInput;
+    float fInputDelta = m_bInitialized ? (fInput - m_fLastInput) : 0.0f;
+
+    m_fIntegral = clamp(m_fIntegral + fSign * m_fKi * fDtSec * fError);
+
+    float fOutput = fSign * m_fKp * fError + m_fIntegral - fSign * (m_fKd / fDtSec) * fInputDelta;
+
+    m_fOutput = clamp(fOutput);
+    m_fLastInput = fInput;
+    m_fLastError = fError;
+    m_bInitialized = true;
+  }
+
+  return m_fOutput;
+}
+
+float CPidController::clamp(const float fValue)
+{
+  float fReturn = fValue;
+
+  if (fReturn > m_fOutMax)
+  {
+    fReturn = m_fOutMax;
+  }
+  else if (fReturn < m_fOutMin)
+  {
+    fReturn = m_fOutMin;
+  }
+
+  return fReturn;
+}
+
+float CPidController::getKp()
+{
+  return m_fKp;
+}
+
+float CPidController::getKi()
+{
+  return m_fKi;
+}
+
+float CPidController::getKd()
+{
+  return m_fKd;
+}
+
+float CPidController::getSetpoint()
+{
+  return m_fSetpoint;
+}
+
+float CPidController::getOutput()
+{
+  return m_fOutput;
+}
+
+bool CPidController::isAutomatic()
+{
+  return m_bAutomatic;
+}
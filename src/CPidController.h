@@ -0,0 +1,63 @@
+#ifndef __CPIDCONTROLLER_H__
+#define __CPIDCONTROLLER_H__
+
+#include <stdint.h>
+
+enum PidDirection
+{
+  PID_DIRECTION_DIRECT, // output rises as input falls below setpoint
+  PID_DIRECTION_REVERSE // output rises as input rises above setpoint
+};
+
+// Single precision PID with the same gain scaling as PID_v1 (Ki and Kd are
+// per second, applied over the sample time), plus:
+//  - integral clamped to the output limits (anti-windup)
+//  - derivative taken on the measurement, so setpoint steps don't kick
+//  - bumpless transfer on tuning and setpoint changes and when switching
+//    to automatic, so a new setpoint is reached through the integral
+class CPidController
+{
+public:
+  CPidController(const float fKp,
+                 const float fKi,
+                 const float fKd,
+                 const PidDirection direction = PID_DIRECTION_DIRECT,
+                 const uint32_t nSampleTimeMs = 100);
+
+  void setTunings(const float fKp, const float fKi, const float fKd);
+  void setDirection(const PidDirection direction);
+  void setSampleTimeMs(const uint32_t nSampleTimeMs);
+  void setOutputLimits(const float fMin, const float fMax);
+  void setSetpoint(const float fSetpoint);
+  void setAutomatic(const bool bAutomatic, const float fInput, const float fOutput);
+
+  float compute(const float fInput);
+  float compute(const float fInput, const float fDtSec);
+
+  float getKp();
+  float getKi();
+  float getKd();
+  float getSetpoint();
+  float getOutput();
+  bool isAutomatic();
+
+private:
+  float clamp(const float fValue);
+
+  float m_fKp = 0.0f;
+  float m_fKi = 0.0f;
+  float m_fKd = 0.0f;
+  PidDirection m_direction = PID_DIRECTION_DIRECT;
+  float m_fSampleTimeSec = 0.1f;
+  float m_fOutMin = 0.0f;
+  float m_fOutMax = 255.0f;
+  float m_fSetpoint = 0.0f;
+  float m_fIntegral = 0.0f;
+  float m_fLastInput = 0.0f;
+  float m_fLastError = 0.0f;
+  float m_fOutput = 0.0f;
+  bool m_bAutomatic = false;
+  bool m_bInitialized = false;
+};
+
+#endif // #ifndef __CPIDCONTROLLER_H__
@@ -0,0 +1,32 @@
+#ifndef __CPWMCHANNEL_H__
+#define __CPWMCHANNEL_H__
+
+#include <stdint.h>
+
+// PWM output driving one fan. Duty cycles are in the channel's own
+// resolution, 0 to 2^bits - 1. Kept free of Arduino/ESP-IDF includes so a
+// simulated channel can stand in for the hardware.
+class CPwmChannel
+{
+public:
+  virtual ~CPwmChannel() {}
+
+  virtual bool begin(const uint32_t nFrequency, const uint8_t nResolution) = 0;
+
+  virtual void write(const uint32_t nDutyCycle) = 0;
+
+  // Duty cycle on the output right now, part way through a fade if one is
+  // running
+  virtual uint32_t read() = 0;
+
+  // Starts moving linearly to nDutyCycle over nFadeMs without waiting for
+  // it. Returns false if the channel can't fade; the caller writes instead.
+  virtual bool fade(const uint32_t nDutyCycle, const uint32_t nFadeMs) = 0;
+
+  // Holds the output wherever a running fade has got to, so a write can
+  // follow without waiting for the fade to finish. Returns false if the
+  // channel can't stop a fade.
+  virtual bool stopFade() = 0;
+};
+
+#endif // #ifndef __CPWMCHANNEL_H__
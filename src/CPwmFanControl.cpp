@@ -1,35 +1,54 @@
 #include <CPwmFanControl.h>
-#include <limits>
+#ifdef ARDUINO
+#include <CIsrTachCounter.h>
+#include <CLedcPwmChannel.h>
+#include <CPcntTachCounter.h>
+#endif
 
-const double CPwmFanControl::PWM_FREQUENCY = 25000.0;
-const uint8_t CPwmFanControl::PWM_RESOUTION = 8;
+#define TACH_PULSES_PER_REV 2
 
 CPwmFanControl::CPwmFanControl(const uint8_t nPwmChannel,
                                const uint8_t nPinFanPwm,
                                const uint8_t nPinFanTach,
-                               const dutycycle_t nMinFanDutyCycle /* = 0.0*/,
-                               const dutycycle_t nFanOffDutyCycle /* = 0.0*/,
-                               const uint8_t bAllowOff /*= 1*/,
-                               const uint32_t nFanMinRuntimeMs /*= 30000*/) : m_muxFanIrqCounter(portMUX_INITIALIZER_UNLOCKED)
+                               const uint8_t nPwmResolution,
+                               const uint32_t nPwmFrequency,
+                               const uint32_t nMinFanDutyCycle,
+                               const uint32_t nFanOffDutyCycle,
+                               const uint8_t bAllowOff,
+                               const uint32_t nFanMinRuntimeMs) : m_muxFanTachRead(HAL_SPINLOCK_INITIALIZER)
 {
   m_nPwmChannel = nPwmChannel;
   m_nPinFanPwm = nPinFanPwm;
   m_nPinFanTach = nPinFanTach;
+  m_nPwmResolution = nPwmResolution;
+  m_nPwmFrequency = nPwmFrequency;
+  m_nMaxDutyCycle = (1UL << nPwmResolution) - 1;
+  m_fMaxDutyCycle = (float)m_nMaxDutyCycle;
   m_nMinFanDutyCycle = nMinFanDutyCycle;
   m_nFanOffDutyCycle = nFanOffDutyCycle;
   m_bFanAllowOff = bAllowOff;
   m_nFanMinRuntimeMs = nFanMinRuntimeMs;
-  m_nLastFanStartMs = millis();
+  m_nLastFanStartMs = halMillis();
 }
 
-void CPwmFanControl::setMinFanDutyCycle(const dutycycle_t nMinFanDutyCycle)
+void CPwmFanControl::setMinFanDutyCycle(const uint32_t nMinFanDutyCycle)
 {
-  m_nMinFanDutyCycle = nMinFanDutyCycle;
+  m_nMinFanDutyCycle = min(nMinFanDutyCycle, m_nMaxDutyCycle);
 }
 
-void CPwmFanControl::setFanOffDutyCycle(const dutycycle_t nFanOffDutyCycle)
+void CPwmFanControl::setFanOffDutyCycle(const uint32_t nFanOffDutyCycle)
 {
-  m_nFanOffDutyCycle = nFanOffDutyCycle;
+  m_nFanOffDutyCycle = min(nFanOffDutyCycle, m_nMaxDutyCycle);
+}
+
+void CPwmFanControl::setMinFanDutyCyclePercent(const float fMinFanDutyPercent)
+{
+  setMinFanDutyCycle(percentToDuty(fMinFanDutyPercent));
+}
+
+void CPwmFanControl::setFanOffDutyCyclePercent(const float fFanOffDutyPercent)
+{
+  setFanOffDutyCycle(percentToDuty(fFanOffDutyPercent));
 }
 
 void CPwmFanControl::setAllowOff(const uint8_t bAllowOff)
@@ -42,37 +61,83 @@ void CPwmFanControl::setFanMinRuntimeMs(uint32_t nFanMinRuntimeMs)
   m_nFanMinRuntimeMs = nFanMinRuntimeMs;
 }
 
-void CPwmFanControl::begin(void (*pHandleFanTackIrq)())
+CPwmFanControl::~CPwmFanControl()
 {
-  m_muxFanIrqCounter = portMUX_INITIALIZER_UNLOCKED;
+  if (m_bOwnsTachCounter && (m_pTachCounter != NULL))
+  {
+    delete m_pTachCounter;
+    m_pTachCounter = NULL;
+  }
+
+  if (m_bOwnsPwmChannel && (m_pPwmChannel != NULL))
+  {
+    delete m_pPwmChannel;
+    m_pPwmChannel = NULL;
+  }
+}
 
-  ledcSetup(m_nPwmChannel, PWM_FREQUENCY, PWM_RESOUTION);
-  ledcWrite(m_nPwmChannel, 0);
-  ledcAttachPin(m_nPinFanPwm, m_nPwmChannel);
+#ifdef ARDUINO
+void CPwmFanControl::begin(const TachBackend tachBackend /* = TACH_BACKEND_PCNT*/)
+{
+  CTachCounter *pTachCounter = NULL;
 
-  if (pHandleFanTackIrq != NULL)
+  if (tachBackend == TACH_BACKEND_PCNT)
+  {
+    pTachCounter = new CPcntTachCounter(m_nPinFanTach);
+  }
+  else
   {
-    pinMode(m_nPinFanTach, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(m_nPinFanTach),
-                    (void (*)())pHandleFanTackIrq,
-                    FALLING);
+    pTachCounter = new CIsrTachCounter(m_nPinFanTach);
   }
+
+  begin(pTachCounter);
+  m_bOwnsTachCounter = true;
+}
+
+void CPwmFanControl::begin(CTachCounter *pTachCounter)
+{
+  begin(new CLedcPwmChannel(m_nPwmChannel, m_nPinFanPwm), pTachCounter);
+  m_bOwnsPwmChannel = true;
 }
+#endif
 
-void IRAM_ATTR CPwmFanControl::isrFanTach()
+// Runs the fan on the given output and tach input, which the caller keeps
+// ownership of
+void CPwmFanControl::begin(CPwmChannel *pPwmChannel, CTachCounter *pTachCounter)
 {
-  portENTER_CRITICAL_ISR(&m_muxFanIrqCounter);
+  m_muxFanTachRead = HAL_SPINLOCK_INITIALIZER;
+
+  m_pPwmChannel = pPwmChannel;
+  m_bOwnsPwmChannel = false;
+
+  if (m_pPwmChannel != NULL)
   {
-    m_nFanTackIrqCounter++;
+    m_pPwmChannel->begin(m_nPwmFrequency, m_nPwmResolution);
   }
-  portEXIT_CRITICAL_ISR(&m_muxFanIrqCounter);
+
+  m_pTachCounter = pTachCounter;
+  m_bOwnsTachCounter = false;
+
+  m_nTachSampleHead = 0;
+  m_nTachSampleCount = 0;
+  m_nFanRpms = 0;
+
+  if (m_pTachCounter != NULL)
+  {
+    m_pTachCounter->begin();
+  }
+}
+
+void CPwmFanControl::setFanDutyCycle(const uint32_t nDutyCycle)
+{
+  applyDutyCycle(nDutyCycle, false);
 }
 
-void CPwmFanControl::setFanDutyCycle(const dutycycle_t nDutyCycle)
+void CPwmFanControl::applyDutyCycle(const uint32_t nDutyCycle, const bool bImmediate)
 {
-  m_nLastSpecDutyCycle = nDutyCycle;
+  m_nLastSpecDutyCycle = min(nDutyCycle, m_nMaxDutyCycle);
 
-  uint8_t nTmpDutyCycle = nDutyCycle;
+  uint32_t nTmpDutyCycle = m_nLastSpecDutyCycle;
 
   if (nTmpDutyCycle <= m_nFanOffDutyCycle)
   {
@@ -98,28 +163,124 @@ void CPwmFanControl::setFanDutyCycle(const dutycycle_t nDutyCycle)
   // If we go from zero to nonzero duty cycle, start the runtime timer
   if ((m_nLastDutyCycle <= 0) && (nTmpDutyCycle > 0))
   {
-    m_nLastFanStartMs = millis();
+    m_nLastFanStartMs = halMillis();
   }
 
   m_nLastDutyCycle = nTmpDutyCycle;
-  ledcWrite(m_nPwmChannel, nTmpDutyCycle);
+  if (m_pPwmChannel != NULL)
+  {
+    writeDutyCycle(nTmpDutyCycle, bImmediate);
+  }
 }
 
-uint32_t CPwmFanControl::getRuntimeMs()
+// Writes the policy duty cycle to the PWM channel. With ramping enabled
+// the move is handed to the channel's fade in segments of at most
+// m_nFadeSegmentMs, each limited to the configured %/s. Fades only cover
+// the range between the min duty cycle and full speed: starting up jumps
+// to the min duty cycle first, and switching off ramps down to the min
+// duty cycle before cutting power, so a fade never lingers where the fan
+// would stall.
+void CPwmFanControl::writeDutyCycle(const uint32_t nDutyCycle, const bool bImmediate)
 {
-  uint32_t nReturn = 0;
+  uint32_t nCurrentDutyCycle = readHardwareDutyCycle();
+
+  // Once the ramp down has reached the min duty cycle, switching off cuts
+  // power straight away
+  bool bSwitchOff = (nDutyCycle == 0) && (nCurrentDutyCycle <= m_nMinFanDutyCycle);
 
-  uint32_t nNowMs = millis();
-  if (m_nLastFanStartMs < nNowMs)
+  uint32_t nRampTarget = nDutyCycle;
+  if ((nDutyCycle == 0) && !bSwitchOff)
   {
-    nReturn = nNowMs - m_nLastFanStartMs;
+    nRampTarget = m_nMinFanDutyCycle;
   }
-  else // handle rollover
+
+  float fDutyPerSec = (nRampTarget > nCurrentDutyCycle) ? m_fRampUpDutyPerSec : m_fRampDownDutyPerSec;
+
+  if (bImmediate || bSwitchOff || (fDutyPerSec <= 0.0f) || (nRampTarget == nCurrentDutyCycle))
   {
-    nReturn = std::numeric_limits<uint32_t>::max() - m_nLastFanStartMs + nNowMs;
+    // Only touch the channel for a change, or to cut a fade short. The fade
+    // is stopped first, as a write waits for a running one to finish.
+    bool bFading = isFading();
+    if ((bImmediate && bFading) || (!bFading && (nDutyCycle != nCurrentDutyCycle)))
+    {
+      if (bFading)
+      {
+        m_pPwmChannel->stopFade();
+      }
+      m_pPwmChannel->write(nDutyCycle);
+      m_nFadeEndMs = 0;
+    }
   }
+  else if (!isFading())
+  {
+    // A new segment only starts once the last one is done. The next call picks
+    // up from wherever the fade left off.
+    if (nCurrentDutyCycle < m_nMinFanDutyCycle)
+    {
+      nCurrentDutyCycle = min(m_nMinFanDutyCycle, nRampTarget);
+      m_pPwmChannel->write(nCurrentDutyCycle);
+    }
 
-  return nReturn;
+    float fMaxStep = fDutyPerSec * (float)m_nFadeSegmentMs / 1000.0f;
+    float fStep = (float)nRampTarget - (float)nCurrentDutyCycle;
+    if (fStep > fMaxStep)
+    {
+      fStep = fMaxStep;
+    }
+    else if (fStep < -fMaxStep)
+    {
+      fStep = -fMaxStep;
+    }
+
+    // Round to nearest so a fade lands on its target, and move at least one
+    // count so a rate under half a count per segment still gets there. Jumping
+    // up to the min duty cycle may already have reached the target.
+    uint32_t nFadeTarget = (uint32_t)lroundf((float)nCurrentDutyCycle + fStep);
+    if ((nFadeTarget == nCurrentDutyCycle) && (nRampTarget != nCurrentDutyCycle))
+    {
+      nFadeTarget = (nRampTarget > nCurrentDutyCycle) ? nCurrentDutyCycle + 1 : nCurrentDutyCycle - 1;
+    }
+    uint32_t nFadeMs = max((uint32_t)(fabsf(fStep) * 1000.0f / fDutyPerSec), (uint32_t)1);
+
+    if (nFadeTarget != nCurrentDutyCycle)
+    {
+      if (m_pPwmChannel->fade(nFadeTarget, nFadeMs))
+      {
+        m_nFadeEndMs = halMillis() + nFadeMs;
+      }
+      else
+      {
+        m_pPwmChannel->write(nFadeTarget);
+      }
+    }
+  }
+}
+
+uint32_t CPwmFanControl::readHardwareDutyCycle()
+{
+  return (m_pPwmChannel != NULL) ? m_pPwmChannel->read() : m_nLastDutyCycle;
+}
+
+void CPwmFanControl::setRampRates(const float fUpPercentPerSec, const float fDownPercentPerSec)
+{
+  m_fRampUpDutyPerSec = max(fUpPercentPerSec, 0.0f) * m_fMaxDutyCycle / 100.0f;
+  m_fRampDownDutyPerSec = max(fDownPercentPerSec, 0.0f) * m_fMaxDutyCycle / 100.0f;
+}
+
+void CPwmFanControl::setFadeSegmentMs(const uint32_t nFadeSegmentMs)
+{
+  m_nFadeSegmentMs = max(nFadeSegmentMs, (uint32_t)1);
+}
+
+bool CPwmFanControl::isFading()
+{
+  return (m_nFadeEndMs != 0) && ((int32_t)(halMillis() - m_nFadeEndMs) < 0);
+}
+
+uint32_t CPwmFanControl::getRuntimeMs()
+{
+  // Unsigned subtraction stays correct across a millis() rollover
+  return halMillis() - m_nLastFanStartMs;
 }
 
 bool CPwmFanControl::isMinRuntimeComplete()
@@ -134,96 +295,223 @@ bool CPwmFanControl::isMinRuntimeComplete()
   return bReturn;
 }
 
-void CPwmFanControl::setFanDutyCyclePercent(const double fDutyPercent)
+void CPwmFanControl::setFanDutyCyclePercent(const float fDutyPercent)
 {
-  setFanDutyCycle(percentToDutyCycle(fDutyPercent));
+  setFanDutyCycle(percentToDuty(fDutyPercent));
 }
 
+// Full speed is the over temperature response, so it skips any ramp
 void CPwmFanControl::setFullSpeed()
 {
-  setFanDutyCycle((dutycycle_t)pow(2.0, (double)PWM_RESOUTION));
+  applyDutyCycle(getMaxDutyCycle(), true);
 }
 
-dutycycle_t CPwmFanControl::getLastDutyCycle()
+// Duty cycle currently on the pin, including the progress of a fade
+uint32_t CPwmFanControl::getLastDutyCycle()
 {
-  return m_nLastDutyCycle;
+  uint32_t nReturn = m_nLastDutyCycle;
+
+  if ((m_fRampUpDutyPerSec > 0.0f) || (m_fRampDownDutyPerSec > 0.0f))
+  {
+    nReturn = readHardwareDutyCycle();
+  }
+
+  return nReturn;
 }
 
-double CPwmFanControl::getLastDutyCyclePercent()
+// Duty cycle the policy settled on, which a fade may still be heading to
+uint32_t CPwmFanControl::getTargetDutyCycle()
 {
-  return CPwmFanControl::dutyCycleToPercent(m_nLastDutyCycle);
+  return m_nLastDutyCycle;
 }
 
-dutycycle_t CPwmFanControl::getLastSpecDutyCycle()
+uint32_t CPwmFanControl::getLastSpecDutyCycle()
 {
   return m_nLastSpecDutyCycle;
 }
 
-uint32_t CPwmFanControl::getFanRpms()
+float CPwmFanControl::getLastDutyCyclePercent()
 {
-  uint32_t nReturn = 0;
+  return dutyToPercent(getLastDutyCycle());
+}
+
+float CPwmFanControl::getLastSpecDutyCyclePercent()
+{
+  return dutyToPercent(m_nLastSpecDutyCycle);
+}
 
-  uint32_t nPrevFanTackIrqCounter = 0;
-  uint32_t nPrevFanTackCounterLastReadMicros = 0;
+uint32_t CPwmFanControl::getMaxDutyCycle()
+{
+  return m_nMaxDutyCycle;
+}
+
+uint8_t CPwmFanControl::getPwmResolution()
+{
+  return m_nPwmResolution;
+}
 
-  portENTER_CRITICAL(&m_muxFanIrqCounter);
+uint32_t CPwmFanControl::getPwmFrequency()
+{
+  return m_nPwmFrequency;
+}
+
+// Records the current tach count and refreshes the cached RPM from the
+// sliding window of samples. Meant to be called at a fixed cadence from a
+// single task; readers only ever see the cached value via getFanRpms().
+void CPwmFanControl::sampleTach()
+{
+  if (m_pTachCounter != NULL)
   {
-    nPrevFanTackIrqCounter = m_nFanTackIrqCounter;
-    nPrevFanTackCounterLastReadMicros = m_nFanTackCounterLastReadMicros;
-    m_nFanTackIrqCounter = 0;
-    m_nFanTackCounterLastReadMicros = micros();
+    uint32_t nPulseCount = m_pTachCounter->getPulseCount();
+    uint32_t nNowMicros = halMicros();
+    uint32_t nRpms = 0;
+    float fEdgeRate = 0.0f;
+
+    halEnterCritical(&m_muxFanTachRead);
+    {
+      const uint8_t nRingSize = RPM_WINDOW_MAX_SAMPLES + 1;
+
+      m_nTachSampleHead = (m_nTachSampleHead + 1) % nRingSize;
+      m_arrTachSamplePulses[m_nTachSampleHead] = nPulseCount;
+      m_arrTachSampleMicros[m_nTachSampleHead] = nNowMicros;
+      if (m_nTachSampleCount < nRingSize)
+      {
+        m_nTachSampleCount++;
+      }
+
+      uint8_t nWindow = min((uint8_t)(m_nTachSampleCount - 1), m_nRpmWindow);
+      if (nWindow > 0)
+      {
+        uint8_t nOldest = (m_nTachSampleHead + nRingSize - nWindow) % nRingSize;
+
+        // Unsigned subtraction stays correct across counter and halMicros() rollover
+        uint32_t nPulses = nPulseCount - m_arrTachSamplePulses[nOldest];
+        uint32_t nMicros = nNowMicros - m_arrTachSampleMicros[nOldest];
+
+        if (nMicros > 0)
+        {
+          uint64_t nDivisor = (uint64_t)nMicros * TACH_PULSES_PER_REV;
+          nRpms = (uint32_t)(((uint64_t)nPulses * 60000000ULL + nDivisor / 2) / nDivisor);
+          fEdgeRate = (float)nPulses * 1000000.0f / (float)nMicros;
+        }
+      }
+    }
+    halExitCritical(&m_muxFanTachRead);
+
+    m_nFanRpms = nRpms;
+    m_fTachEdgeRate = fEdgeRate;
   }
-  portEXIT_CRITICAL(&m_muxFanIrqCounter);
+}
+
+uint32_t CPwmFanControl::getFanRpms()
+{
+  uint32_t nReturn = m_nFanRpms;
 
-  if ((nPrevFanTackIrqCounter > 0) && (nPrevFanTackCounterLastReadMicros > 0))
+  const CTachEdgeRing *pEdgeRing = (m_pTachCounter != NULL) ? m_pTachCounter->getEdgeRing() : NULL;
+  if ((m_rpmEstimator == RPM_ESTIMATOR_PERIOD) && (pEdgeRing != NULL))
   {
-    double fNumFanRevs = ((double)nPrevFanTackIrqCounter) / 2.0;
-    double nNumMicros = 0;
+    uint32_t arrEdgeMicros[CTachEdgeRing::MAX_SNAPSHOT];
+    uint8_t nNumEdges = pEdgeRing->snapshot(arrEdgeMicros, CTachEdgeRing::MAX_SNAPSHOT);
+
+    nReturn = CTachPeriodEstimator::estimateRpm(arrEdgeMicros,
+                                                nNumEdges,
+                                                halMicros(),
+                                                m_nStallTimeoutMs * 1000,
+                                                TACH_PULSES_PER_REV);
+  }
 
-    // Handle rollover
-    if (nPrevFanTackCounterLastReadMicros > m_nFanTackCounterLastReadMicros)
+  return nReturn;
+}
+
+// Tach edges per second over the sampler window
+float CPwmFanControl::getTachEdgeRate()
+{
+  return m_fTachEdgeRate;
+}
+
+// With an interrupt per edge, getTachEdgeRate() is also the ISR rate
+bool CPwmFanControl::isTachInterruptPerEdge()
+{
+  return (m_pTachCounter != NULL) && m_pTachCounter->isInterruptPerEdge();
+}
+
+void CPwmFanControl::setRpmEstimator(const RpmEstimator rpmEstimator)
+{
+  m_rpmEstimator = rpmEstimator;
+}
+
+RpmEstimator CPwmFanControl::getRpmEstimator()
+{
+  return m_rpmEstimator;
+}
+
+void CPwmFanControl::setStallTimeoutMs(const uint32_t nStallTimeoutMs)
+{
+  m_nStallTimeoutMs = nStallTimeoutMs;
+}
+
+// A fan is stalled if it is being driven, has had the stall timeout to spin
+// up, and no tach edges arrived within the timeout
+bool CPwmFanControl::isStalled()
+{
+  bool bReturn = false;
+
+  if ((m_nLastDutyCycle > 0) && (getRuntimeMs() >= m_nStallTimeoutMs))
+  {
+    const CTachEdgeRing *pEdgeRing = (m_pTachCounter != NULL) ? m_pTachCounter->getEdgeRing() : NULL;
+    if ((m_rpmEstimator == RPM_ESTIMATOR_PERIOD) && (pEdgeRing != NULL))
     {
-      nNumMicros = std::numeric_limits<double>::max() - nPrevFanTackCounterLastReadMicros + m_nFanTackCounterLastReadMicros;
+      uint32_t arrEdgeMicros[1];
+      uint8_t nNumEdges = pEdgeRing->snapshot(arrEdgeMicros, 1);
+
+      CTachPeriodEstimator::estimateRpm(arrEdgeMicros,
+                                        nNumEdges,
+                                        halMicros(),
+                                        m_nStallTimeoutMs * 1000,
+                                        TACH_PULSES_PER_REV,
+                                        &bReturn);
     }
     else
     {
-      nNumMicros = (double)m_nFanTackCounterLastReadMicros - (double)nPrevFanTackCounterLastReadMicros;
+      bReturn = (m_nFanRpms == 0);
     }
+  }
 
-    double fFanTimeSec = nNumMicros / 1000000.0;
+  return bReturn;
+}
 
-    double fFanFreqHz = fNumFanRevs / fFanTimeSec;
-    double fFanRpms = fFanFreqHz * 60.0;
-    nReturn = round(fFanRpms);
+void CPwmFanControl::setRpmWindow(const uint8_t nWindowSamples)
+{
+  halEnterCritical(&m_muxFanTachRead);
+  {
+    m_nRpmWindow = constrain(nWindowSamples, 1, RPM_WINDOW_MAX_SAMPLES);
   }
+  halExitCritical(&m_muxFanTachRead);
+}
 
-  return nReturn;
+uint8_t CPwmFanControl::getRpmWindow()
+{
+  return m_nRpmWindow;
 }
 
-dutycycle_t CPwmFanControl::percentToDutyCycle(double fDutyPercent)
+// Rounds to the nearest step. NaN fails both comparisons and maps to 0.
+uint32_t CPwmFanControl::percentToDuty(const float fDutyPercent)
 {
-  dutycycle_t nReturn = 0;
+  uint32_t nReturn = 0;
 
-  if (fDutyPercent < 0.0)
+  if (fDutyPercent >= 100.0f)
   {
-    fDutyPercent = 0.0;
+    nReturn = m_nMaxDutyCycle;
   }
-  if (fDutyPercent > 100.0)
+  else if (fDutyPercent > 0.0f)
   {
-    fDutyPercent = 100.0;
+    nReturn = (uint32_t)(fDutyPercent * m_fMaxDutyCycle / 100.0f + 0.5f);
   }
 
-  double fMin = 0.0;
-  double fMax = pow(2.0, PWM_RESOUTION);
-  dutycycle_t nDutyCycle = min(round((fMax - fMin) * (fDutyPercent / 100.0)), fMax - 1.0);
-
-  nReturn = nDutyCycle;
-
   return nReturn;
 }
 
-double CPwmFanControl::dutyCycleToPercent(const dutycycle_t nDutyCycle)
+float CPwmFanControl::dutyToPercent(const uint32_t nDutyCycle)
 {
-  double fMax = pow(2.0, PWM_RESOUTION) - 1.0;
-  return ((double)nDutyCycle / fMax) * 100.0;
+  return ((float)nDutyCycle * 100.0f) / m_fMaxDutyCycle;
 }
@@ -1,65 +1,229 @@
 #ifndef __CPWMFANCONTROL_H__
 #define __CPWMFANCONTROL_H__
 
-#include <Arduino.h>
+#include <Hal.h>
+#include <type_traits>
+#include <CPwmChannel.h>
+#include <CTachCounter.h>
 
-typedef uint8_t dutycycle_t;
+enum TachBackend
+{
+  TACH_BACKEND_ISR,
+  TACH_BACKEND_PCNT
+};
+
+enum RpmEstimator
+{
+  RPM_ESTIMATOR_COUNT, // pulses counted over the sampler window
+  RPM_ESTIMATOR_PERIOD // inter-edge periods, needs TACH_BACKEND_ISR
+};
 
+// Resolution independent part of the fan controller: duty cycle policy,
+// tach/RPM measurement and runtime tracking. Duty cycles are handled as
+// uint32_t here; use CPwmFanControlT to fix the PWM resolution and
+// frequency at compile time. The percent conversions and the max duty
+// cycle are virtual so CPwmFanControlT can supply compile time ones, which
+// every percent setter and getter then goes through.
 class CPwmFanControl
 {
 public:
-  CPwmFanControl(const uint8_t nPwmChannel,
-                 const uint8_t nPinFanPwm,
-                 const uint8_t nPinFanTach,
-                 const dutycycle_t nMinFanDutyCycle = 0.0,
-                 const dutycycle_t nFanOffDutyCycle = 0.0,
-                 const uint8_t bAllowOff = 1,
-                 const uint32_t nFanMinRuntimeMs = 30000);
-
-  void begin(void (*pHandleFanTackIrq)());
-
-  void IRAM_ATTR isrFanTach();
-
-  void setMinFanDutyCycle(const dutycycle_t nMinFanDutyCycle);
-  void setFanOffDutyCycle(const dutycycle_t nFanOffDutyCycle);
+  virtual ~CPwmFanControl();
+
+#ifdef ARDUINO
+  void begin(const TachBackend tachBackend = TACH_BACKEND_PCNT);
+  void begin(CTachCounter *pTachCounter);
+#endif
+  void begin(CPwmChannel *pPwmChannel, CTachCounter *pTachCounter);
+
+  void setMinFanDutyCycle(const uint32_t nMinFanDutyCycle);
+  void setFanOffDutyCycle(const uint32_t nFanOffDutyCycle);
+  void setMinFanDutyCyclePercent(const float fMinFanDutyPercent);
+  void setFanOffDutyCyclePercent(const float fFanOffDutyPercent);
   void setAllowOff(const uint8_t bAllowOff);
   void setFanMinRuntimeMs(uint32_t nFanMinRuntimeMs);
 
-  void setFanDutyCycle(const dutycycle_t nDutyCycle);
-  void setFanDutyCyclePercent(const double fDutyPercent);
+  void setFanDutyCycle(const uint32_t nDutyCycle);
+  void setFanDutyCyclePercent(const float fDutyPercent);
 
-  dutycycle_t getLastDutyCycle();
-  dutycycle_t getLastSpecDutyCycle();
+  uint32_t getLastDutyCycle();
+  uint32_t getTargetDutyCycle();
+  uint32_t getLastSpecDutyCycle();
 
-  double getLastDutyCyclePercent();
+  float getLastDutyCyclePercent();
+  float getLastSpecDutyCyclePercent();
 
   void setFullSpeed();
 
+  void setRampRates(const float fUpPercentPerSec, const float fDownPercentPerSec);
+  void setFadeSegmentMs(const uint32_t nFadeSegmentMs);
+  bool isFading();
+
+  virtual uint32_t getMaxDutyCycle();
+  uint8_t getPwmResolution();
+  uint32_t getPwmFrequency();
+
+  virtual uint32_t percentToDuty(const float fDutyPercent);
+  virtual float dutyToPercent(const uint32_t nDutyCycle);
+
+  void sampleTach();
   uint32_t getFanRpms();
+  float getTachEdgeRate();
+  bool isTachInterruptPerEdge();
+  void setRpmWindow(const uint8_t nWindowSamples);
+  uint8_t getRpmWindow();
+
+  void setRpmEstimator(const RpmEstimator rpmEstimator);
+  RpmEstimator getRpmEstimator();
+  void setStallTimeoutMs(const uint32_t nStallTimeoutMs);
+  bool isStalled();
 
   uint32_t getRuntimeMs();
   bool isMinRuntimeComplete();
 
-  static uint8_t percentToDutyCycle(const double fDutyPercent);
-  static double dutyCycleToPercent(const dutycycle_t nDutyCycle);
+  static const uint8_t RPM_WINDOW_MAX_SAMPLES = 16;
 
-  static const double PWM_FREQUENCY;
-  static const uint8_t PWM_RESOUTION;
+protected:
+  CPwmFanControl(const uint8_t nPwmChannel,
+                 const uint8_t nPinFanPwm,
+                 const uint8_t nPinFanTach,
+                 const uint8_t nPwmResolution,
+                 const uint32_t nPwmFrequency,
+                 const uint32_t nMinFanDutyCycle,
+                 const uint32_t nFanOffDutyCycle,
+                 const uint8_t bAllowOff,
+                 const uint32_t nFanMinRuntimeMs);
 
 private:
-  portMUX_TYPE m_muxFanIrqCounter = portMUX_INITIALIZER_UNLOCKED;
-  volatile uint32_t m_nFanTackIrqCounter = 0;
-  volatile u_long m_nFanTackCounterLastReadMicros = 0;
+  void applyDutyCycle(const uint32_t nDutyCycle, const bool bImmediate);
+  void writeDutyCycle(const uint32_t nDutyCycle, const bool bImmediate);
+  uint32_t readHardwareDutyCycle();
+
+  HalSpinlock m_muxFanTachRead = HAL_SPINLOCK_INITIALIZER;
+  CPwmChannel *m_pPwmChannel = NULL;
+  bool m_bOwnsPwmChannel = false;
+  CTachCounter *m_pTachCounter = NULL;
+  bool m_bOwnsTachCounter = false;
+  uint32_t m_arrTachSamplePulses[RPM_WINDOW_MAX_SAMPLES + 1] = {};
+  uint32_t m_arrTachSampleMicros[RPM_WINDOW_MAX_SAMPLES + 1] = {};
+  uint8_t m_nTachSampleHead = 0;
+  uint8_t m_nTachSampleCount = 0;
+  uint8_t m_nRpmWindow = 4;
+  volatile uint32_t m_nFanRpms = 0;
+  volatile float m_fTachEdgeRate = 0.0f;
+  RpmEstimator m_rpmEstimator = RPM_ESTIMATOR_COUNT;
+  uint32_t m_nStallTimeoutMs = 1000;
   uint8_t m_nPwmChannel = 0; // this variable is used to select the channel number
   uint8_t m_nPinFanPwm = 0;  // GPIO to which we want to attach this channel signal
   uint8_t m_nPinFanTach = 0;
-  dutycycle_t m_nMinFanDutyCycle = 0;
-  dutycycle_t m_nFanOffDutyCycle = 0;
+  uint8_t m_nPwmResolution = 8;
+  uint32_t m_nPwmFrequency = 25000;
+  uint32_t m_nMaxDutyCycle = 255;
+  float m_fMaxDutyCycle = 255.0f;
+  uint32_t m_nMinFanDutyCycle = 0;
+  uint32_t m_nFanOffDutyCycle = 0;
   uint8_t m_bFanAllowOff = 1;
   uint32_t m_nFanMinRuntimeMs = 0;
-  dutycycle_t m_nLastDutyCycle = 0;
-  dutycycle_t m_nLastSpecDutyCycle = 0;
+  uint32_t m_nLastDutyCycle = 0;
+  uint32_t m_nLastSpecDutyCycle = 0;
   uint32_t m_nLastFanStartMs = 0;
+  float m_fRampUpDutyPerSec = 0.0f;   // 0 = no ramp, jump straight to the new duty
+  float m_fRampDownDutyPerSec = 0.0f; // 0 = no ramp, jump straight to the new duty
+  uint32_t m_nFadeSegmentMs = 750;
+  uint32_t m_nFadeEndMs = 0;
 };
 
+// Fan controller specialized at compile time on PWM resolution (8-16 bits)
+// and frequency; a combination the LEDC can't produce fails to build. The
+// duty cycle type is the narrowest that fits, and the percent/duty
+// conversions are constexpr on MAX_DUTY_CYCLE. They replace the base
+// class's, so calls through a CPwmFanControl pointer use them too.
+template <uint8_t RESOLUTION, uint32_t FREQUENCY>
+class CPwmFanControlT : public CPwmFanControl
+{
+  static_assert((RESOLUTION >= 8) && (RESOLUTION <= 16), "PWM resolution must be 8-16 bits");
+  static_assert((80000000UL >> RESOLUTION) >= FREQUENCY, "PWM frequency too high for this resolution (80 MHz LEDC clock)");
+
+public:
+  typedef typename std::conditional<(RESOLUTION <= 8), uint8_t, uint16_t>::type dutycycle_t;
+
+  static constexpr uint8_t PWM_RESOLUTION = RESOLUTION;
+  static constexpr uint32_t PWM_FREQUENCY = FREQUENCY;
+  static constexpr dutycycle_t MAX_DUTY_CYCLE = (dutycycle_t)((1UL << RESOLUTION) - 1);
+
+  CPwmFanControlT(const uint8_t nPwmChannel,
+                  const uint8_t nPinFanPwm,
+                  const uint8_t nPinFanTach,
+                  const dutycycle_t nMinFanDutyCycle = 0,
+                  const dutycycle_t nFanOffDutyCycle = 0,
+                  const uint8_t bAllowOff = 1,
+                  const uint32_t nFanMinRuntimeMs = 30000)
+      : CPwmFanControl(nPwmChannel,
+                       nPinFanPwm,
+                       nPinFanTach,
+                       RESOLUTION,
+                       FREQUENCY,
+                       nMinFanDutyCycle,
+                       nFanOffDutyCycle,
+                       bAllowOff,
+                       nFanMinRuntimeMs)
+  {
+  }
+
+  void setFanDutyCycle(const dutycycle_t nDutyCycle)
+  {
+    CPwmFanControl::setFanDutyCycle(nDutyCycle);
+  }
+
+  dutycycle_t getLastDutyCycle()
+  {
+    return (dutycycle_t)CPwmFanControl::getLastDutyCycle();
+  }
+
+  dutycycle_t getTargetDutyCycle()
+  {
+    return (dutycycle_t)CPwmFanControl::getTargetDutyCycle();
+  }
+
+  dutycycle_t getLastSpecDutyCycle()
+  {
+    return (dutycycle_t)CPwmFanControl::getLastSpecDutyCycle();
+  }
+
+  uint32_t getMaxDutyCycle()
+  {
+    return MAX_DUTY_CYCLE;
+  }
+
+  uint32_t percentToDuty(const float fDutyPercent)
+  {
+    return percentToDutyCycle(fDutyPercent);
+  }
+
+  float dutyToPercent(const uint32_t nDutyCycle)
+  {
+    return dutyCycleToPercent((dutycycle_t)min(nDutyCycle, (uint32_t)MAX_DUTY_CYCLE));
+  }
+
+  // Same rounding and clamping as CPwmFanControl::percentToDuty(); NaN
+  // fails the first test and maps to 0
+  static constexpr dutycycle_t percentToDutyCycle(const float fDutyPercent)
+  {
+    return !(fDutyPercent > 0.0f)     ? (dutycycle_t)0
+           : (fDutyPercent >= 100.0f) ? MAX_DUTY_CYCLE
+                                      : (dutycycle_t)(fDutyPercent * (float)MAX_DUTY_CYCLE / 100.0f + 0.5f);
+  }
+
+  static constexpr float dutyCycleToPercent(const dutycycle_t nDutyCycle)
+  {
+    return ((float)nDutyCycle * 100.0f) / (float)MAX_DUTY_CYCLE;
+  }
+};
+
+template <uint8_t RESOLUTION, uint32_t FREQUENCY>
+constexpr uint8_t CPwmFanControlT<RESOLUTION, FREQUENCY>::PWM_RESOLUTION;
+template <uint8_t RESOLUTION, uint32_t FREQUENCY>
+constexpr uint32_t CPwmFanControlT<RESOLUTION, FREQUENCY>::PWM_FREQUENCY;
+template <uint8_t RESOLUTION, uint32_t FREQUENCY>
+constexpr typename CPwmFanControlT<RESOLUTION, FREQUENCY>::dutycycle_t CPwmFanControlT<RESOLUTION, FREQUENCY>::MAX_DUTY_CYCLE;
+
 #endif // #ifndef __CPWMFANCONTROL_H__
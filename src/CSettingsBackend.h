@@ -0,0 +1,21 @@
+#ifndef __CSETTINGSBACKEND_H__
+#define __CSETTINGSBACKEND_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where CSettingsStore keeps its single settings blob. A write must
+// replace the whole blob or leave the old one intact.
+class CSettingsBackend
+{
+public:
+  virtual ~CSettingsBackend() {}
+
+  virtual bool begin() = 0;
+
+  // Returns the blob length, or 0 if there is no blob or it doesn't fit
+  virtual size_t read(uint8_t *pBuf, size_t nBufLen) = 0;
+  virtual bool write(const uint8_t *pBuf, size_t nLen) = 0;
+};
+
+#endif // #ifndef __CSETTINGSBACKEND_H__
@@ -0,0 +1,376 @@
+#include <CSettingsStore.h>
+#include <Crc32.h>
+#include <string.h>
+#include <math.h>
+
+#define SETTINGS_HEADER_LEN 12
+
+// Original gains were in 8 bit duty steps (0..255) per F, now % per F
+#define SETTINGS_V1_GAIN_SCALE (100.0 / 255.0)
+
+// Sequential little endian field access that stops at the end of the buffer
+class CFieldCursor
+{
+public:
+  CFieldCursor(uint8_t *pBuf, size_t nLen)
+      : m_pBuf(pBuf),
+        m_nLen(nLen)
+  {
+  }
+
+  void put(const void *pValue, size_t nSize)
+  {
+    if (m_nPos + nSize <= m_nLen)
+    {
+      memcpy(m_pBuf + m_nPos, pValue, nSize);
+    }
+    else
+    {
+      m_bOverflow = true;
+    }
+    m_nPos += nSize;
+  }
+
+  void get(void *pValue, size_t nSize)
+  {
+    if (m_nPos + nSize <= m_nLen)
+    {
+      memcpy(pValue, m_pBuf + m_nPos, nSize);
+    }
+    else
+    {
+      m_bOverflow = true;
+    }
+    m_nPos += nSize;
+  }
+
+  template <typename T>
+  void put(T value)
+  {
+    put(&value, sizeof(T));
+  }
+
+  template <typename T>
+  T get()
+  {
+    T value = T();
+    get(&value, sizeof(T));
+    return value;
+  }
+
+  size_t getPos() const { return m_nPos; }
+  bool isOverflow() const { return m_bOverflow; }
+
+private:
+  uint8_t *m_pBuf;
+  size_t m_nLen;
+  size_t m_nPos = 0;
+  bool m_bOverflow = false;
+};
+
+static void readFanV1(CFieldCursor &cursor, FanSettings *pFan)
+{
+  pFan->fPidSetpoint = cursor.get<double>();
+  pFan->fPidKp = cursor.get<double>() * SETTINGS_V1_GAIN_SCALE;
+  pFan->fPidKi = cursor.get<double>() * SETTINGS_V1_GAIN_SCALE;
+  pFan->fPidKd = cursor.get<double>() * SETTINGS_V1_GAIN_SCALE;
+  pFan->fFullSpeedTemp = cursor.get<double>();
+  pFan->fMinFanDutyCyclePercent = cursor.get<double>();
+  pFan->fFanOffDutyCyclePercent = cursor.get<double>();
+  pFan->bAllowOff = cursor.get<uint8_t>();
+  pFan->nFanMinRuntimeMs = cursor.get<uint32_t>();
+  pFan->fRampUpPercentPerSec = 0.0;
+  pFan->fRampDownPercentPerSec = 0.0;
+}
+
+static void readFanV2(CFieldCursor &cursor, FanSettings *pFan)
+{
+  pFan->fPidSetpoint = cursor.get<double>();
+  pFan->fPidKp = cursor.get<double>();
+  pFan->fPidKi = cursor.get<double>();
+  pFan->fPidKd = cursor.get<double>();
+  pFan->fFullSpeedTemp = cursor.get<double>();
+  pFan->fMinFanDutyCyclePercent = cursor.get<double>();
+  pFan->fFanOffDutyCyclePercent = cursor.get<double>();
+  pFan->bAllowOff = cursor.get<uint8_t>();
+  pFan->nFanMinRuntimeMs = cursor.get<uint32_t>();
+  pFan->fRampUpPercentPerSec = cursor.get<double>();
+  pFan->fRampDownPercentPerSec = cursor.get<double>();
+}
+
+static void writeFan(CFieldCursor &cursor, const FanSettings *pFan)
+{
+  cursor.put<double>(pFan->fPidSetpoint);
+  cursor.put<double>(pFan->fPidKp);
+  cursor.put<double>(pFan->fPidKi);
+  cursor.put<double>(pFan->fPidKd);
+  cursor.put<double>(pFan->fFullSpeedTemp);
+  cursor.put<double>(pFan->fMinFanDutyCyclePercent);
+  cursor.put<double>(pFan->fFanOffDutyCyclePercent);
+  cursor.put<uint8_t>(pFan->bAllowOff);
+  cursor.put<uint32_t>(pFan->nFanMinRuntimeMs);
+  cursor.put<double>(pFan->fRampUpPercentPerSec);
+  cursor.put<double>(pFan->fRampDownPercentPerSec);
+}
+
+CSettingsStore::CSettingsStore(CSettingsBackend *pBackend, PersistentSettings *pSettings, uint32_t nDebounceMs /* = 5000*/, uint32_t nMaxDelayMs /* = 60000*/)
+    : m_pBackend(pBackend),
+      m_pSettings(pSettings),
+      m_nDebounceMs(nDebounceMs),
+      m_nMaxDelayMs(nMaxDelayMs)
+{
+}
+
+// Returns the blob length, 0 if it doesn't fit
+size_t CSettingsStore::serialize(const PersistentSettings *pSettings, uint8_t *pBuf, size_t nBufLen)
+{
+  size_t nReturn = 0;
+
+  if ((pSettings != NULL) && (pBuf != NULL) && (nBufLen > SETTINGS_HEADER_LEN))
+  {
+    CFieldCursor payload(pBuf + SETTINGS_HEADER_LEN, nBufLen - SETTINGS_HEADER_LEN);
+    payload.put<uint8_t>(MAX_FANS);
+    for (uint8_t nIndex = 0; nIndex < MAX_FANS; nIndex++)
+    {
+      writeFan(payload, &pSettings->arrFans[nIndex]);
+    }
+
+    if (!payload.isOverflow())
+    {
+      CFieldCursor header(pBuf, SETTINGS_HEADER_LEN);
+      header.put<uint32_t>(SETTINGS_MAGIC);
+      header.put<uint16_t>(SETTINGS_VERSION);
+      header.put<uint16_t>((uint16_t)payload.getPos());
+      header.put<uint32_t>(computeCrc32(pBuf + SETTINGS_HEADER_LEN, payload.getPos()));
+      nReturn = SETTINGS_HEADER_LEN + payload.getPos();
+    }
+  }
+
+  return nReturn;
+}
+
+static bool isInRange(double fValue, double fMin, double fMax)
+{
+  return isfinite(fValue) && (fValue >= fMin) && (fValue <= fMax);
+}
+
+// Checks one fan's settings are safe to run with. On failure *ppszError
+// names the first offending field.
+bool CSettingsStore::validate(const FanSettings *pFan, const char **ppszError /* = 0*/)
+{
+  const char *pszError = NULL;
+
+  if (pFan == NULL)
+  {
+    pszError = "missing settings";
+  }
+  else if (!isInRange(pFan->fPidSetpoint, SETTINGS_MIN_TEMP, SETTINGS_MAX_TEMP))
+  {
+    pszError = "setpoint out of range";
+  }
+  else if (!isInRange(pFan->fFullSpeedTemp, SETTINGS_MIN_TEMP, SETTINGS_MAX_TEMP) || (pFan->fFullSpeedTemp <= pFan->fPidSetpoint))
+  {
+    pszError = "fullSpeedTemp must be above the setpoint";
+  }
+  else if (!isInRange(pFan->fPidKp, 0.0, SETTINGS_MAX_GAIN) ||
+           !isInRange(pFan->fPidKi, 0.0, SETTINGS_MAX_GAIN) ||
+           !isInRange(pFan->fPidKd, 0.0, SETTINGS_MAX_GAIN))
+  {
+    pszError = "gain out of range";
+  }
+  else if (!isInRange(pFan->fMinFanDutyCyclePercent, 0.0, 100.0))
+  {
+    pszError = "minDutyPercent out of range";
+  }
+  else if (!isInRange(pFan->fFanOffDutyCyclePercent, 0.0, 100.0))
+  {
+    pszError = "offDutyPercent out of range";
+  }
+  else if (pFan->bAllowOff > 1)
+  {
+    pszError = "allowOff must be 0 or 1";
+  }
+  else if (pFan->nFanMinRuntimeMs > SETTINGS_MAX_RUNTIME_MS)
+  {
+    pszError = "minRuntimeMs out of range";
+  }
+  else if (!isInRange(pFan->fRampUpPercentPerSec, 0.0, SETTINGS_MAX_RAMP) ||
+           !isInRange(pFan->fRampDownPercentPerSec, 0.0, SETTINGS_MAX_RAMP))
+  {
+    pszError = "ramp rate out of range";
+  }
+
+  if (ppszError != NULL)
+  {
+    *ppszError = pszError;
+  }
+
+  return (pszError == NULL);
+}
+
+// pSettings is only touched if the blob is valid. Fans the blob doesn't
+// cover keep whatever pSettings already held.
+SettingsLoadResult CSettingsStore::deserialize(const uint8_t *pBuf, size_t nLen, PersistentSettings *pSettings, uint16_t *pnVersion /* = 0*/)
+{
+  SettingsLoadResult result = SETTINGS_DEFAULTS_CORRUPT;
+
+  if ((pBuf != NULL) && (pSettings != NULL) && (nLen >= SETTINGS_HEADER_LEN))
+  {
+    CFieldCursor header((uint8_t *)pBuf, SETTINGS_HEADER_LEN);
+    uint32_t nMagic = header.get<uint32_t>();
+    uint16_t nVersion = header.get<uint16_t>();
+    uint16_t nPayloadLen = header.get<uint16_t>();
+    uint32_t nCrc = header.get<uint32_t>();
+    const uint8_t *pPayload = pBuf + SETTINGS_HEADER_LEN;
+
+    if ((nMagic == SETTINGS_MAGIC) &&
+        (SETTINGS_HEADER_LEN + (size_t)nPayloadLen == nLen) &&
+        (computeCrc32(pPayload, nPayloadLen) == nCrc) &&
+        (nVersion >= 1) && (nVersion <= SETTINGS_VERSION))
+    {
+      // Decode into a copy so a short payload can't leave a half update
+      PersistentSettings settings = *pSettings;
+      bool bValid = true;
+      CFieldCursor payload((uint8_t *)pPayload, nPayloadLen);
+      uint8_t nNumFans = payload.get<uint8_t>();
+
+      for (uint8_t nIndex = 0; nIndex < nNumFans; nIndex++)
+      {
+        FanSettings fan;
+        if (nVersion == 1)
+        {
+          readFanV1(payload, &fan);
+        }
+        else
+        {
+          readFanV2(payload, &fan);
+        }
+        if (nIndex < MAX_FANS)
+        {
+          settings.arrFans[nIndex] = fan;
+          bValid = bValid && validate(&fan);
+        }
+      }
+
+      if (bValid && !payload.isOverflow())
+      {
+        *pSettings = settings;
+        result = (nVersion == SETTINGS_VERSION) ? SETTINGS_LOADED : SETTINGS_MIGRATED;
+        if (pnVersion != NULL)
+        {
+          *pnVersion = nVersion;
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+// One read. On anything but a clean load the settings keep their defaults.
+SettingsLoadResult CSettingsStore::load()
+{
+  SettingsLoadResult result = SETTINGS_DEFAULTS;
+  uint8_t arrBlob[SETTINGS_MAX_BLOB];
+
+  if ((m_pBackend != NULL) && (m_pSettings != NULL) && m_pBackend->begin())
+  {
+    size_t nLen = m_pBackend->read(arrBlob, sizeof(arrBlob));
+    if (nLen > 0)
+    {
+      result = deserialize(arrBlob, nLen, m_pSettings, &m_nLoadedVersion);
+    }
+  }
+
+  if (result == SETTINGS_MIGRATED)
+  {
+    // Store it in the current layout, no need to wait for the debounce
+    saveNow();
+  }
+
+  return result;
+}
+
+void CSettingsStore::markDirty(uint32_t nNowMs)
+{
+  if (m_bDirty)
+  {
+    m_nCoalescedCount++;
+  }
+  else
+  {
+    m_nFirstDirtyMs = nNowMs;
+    m_bDirty = true;
+  }
+  m_nLastDirtyMs = nNowMs;
+}
+
+// Call periodically. Returns true if it wrote.
+bool CSettingsStore::service(uint32_t nNowMs)
+{
+  bool bReturn = false;
+
+  if (m_bDirty &&
+      (((nNowMs - m_nLastDirtyMs) >= m_nDebounceMs) || ((nNowMs - m_nFirstDirtyMs) >= m_nMaxDelayMs)))
+  {
+    bReturn = saveNow();
+  }
+
+  return bReturn;
+}
+
+bool CSettingsStore::saveNow()
+{
+  bool bReturn = false;
+  uint8_t arrBlob[SETTINGS_MAX_BLOB];
+
+  if ((m_pBackend != NULL) && (m_pSettings != NULL))
+  {
+    size_t nLen = serialize(m_pSettings, arrBlob, sizeof(arrBlob));
+
+    // Unchanged settings would only cost an erase cycle
+    uint8_t arrStored[SETTINGS_MAX_BLOB];
+    bool bSame = (nLen > 0) && (m_pBackend->read(arrStored, sizeof(arrStored)) == nLen) && (memcmp(arrStored, arrBlob, nLen) == 0);
+
+    bReturn = bSame || ((nLen > 0) && m_pBackend->write(arrBlob, nLen));
+    if (bReturn)
+    {
+      if (!bSame)
+      {
+        m_nWriteCount++;
+      }
+      m_bDirty = false;
+    }
+    else
+    {
+      m_nWriteErrors++;
+    }
+  }
+
+  return bReturn;
+}
+
+bool CSettingsStore::isDirty()
+{
+  return m_bDirty;
+}
+
+uint32_t CSettingsStore::getWriteCount()
+{
+  return m_nWriteCount;
+}
+
+uint32_t CSettingsStore::getWriteErrors()
+{
+  return m_nWriteErrors;
+}
+
+uint32_t CSettingsStore::getCoalescedCount()
+{
+  return m_nCoalescedCount;
+}
+
+uint16_t CSettingsStore::getLoadedVersion()
+{
+  return m_nLoadedVersion;
+}
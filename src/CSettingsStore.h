@@ -0,0 +1,81 @@
+#ifndef __CSETTINGSSTORE_H__
+#define __CSETTINGSSTORE_H__
+
+#include <CSettingsBackend.h>
+#include <FanSettings.h>
+
+#define SETTINGS_MAGIC 0x54455346 // "FSET"
+#define SETTINGS_VERSION 2
+#define SETTINGS_MAX_BLOB 1024
+
+// Limits enforced by validate(), temperatures in F
+#define SETTINGS_MIN_TEMP 32.0
+#define SETTINGS_MAX_TEMP 250.0
+#define SETTINGS_MAX_GAIN 100.0
+#define SETTINGS_MAX_RUNTIME_MS 3600000UL
+#define SETTINGS_MAX_RAMP 1000.0
+
+enum SettingsLoadResult
+{
+  SETTINGS_LOADED = 0,       // current version, CRC good
+  SETTINGS_MIGRATED,         // older version, converted (and rewritten soon)
+  SETTINGS_DEFAULTS,         // nothing stored yet
+  SETTINGS_DEFAULTS_CORRUPT  // bad magic, CRC, length or unknown version
+};
+
+// Persists PersistentSettings as one versioned, CRC-checked blob.
+//
+//   magic (4) | version (2) | payload length (2) | CRC-32 of payload (4) | payload
+//
+// The payload is an explicit little endian field list rather than the
+// in-memory struct, so reordering FanSettings can't silently change the
+// stored layout. Every past layout has a reader that migrates it to the
+// current one:
+//   1  the original firmware's fields, gains in 8 bit duty steps per F
+//   2  adds ramp rates, gains in % duty per F
+//
+// Blobs holding a fan that fails validate() are treated as corrupt.
+//
+// load() is a single backend read. Changes are recorded with markDirty()
+// and written by service() once they have been quiet for the debounce
+// time, or after the max delay if they never go quiet, so a burst of
+// edits costs one flash write.
+//
+// Plain C++; the caller provides the time and serializes calls.
+class CSettingsStore
+{
+public:
+  CSettingsStore(CSettingsBackend *pBackend, PersistentSettings *pSettings, uint32_t nDebounceMs = 5000, uint32_t nMaxDelayMs = 60000);
+
+  SettingsLoadResult load();
+  void markDirty(uint32_t nNowMs);
+  bool service(uint32_t nNowMs);
+  bool saveNow();
+
+  bool isDirty();
+  uint32_t getWriteCount();
+  uint32_t getWriteErrors();
+  uint32_t getCoalescedCount();
+  uint16_t getLoadedVersion();
+
+  static size_t serialize(const PersistentSettings *pSettings, uint8_t *pBuf, size_t nBufLen);
+  static bool validate(const FanSettings *pFan, const char **ppszError = 0);
+  static SettingsLoadResult deserialize(const uint8_t *pBuf, size_t nLen, PersistentSettings *pSettings, uint16_t *pnVersion = 0);
+
+private:
+  CSettingsBackend *m_pBackend = 0;
+  PersistentSettings *m_pSettings = 0;
+  uint32_t m_nDebounceMs = 5000;
+  uint32_t m_nMaxDelayMs = 60000;
+
+  bool m_bDirty = false;
+  uint32_t m_nFirstDirtyMs = 0;
+  uint32_t m_nLastDirtyMs = 0;
+
+  uint16_t m_nLoadedVersion = 0;
+  uint32_t m_nWriteCount = 0;
+  uint32_t m_nWriteErrors = 0;
+  uint32_t m_nCoalescedCount = 0;
+};
+
+#endif // #ifndef __CSETTINGSSTORE_H__
@@ -0,0 +1,71 @@
+#include <CSimPwmChannel.h>
+
+bool CSimPwmChannel::begin(const uint32_t nFrequency, const uint8_t nResolution)
+{
+  m_nMaxDutyCycle = (1UL << nResolution) - 1;
+  write(0);
+
+  return true;
+}
+
+void CSimPwmChannel::write(const uint32_t nDutyCycle)
+{
+  m_nDutyCycle = min(nDutyCycle, m_nMaxDutyCycle);
+  m_nFadeMicros = 0;
+  m_nNumWrites++;
+}
+
+uint32_t CSimPwmChannel::read()
+{
+  uint32_t nReturn = m_nDutyCycle;
+
+  uint32_t nElapsedMicros = halMicros() - m_nFadeStartMicros;
+  if ((m_nFadeMicros > 0) && (nElapsedMicros < m_nFadeMicros))
+  {
+    int64_t nDelta = (int64_t)m_nDutyCycle - (int64_t)m_nFadeFromDutyCycle;
+    nReturn = (uint32_t)((int64_t)m_nFadeFromDutyCycle + nDelta * nElapsedMicros / m_nFadeMicros);
+  }
+
+  return nReturn;
+}
+
+bool CSimPwmChannel::fade(const uint32_t nDutyCycle, const uint32_t nFadeMs)
+{
+  m_nFadeFromDutyCycle = read();
+  m_nDutyCycle = min(nDutyCycle, m_nMaxDutyCycle);
+  m_nFadeStartMicros = halMicros();
+  m_nFadeMicros = nFadeMs * 1000;
+  m_nNumFades++;
+
+  return true;
+}
+
+bool CSimPwmChannel::stopFade()
+{
+  m_nDutyCycle = read();
+  m_nFadeMicros = 0;
+  m_nNumFadeStops++;
+
+  return true;
+}
+
+// Duty cycle on the output as 0.0-1.0, for plant models
+float CSimPwmChannel::getDutyFraction()
+{
+  return (float)read() / (float)m_nMaxDutyCycle;
+}
+
+uint32_t CSimPwmChannel::getNumWrites()
+{
+  return m_nNumWrites;
+}
+
+uint32_t CSimPwmChannel::getNumFades()
+{
+  return m_nNumFades;
+}
+
+uint32_t CSimPwmChannel::getNumFadeStops()
+{
+  return m_nNumFadeStops;
+}
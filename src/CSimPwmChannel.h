@@ -0,0 +1,34 @@
+#ifndef __CSIMPWMCHANNEL_H__
+#define __CSIMPWMCHANNEL_H__
+
+#include <Hal.h>
+#include <CPwmChannel.h>
+
+// Simulated PWM channel. Fades move linearly on the HAL clock, so on the
+// native build they progress as the simulation advances time.
+class CSimPwmChannel : public CPwmChannel
+{
+public:
+  bool begin(const uint32_t nFrequency, const uint8_t nResolution);
+  void write(const uint32_t nDutyCycle);
+  uint32_t read();
+  bool fade(const uint32_t nDutyCycle, const uint32_t nFadeMs);
+  bool stopFade();
+
+  float getDutyFraction();
+  uint32_t getNumWrites();
+  uint32_t getNumFades();
+  uint32_t getNumFadeStops();
+
+private:
+  uint32_t m_nMaxDutyCycle = 255;
+  uint32_t m_nFadeFromDutyCycle = 0;
+  uint32_t m_nDutyCycle = 0;
+  uint32_t m_nFadeStartMicros = 0;
+  uint32_t m_nFadeMicros = 0;
+  uint32_t m_nNumWrites = 0;
+  uint32_t m_nNumFades = 0;
+  uint32_t m_nNumFadeStops = 0;
+};
+
+#endif // #ifndef __CSIMPWMCHANNEL_H__
@@ -0,0 +1,41 @@
+#include <CSimTachCounter.h>
+
+CSimTachCounter::CSimTachCounter(const uint8_t nPulsesPerRev /* = 2*/)
+{
+  m_nPulsesPerRev = nPulsesPerRev;
+}
+
+bool CSimTachCounter::begin()
+{
+  m_fPulses = 0.0;
+  m_nLastMicros = halMicros();
+
+  return true;
+}
+
+uint32_t CSimTachCounter::getPulseCount()
+{
+  integrate();
+
+  return (uint32_t)(uint64_t)m_fPulses;
+}
+
+// The speed changes from now on; pulses up to now count at the old speed
+void CSimTachCounter::setRpm(const float fRpm)
+{
+  integrate();
+  m_fRpm = max(fRpm, 0.0f);
+}
+
+float CSimTachCounter::getRpm()
+{
+  return m_fRpm;
+}
+
+void CSimTachCounter::integrate()
+{
+  uint32_t nNowMicros = halMicros();
+
+  m_fPulses += (double)m_fRpm * m_nPulsesPerRev * (uint32_t)(nNowMicros - m_nLastMicros) / 60000000.0;
+  m_nLastMicros = nNowMicros;
+}
@@ -0,0 +1,29 @@
+#ifndef __CSIMTACHCOUNTER_H__
+#define __CSIMTACHCOUNTER_H__
+
+#include <Hal.h>
+#include <CTachCounter.h>
+
+// Simulated tach: integrates a settable fan speed over the HAL clock into
+// a running pulse count, as a counting backend (no edge timestamps)
+class CSimTachCounter : public CTachCounter
+{
+public:
+  CSimTachCounter(const uint8_t nPulsesPerRev = 2);
+
+  bool begin();
+  uint32_t getPulseCount();
+
+  void setRpm(const float fRpm);
+  float getRpm();
+
+private:
+  void integrate();
+
+  uint8_t m_nPulsesPerRev = 2;
+  float m_fRpm = 0.0f;
+  double m_fPulses = 0.0;
+  uint32_t m_nLastMicros = 0;
+};
+
+#endif // #ifndef __CSIMTACHCOUNTER_H__
@@ -0,0 +1,217 @@
+#include <CSimTempBus.h>
+
+#define SIM_TEMP_POWER_ON_RAW 10880 // 85 C
+
+CSimTempBus::CSimTempBus(const uint8_t nNumSensors)
+{
+  m_nNumSensors = min(nNumSensors, (uint8_t)SIM_TEMP_BUS_MAX_SENSORS);
+
+  for (uint8_t nIndex = 0; nIndex < m_nNumSensors; nIndex++)
+  {
+    SimSensor *pSensor = &m_arrSensors[nIndex];
+
+    pSensor->address[0] = 0x28; // DS18B20 family code
+    pSensor->address[1] = nIndex + 1;
+    pSensor->nBits = 12;
+    pSensor->bConnected = true;
+    pSensor->fTempC = 20.0f;
+    pSensor->nRegisterRaw = SIM_TEMP_POWER_ON_RAW;
+  }
+}
+
+bool CSimTempBus::begin()
+{
+  return true;
+}
+
+uint8_t CSimTempBus::discover(DeviceAddress *arrAddresses, const uint8_t nMaxAddresses)
+{
+  uint8_t nReturn = 0;
+
+  for (uint8_t nIndex = 0; (nIndex < m_nNumSensors) && (nReturn < nMaxAddresses); nIndex++)
+  {
+    if (m_arrSensors[nIndex].bConnected)
+    {
+      memcpy(arrAddresses[nReturn++], m_arrSensors[nIndex].address, sizeof(DeviceAddress));
+    }
+  }
+
+  return nReturn;
+}
+
+bool CSimTempBus::setResolution(const uint8_t *pAddress, const uint8_t nBits)
+{
+  bool bReturn = false;
+
+  SimSensor *pSensor = findSensor(pAddress);
+  if ((pSensor != NULL) && (nBits >= 9) && (nBits <= 12))
+  {
+    pSensor->nBits = nBits;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+// Same worst case times DallasTemperature waits for
+uint32_t CSimTempBus::getConversionTimeMs(const uint8_t nBits)
+{
+  uint32_t nReturn = 750;
+
+  switch (nBits)
+  {
+  case 9:
+    nReturn = 94;
+    break;
+  case 10:
+    nReturn = 188;
+    break;
+  case 11:
+    nReturn = 375;
+    break;
+  }
+
+  return nReturn;
+}
+
+void CSimTempBus::setWaitForConversion(const bool bWait)
+{
+  m_bWaitForConversion = bWait;
+}
+
+// A waiting request takes the conversion time of the slowest sensor on the
+// HAL clock, as the blocking DallasTemperature call does
+void CSimTempBus::requestTemperatures()
+{
+  uint8_t nMaxBits = 9;
+
+  halDelayMs(m_nRequestLatencyMs);
+
+  for (uint8_t nIndex = 0; nIndex < m_nNumSensors; nIndex++)
+  {
+    startConversion(&m_arrSensors[nIndex]);
+    nMaxBits = max(nMaxBits, m_arrSensors[nIndex].nBits);
+  }
+
+  if (m_bWaitForConversion)
+  {
+    halDelayMs(getConversionTimeMs(nMaxBits));
+  }
+}
+
+void CSimTempBus::requestTemperature(const uint8_t *pAddress)
+{
+  halDelayMs(m_nRequestLatencyMs);
+
+  SimSensor *pSensor = findSensor(pAddress);
+  if (pSensor != NULL)
+  {
+    startConversion(pSensor);
+
+    if (m_bWaitForConversion)
+    {
+      halDelayMs(getConversionTimeMs(pSensor->nBits));
+    }
+  }
+}
+
+int32_t CSimTempBus::getTempRaw(const uint8_t *pAddress)
+{
+  int32_t nReturn = TEMP_BUS_DISCONNECTED_RAW;
+
+  // A missing sensor takes as long to fail as a present one to answer
+  halDelayMs(m_nReadLatencyMs);
+
+  SimSensor *pSensor = findSensor(pAddress);
+  if ((pSensor != NULL) && pSensor->bConnected)
+  {
+    finishConversion(pSensor);
+    nReturn = pSensor->nRegisterRaw;
+  }
+
+  return nReturn;
+}
+
+bool CSimTempBus::isParasitePowered()
+{
+  return false;
+}
+
+void CSimTempBus::setTempC(const uint8_t nIndex, const float fTempC)
+{
+  if (nIndex < m_nNumSensors)
+  {
+    m_arrSensors[nIndex].fTempC = fTempC;
+  }
+}
+
+float CSimTempBus::getTempC(const uint8_t nIndex)
+{
+  return (nIndex < m_nNumSensors) ? m_arrSensors[nIndex].fTempC : -127.0f;
+}
+
+// A disconnected sensor reads as DEVICE_DISCONNECTED and drops out of
+// discovery
+void CSimTempBus::setConnected(const uint8_t nIndex, const bool bConnected)
+{
+  if (nIndex < m_nNumSensors)
+  {
+    m_arrSensors[nIndex].bConnected = bConnected;
+  }
+}
+
+uint32_t CSimTempBus::getNumConversions()
+{
+  return m_nNumConversions;
+}
+
+// Time each conversion request and each sensor read takes; 0 for none.
+// Can be changed between calls to model a bus with variable timing.
+void CSimTempBus::setBusLatencyMs(const uint32_t nRequestMs, const uint32_t nReadMs)
+{
+  m_nRequestLatencyMs = nRequestMs;
+  m_nReadLatencyMs = nReadMs;
+}
+
+CSimTempBus::SimSensor *CSimTempBus::findSensor(const uint8_t *pAddress)
+{
+  SimSensor *pReturn = NULL;
+
+  for (uint8_t nIndex = 0; (nIndex < m_nNumSensors) && (pReturn == NULL) && (pAddress != NULL); nIndex++)
+  {
+    if (memcmp(m_arrSensors[nIndex].address, pAddress, sizeof(DeviceAddress)) == 0)
+    {
+      pReturn = &m_arrSensors[nIndex];
+    }
+  }
+
+  return pReturn;
+}
+
+// Samples the true temperature, truncated to the resolution's step:
+// 1/16 C at 12 bits up to 1/2 C at 9 bits. A finished conversion nobody
+// read yet lands in the register first.
+void CSimTempBus::startConversion(SimSensor *pSensor)
+{
+  finishConversion(pSensor);
+
+  if (pSensor->bConnected)
+  {
+    int32_t nStep = 8 << (12 - pSensor->nBits);
+
+    pSensor->nPendingRaw = (int32_t)floorf(pSensor->fTempC * 128.0f / (float)nStep) * nStep;
+    pSensor->nConversionStartMs = halMillis();
+    pSensor->bConverting = true;
+    m_nNumConversions++;
+  }
+}
+
+// The register only changes once the conversion has had its full time
+void CSimTempBus::finishConversion(SimSensor *pSensor)
+{
+  if (pSensor->bConverting && (halMillis() - pSensor->nConversionStartMs >= getConversionTimeMs(pSensor->nBits)))
+  {
+    pSensor->nRegisterRaw = pSensor->nPendingRaw;
+    pSensor->bConverting = false;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef __CSIMTEMPBUS_H__
+#define __CSIMTEMPBUS_H__
+
+#include <Hal.h>
+#include <CTempBus.h>
+
+#define SIM_TEMP_BUS_MAX_SENSORS 8
+
+// Simulated DS18B20 bus. Each sensor has a true temperature the simulation
+// sets; a conversion samples it when requested, quantized to the sensor's
+// resolution, and the value only shows up in the temperature register once
+// the conversion time has passed on the HAL clock. Registers start at the
+// 85 C power-on value, like the real parts. setBusLatencyMs() makes each
+// request and read take time on the HAL clock, as OneWire transactions do.
+class CSimTempBus : public CTempBus
+{
+public:
+  CSimTempBus(const uint8_t nNumSensors);
+
+  bool begin();
+  uint8_t discover(DeviceAddress *arrAddresses, const uint8_t nMaxAddresses);
+  bool setResolution(const uint8_t *pAddress, const uint8_t nBits);
+  uint32_t getConversionTimeMs(const uint8_t nBits);
+  void setWaitForConversion(const bool bWait);
+  void requestTemperatures();
+  void requestTemperature(const uint8_t *pAddress);
+  int32_t getTempRaw(const uint8_t *pAddress);
+  bool isParasitePowered();
+
+  void setTempC(const uint8_t nIndex, const float fTempC);
+  float getTempC(const uint8_t nIndex);
+  void setConnected(const uint8_t nIndex, const bool bConnected);
+  uint32_t getNumConversions();
+  void setBusLatencyMs(const uint32_t nRequestMs, const uint32_t nReadMs);
+
+private:
+  typedef struct SimSensor
+  {
+    DeviceAddress address;
+    uint8_t nBits;
+    bool bConnected;
+    bool bConverting;
+    uint32_t nConversionStartMs;
+    float fTempC;
+    int32_t nPendingRaw;
+    int32_t nRegisterRaw;
+  } SimSensor;
+
+  SimSensor *findSensor(const uint8_t *pAddress);
+  void startConversion(SimSensor *pSensor);
+  void finishConversion(SimSensor *pSensor);
+
+  SimSensor m_arrSensors[SIM_TEMP_BUS_MAX_SENSORS] = {};
+  uint8_t m_nNumSensors = 0;
+  bool m_bWaitForConversion = true;
+  uint32_t m_nNumConversions = 0;
+  uint32_t m_nRequestLatencyMs = 0;
+  uint32_t m_nReadLatencyMs = 0;
+};
+
+#endif // #ifndef __CSIMTEMPBUS_H__
@@ -0,0 +1,29 @@
+#ifndef __CTACHCOUNTER_H__
+#define __CTACHCOUNTER_H__
+
+#include <stdint.h>
+#include <CTachPeriodEstimator.h>
+
+// Source of fan tach edge counts. Implementations count falling tach edges
+// and report a running (wrapping) total, so callers compute pulses over an
+// interval with plain unsigned subtraction. Kept free of Arduino/ESP-IDF
+// includes so a host-side fake can stand in for the hardware.
+class CTachCounter
+{
+public:
+  virtual ~CTachCounter() {}
+
+  virtual bool begin() = 0;
+
+  // Total edges counted since begin(), wraps at 2^32
+  virtual uint32_t getPulseCount() = 0;
+
+  // Edge timestamps for period based RPM estimation, or NULL if the
+  // backend only counts edges
+  virtual const CTachEdgeRing *getEdgeRing() { return 0; }
+
+  // True if every edge costs the CPU an interrupt
+  virtual bool isInterruptPerEdge() { return false; }
+};
+
+#endif // #ifndef __CTACHCOUNTER_H__
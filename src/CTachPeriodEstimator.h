@@ -0,0 +1,124 @@
+#ifndef __CTACHPERIODESTIMATOR_H__
+#define __CTACHPERIODESTIMATOR_H__
+
+#include <stdint.h>
+
+// Ring of tach edge timestamps (micros). Single producer (the tach ISR),
+// any number of readers. Readers copy the newest edges and retry if the
+// producer lapped them mid-copy, so no lock is ever taken.
+class CTachEdgeRing
+{
+public:
+  static const uint8_t CAPACITY = 16; // must be a power of 2
+  static const uint8_t MAX_SNAPSHOT = CAPACITY / 2;
+
+  inline void push(const uint32_t nEdgeMicros)
+  {
+    uint32_t nWriteIndex = m_nWriteIndex;
+    m_arrEdgeMicros[nWriteIndex & (CAPACITY - 1)] = nEdgeMicros;
+    m_nWriteIndex = nWriteIndex + 1;
+  }
+
+  // Copies up to nMaxEdges (<= MAX_SNAPSHOT) of the newest timestamps into
+  // arrEdgeMicros, oldest first. Returns the number of edges copied.
+  uint8_t snapshot(uint32_t *arrEdgeMicros, uint8_t nMaxEdges) const
+  {
+    uint8_t nReturn = 0;
+
+    if (nMaxEdges > MAX_SNAPSHOT)
+    {
+      nMaxEdges = MAX_SNAPSHOT;
+    }
+
+    for (uint8_t nAttempt = 0; nAttempt < 4; nAttempt++)
+    {
+      uint32_t nEndIndex = m_nWriteIndex;
+      uint8_t nCount = (nEndIndex < nMaxEdges) ? (uint8_t)nEndIndex : nMaxEdges;
+
+      for (uint8_t nIndex = 0; nIndex < nCount; nIndex++)
+      {
+        arrEdgeMicros[nIndex] = m_arrEdgeMicros[(nEndIndex - nCount + nIndex) & (CAPACITY - 1)];
+      }
+
+      // Entries we copied are only overwritten once the producer has lapped
+      // the free part of the ring
+      if ((m_nWriteIndex - nEndIndex) < (uint32_t)(CAPACITY - nCount))
+      {
+        nReturn = nCount;
+        break;
+      }
+    }
+
+    return nReturn;
+  }
+
+  uint32_t getEdgeCount() const
+  {
+    return m_nWriteIndex;
+  }
+
+private:
+  volatile uint32_t m_arrEdgeMicros[CAPACITY] = {};
+  volatile uint32_t m_nWriteIndex = 0;
+};
+
+// Computes RPM from the periods between tach edges rather than from a
+// count over a fixed window, which gives a fresh value after a revolution
+// or two and resolves low speeds well.
+class CTachPeriodEstimator
+{
+public:
+  // arrEdgeMicros is oldest first. A stall is reported (and 0 returned) if
+  // no edge arrived within nStallTimeoutMicros of nNowMicros.
+  static uint32_t estimateRpm(const uint32_t *arrEdgeMicros,
+                              const uint8_t nNumEdges,
+                              const uint32_t nNowMicros,
+                              const uint32_t nStallTimeoutMicros,
+                              const uint8_t nPulsesPerRev,
+                              bool *pbStalled = 0)
+  {
+    uint32_t nReturn = 0;
+    bool bStalled = true;
+
+    if ((nNumEdges > 0) && (nPulsesPerRev > 0))
+    {
+      uint32_t nSinceLastEdge = nNowMicros - arrEdgeMicros[nNumEdges - 1];
+      bStalled = (nSinceLastEdge > nStallTimeoutMicros);
+
+      // Use whole revolutions so uneven tach duty cycles cancel out
+      uint8_t nPeriods = nNumEdges - 1;
+      if (nPeriods >= nPulsesPerRev)
+      {
+        nPeriods -= nPeriods % nPulsesPerRev;
+      }
+
+      if (!bStalled && (nPeriods > 0))
+      {
+        uint32_t nSpanMicros = arrEdgeMicros[nNumEdges - 1] - arrEdgeMicros[nNumEdges - 1 - nPeriods];
+
+        // If the fan is slowing down, the open interval since the last edge
+        // is already longer than the measured period, so bound the estimate
+        if ((uint64_t)nSinceLastEdge * nPeriods > nSpanMicros)
+        {
+          nSpanMicros = nSinceLastEdge;
+          nPeriods = 1;
+        }
+
+        if (nSpanMicros > 0)
+        {
+          uint64_t nDivisor = (uint64_t)nSpanMicros * nPulsesPerRev;
+          nReturn = (uint32_t)(((uint64_t)nPeriods * 60000000ULL + nDivisor / 2) / nDivisor);
+        }
+      }
+    }
+
+    if (pbStalled != 0)
+    {
+      *pbStalled = bStalled;
+    }
+
+    return nReturn;
+  }
+};
+
+#endif // #ifndef __CTACHPERIODESTIMATOR_H__
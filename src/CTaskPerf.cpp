@@ -0,0 +1,139 @@
+#include <CTaskPerf.h>
+
+CTaskPerf::CTaskPerf(const char *pszName)
+{
+  m_pszName = pszName;
+}
+
+// Call from the task itself so the stack high water can be read later
+void CTaskPerf::attach()
+{
+  m_hTask = halTaskGetCurrent();
+}
+
+void CTaskPerf::loopStart()
+{
+  if (m_bResetRequested)
+  {
+    clear();
+    m_bResetRequested = false;
+  }
+
+  uint32_t nNowMicros = halMicros();
+  uint32_t nLoopCount = m_nLoopCount;
+
+  if (nLoopCount > 0)
+  {
+    uint32_t nPeriodMicros = nNowMicros - m_nStartMicros;
+    record(&m_period, nPeriodMicros, nLoopCount - 1);
+
+    if (nLoopCount > 1)
+    {
+      uint32_t nJitterMicros = (nPeriodMicros > m_nLastPeriodMicros) ? (nPeriodMicros - m_nLastPeriodMicros) : (m_nLastPeriodMicros - nPeriodMicros);
+      record(&m_jitter, nJitterMicros, nLoopCount - 2);
+    }
+
+    m_nLastPeriodMicros = nPeriodMicros;
+  }
+
+  m_nStartMicros = nNowMicros;
+  m_nLoopCount = nLoopCount + 1;
+}
+
+void CTaskPerf::loopEnd()
+{
+  if (m_nLoopCount > 0)
+  {
+    record(&m_exec, halMicros() - m_nStartMicros, m_nLoopCount - 1);
+  }
+}
+
+void CTaskPerf::reset()
+{
+  m_bResetRequested = true;
+}
+
+const char *CTaskPerf::getName()
+{
+  return m_pszName;
+}
+
+HalTaskHandle CTaskPerf::getTask()
+{
+  return m_hTask;
+}
+
+uint32_t CTaskPerf::getLoopCount()
+{
+  return m_nLoopCount;
+}
+
+// 0 until attach() has been called
+uint32_t CTaskPerf::getStackHighWater()
+{
+  uint32_t nReturn = 0;
+
+  if (m_hTask != NULL)
+  {
+    nReturn = halTaskGetStackHighWater(m_hTask);
+  }
+
+  return nReturn;
+}
+
+const TaskPerfTiming *CTaskPerf::getPeriod()
+{
+  return &m_period;
+}
+
+const TaskPerfTiming *CTaskPerf::getJitter()
+{
+  return &m_jitter;
+}
+
+const TaskPerfTiming *CTaskPerf::getExec()
+{
+  return &m_exec;
+}
+
+uint8_t CTaskPerf::getBucket(uint32_t nMicros)
+{
+  uint8_t nReturn = 0;
+
+  if (nMicros > 0)
+  {
+    nReturn = (uint8_t)min(32 - __builtin_clz(nMicros), TASK_PERF_BUCKETS - 1);
+  }
+
+  return nReturn;
+}
+
+// nCount is the number of values recorded before this one
+void CTaskPerf::record(TaskPerfTiming *pTiming, uint32_t nMicros, uint32_t nCount)
+{
+  pTiming->nLastMicros = nMicros;
+  if (nMicros > pTiming->nMaxMicros)
+  {
+    pTiming->nMaxMicros = nMicros;
+  }
+
+  if (nCount == 0)
+  {
+    pTiming->fAvgMicros = nMicros;
+  }
+  else
+  {
+    pTiming->fAvgMicros = pTiming->fAvgMicros + ((float)nMicros - pTiming->fAvgMicros) / 16.0f;
+  }
+
+  pTiming->arrHistogram[getBucket(nMicros)]++;
+}
+
+void CTaskPerf::clear()
+{
+  memset(&m_period, 0, sizeof(m_period));
+  memset(&m_jitter, 0, sizeof(m_jitter));
+  memset(&m_exec, 0, sizeof(m_exec));
+  m_nLastPeriodMicros = 0;
+  m_nLoopCount = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __CTASKPERF_H__
+#define __CTASKPERF_H__
+
+#include <Hal.h>
+
+// Log2 buckets of microseconds: bucket 0 counts 0 us, bucket k counts
+// [2^(k-1), 2^k) us, the last bucket everything from 2^22 us (~4.2 s) up
+#define TASK_PERF_BUCKETS 24
+
+typedef struct TaskPerfTiming
+{
+  uint32_t nLastMicros;
+  uint32_t nMaxMicros;
+  float fAvgMicros;
+  uint32_t arrHistogram[TASK_PERF_BUCKETS];
+} TaskPerfTiming;
+
+// Loop timing for one task. The task calls loopStart() when an iteration
+// begins (after its wait) and loopEnd() when it's about to wait again:
+//   period    start to start
+//   jitter    difference between consecutive periods
+//   exec      start to end
+// Each keeps last, max, a running average (1/16 weight) and a histogram.
+//
+// Only the task itself writes, so the per loop cost is two halMicros()
+// reads and a few increments, with no lock. Readers on other tasks may
+// see a loop half recorded. reset() only raises a flag; the task clears
+// the figures at its next loopStart().
+class CTaskPerf
+{
+public:
+  CTaskPerf(const char *pszName);
+
+  void attach();
+  void loopStart();
+  void loopEnd();
+  void reset();
+
+  const char *getName();
+  HalTaskHandle getTask();
+  uint32_t getLoopCount();
+  uint32_t getStackHighWater();
+  const TaskPerfTiming *getPeriod();
+  const TaskPerfTiming *getJitter();
+  const TaskPerfTiming *getExec();
+
+  static uint8_t getBucket(uint32_t nMicros);
+
+private:
+  static void record(TaskPerfTiming *pTiming, uint32_t nMicros, uint32_t nCount);
+  void clear();
+
+  const char *m_pszName = NULL;
+  HalTaskHandle m_hTask = NULL;
+  volatile uint32_t m_nLoopCount = 0;
+  volatile bool m_bResetRequested = false;
+  uint32_t m_nStartMicros = 0;
+  uint32_t m_nLastPeriodMicros = 0;
+  TaskPerfTiming m_period = {};
+  TaskPerfTiming m_jitter = {};
+  TaskPerfTiming m_exec = {};
+};
+
+#endif // #ifndef __CTASKPERF_H__
@@ -0,0 +1,206 @@
+#include <CTelemetry.h>
+#include <CCborWriter.h>
+#include <Appendf.h>
+
+CTelemetry::CTelemetry()
+{
+}
+
+void CTelemetry::begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors)
+{
+  m_arrFanCtrl = arrFanCtrl;
+  m_nNumFans = (arrFanCtrl != NULL) ? min(nNumFans, (size_t)MAX_FANS) : 0;
+  m_pTempSensors = pTempSensors;
+  m_bHavePrevious = false;
+}
+
+void CTelemetry::sample()
+{
+  m_current.nNumFans = m_nNumFans;
+  for (size_t nIndex = 0; nIndex < m_nNumFans; nIndex++)
+  {
+    CPwmFanControl *pFanCtrl = m_arrFanCtrl[nIndex];
+    m_current.arrFanRpms[nIndex] = (pFanCtrl != NULL) ? pFanCtrl->getFanRpms() : 0;
+    m_current.arrFanDutyMilli[nIndex] = (pFanCtrl != NULL) ? lroundf(pFanCtrl->getLastDutyCyclePercent() * 1000.0f) : 0;
+  }
+
+  if (m_pTempSensors != NULL)
+  {
+    m_pTempSensors->getSnapshot(&m_current.temps);
+  }
+  else
+  {
+    memset(&m_current.temps, 0, sizeof(m_current.temps));
+  }
+
+  m_current.nGeneration = m_current.temps.nGeneration;
+}
+
+void CTelemetry::commit()
+{
+  memcpy(&m_previous, &m_current, sizeof(TelemetryValues));
+  m_bHavePrevious = true;
+}
+
+uint32_t CTelemetry::getGeneration()
+{
+  return m_current.nGeneration;
+}
+
+size_t CTelemetry::writeFull(char *pszBuf, size_t nBufLen)
+{
+  size_t nPos = 0;
+
+  appendf(pszBuf, nBufLen, nPos, "{\"gen\":%u,\"fans\":[", m_current.nGeneration);
+  for (uint8_t nIndex = 0; nIndex < m_current.nNumFans; nIndex++)
+  {
+    appendf(pszBuf, nBufLen, nPos, "%s{\"rpm\":%u,\"duty\":%.3f}",
+            (nIndex > 0) ? "," : "",
+            m_current.arrFanRpms[nIndex],
+            m_current.arrFanDutyMilli[nIndex] / 1000.0);
+  }
+
+  float fMaxTempF = (m_pTempSensors != NULL) ? CTempSensors::rawToFahrenheit(m_current.temps.fMaxRawTemp) : -999.0;
+  float fMaxTempC = (m_pTempSensors != NULL) ? CTempSensors::rawToCelsius(m_current.temps.fMaxRawTemp) : -999.0;
+  appendf(pszBuf, nBufLen, nPos, "],\"tempSensors\":{\"maxTempF\":%.3f,\"maxTempC\":%.3f,\"sensors\":[", fMaxTempF, fMaxTempC);
+  for (uint8_t nIndex = 0; nIndex < m_current.temps.nNumSensors; nIndex++)
+  {
+    appendf(pszBuf, nBufLen, nPos, "%s{\"tempF\":%.3f,\"tempC\":%.3f}",
+            (nIndex > 0) ? "," : "",
+            CTempSensors::rawToFahrenheit(m_current.temps.arrRawTemps[nIndex]),
+            CTempSensors::rawToCelsius(m_current.temps.arrRawTemps[nIndex]));
+  }
+  appendf(pszBuf, nBufLen, nPos, "]}}");
+
+  // Report truncation as nothing written rather than as broken JSON
+  return (nPos < nBufLen) ? nPos : 0;
+}
+
+// Returns 0 if the frame doesn't fit
+size_t CTelemetry::writeCbor(uint8_t *pBuf, size_t nBufLen)
+{
+  CCborWriter writer(pBuf, nBufLen);
+
+  writer.beginArray(5);
+  writer.writeUnsigned(TELEMETRY_CBOR_VERSION);
+  writer.writeUnsigned(m_current.nGeneration);
+
+  writer.beginArray(m_current.nNumFans);
+  for (uint8_t nIndex = 0; nIndex < m_current.nNumFans; nIndex++)
+  {
+    writer.beginArray(2);
+    writer.writeUnsigned(m_current.arrFanRpms[nIndex]);
+    writer.writeInt(m_current.arrFanDutyMilli[nIndex]);
+  }
+
+  writer.writeInt(lroundf(m_current.temps.fMaxRawTemp));
+
+  writer.beginArray(m_current.temps.nNumSensors);
+  for (uint8_t nIndex = 0; nIndex < m_current.temps.nNumSensors; nIndex++)
+  {
+    writer.writeInt(lroundf(m_current.temps.arrRawTemps[nIndex]));
+  }
+
+  return writer.getLength();
+}
+
+// Returns 0 if nothing changed since the last commit(). Falls back to a
+// full frame if there is nothing to diff against.
+size_t CTelemetry::writeDelta(char *pszBuf, size_t nBufLen)
+{
+  size_t nReturn = 0;
+
+  if (!m_bHavePrevious ||
+      (m_current.nNumFans != m_previous.nNumFans) ||
+      (m_current.temps.nNumSensors != m_previous.temps.nNumSensors))
+  {
+    nReturn = writeFull(pszBuf, nBufLen);
+  }
+  else
+  {
+    nReturn = writeChanges(pszBuf, nBufLen);
+  }
+
+  return nReturn;
+}
+
+size_t CTelemetry::writeChanges(char *pszBuf, size_t nBufLen)
+{
+  size_t nPos = 0;
+  bool bChanged = false;
+
+  appendf(pszBuf, nBufLen, nPos, "{\"gen\":%u", m_current.nGeneration);
+
+  bool bFirst = true;
+  for (uint8_t nIndex = 0; nIndex < m_current.nNumFans; nIndex++)
+  {
+    bool bRpm = (m_current.arrFanRpms[nIndex] != m_previous.arrFanRpms[nIndex]);
+    bool bDuty = (m_current.arrFanDutyMilli[nIndex] != m_previous.arrFanDutyMilli[nIndex]);
+    if (bRpm || bDuty)
+    {
+      appendf(pszBuf, nBufLen, nPos, "%s\"%u\":{", bFirst ? ",\"fans\":{" : ",", nIndex);
+      if (bRpm)
+      {
+        appendf(pszBuf, nBufLen, nPos, "\"rpm\":%u", m_current.arrFanRpms[nIndex]);
+      }
+      if (bDuty)
+      {
+        appendf(pszBuf, nBufLen, nPos, "%s\"duty\":%.3f", bRpm ? "," : "", m_current.arrFanDutyMilli[nIndex] / 1000.0);
+      }
+      appendf(pszBuf, nBufLen, nPos, "}");
+      bFirst = false;
+      bChanged = true;
+    }
+  }
+  if (!bFirst)
+  {
+    appendf(pszBuf, nBufLen, nPos, "}");
+  }
+
+  bFirst = true;
+  if (m_current.temps.fMaxRawTemp != m_previous.temps.fMaxRawTemp)
+  {
+    appendf(pszBuf, nBufLen, nPos, ",\"tempSensors\":{\"maxTempF\":%.3f,\"maxTempC\":%.3f",
+            CTempSensors::rawToFahrenheit(m_current.temps.fMaxRawTemp),
+            CTempSensors::rawToCelsius(m_current.temps.fMaxRawTemp));
+    bFirst = false;
+    bChanged = true;
+  }
+
+  bool bFirstSensor = true;
+  for (uint8_t nIndex = 0; nIndex < m_current.temps.nNumSensors; nIndex++)
+  {
+    if (m_current.temps.arrRawTemps[nIndex] != m_previous.temps.arrRawTemps[nIndex])
+    {
+      if (bFirst)
+      {
+        appendf(pszBuf, nBufLen, nPos, ",\"tempSensors\":{");
+        bFirst = false;
+      }
+      else if (bFirstSensor)
+      {
+        appendf(pszBuf, nBufLen, nPos, ",");
+      }
+
+      appendf(pszBuf, nBufLen, nPos, "%s\"%u\":{\"tempF\":%.3f,\"tempC\":%.3f}",
+              bFirstSensor ? "\"sensors\":{" : ",",
+              nIndex,
+              CTempSensors::rawToFahrenheit(m_current.temps.arrRawTemps[nIndex]),
+              CTempSensors::rawToCelsius(m_current.temps.arrRawTemps[nIndex]));
+      bFirstSensor = false;
+      bChanged = true;
+    }
+  }
+  if (!bFirstSensor)
+  {
+    appendf(pszBuf, nBufLen, nPos, "}");
+  }
+  if (!bFirst)
+  {
+    appendf(pszBuf, nBufLen, nPos, "}");
+  }
+
+  appendf(pszBuf, nBufLen, nPos, "}");
+
+  return (bChanged && (nPos < nBufLen)) ? nPos : 0;
+}
@@ -0,0 +1,61 @@
+#ifndef __CTELEMETRY_H__
+#define __CTELEMETRY_H__
+
+#include <Hal.h>
+#include <CPwmFanControl.h>
+#include <CTempSensors.h>
+#include <FanSettings.h>
+
+// Captures fan and temperature values once per sample generation and
+// serializes them as JSON frames without any heap allocation.
+//
+// Full frames use the /status schema plus the generation:
+//   {"gen":N,"fans":[{"rpm":R,"duty":D},...],
+//    "tempSensors":{"maxTempF":F,"maxTempC":C,"sensors":[{"tempF":F,"tempC":C},...]}}
+//
+// Delta frames carry only what changed since the last commit(), keyed by
+// fan / sensor index:
+//   {"gen":N,"fans":{"1":{"rpm":R}},"tempSensors":{"maxTempF":F,"sensors":{"0":{"tempF":F,"tempC":C}}}}
+//
+// CBOR frames carry the full frame with a fixed positional schema and no
+// floats. Temperatures stay in CTempBus raw units (1/128 C):
+//   [TELEMETRY_CBOR_VERSION, gen, [[rpm, dutyMilliPercent], ...], maxTempRaw, [tempRaw, ...]]
+#define TELEMETRY_CBOR_VERSION 1
+
+class CTelemetry
+{
+public:
+  CTelemetry();
+
+  void begin(CPwmFanControl **arrFanCtrl, size_t nNumFans, CTempSensors *pTempSensors);
+
+  void sample();
+  void commit();
+
+  size_t writeFull(char *pszBuf, size_t nBufLen);
+  size_t writeDelta(char *pszBuf, size_t nBufLen);
+  size_t writeCbor(uint8_t *pBuf, size_t nBufLen);
+
+  uint32_t getGeneration();
+
+private:
+  typedef struct TelemetryValues
+  {
+    uint32_t nGeneration;
+    uint8_t nNumFans;
+    uint32_t arrFanRpms[MAX_FANS];
+    int32_t arrFanDutyMilli[MAX_FANS]; // duty percent x 1000
+    TempSnapshot temps;
+  } TelemetryValues;
+
+  size_t writeChanges(char *pszBuf, size_t nBufLen);
+
+  CPwmFanControl **m_arrFanCtrl = NULL;
+  size_t m_nNumFans = 0;
+  CTempSensors *m_pTempSensors = NULL;
+  TelemetryValues m_current = {};
+  TelemetryValues m_previous = {};
+  bool m_bHavePrevious = false;
+};
+
+#endif // #ifndef __CTELEMETRY_H__
@@ -0,0 +1,257 @@
+#include <CTelnetLog.h>
+#include <lwip/sockets.h>
+
+// How long the drain task sleeps once every client is caught up or can't
+// take more. Lines written in the meantime go out together.
+#define TELNET_LOG_POLL_MS 20
+
+CTelnetLog::CTelnetLog(uint16_t nPort /* = 23*/)
+    : m_server(nPort)
+{
+  for (uint8_t nIndex = 0; nIndex < TELNET_LOG_MAX_CLIENTS; nIndex++)
+  {
+    m_arrClients[nIndex].bActive = false;
+    m_arrClients[nIndex].nTail = 0;
+  }
+}
+
+void CTelnetLog::begin(const BaseType_t nCore /* = 0*/, const UBaseType_t nPriority /* = 1*/, const uint32_t nStackSize /* = 4096*/)
+{
+  m_server.begin();
+  m_server.setNoDelay(true);
+
+  xTaskCreatePinnedToCore(
+      CTelnetLog::taskTelnetLog, // Function that should be called
+      "taskTelnetLog",           // Name of the task (for debugging)
+      nStackSize,                // Stack size (bytes)
+      this,                      // Parameter to pass
+      nPriority,                 // Task priority
+      &m_hTask,                  // Task handle
+      nCore                      // Core you want to run the task on (0 or 1)
+  );
+}
+
+// Disconnects every client; the drain task does the work
+void CTelnetLog::stop()
+{
+  m_bStopRequested = true;
+}
+
+size_t CTelnetLog::write(uint8_t nValue)
+{
+  return write(&nValue, 1);
+}
+
+size_t CTelnetLog::write(const uint8_t *pBuf, size_t nLen)
+{
+  size_t nReturn = nLen;
+
+  if ((pBuf != NULL) && (nLen > 0))
+  {
+    // Only the tail of an oversized write could survive in the ring anyway
+    if (nLen > TELNET_LOG_BUFFER)
+    {
+      pBuf += nLen - TELNET_LOG_BUFFER;
+      nLen = TELNET_LOG_BUFFER;
+    }
+
+    // The spinlock masks interrupts on this core, so it's only ever held
+    // for one piece
+    while (nLen > 0)
+    {
+      size_t nPiece = min(nLen, (size_t)TELNET_LOG_WRITE_CHUNK);
+
+      portENTER_CRITICAL(&m_muxWrite);
+
+      uint32_t nPos = m_nCommitted;
+      size_t nIndex = nPos & (TELNET_LOG_BUFFER - 1);
+      size_t nFirst = min(nPiece, (size_t)(TELNET_LOG_BUFFER - nIndex));
+
+      // Readers check the reserved position after copying out, so it has to
+      // move before the bytes it covers are overwritten
+      m_nReserved = nPos + nPiece;
+      __sync_synchronize();
+
+      memcpy(m_arrRing + nIndex, pBuf, nFirst);
+      memcpy(m_arrRing, pBuf + nFirst, nPiece - nFirst);
+
+      __sync_synchronize();
+      m_nCommitted = nPos + nPiece;
+
+      portEXIT_CRITICAL(&m_muxWrite);
+
+      pBuf += nPiece;
+      nLen -= nPiece;
+    }
+  }
+
+  return nReturn;
+}
+
+void CTelnetLog::taskTelnetLog(void *pvParam)
+{
+  CTelnetLog *pThis = (CTelnetLog *)pvParam;
+
+  for (;;)
+  {
+    pThis->acceptClients();
+
+    bool bMore = false;
+    for (uint8_t nIndex = 0; nIndex < TELNET_LOG_MAX_CLIENTS; nIndex++)
+    {
+      if (pThis->m_arrClients[nIndex].bActive)
+      {
+        bMore = pThis->drainClient(&pThis->m_arrClients[nIndex]) || bMore;
+      }
+    }
+
+    // Keep going while a whole chunk went out and more is waiting
+    if (!bMore)
+    {
+      vTaskDelay(TELNET_LOG_POLL_MS / portTICK_PERIOD_MS);
+    }
+  }
+
+  vTaskDelete(NULL);
+}
+
+// Takes new connections and retires closed ones. New clients start at the
+// oldest byte still in the ring.
+void CTelnetLog::acceptClients()
+{
+  for (uint8_t nIndex = 0; nIndex < TELNET_LOG_MAX_CLIENTS; nIndex++)
+  {
+    TelnetLogClient *pClient = &m_arrClients[nIndex];
+    if (pClient->bActive && (m_bStopRequested || !pClient->client.connected()))
+    {
+      pClient->client.stop();
+      pClient->bActive = false;
+      m_nNumClients--;
+    }
+  }
+  m_bStopRequested = false;
+
+  while (m_server.hasClient())
+  {
+    WiFiClient client = m_server.available();
+
+    TelnetLogClient *pFree = NULL;
+    for (uint8_t nIndex = 0; (nIndex < TELNET_LOG_MAX_CLIENTS) && (pFree == NULL); nIndex++)
+    {
+      if (!m_arrClients[nIndex].bActive)
+      {
+        pFree = &m_arrClients[nIndex];
+      }
+    }
+
+    if (pFree == NULL)
+    {
+      client.stop();
+    }
+    else
+    {
+      uint32_t nCommitted = m_nCommitted;
+      pFree->client = client;
+      pFree->client.setNoDelay(true);
+      pFree->nTail = nCommitted - min(nCommitted, (uint32_t)TELNET_LOG_BUFFER);
+      pFree->bActive = true;
+      m_nNumClients++;
+    }
+  }
+}
+
+// Sends up to one chunk from the client's position without waiting on the
+// socket. Returns true if a full chunk went out and more is waiting.
+bool CTelnetLog::drainClient(TelnetLogClient *pClient)
+{
+  bool bReturn = false;
+
+  uint32_t nCommitted = m_nCommitted;
+  __sync_synchronize();
+
+  // Fell a whole ring behind; skip to the oldest byte still held
+  uint32_t nTail = pClient->nTail;
+  if (nCommitted - nTail > TELNET_LOG_BUFFER)
+  {
+    m_nDroppedBytes += nCommitted - TELNET_LOG_BUFFER - nTail;
+    nTail = nCommitted - TELNET_LOG_BUFFER;
+  }
+
+  size_t nLen = min((size_t)(nCommitted - nTail), (size_t)TELNET_LOG_CHUNK);
+  if (nLen > 0)
+  {
+    copyOut(nTail, m_arrChunk, nLen);
+    __sync_synchronize();
+
+    // A writer may have started overwriting the front of what was copied
+    uint32_t nReserved = m_nReserved;
+    size_t nLost = 0;
+    if (nReserved - nTail > TELNET_LOG_BUFFER)
+    {
+      nLost = min((size_t)(nReserved - TELNET_LOG_BUFFER - nTail), nLen);
+      m_nDroppedBytes += nLost;
+      nTail += nLost;
+    }
+
+    if (nLost < nLen)
+    {
+      int nSent = send(pClient->client.fd(), m_arrChunk + nLost, nLen - nLost, MSG_DONTWAIT);
+      if (nSent > 0)
+      {
+        nTail += nSent;
+        m_nBytesSent += nSent;
+        bReturn = ((size_t)nSent == nLen - nLost) && (nTail != nCommitted);
+      }
+      else if ((nSent < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+      {
+        pClient->client.stop();
+        pClient->bActive = false;
+        m_nNumClients--;
+      }
+    }
+    else
+    {
+      bReturn = true;
+    }
+  }
+
+  pClient->nTail = nTail;
+
+  return bReturn;
+}
+
+size_t CTelnetLog::copyOut(uint32_t nPos, uint8_t *pBuf, size_t nLen)
+{
+  size_t nIndex = nPos & (TELNET_LOG_BUFFER - 1);
+  size_t nFirst = min(nLen, (size_t)(TELNET_LOG_BUFFER - nIndex));
+
+  memcpy(pBuf, m_arrRing + nIndex, nFirst);
+  memcpy(pBuf + nFirst, m_arrRing, nLen - nFirst);
+
+  return nLen;
+}
+
+uint8_t CTelnetLog::getNumClients()
+{
+  return m_nNumClients;
+}
+
+// Everything written, whether or not anyone was connected
+uint32_t CTelnetLog::getBytesWritten()
+{
+  return m_nCommitted;
+}
+
+// Summed over clients
+uint32_t CTelnetLog::getBytesSent()
+{
+  return m_nBytesSent;
+}
+
+// Bytes a connected client never got because it fell a ring behind
+uint32_t CTelnetLog::getDroppedBytes()
+{
+  return m_nDroppedBytes;
+}
+
+CTelnetLog TelnetLog(23);
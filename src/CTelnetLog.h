@@ -0,0 +1,79 @@
+#ifndef __CTELNETLOG_H__
+#define __CTELNETLOG_H__
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define TELNET_LOG_BUFFER 4096 // power of 2
+#define TELNET_LOG_CHUNK 1436  // one TCP segment at the default MSS
+#define TELNET_LOG_MAX_CLIENTS 4
+#define TELNET_LOG_WRITE_CHUNK 256 // most bytes copied per critical section
+
+// Log output for any number of telnet clients that never blocks the
+// writer. write() copies into a ring buffer and returns; a background task
+// drains the ring to each client in segment sized sends that never wait on
+// the socket.
+//
+// The ring keeps the newest TELNET_LOG_BUFFER bytes. Each client has its
+// own read position, so a slow client loses its oldest bytes (counted in
+// getDroppedBytes()) without holding back the others, and a new client
+// starts with whatever the ring still holds.
+//
+// The drain task takes no lock. Writers copy in TELNET_LOG_WRITE_CHUNK
+// byte pieces, each under a spinlock that serializes concurrent writers,
+// so interrupts are never held off for more than one piece. Each piece
+// bumps a reserved position before copying and the committed one after;
+// the drain task copies out, then discards anything the reserved position
+// shows may have been overwritten meanwhile. A write longer than a piece
+// may interleave with another task's at piece boundaries. Not for use
+// from ISRs.
+class CTelnetLog : public Print
+{
+public:
+  CTelnetLog(uint16_t nPort = 23);
+
+  void begin(const BaseType_t nCore = 0, const UBaseType_t nPriority = 1, const uint32_t nStackSize = 4096);
+  void stop();
+
+  size_t write(uint8_t nValue);
+  size_t write(const uint8_t *pBuf, size_t nLen);
+  using Print::write;
+
+  uint8_t getNumClients();
+  uint32_t getBytesWritten();
+  uint32_t getBytesSent();
+  uint32_t getDroppedBytes();
+
+private:
+  typedef struct TelnetLogClient
+  {
+    WiFiClient client;
+    bool bActive;
+    uint32_t nTail;
+  } TelnetLogClient;
+
+  static void taskTelnetLog(void *pvParam);
+  void acceptClients();
+  bool drainClient(TelnetLogClient *pClient);
+  size_t copyOut(uint32_t nPos, uint8_t *pBuf, size_t nLen);
+
+  WiFiServer m_server;
+  TaskHandle_t m_hTask = NULL;
+  TelnetLogClient m_arrClients[TELNET_LOG_MAX_CLIENTS];
+  volatile uint8_t m_nNumClients = 0;
+  volatile bool m_bStopRequested = false;
+  uint8_t m_arrChunk[TELNET_LOG_CHUNK] = {};
+
+  // Positions count every byte ever written; the ring index is the low bits
+  uint8_t m_arrRing[TELNET_LOG_BUFFER] = {};
+  volatile uint32_t m_nReserved = 0;
+  volatile uint32_t m_nCommitted = 0;
+  portMUX_TYPE m_muxWrite = portMUX_INITIALIZER_UNLOCKED;
+
+  volatile uint32_t m_nBytesSent = 0;
+  volatile uint32_t m_nDroppedBytes = 0;
+};
+
+extern CTelnetLog TelnetLog;
+
+#endif // #ifndef __CTELNETLOG_H__
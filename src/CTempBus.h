@@ -0,0 +1,62 @@
+#ifndef __CTEMPBUS_H__
+#define __CTEMPBUS_H__
+
+#include <stdint.h>
+
+// Same as DallasTemperature's, so both headers can be included together
+typedef uint8_t DeviceAddress[8];
+
+// Raw reading of a sensor that didn't answer (-127 C)
+#define TEMP_BUS_DISCONNECTED_RAW -7040
+
+typedef struct TempBusTiming
+{
+  uint32_t nCount;
+  uint32_t nLastMicros;
+  uint32_t nMaxMicros;
+  float fAvgMicros;
+} TempBusTiming;
+
+// Transaction times and failures on a bus. Convert is a conversion request,
+// read a scratchpad read. A CRC error is a read rejected while a sensor
+// still answered reset; no presence is a read nothing answered.
+typedef struct TempBusStats
+{
+  TempBusTiming convert;
+  TempBusTiming read;
+  uint32_t nCrcErrors;
+  uint32_t nNoPresence;
+} TempBusStats;
+
+// Bus of DS18B20 style temperature sensors. Temperatures are raw units of
+// 1/128 C. Kept free of Arduino/OneWire includes so a simulated bus can
+// stand in for the hardware.
+class CTempBus
+{
+public:
+  virtual ~CTempBus() {}
+
+  virtual bool begin() = 0;
+
+  // Finds up to nMaxAddresses supported sensors, returns how many
+  virtual uint8_t discover(DeviceAddress *arrAddresses, const uint8_t nMaxAddresses) = 0;
+
+  virtual bool setResolution(const uint8_t *pAddress, const uint8_t nBits) = 0;
+  virtual uint32_t getConversionTimeMs(const uint8_t nBits) = 0;
+
+  // With wait on, requesting returns once the conversion is done; with it
+  // off, the caller waits getConversionTimeMs() before reading
+  virtual void setWaitForConversion(const bool bWait) = 0;
+  virtual void requestTemperatures() = 0;
+  virtual void requestTemperature(const uint8_t *pAddress) = 0;
+
+  virtual int32_t getTempRaw(const uint8_t *pAddress) = 0;
+
+  // Parasite powered sensors hold the bus while converting
+  virtual bool isParasitePowered() = 0;
+
+  // Fills pStats and returns true if the bus keeps statistics
+  virtual bool getStats(TempBusStats *) { return false; }
+};
+
+#endif // #ifndef __CTEMPBUS_H__
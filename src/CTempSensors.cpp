@@ -1,28 +1,20 @@
 #include <CTempSensors.h>
 
-CTempSensors::CTempSensors(OneWire *pOneWire, Resolution resolution /*=MEDIUM_RES*/, uint8_t nMaxSensors /* =4 */)
-    : m_sensors(pOneWire)
+CTempSensors::CTempSensors(CTempBus *pBus, Resolution resolution /*=MEDIUM_RES*/, uint8_t nMaxSensors /* =4 */)
 {
-  m_pOneWire = pOneWire;
+  m_pBus = pBus;
   m_resolution = resolution;
+  m_nMaxSensors = min(nMaxSensors, (uint8_t)TEMP_SENSORS_MAX);
 
-  m_arrRawTemps = new float[nMaxSensors];
-  memset(m_arrRawTemps, 0, sizeof(float[m_nMaxSensors]));
-
-  m_arrSensorAddresses = new DeviceAddress[nMaxSensors];
-  memset(m_arrRawTemps, 0, sizeof(DeviceAddress[m_nMaxSensors]));
+  m_arrSensorAddresses = new DeviceAddress[m_nMaxSensors];
+  memset(m_arrSensorAddresses, 0, sizeof(DeviceAddress[m_nMaxSensors]));
 }
 
 CTempSensors::~CTempSensors()
 {
-  if (m_arrRawTemps != NULL)
-  {
-    delete m_arrRawTemps;
-  }
-
   if (m_arrSensorAddresses != NULL)
   {
-    delete m_arrSensorAddresses;
+    delete[] m_arrSensorAddresses;
   }
 }
 
@@ -32,10 +24,31 @@ void CTempSensors::begin()
 
   for (int nIndex = 0; nIndex < m_nNumSensors; nIndex++)
   {
-    m_sensors.setResolution(m_arrSensorAddresses[nIndex], m_resolution, true);
+    m_pBus->setResolution(m_arrSensorAddresses[nIndex], m_resolution);
   }
 
-  m_sensors.begin();
+  m_pBus->begin();
+  m_pBus->setWaitForConversion(!m_bAsync);
+
+  m_nConversionMs = m_pBus->getConversionTimeMs(m_resolution);
+  m_bConversionPending = false;
+}
+
+void CTempSensors::setAsyncConversion(bool bAsync)
+{
+  m_bAsync = bAsync;
+  m_bConversionPending = false;
+  m_pBus->setWaitForConversion(!m_bAsync);
+}
+
+bool CTempSensors::isAsyncConversion()
+{
+  return m_bAsync;
+}
+
+uint32_t CTempSensors::getConversionTimeMs()
+{
+  return m_nConversionMs;
 }
 
 char *CTempSensors::addressToString(DeviceAddress deviceAddress, char *pszBuf24, size_t nBufLen /* = 24*/)
@@ -58,6 +71,18 @@ char *CTempSensors::addressToString(DeviceAddress deviceAddress, char *pszBuf24,
   return pszBuf24;
 }
 
+// Same conversions as DallasTemperature's, including a disconnected
+// sensor reading as -127 C
+float CTempSensors::rawToCelsius(float fRawTemp)
+{
+  return (fRawTemp <= TEMP_BUS_DISCONNECTED_RAW) ? -127.0f : (fRawTemp * 0.0078125f);
+}
+
+float CTempSensors::rawToFahrenheit(float fRawTemp)
+{
+  return (fRawTemp <= TEMP_BUS_DISCONNECTED_RAW) ? -196.6f : ((fRawTemp * 0.0140625f) + 32.0f);
+}
+
 DeviceAddress *CTempSensors::getSensorAddresses()
 {
   return m_arrSensorAddresses;
@@ -73,59 +98,225 @@ void CTempSensors::discoverSensorAddresses()
 
   memset(m_arrSensorAddresses, 0, sizeof(DeviceAddress[m_nMaxSensors]));
 
-  DeviceAddress deviceAddress = {};
+  m_nNumSensors = m_pBus->discover(m_arrSensorAddresses, m_nMaxSensors);
+}
+
+float CTempSensors::readSensor(uint8_t nIndex)
+{
+  float fReturn = -999.0;
+
+  if ((nIndex >= 0) && (nIndex < m_nNumSensors))
+  {
+    const uint8_t *pAddr = m_arrSensorAddresses[nIndex];
+    m_pBus->requestTemperature(pAddr);
+    fReturn = m_pBus->getTempRaw(pAddr);
+  }
+
+  return fReturn;
+}
 
-  memset(deviceAddress, 0, sizeof(deviceAddress));
-  m_pOneWire->reset_search();
-  m_pOneWire->search(deviceAddress);
-  m_pOneWire->reset_search();
+// Returns the number of ms until the next call to update() can publish new
+// temperatures. Always 0 in blocking mode, since the conversion has already
+// completed by the time update() returns.
+uint32_t CTempSensors::update()
+{
+  uint32_t nReturn = 0;
 
-  while (m_nNumSensors < m_nMaxSensors && m_pOneWire->search(deviceAddress))
+  if (!m_bAsync)
   {
-    if (m_sensors.validAddress(deviceAddress))
+    m_pBus->requestTemperatures();
+    readScratchpads();
+  }
+  else if (!m_bConversionPending)
+  {
+    startConversion();
+    nReturn = m_nConversionMs;
+  }
+  else
+  {
+    uint32_t nElapsedMs = halMillis() - m_nConversionStartMs;
+    if (nElapsedMs < m_nConversionMs)
     {
-      if (m_sensors.validFamily(deviceAddress))
+      nReturn = m_nConversionMs - nElapsedMs;
+    }
+    else
+    {
+      if (m_pBus->isParasitePowered())
+      {
+        // Parasite powered sensors hold the bus during conversion, so the
+        // scratchpads have to be read before the next conversion starts
+        readScratchpads();
+        startConversion();
+      }
+      else
       {
-        memcpy(m_arrSensorAddresses[m_nNumSensors++], deviceAddress, sizeof(deviceAddress));
+        // The temperature register is only overwritten at the end of a
+        // conversion, so the next conversion can run while we read the
+        // results of the previous one
+        startConversion();
+        readScratchpads();
       }
+
+      nElapsedMs = halMillis() - m_nConversionStartMs;
+      nReturn = (nElapsedMs < m_nConversionMs) ? (m_nConversionMs - nElapsedMs) : 0;
+    }
+  }
+
+  return nReturn;
+}
+
+void CTempSensors::startConversion()
+{
+  m_pBus->requestTemperatures();
+  m_nConversionStartMs = halMillis();
+  m_bConversionPending = true;
+}
+
+// Reads every sensor into the unpublished buffer, then publishes it. All
+// of the bus I/O happens before publication, outside of any lock.
+void CTempSensors::readScratchpads()
+{
+  uint32_t nPublished = m_nPublished;
+  TempSnapshot *pNext = &m_arrSnapshots[(nPublished & 1) ^ 1];
+
+  pNext->nNumSensors = m_nNumSensors;
+  pNext->fMaxRawTemp = 0.0;
+  for (int nIndex = 0; nIndex < m_nNumSensors; nIndex++)
+  {
+    pNext->arrRawTemps[nIndex] = m_pBus->getTempRaw(m_arrSensorAddresses[nIndex]);
+
+    if (pNext->arrRawTemps[nIndex] > pNext->fMaxRawTemp)
+    {
+      pNext->fMaxRawTemp = pNext->arrRawTemps[nIndex];
     }
+  }
+
+  countSample();
+  publishSample();
+}
+
+// Stamps the filled buffer, makes it the published one and wakes every
+// task waiting on new samples
+void CTempSensors::publishSample()
+{
+  uint32_t nPublished = m_nPublished;
+  uint8_t nNext = (nPublished & 1) ^ 1;
+  TempSnapshot *pNext = &m_arrSnapshots[nNext];
 
-    memset(deviceAddress, 0, sizeof(deviceAddress));
+  pNext->nGeneration = (nPublished >> 1) + 1;
+  pNext->nTimestampMs = halMillis();
+  pNext->nTimestampMicros = halMicros();
+
+  // The buffer contents have to land before the word that publishes them
+  __sync_synchronize();
+  m_nPublished = (pNext->nGeneration << 1) | nNext;
+
+  for (uint8_t nIndex = 0; nIndex < m_nNumSampleListeners; nIndex++)
+  {
+    halTaskNotifyGive(m_arrSampleListeners[nIndex]);
   }
 }
 
-float CTempSensors::readSensor(uint8_t nIndex)
+// Readers copy what they need from the returned buffer, then call
+// endRead() and retry if it returns false. The writer only fills the
+// unpublished buffer, so a copy can only tear if two samples are published
+// during it, and then the published word has changed.
+const TempSnapshot *CTempSensors::beginRead(uint32_t *pnPublished)
 {
-  float fReturn = -999.0;
+  *pnPublished = m_nPublished;
+  __sync_synchronize();
 
-  if ((nIndex >= 0) && (nIndex < m_nNumSensors))
+  return &m_arrSnapshots[*pnPublished & 1];
+}
+
+bool CTempSensors::endRead(uint32_t nPublished)
+{
+  __sync_synchronize();
+
+  return (m_nPublished == nPublished);
+}
+
+void CTempSensors::getSnapshot(TempSnapshot *pSnapshot)
+{
+  if (pSnapshot != NULL)
   {
-    const uint8_t *pAddr = m_arrSensorAddresses[nIndex];
-    m_sensors.requestTemperaturesByAddress(pAddr);
-    fReturn = m_sensors.getTemp(pAddr);
+    uint32_t nPublished = 0;
+
+    do
+    {
+      *pSnapshot = *beginRead(&nPublished);
+    } while (!endRead(nPublished));
   }
+}
 
-  return fReturn;
+// Registers a task to receive a task notification each time update()
+// publishes new temperatures. Wait with halTaskNotifyTake().
+bool CTempSensors::addSampleListener(HalTaskHandle hTask)
+{
+  bool bReturn = false;
+
+  if ((hTask != NULL) && (m_nNumSampleListeners < MAX_SAMPLE_LISTENERS))
+  {
+    m_arrSampleListeners[m_nNumSampleListeners++] = hTask;
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+uint32_t CTempSensors::getGeneration()
+{
+  return m_nPublished >> 1;
+}
+
+uint32_t CTempSensors::getLastSampleMicros()
+{
+  uint32_t nPublished = 0;
+  uint32_t nReturn = 0;
+
+  do
+  {
+    nReturn = beginRead(&nPublished)->nTimestampMicros;
+  } while (!endRead(nPublished));
+
+  return nReturn;
 }
 
-void CTempSensors::update()
+void CTempSensors::countSample()
 {
-  m_sensors.requestTemperatures();
+  uint32_t nNowMs = halMillis();
 
-  portENTER_CRITICAL(&m_muxTempData);
+  if (m_nSampleCount > 0)
   {
-    m_fMaxRawTemp = 0.0;
-    for (int nIndex = 0; nIndex < m_nNumSensors; nIndex++)
+    uint32_t nIntervalMs = nNowMs - m_nLastSampleMs;
+    if (nIntervalMs > 0)
     {
-      m_arrRawTemps[nIndex] = m_sensors.getTemp(m_arrSensorAddresses[nIndex]);
+      float fSamplesPerSec = 1000.0 / (float)nIntervalMs;
 
-      if (m_arrRawTemps[nIndex] > m_fMaxRawTemp)
+      // Exponential moving average, 1/8 weight for the newest interval
+      if (m_nSampleCount == 1)
       {
-        m_fMaxRawTemp = m_arrRawTemps[nIndex];
+        m_fSamplesPerSec = fSamplesPerSec;
+      }
+      else
+      {
+        m_fSamplesPerSec = m_fSamplesPerSec + (fSamplesPerSec - m_fSamplesPerSec) / 8.0;
       }
     }
   }
-  portEXIT_CRITICAL(&m_muxTempData);
+
+  m_nLastSampleMs = nNowMs;
+  m_nSampleCount++;
+}
+
+float CTempSensors::getSamplesPerSec()
+{
+  return m_fSamplesPerSec;
+}
+
+uint32_t CTempSensors::getSampleCount()
+{
+  return m_nSampleCount;
 }
 
 float CTempSensors::getTempRaw(uint8_t nIndex)
@@ -134,11 +325,12 @@ float CTempSensors::getTempRaw(uint8_t nIndex)
 
   if ((nIndex >= 0) && (nIndex < m_nNumSensors))
   {
-    portENTER_CRITICAL(&m_muxTempData);
+    uint32_t nPublished = 0;
+
+    do
     {
-      fReturn = m_arrRawTemps[nIndex];
-    }
-    portEXIT_CRITICAL(&m_muxTempData);
+      fReturn = beginRead(&nPublished)->arrRawTemps[nIndex];
+    } while (!endRead(nPublished));
   }
 
   return fReturn;
@@ -146,23 +338,27 @@ float CTempSensors::getTempRaw(uint8_t nIndex)
 
 float CTempSensors::getTempF(uint8_t nIndex)
 {
-  return m_sensors.rawToFahrenheit(getTempRaw(nIndex));
+  return rawToFahrenheit(getTempRaw(nIndex));
 }
 
 float CTempSensors::getTempC(uint8_t nIndex)
 {
-  return m_sensors.rawToCelsius(getTempRaw(nIndex));
+  return rawToCelsius(getTempRaw(nIndex));
 }
 
 float CTempSensors::getMaxTempF()
 {
   float fReturn = -999.9;
 
-  portENTER_CRITICAL(&m_muxTempData);
+  uint32_t nPublished = 0;
+  float fMaxRawTemp = 0.0;
+
+  do
   {
-    fReturn = m_sensors.rawToFahrenheit(m_fMaxRawTemp);
-  }
-  portEXIT_CRITICAL(&m_muxTempData);
+    fMaxRawTemp = beginRead(&nPublished)->fMaxRawTemp;
+  } while (!endRead(nPublished));
+
+  fReturn = rawToFahrenheit(fMaxRawTemp);
 
   return fReturn;
 }
@@ -171,11 +367,15 @@ float CTempSensors::getMaxTempC()
 {
   float fReturn = -999.9;
 
-  portENTER_CRITICAL(&m_muxTempData);
+  uint32_t nPublished = 0;
+  float fMaxRawTemp = 0.0;
+
+  do
   {
-    fReturn = m_sensors.rawToCelsius(m_fMaxRawTemp);
-  }
-  portEXIT_CRITICAL(&m_muxTempData);
+    fMaxRawTemp = beginRead(&nPublished)->fMaxRawTemp;
+  } while (!endRead(nPublished));
+
+  fReturn = rawToCelsius(fMaxRawTemp);
 
   return fReturn;
 }
@@ -1,8 +1,8 @@
 #ifndef __CTEMPSENSORS_H__
 #define __CTEMPSENSORS_H__
 
-#include <Arduino.h>
-#include <DallasTemperature.h>
+#include <Hal.h>
+#include <CTempBus.h>
 
 enum Resolution
 {
@@ -12,15 +12,42 @@ enum Resolution
   HIGH_RES = 12
 };
 
+#define TEMP_SENSORS_MAX 8
+
+// One published set of readings. Raw values are CTempBus raw units
+// (1/128 C); nGeneration increments with every published sample.
+typedef struct TempSnapshot
+{
+  uint32_t nGeneration;
+  uint32_t nTimestampMs;
+  uint32_t nTimestampMicros;
+  uint8_t nNumSensors;
+  float fMaxRawTemp;
+  float arrRawTemps[TEMP_SENSORS_MAX];
+} TempSnapshot;
+
 class CTempSensors
 {
 public:
-  CTempSensors(OneWire *pOneWire, Resolution resolution = MEDIUM_RES, uint8_t nMaxSensors = 4);
+  CTempSensors(CTempBus *pBus, Resolution resolution = MEDIUM_RES, uint8_t nMaxSensors = 4);
   ~CTempSensors();
 
   void begin();
   float readSensor(uint8_t nIndex);
-  void update();
+  uint32_t update();
+
+  void setAsyncConversion(bool bAsync);
+  bool isAsyncConversion();
+  uint32_t getConversionTimeMs();
+  float getSamplesPerSec();
+  uint32_t getSampleCount();
+
+  bool addSampleListener(HalTaskHandle hTask);
+  uint32_t getGeneration();
+  uint32_t getLastSampleMicros();
+  void getSnapshot(TempSnapshot *pSnapshot);
+
+  static const uint8_t MAX_SAMPLE_LISTENERS = 4;
 
   uint8_t getNumSensors();
   float getTempRaw(uint8_t nIndex);
@@ -32,18 +59,38 @@ public:
   DeviceAddress *getSensorAddresses();
   static char *addressToString(DeviceAddress deviceAddress, char *pszBuf24, size_t nBufLen = 24);
 
+  static float rawToCelsius(float fRawTemp);
+  static float rawToFahrenheit(float fRawTemp);
+
 private:
   void discoverSensorAddresses();
+  void startConversion();
+  void readScratchpads();
+  void countSample();
+  void publishSample();
+  const TempSnapshot *beginRead(uint32_t *pnPublished);
+  bool endRead(uint32_t nPublished);
 
-  portMUX_TYPE m_muxTempData = portMUX_INITIALIZER_UNLOCKED;
   uint8_t m_nMaxSensors = 4;
   uint8_t m_nNumSensors = 0;
   Resolution m_resolution;
-  float *m_arrRawTemps = NULL;
-  float m_fMaxRawTemp = -999.0;
+
+  // Double buffered snapshots. m_nPublished packs (generation << 1) with
+  // the index of the buffer readers should use, so publishing is a single
+  // store and the writer only ever fills the other buffer.
+  TempSnapshot m_arrSnapshots[2] = {};
+  volatile uint32_t m_nPublished = 0;
   DeviceAddress *m_arrSensorAddresses = NULL;
-  OneWire *m_pOneWire = NULL;
-  DallasTemperature m_sensors;
+  CTempBus *m_pBus = NULL;
+  bool m_bAsync = false;
+  bool m_bConversionPending = false;
+  uint32_t m_nConversionStartMs = 0;
+  uint32_t m_nConversionMs = 750;
+  uint32_t m_nLastSampleMs = 0;
+  volatile uint32_t m_nSampleCount = 0;
+  volatile float m_fSamplesPerSec = 0.0;
+  HalTaskHandle m_arrSampleListeners[MAX_SAMPLE_LISTENERS] = {};
+  uint8_t m_nNumSampleListeners = 0;
 };
 
 #endif // #ifndef __CTEMPSENSORS_H__
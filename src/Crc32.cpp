@@ -0,0 +1,19 @@
+#include <Crc32.h>
+
+// Reflected polynomial 0xEDB88320, a nibble at a time to keep the table small
+uint32_t computeCrc32(const uint8_t *pData, size_t nLen, uint32_t nCrc /* = 0*/)
+{
+  static const uint32_t s_arrTable[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+  nCrc = ~nCrc;
+  for (size_t nIndex = 0; nIndex < nLen; nIndex++)
+  {
+    nCrc ^= pData[nIndex];
+    nCrc = (nCrc >> 4) ^ s_arrTable[nCrc & 0x0F];
+    nCrc = (nCrc >> 4) ^ s_arrTable[nCrc & 0x0F];
+  }
+
+  return ~nCrc;
+}
@@ -0,0 +1,11 @@
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, the zlib one). Pass the previous result as nCrc to
+// continue over several buffers.
+uint32_t computeCrc32(const uint8_t *pData, size_t nLen, uint32_t nCrc = 0);
+
+#endif // #ifndef __CRC32_H__
@@ -0,0 +1,45 @@
+#ifndef __FANSETTINGS_H__
+#define __FANSETTINGS_H__
+
+#include <stdint.h>
+
+// Only pointers to these are held here, which keeps the settings structs
+// free of Arduino headers for the host side settings tools
+class CPwmFanControl;
+class CTempSensors;
+
+#define MAX_FANS 8
+
+typedef struct FanSettings
+{
+  double fPidSetpoint = 85.0;
+  // Gains are in % duty per F; the old 8 bit duty step gains were 4.0, 2.0, 1.0
+  double fPidKp = 1.57;
+  double fPidKi = 0.78;
+  double fPidKd = 0.39;
+  double fFullSpeedTemp = 100.0;
+  double fMinFanDutyCyclePercent = 30.0;
+  double fFanOffDutyCyclePercent = 0.00;
+  uint8_t bAllowOff = 1;
+  uint32_t nFanMinRuntimeMs = 0;
+  double fRampUpPercentPerSec = 0.0;   // 0 = no ramp
+  double fRampDownPercentPerSec = 0.0; // 0 = no ramp
+} FanSettings;
+
+typedef struct PersistentSettings
+{
+  FanSettings arrFans[MAX_FANS];
+} PersistentSettings;
+
+// One row of the fan table: which controller drives the fan, its settings,
+// and which temperature it follows
+typedef struct FanControlSettings
+{
+  FanSettings *pFanSettings;
+  CPwmFanControl *pFanCtrl;
+  CTempSensors *pTempSensors;
+  uint8_t nTempSensorIndex;
+  uint8_t bUseMaxTemp;
+} FanControlSettings;
+
+#endif // #ifndef __FANSETTINGS_H__
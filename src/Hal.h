@@ -0,0 +1,156 @@
+#ifndef __HAL_H__
+#define __HAL_H__
+
+// Platform services the control code uses: clock, critical sections and
+// tasks with notifications. On the ESP32 these are inlines over Arduino and
+// FreeRTOS. Everywhere else (the [env:native] build) HalNative.cpp supplies
+// a simulated clock that only moves when the program advances it, and
+// tasks on std::thread. Peripherals have their own interfaces:
+// CPwmChannel, CTachCounter and CTempBus.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_WAIT_FOREVER 0xffffffffUL
+
+typedef struct HalHeapStats
+{
+  uint32_t nFree;
+  uint32_t nMinFree;
+  uint32_t nLargestBlock;
+} HalHeapStats;
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+typedef TaskHandle_t HalTaskHandle;
+typedef portMUX_TYPE HalSpinlock;
+#define HAL_SPINLOCK_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+
+inline uint32_t halMillis()
+{
+  return millis();
+}
+
+inline uint32_t halMicros()
+{
+  return micros();
+}
+
+inline void halDelayMs(uint32_t nMs)
+{
+  delay(nMs);
+}
+
+// Free running counter for timing short stretches of code: CPU cycles
+inline uint32_t halCycleCount()
+{
+  return ESP.getCycleCount();
+}
+
+inline uint32_t halCyclesPerMicro()
+{
+  return ESP.getCpuFreqMHz();
+}
+
+inline void halEnterCritical(HalSpinlock *pLock)
+{
+  portENTER_CRITICAL(pLock);
+}
+
+inline void halExitCritical(HalSpinlock *pLock)
+{
+  portEXIT_CRITICAL(pLock);
+}
+
+inline bool halTaskCreate(void (*pfnTask)(void *), const char *pszName, uint32_t nStackSize, void *pvParam, uint32_t nPriority, HalTaskHandle *phTask, int nCore)
+{
+  return (xTaskCreatePinnedToCore(pfnTask, pszName, nStackSize, pvParam, nPriority, phTask, nCore) == pdPASS);
+}
+
+// For the end of a task function
+inline void halTaskDeleteSelf()
+{
+  vTaskDelete(NULL);
+}
+
+inline void halTaskNotifyGive(HalTaskHandle hTask)
+{
+  xTaskNotifyGive(hTask);
+}
+
+// Waits for a notification, clears the count and returns it; 0 on timeout
+inline uint32_t halTaskNotifyTake(uint32_t nTimeoutMs)
+{
+  return ulTaskNotifyTake(pdTRUE, (nTimeoutMs == HAL_WAIT_FOREVER) ? portMAX_DELAY : (nTimeoutMs / portTICK_PERIOD_MS));
+}
+
+inline HalTaskHandle halTaskGetCurrent()
+{
+  return xTaskGetCurrentTaskHandle();
+}
+
+// Least free stack the task has had, in bytes (ESP-IDF counts stack in bytes)
+inline uint32_t halTaskGetStackHighWater(HalTaskHandle hTask)
+{
+  return uxTaskGetStackHighWaterMark(hTask);
+}
+
+inline void halGetHeapStats(HalHeapStats *pStats)
+{
+  pStats->nFree = ESP.getFreeHeap();
+  pStats->nMinFree = ESP.getMinFreeHeap();
+  pStats->nLargestBlock = ESP.getMaxAllocHeap();
+}
+
+#else
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+inline T constrain(T value, L low, H high)
+{
+  return (value < low) ? (T)low : ((value > high) ? (T)high : value);
+}
+
+struct HalTask;
+typedef HalTask *HalTaskHandle;
+
+typedef struct HalSpinlock
+{
+  volatile int nLocked;
+} HalSpinlock;
+#define HAL_SPINLOCK_INITIALIZER {0}
+
+uint32_t halMillis();
+uint32_t halMicros();
+void halDelayMs(uint32_t nMs);
+uint32_t halCycleCount();
+uint32_t halCyclesPerMicro();
+void halEnterCritical(HalSpinlock *pLock);
+void halExitCritical(HalSpinlock *pLock);
+bool halTaskCreate(void (*pfnTask)(void *), const char *pszName, uint32_t nStackSize, void *pvParam, uint32_t nPriority, HalTaskHandle *phTask, int nCore);
+void halTaskDeleteSelf();
+void halTaskNotifyGive(HalTaskHandle hTask);
+uint32_t halTaskNotifyTake(uint32_t nTimeoutMs);
+HalTaskHandle halTaskGetCurrent();
+uint32_t halTaskGetStackHighWater(HalTaskHandle hTask);
+void halGetHeapStats(HalHeapStats *pStats);
+
+// Simulated clock. halDelayMs() advances it too, so a single threaded
+// simulation can run code that waits. halCycleCount() is the exception:
+// it counts real nanoseconds so code can still be timed.
+uint64_t halSimGetMicros();
+void halSimSetMicros(uint64_t nMicros);
+void halSimAdvanceMicros(uint64_t nMicros);
+
+#endif
+
+#endif // #ifndef __HAL_H__
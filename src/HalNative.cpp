@@ -0,0 +1,158 @@
+#ifndef ARDUINO
+
+#include <Hal.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct HalTask
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  uint32_t nNotifications = 0;
+  void (*pfnTask)(void *) = NULL;
+  void *pvParam = NULL;
+};
+
+static volatile uint64_t s_nSimMicros = 0;
+static thread_local HalTask *s_pCurrentTask = NULL;
+
+uint64_t halSimGetMicros()
+{
+  return __atomic_load_n(&s_nSimMicros, __ATOMIC_SEQ_CST);
+}
+
+void halSimSetMicros(uint64_t nMicros)
+{
+  __atomic_store_n(&s_nSimMicros, nMicros, __ATOMIC_SEQ_CST);
+}
+
+void halSimAdvanceMicros(uint64_t nMicros)
+{
+  __atomic_fetch_add(&s_nSimMicros, nMicros, __ATOMIC_SEQ_CST);
+}
+
+uint32_t halMillis()
+{
+  return (uint32_t)(halSimGetMicros() / 1000);
+}
+
+uint32_t halMicros()
+{
+  return (uint32_t)halSimGetMicros();
+}
+
+void halDelayMs(uint32_t nMs)
+{
+  halSimAdvanceMicros((uint64_t)nMs * 1000);
+}
+
+uint32_t halCycleCount()
+{
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t halCyclesPerMicro()
+{
+  return 1000;
+}
+
+void halEnterCritical(HalSpinlock *pLock)
+{
+  while (__sync_lock_test_and_set(&pLock->nLocked, 1))
+  {
+    std::this_thread::yield();
+  }
+}
+
+void halExitCritical(HalSpinlock *pLock)
+{
+  __sync_lock_release(&pLock->nLocked);
+}
+
+// Tasks run on detached threads for the life of the program. Stack size,
+// priority and core don't apply.
+bool halTaskCreate(void (*pfnTask)(void *), const char *pszName, uint32_t nStackSize, void *pvParam, uint32_t nPriority, HalTaskHandle *phTask, int nCore)
+{
+  HalTask *pTask = new HalTask();
+  pTask->pfnTask = pfnTask;
+  pTask->pvParam = pvParam;
+
+  if (phTask != NULL)
+  {
+    *phTask = pTask;
+  }
+
+  std::thread thread([pTask]()
+                     {
+                       s_pCurrentTask = pTask;
+                       pTask->pfnTask(pTask->pvParam);
+                     });
+  thread.detach();
+
+  return true;
+}
+
+// The thread ends when the task function returns
+void halTaskDeleteSelf()
+{
+}
+
+void halTaskNotifyGive(HalTaskHandle hTask)
+{
+  if (hTask != NULL)
+  {
+    std::lock_guard<std::mutex> lock(hTask->mutex);
+    hTask->nNotifications++;
+    hTask->cond.notify_one();
+  }
+}
+
+// The timeout is wall clock time, not simulated time: it only bounds how
+// long a task idles when nothing notifies it.
+uint32_t halTaskNotifyTake(uint32_t nTimeoutMs)
+{
+  uint32_t nReturn = 0;
+  HalTask *pTask = s_pCurrentTask;
+
+  if (pTask != NULL)
+  {
+    std::unique_lock<std::mutex> lock(pTask->mutex);
+    if (nTimeoutMs == HAL_WAIT_FOREVER)
+    {
+      pTask->cond.wait(lock, [pTask]()
+                       { return pTask->nNotifications > 0; });
+    }
+    else
+    {
+      pTask->cond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [pTask]()
+                           { return pTask->nNotifications > 0; });
+    }
+    nReturn = pTask->nNotifications;
+    pTask->nNotifications = 0;
+  }
+
+  return nReturn;
+}
+
+HalTaskHandle halTaskGetCurrent()
+{
+  return s_pCurrentTask;
+}
+
+// Threads don't report stack use, nor does the heap
+uint32_t halTaskGetStackHighWater(HalTaskHandle hTask)
+{
+  return 0;
+}
+
+void halGetHeapStats(HalHeapStats *pStats)
+{
+  pStats->nFree = 0;
+  pStats->nMinFree = 0;
+  pStats->nLargestBlock = 0;
+}
+
+#endif // #ifndef ARDUINO
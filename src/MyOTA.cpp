@@ -12,6 +12,8 @@ void taskOTAHandle(void *parameter)
 }
 #endif
 
+static void (*s_pfnOnStart)() = NULL;
+
 const char *computeHostname(const char *pszPrefix, char *pszOutput, size_t nBufLen /* = 40 */)
 {
   uint8_t mac[6];
@@ -25,8 +27,10 @@ const char *computeHostname(const char *pszPrefix, char *pszOutput, size_t nBufL
   return pszOutput;
 }
 
-void setupOTA(const char *nameprefix)
+void setupOTA(const char *nameprefix, void (*pfnOnStart)() /* = NULL*/)
 {
+  s_pfnOnStart = pfnOnStart;
+
   //const int maxlen =
   if (nameprefix == NULL)
   {
@@ -65,6 +69,12 @@ void setupOTA(const char *nameprefix)
 
         // NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using SPIFFS.end()
         Serial.println("Start updating " + type);
+
+        // Only for sketch updates, a filesystem image is about to replace whatever we'd write
+        if ((s_pfnOnStart != NULL) && (ArduinoOTA.getCommand() == U_FLASH))
+        {
+          s_pfnOnStart();
+        }
       })
       .onEnd([]() {
         Serial.println("\nEnd");
@@ -87,7 +97,7 @@ void setupOTA(const char *nameprefix)
       });
 
   ArduinoOTA.begin();
-  TelnetStream.begin();
+  TelnetLog.begin();
 
   Serial.println("OTA Initialized");
   Serial.print("IP address: ");
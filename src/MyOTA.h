@@ -14,18 +14,18 @@
 
 #include <WiFiUdp.h>
 #include <ArduinoOTA.h>
-#include <TelnetStream.h>
+#include <CTelnetLog.h>
 
-#define USE_TELNETSTREAM
+#define USE_TELNETLOG
 
-#ifndef USE_TELNETSTREAM
+#ifndef USE_TELNETLOG
 #define MySerial Serial
 #else
-#define MySerial TelnetStream
+#define MySerial TelnetLog
 #endif
 
 const char *computeHostname(const char *pszPrefix, char *pszOutput, size_t nBufLen = 40);
 
-void setupOTA(const char *nameprefix);
+void setupOTA(const char *nameprefix, void (*pfnOnStart)() = NULL);
 
 #endif // __MYOTA_H__
@@ -1,11 +1,21 @@
 #include <Arduino.h>
-#include <EEPROM.h>
+#include <LittleFS.h>
 #include <WiFi.h>
-#include <PID_v1.h>
 
 #include <CPwmFanControl.h>
 #include <CTempSensors.h>
+#include <CDallasTempBus.h>
+#include <CFanScheduler.h>
 #include <CControllerServer.h>
+#include <CHistoryRecorder.h>
+#include <CFileLogStorage.h>
+#include <CFlashLog.h>
+#include <CNvsSettingsBackend.h>
+#include <CSettingsStore.h>
+#include <CBinaryLog.h>
+#include <CHotPathBench.h>
+#include <CPerfMonitor.h>
+#include <CPeriodicTick.h>
 #include <MyOTA.h>
 #include "private.h"
 
@@ -21,124 +31,250 @@
 
 #define NON_WIFI_CORE 1
 
-typedef struct FanSettings
-{
-  double fPidSetpoint = 85.0;
-  double fPidKp = 4.0; //2.0;
-  double fPidKi = 2.0; //5.0;
-  double fPidKd = 1.0; //1.0;
-  double fFullSpeedTemp = 100.0;
-  double fMinFanDutyCyclePercent = 30.0;
-  double fFanOffDutyCyclePercent = 0.00;
-  uint8_t bAllowOff = 1;
-  uint32_t nFanMinRuntimeMs = 0;
-} FanSettings;
-
-typedef struct PersistentSettings
-{
-  FanSettings fan1;
-  FanSettings fan2;
-} PersistentSettings;
+#define TACH_SAMPLE_PERIOD_MS 250
 
-typedef struct FanControlSettings
-{
-  FanSettings *pFanSettings = NULL;
-  CPwmFanControl *pFanCtrl = NULL;
-  CTempSensors *pTempSensors = NULL;
-  uint8_t nTempSensorIndex = 0;
-  uint8_t bUseMaxTemp = 1;
-} FanControlSettings;
+// The temperature task wakes every conversion time plus this guard, which
+// covers the bus time between a wakeup and the next conversion starting,
+// so each wakeup finds the previous conversion done. Without async
+// conversion the gap after each blocking update is longer.
+#define TEMP_UPDATE_GUARD_MS 50
+#define TEMP_UPDATE_SYNC_GAP_MS 250
+
+// 10 bit PWM at 25 kHz (the 80 MHz LEDC clock allows up to 11 bits)
+#define FAN_PWM_RESOLUTION 10
+#define FAN_PWM_FREQUENCY 25000
+
+#define NUM_FANS 2
+#define FAN_CONTROL_WATCHDOG_MS 2000
+
+// 64 x 512 byte blocks hold roughly 4 hours of 2 fans + 4 sensors at this interval
+#define HISTORY_NUM_BLOCKS 96
+#define HISTORY_BLOCK_BYTES 512
+
+// Persistent log on LittleFS: one sample every 10 s, written in 512 byte
+// batches (~11 samples) or at least once a minute. 16 x 32 KB segments
+// keep about a day and a half.
+#define FLASH_LOG_DIR "/littlefs/log"
+#define FLASH_LOG_NUM_SEGMENTS 16
+#define FLASH_LOG_SEGMENT_BYTES 32768
+#define FLASH_LOG_BATCH_BYTES 512
+#define FLASH_LOG_SAMPLE_MS 10000
+#define FLASH_LOG_FLUSH_MS 60000
 
 PersistentSettings persistentSettings;
-FanControlSettings settingsFan1 = {};
-FanControlSettings settingsFan2 = {};
 
-CPwmFanControl fan1Ctrl(FAN1_PWM_CHANNEL, FAN1_PWM_PIN, FAN1_TACH_PIN);
-CPwmFanControl fan2Ctrl(FAN2_PWM_CHANNEL, FAN2_PWM_PIN, FAN2_TACH_PIN);
+// Settings are written 5 s after the last change, or at most a minute
+// after the first one if changes keep coming
+#define SETTINGS_DEBOUNCE_MS 5000
+#define SETTINGS_MAX_DELAY_MS 60000
+
+CNvsSettingsBackend settingsBackend;
+CSettingsStore settingsStore(&settingsBackend, &persistentSettings, SETTINGS_DEBOUNCE_MS, SETTINGS_MAX_DELAY_MS);
+
+// Scheduler settings generation last copied into persistentSettings. Only
+// loop() touches persistentSettings once the scheduler is running.
+uint32_t nPersistedSettingsGeneration = 0;
+
+typedef CPwmFanControlT<FAN_PWM_RESOLUTION, FAN_PWM_FREQUENCY> CFanPwmControl;
+
+CFanPwmControl arrFanCtrl[NUM_FANS] = {
+    {FAN1_PWM_CHANNEL, FAN1_PWM_PIN, FAN1_TACH_PIN},
+    {FAN2_PWM_CHANNEL, FAN2_PWM_PIN, FAN2_TACH_PIN}};
 OneWire oneWire(TEMP_SENSOR_PIN);
-CTempSensors tempSensors(&oneWire, HIGH_RES);
+CDallasTempBus tempBus(&oneWire);
+CTempSensors tempSensors(&tempBus, HIGH_RES);
+
+// Fan table, one row per fan:
+//   settings, controller, temp sensors, sensor index, use max temp
+FanControlSettings arrFanControls[NUM_FANS] = {
+    {&persistentSettings.arrFans[0], &arrFanCtrl[0], &tempSensors, 0, 1},
+    {&persistentSettings.arrFans[1], &arrFanCtrl[1], &tempSensors, 1, 0}};
+
+CFanScheduler fanScheduler(arrFanControls, NUM_FANS, FAN_CONTROL_WATCHDOG_MS);
+
+CHistoryRecorder history;
+
+CFileLogStorage flashLogStorage(FLASH_LOG_DIR, FLASH_LOG_NUM_SEGMENTS, FLASH_LOG_SEGMENT_BYTES);
+CFlashLog flashLog(&flashLogStorage, FLASH_LOG_BATCH_BYTES);
+TaskHandle_t hFlashLogTask = NULL;
 
 CControllerServer server(80);
 
-void IRAM_ATTR handleFan1TachIrq()
+CHotPathBench hotPathBench;
+#ifdef MICRO_BENCHMARK
+CMicroBench bootBench;
+#endif
+
+// Loop timing of each task, served on /debug/perf and printed by loop()
+CPerfMonitor perfMonitor;
+CTaskPerf tachSamplerPerf("taskTachSampler");
+CTaskPerf tempUpdatePerf("taskTempUpdate");
+CTaskPerf flashLogPerf("taskFlashLog");
+CTaskPerf loopPerf("loop");
+
+// Fixed rate wakeups for the temperature task (period set in setup())
+CPeriodicTick tempUpdateTick("taskTempUpdate");
+
+// Samples every fan's tach count at a fixed cadence so getFanRpms() can be
+// read from anywhere without disturbing the measurement window
+void taskTachSampler(void *pvParam)
 {
-  fan1Ctrl.isrFanTach();
+  tachSamplerPerf.attach();
+
+  for (;;)
+  {
+    tachSamplerPerf.loopStart();
+    for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+    {
+      arrFanCtrl[nIndex].sampleTach();
+    }
+    tachSamplerPerf.loopEnd();
+    vTaskDelay(TACH_SAMPLE_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+  vTaskDelete(NULL);
 }
 
-void IRAM_ATTR handleFan2TachIrq()
+// Runs on a CPeriodicTick, so the sample rate stays constant however long
+// the OneWire transactions take; the scheduler ticks on each new sample
+void taskTempUpdate(void *pvParam)
 {
-  fan2Ctrl.isrFanTach();
+  tempUpdatePerf.attach();
+
+  for (;;)
+  {
+    tempUpdateTick.wait();
+    tempUpdatePerf.loopStart();
+
+    uint32_t nGeneration = tempSensors.getGeneration();
+    tempSensors.update();
+
+    if (tempSensors.getGeneration() != nGeneration)
+    {
+      history.record();
+    }
+
+    tempUpdatePerf.loopEnd();
+  }
+  vTaskDelete(NULL);
 }
 
-void taskFanControl(FanControlSettings *pSettings)
+// Sole writer of the flash log. A notification (sent when an OTA update
+// starts) flushes the pending batch right away so the reboot loses nothing.
+void taskFlashLog(void *pvParam)
 {
-  if (pSettings != NULL &&
-      pSettings->pFanSettings != NULL &&
-      pSettings->pFanCtrl != NULL &&
-      pSettings->pTempSensors != NULL)
+  uint32_t nLastFlushMs = millis();
+  int32_t arrValues[HISTORY_MAX_CHANNELS];
+  uint32_t nTimeMs = 0;
+
+  flashLogPerf.attach();
+
+  for (;;)
   {
-    double fPidSetpoint = pSettings->pFanSettings->fPidSetpoint;
-    double fPidInput = 0.0;
-    double fPidOutputDutyCycle = 0.0;
-
-    pSettings->pFanCtrl->setMinFanDutyCycle(CPwmFanControl::percentToDutyCycle(pSettings->pFanSettings->fMinFanDutyCyclePercent));
-    pSettings->pFanCtrl->setFanOffDutyCycle(CPwmFanControl::percentToDutyCycle(pSettings->pFanSettings->fFanOffDutyCyclePercent));
-    pSettings->pFanCtrl->setAllowOff(pSettings->pFanSettings->bAllowOff);
-    pSettings->pFanCtrl->setFanMinRuntimeMs(pSettings->pFanSettings->nFanMinRuntimeMs);
-
-    PID pid(&fPidInput,
-            &fPidOutputDutyCycle,
-            &fPidSetpoint,
-            pSettings->pFanSettings->fPidKp,
-            pSettings->pFanSettings->fPidKi,
-            pSettings->pFanSettings->fPidKd,
-            REVERSE);
-
-    pid.SetMode(AUTOMATIC);
-
-    for (;;)
+    bool bFlushRequested = (ulTaskNotifyTake(pdTRUE, FLASH_LOG_SAMPLE_MS / portTICK_PERIOD_MS) != 0);
+    flashLogPerf.loopStart();
+
+    if (!bFlushRequested)
     {
-      double fTemp = 0.0;
-      if (pSettings->bUseMaxTemp)
+      uint8_t nNumValues = history.getLastSample(&nTimeMs, arrValues);
+      if (nNumValues > 0)
       {
-        fTemp = pSettings->pTempSensors->getMaxTempF();
-      }
-      else
-      {
-        fTemp = pSettings->pTempSensors->getTempF(pSettings->nTempSensorIndex);
+        flashLog.appendSample(nTimeMs, arrValues, nNumValues);
       }
+    }
 
-      fPidInput = fTemp;
+    if (bFlushRequested || (millis() - nLastFlushMs >= FLASH_LOG_FLUSH_MS))
+    {
+      flashLog.flush();
+      nLastFlushMs = millis();
+    }
+    flashLogPerf.loopEnd();
+  }
+  vTaskDelete(NULL);
+}
 
-      pid.Compute();
+void onOtaStart()
+{
+  if (hFlashLogTask != NULL)
+  {
+    xTaskNotifyGive(hFlashLogTask);
+  }
+}
 
-      if (fTemp >= pSettings->pFanSettings->fFullSpeedTemp)
-      {
-        pSettings->pFanCtrl->setFullSpeed();
-      }
-      else
-      {
-        pSettings->pFanCtrl->setFanDutyCycle(round(fPidOutputDutyCycle));
-      }
+#ifdef PID_BENCHMARK
+#include <PID_v1.h>
 
-      vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
+// Build with -DPID_BENCHMARK to compare the cost of one Compute() of
+// PID_v1 (double) against CPidController (float) on the target
+void benchmarkPid()
+{
+  const uint32_t nIterations = 200;
+
+  double fInput = 100.0;
+  double fOutput = 0.0;
+  double fSetpoint = 105.0;
+  PID pidV1(&fInput, &fOutput, &fSetpoint, 4.0, 2.0, 1.0, REVERSE);
+  pidV1.SetSampleTime(1);
+  pidV1.SetMode(AUTOMATIC);
+
+  CPidController pid(4.0f, 2.0f, 1.0f, PID_DIRECTION_REVERSE, 1);
+  pid.setSetpoint(105.0f);
+  pid.setAutomatic(true, 100.0f, 0.0f);
+
+  // PID_v1 only computes once its sample time has elapsed, so step millis()
+  // between calls and only count the cycles spent inside each Compute()
+  uint32_t nPidV1Cycles = 0;
+  uint32_t nPidCycles = 0;
+  float fPidOutput = 0.0f;
+  for (uint32_t nIndex = 0; nIndex < nIterations; nIndex++)
+  {
+    delay(1);
 
-    vTaskDelete(NULL);
+    fInput = 100.0 + (double)(nIndex & 15) * 0.0625;
+    uint32_t nStartCycles = ESP.getCycleCount();
+    pidV1.Compute();
+    nPidV1Cycles += ESP.getCycleCount() - nStartCycles;
+
+    nStartCycles = ESP.getCycleCount();
+    fPidOutput = pid.compute((float)fInput);
+    nPidCycles += ESP.getCycleCount() - nStartCycles;
   }
+
+  Serial.printf("PID_v1 Compute(): %u cycles, CPidController::compute(): %u cycles (outputs %f / %f)\n",
+                nPidV1Cycles / nIterations,
+                nPidCycles / nIterations,
+                fOutput,
+                fPidOutput);
 }
+#endif
 
-void taskTempUpdate(void *pvParam)
+#ifdef BINARY_LOG_BENCHMARK
+// Build with -DBINARY_LOG_BENCHMARK to compare one BLOG() against
+// formatting the same line with snprintf() on the target
+void benchmarkBinaryLog()
 {
-  for (;;)
+  const uint32_t nIterations = 200;
+
+  char szLine[96];
+  uint32_t nLogCycles = 0;
+  uint32_t nPrintfCycles = 0;
+  for (uint32_t nIndex = 0; nIndex < nIterations; nIndex++)
   {
-    //unsigned long nStart = micros();
-    tempSensors.update();
-    //Serial.printf("Temp Sensor Update took %02.3f sec\n", (double)(micros() - nStart) / 1000000.0);
-    vTaskDelay(250 / portTICK_PERIOD_MS);
+    float fTempF = 100.0f + (float)(nIndex & 15) * 0.0625f;
+
+    uint32_t nStartCycles = ESP.getCycleCount();
+    BLOG("fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", nIndex & 1, fTempF, 42.5f, 40.0f, 0U);
+    nLogCycles += ESP.getCycleCount() - nStartCycles;
+
+    nStartCycles = ESP.getCycleCount();
+    snprintf(szLine, sizeof(szLine), "fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", nIndex & 1, fTempF, 42.5f, 40.0f, 0U);
+    nPrintfCycles += ESP.getCycleCount() - nStartCycles;
   }
-  vTaskDelete(NULL);
+
+  Serial.printf("BLOG(): %u cycles, snprintf(): %u cycles\n",
+                nLogCycles / nIterations,
+                nPrintfCycles / nIterations);
 }
+#endif
 
 void startWifi();
 
@@ -174,91 +310,171 @@ void setup()
   Serial.begin(115200);
   delay(1000);
 
-  //EEPROM.begin(sizeof(PersistentSettings));
-  //EEPROM.get(0, persistentSettings);
-  //EEPROM.put(0, persistentSettings);
-  //EEPROM.commit();
+#ifdef PID_BENCHMARK
+  benchmarkPid();
+#endif
+
+#ifdef BINARY_LOG_BENCHMARK
+  benchmarkBinaryLog();
+#endif
+
+  BLOG("boot: reset reason %u", (uint32_t)esp_reset_reason());
+
+  // LOAD SETTINGS: defaults first, anything stored replaces them
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    persistentSettings.arrFans[nIndex].fPidSetpoint = 105.0;
+    persistentSettings.arrFans[nIndex].fFullSpeedTemp = 110.0;
+    persistentSettings.arrFans[nIndex].bAllowOff = 1;
+    persistentSettings.arrFans[nIndex].nFanMinRuntimeMs = 60000;
+    persistentSettings.arrFans[nIndex].fRampUpPercentPerSec = 20.0;
+    persistentSettings.arrFans[nIndex].fRampDownPercentPerSec = 10.0;
+  }
+
+  {
+    uint32_t nStart = micros();
+    SettingsLoadResult settingsResult = settingsStore.load();
+    const char *arrResultNames[] = {"loaded", "migrated", "defaults", "defaults (stored settings invalid)"};
+    Serial.printf("Settings %s (version %u) in %u us\n", arrResultNames[settingsResult], settingsStore.getLoadedVersion(), micros() - nStart);
+  }
 
   // initialize temp sensors and fan controllers
+  tempSensors.setAsyncConversion(true);
   tempSensors.begin();
-  fan1Ctrl.begin(handleFan1TachIrq);
-  fan1Ctrl.setFanDutyCyclePercent(100.0);
-  fan2Ctrl.begin(handleFan2TachIrq);
-  fan2Ctrl.setFanDutyCyclePercent(100.0);
+  tempUpdateTick.setPeriodMs(tempSensors.getConversionTimeMs() + (tempSensors.isAsyncConversion() ? TEMP_UPDATE_GUARD_MS : TEMP_UPDATE_SYNC_GAP_MS));
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    arrFanCtrl[nIndex].begin(TACH_BACKEND_PCNT);
+    arrFanCtrl[nIndex].setFanDutyCyclePercent(100.0);
 
-  // START TEMPERATURE UPDATE TASK
-  xTaskCreatePinnedToCore(
-      (void (*)(void *))taskTempUpdate, // Function that should be called
-      "taskTempUpdate",                 // Name of the task (for debugging)
-      2500,                             // Stack size (bytes)
-      NULL,                             // Parameter to pass
-      0,                                //configMAX_PRIORITIES / 2, // Task priority
-      NULL,                             // Task handle
-      1                                 // Core you want to run the task on (0 or 1)
-  );
+    // 4 x 250ms samples gives the same 1 second counting window as before
+    arrFanCtrl[nIndex].setRpmWindow(4);
+  }
 
-  // START FAN #1 CONTROL TASK
-  persistentSettings.fan1.fPidSetpoint = 105.0;
-  persistentSettings.fan1.fFullSpeedTemp = 110.0;
-  persistentSettings.fan1.bAllowOff = 1;
-  persistentSettings.fan1.nFanMinRuntimeMs = 60000;
+  CPwmFanControl *arrBenchFanCtrl[NUM_FANS] = {};
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    arrBenchFanCtrl[nIndex] = &arrFanCtrl[nIndex];
+  }
+  hotPathBench.begin(arrBenchFanCtrl, NUM_FANS, &tempSensors);
 
-  settingsFan1.pFanSettings = &persistentSettings.fan1;
-  settingsFan1.pFanCtrl = &fan1Ctrl;
-  settingsFan1.pTempSensors = &tempSensors;
-  settingsFan1.nTempSensorIndex = 0;
-  settingsFan1.bUseMaxTemp = 1;
+#ifdef MICRO_BENCHMARK
+  // Build with -DMICRO_BENCHMARK to time the hot paths, including the ones
+  // the control tasks own, before those tasks start. /bench serves the
+  // results along with a live run.
+  {
+    static char szBenchJson[2048];
+    hotPathBench.runAll(&bootBench);
+    bootBench.writeJson(szBenchJson, sizeof(szBenchJson));
+    Serial.printf("Benchmark: %s\n", szBenchJson);
+  }
+#endif
+
+  // Period based RPM needs edge timestamps from the ISR backend, e.g.
+  //   arrFanCtrl[0].begin(TACH_BACKEND_ISR);
+  //   arrFanCtrl[0].setRpmEstimator(RPM_ESTIMATOR_PERIOD);
+  //   arrFanCtrl[0].setStallTimeoutMs(500);
+
+  // START PERF MONITOR (tasks attach to their CTaskPerf as they start)
+  perfMonitor.begin(arrBenchFanCtrl, NUM_FANS, &tempBus);
+  perfMonitor.addTask(&tachSamplerPerf);
+  perfMonitor.addTask(&tempUpdatePerf);
+  perfMonitor.addTask(fanScheduler.getTaskPerf());
+  perfMonitor.addTask(&flashLogPerf);
+  perfMonitor.addTask(&loopPerf);
+  perfMonitor.addTick(&tempUpdateTick);
+  loopPerf.attach();
+  Serial.printf("Perf instrumentation: %u ns per loop\n", perfMonitor.getOverheadNs());
+
+  // START HISTORY RECORDER (before the temp task that feeds it)
+  CPwmFanControl *arrHistoryFanCtrl[NUM_FANS] = {};
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    arrHistoryFanCtrl[nIndex] = &arrFanCtrl[nIndex];
+  }
+  history.begin(arrHistoryFanCtrl, NUM_FANS, &tempSensors, tempUpdateTick.getPeriodMs(), HISTORY_NUM_BLOCKS, HISTORY_BLOCK_BYTES);
 
-  xTaskCreatePinnedToCore(
-      (void (*)(void *))taskFanControl, // Function that should be called
-      "taskFanControl1",                // Name of the task (for debugging)
-      2500,                             // Stack size (bytes)
-      &settingsFan1,                    // Parameter to pass
-      0,                                //configMAX_PRIORITIES / 2, // Task priority
-      NULL,                             // Task handle
-      NON_WIFI_CORE                     // Core you want to run the task on (0 or 1)
-  );
+  // START FLASH LOG
+  if (LittleFS.begin(true))
+  {
+    uint32_t nStart = micros();
+    bool bLogReady = flashLog.begin(esp_reset_reason());
+    Serial.printf("Flash log %s: boot %u, segment %u, recovered in %u us\n",
+                  bLogReady ? "ready" : "failed", flashLog.getBootId(), flashLog.getSegment(), micros() - nStart);
 
-  // START FAN #2 CONTROL TASKvf
-  persistentSettings.fan2.fPidSetpoint = 105.0;
-  persistentSettings.fan2.fFullSpeedTemp = 110.0;
-  persistentSettings.fan2.bAllowOff = 1;
-  persistentSettings.fan2.nFanMinRuntimeMs = 60000;
+    if (bLogReady)
+    {
+      xTaskCreatePinnedToCore(
+          (void (*)(void *))taskFlashLog, // Function that should be called
+          "taskFlashLog",                 // Name of the task (for debugging)
+          3000,                           // Stack size (bytes)
+          NULL,                           // Parameter to pass
+          0,                              // Task priority
+          &hFlashLogTask,                 // Task handle
+          0                               // Core you want to run the task on (0 or 1)
+      );
+    }
+  }
 
-  settingsFan2.pFanSettings = &persistentSettings.fan2;
-  settingsFan2.pFanCtrl = &fan2Ctrl;
-  settingsFan2.pTempSensors = &tempSensors;
-  settingsFan2.nTempSensorIndex = 1;
-  settingsFan2.bUseMaxTemp = 0;
+  // START TACH SAMPLER TASK
+  xTaskCreatePinnedToCore(
+      (void (*)(void *))taskTachSampler, // Function that should be called
+      "taskTachSampler",                 // Name of the task (for debugging)
+      2000,                              // Stack size (bytes)
+      NULL,                              // Parameter to pass
+      1,                                 // Task priority
+      NULL,                              // Task handle
+      NON_WIFI_CORE                      // Core you want to run the task on (0 or 1)
+  );
 
+  // START TEMPERATURE UPDATE TASK
   xTaskCreatePinnedToCore(
-      (void (*)(void *))taskFanControl, // Function that should be called
-      "taskFanControl2",                // Name of the task (for debugging)
+      (void (*)(void *))taskTempUpdate, // Function that should be called
+      "taskTempUpdate",                 // Name of the task (for debugging)
       2500,                             // Stack size (bytes)
-      &settingsFan2,                    // Parameter to pass
+      NULL,                             // Parameter to pass
       0,                                //configMAX_PRIORITIES / 2, // Task priority
       NULL,                             // Task handle
-      NON_WIFI_CORE                     // Core you want to run the task on (0 or 1)
+      1                                 // Core you want to run the task on (0 or 1)
   );
 
+  // START FAN CONTROL SCHEDULER
+  fanScheduler.setSamplePeriodMs(tempUpdateTick.getPeriodMs());
+  fanScheduler.begin(NON_WIFI_CORE);
+
   // CONNECT TO WIFI
   Serial.printf("Connecting to WiFi...\n");
   startWifi();
 
   if (WiFi.isConnected())
   {
-    CPwmFanControl *arrFanCtrl[] = {&fan1Ctrl, &fan2Ctrl};
-    server.begin(arrFanCtrl, 2, &tempSensors);
+    CPwmFanControl *arrServerFanCtrl[NUM_FANS] = {};
+    for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+    {
+      arrServerFanCtrl[nIndex] = &arrFanCtrl[nIndex];
+    }
+    server.setFanScheduler(&fanScheduler);
+    server.setHistory(&history);
+    server.setFlashLogStorage(&flashLogStorage);
+#ifdef MICRO_BENCHMARK
+    server.setHotPathBench(&hotPathBench, &bootBench);
+#else
+    server.setHotPathBench(&hotPathBench);
+#endif
+    server.setPerfMonitor(&perfMonitor);
+    server.begin(arrServerFanCtrl, NUM_FANS, &tempSensors);
   }
 
   Serial.printf("Setting up OTA...\n");
-  setupOTA("MyFanController1");
+  setupOTA("MyFanController1", onOtaStart);
 
   delay(1000);
 }
 
 void loop()
 {
+  loopPerf.loopStart();
+
   if (!WiFi.isConnected())
   {
     Serial.println("loop(): not connected...");
@@ -272,6 +488,21 @@ void loop()
   }
 
 
+  // Settings posted to /settings are published straight to the scheduler;
+  // pick them up here for the debounced write
+  if (fanScheduler.getSettingsGeneration() != nPersistedSettingsGeneration)
+  {
+    nPersistedSettingsGeneration = fanScheduler.getSettingsGeneration();
+    for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+    {
+      fanScheduler.getFanSettings(nIndex, &persistentSettings.arrFans[nIndex]);
+    }
+    settingsStore.markDirty(millis());
+  }
+
+  // Debounced settings write, if anything changed
+  settingsStore.service(millis());
+
   MySerial.printf("\n### LOOP\n");
    if (WiFi.isConnected())
   {
@@ -281,12 +512,40 @@ void loop()
   {
     MySerial.printf("WiFi NOT CONNECTED!\n");
   }
-  MySerial.printf("Sensors: { %02.3fF, %02.3fF } Max %02.3fF\n", tempSensors.getTempF(0), tempSensors.getTempF(1), tempSensors.getMaxTempF());
-  MySerial.printf("Fan1: %4d RPMs, %6.3f%% (%6.3f%%), %6.3fF / %6.3fF rt=%u\n", fan1Ctrl.getFanRpms(), fan1Ctrl.getLastDutyCyclePercent(), CPwmFanControl::dutyCycleToPercent(fan1Ctrl.getLastSpecDutyCycle()), tempSensors.getMaxTempF(), persistentSettings.fan1.fPidSetpoint, fan1Ctrl.getRuntimeMs());
-  MySerial.printf("Fan2: %4d RPMs, %6.3f%% (%6.3f%%), %6.3fF / %6.3fF\n", fan2Ctrl.getFanRpms(), fan2Ctrl.getLastDutyCyclePercent(), CPwmFanControl::dutyCycleToPercent(fan2Ctrl.getLastSpecDutyCycle()), tempSensors.getTempF(1), persistentSettings.fan2.fPidSetpoint);
+  MySerial.printf("Sensors: { %02.3fF, %02.3fF } Max %02.3fF (%4.2f samples/sec)\n", tempSensors.getTempF(0), tempSensors.getTempF(1), tempSensors.getMaxTempF(), tempSensors.getSamplesPerSec());
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    FanControlSettings *pFanControl = &arrFanControls[nIndex];
+    CPwmFanControl *pFanCtrl = pFanControl->pFanCtrl;
+    float fTempF = pFanControl->bUseMaxTemp ? tempSensors.getMaxTempF() : tempSensors.getTempF(pFanControl->nTempSensorIndex);
+    MySerial.printf("Fan%u: %4d RPMs, %6.3f%% (%6.3f%%), %6.3fF / %6.3fF rt=%u\n", nIndex + 1, pFanCtrl->getFanRpms(), pFanCtrl->getLastDutyCyclePercent(), pFanCtrl->getLastSpecDutyCyclePercent(), fTempF, pFanControl->pFanSettings->fPidSetpoint, pFanCtrl->getRuntimeMs());
+  }
+  MySerial.printf("Control tick: last %uus, avg %6.1fus, max %uus, dt last %uus max %uus\n", fanScheduler.getLastTickMicros(), fanScheduler.getAvgTickMicros(), fanScheduler.getMaxTickMicros(), fanScheduler.getLastDtMicros(), fanScheduler.getMaxDtMicros());
+  MySerial.printf("Temp tick: %ums, %u ticks, %u overruns (%u skipped), late avg %6.1fus max %uus, dt %u-%uus\n", tempUpdateTick.getPeriodMs(), tempUpdateTick.getTickCount(), tempUpdateTick.getOverruns(), tempUpdateTick.getSkippedTicks(), tempUpdateTick.getAvgLatenessMicros(), tempUpdateTick.getMaxLatenessMicros(), tempUpdateTick.getMinDtMicros(), tempUpdateTick.getMaxDtMicros());
+  MySerial.printf("Sample to actuation: last %uus, avg %6.1fus, max %uus, watchdog timeouts %u\n", fanScheduler.getLastLatencyMicros(), fanScheduler.getAvgLatencyMicros(), fanScheduler.getMaxLatencyMicros(), fanScheduler.getWatchdogTimeouts());
+  MySerial.printf("/status: %u requests (%u not modified), handler avg %6.1fus, max %uus\n", server.getStatusRequests(), server.getStatusNotModified(), server.getAvgStatusHandlerMicros(), server.getMaxStatusHandlerMicros());
+  MySerial.printf("History: %u samples, %u of %u bytes\n", history.getSampleCount(), history.getBytesUsed(), history.getCapacityBytes());
+  MySerial.printf("Flash log: boot %u, segment %u (seq %u), %u flushes, %u rotations, %u write errors\n", flashLog.getBootId(), flashLog.getSegment(), flashLog.getSegmentSeq(), flashLog.getFlushCount(), flashLog.getRotationCount(), flashLog.getWriteErrors());
+  MySerial.printf("Settings: generation %u (%u applied), %s, %u writes, %u coalesced, %u errors\n", fanScheduler.getSettingsGeneration(), fanScheduler.getSettingsApplied(), settingsStore.isDirty() ? "pending" : "saved", settingsStore.getWriteCount(), settingsStore.getCoalescedCount(), settingsStore.getWriteErrors());
+  MySerial.printf("Telnet log: %u clients, %u written, %u sent, %u dropped\n", TelnetLog.getNumClients(), TelnetLog.getBytesWritten(), TelnetLog.getBytesSent(), TelnetLog.getDroppedBytes());
+  MySerial.printf("Heap: %u free, %u min free, %u largest block\n", ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
+  for (size_t nIndex = 0; nIndex < perfMonitor.getNumTasks(); nIndex++)
+  {
+    CTaskPerf *pTaskPerf = perfMonitor.getTask(nIndex);
+    MySerial.printf("%-16s period avg %8.0fus max %8uus, jitter max %7uus, exec avg %7.0fus max %7uus, stack free %u\n", pTaskPerf->getName(), pTaskPerf->getPeriod()->fAvgMicros, pTaskPerf->getPeriod()->nMaxMicros, pTaskPerf->getJitter()->nMaxMicros, pTaskPerf->getExec()->fAvgMicros, pTaskPerf->getExec()->nMaxMicros, pTaskPerf->getStackHighWater());
+  }
+  {
+    TempBusStats busStats = {};
+    tempBus.getStats(&busStats);
+    MySerial.printf("OneWire: convert avg %6.0fus max %uus, read avg %6.0fus max %uus, %u CRC errors, %u no presence\n", busStats.convert.fAvgMicros, busStats.convert.nMaxMicros, busStats.read.fAvgMicros, busStats.read.nMaxMicros, busStats.nCrcErrors, busStats.nNoPresence);
+  }
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    MySerial.printf("Fan%u tach: %6.1f edges/sec%s\n", nIndex + 1, arrFanCtrl[nIndex].getTachEdgeRate(), arrFanCtrl[nIndex].isTachInterruptPerEdge() ? " (one interrupt each)" : "");
+  }
+  MySerial.printf("Perf instrumentation: %u ns per loop, %.2f ppm of a CPU\n", perfMonitor.getOverheadNs(), perfMonitor.getOverheadPpm());
   MySerial.printf("\n");
 
-  fan1Ctrl.getFanRpms();
-  fan2Ctrl.getFanRpms();
+  loopPerf.loopEnd();
   delay(1000);
 }
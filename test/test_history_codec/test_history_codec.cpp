@@ -0,0 +1,193 @@
+// Round trips samples through CHistoryRing and CHistoryBlockDecoder: a
+// controller trace across the millis() rollover, irregular timestamps with
+// large value jumps, and eviction once the ring is full.
+//
+//   pio test -e native -f test_history_codec
+
+#include <CHistoryRing.h>
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define NUM_SENSORS 4
+#define NUM_FANS 2
+#define NUM_CHANNELS (NUM_SENSORS + NUM_FANS * 2)
+
+// Appended samples, kept to compare the decoded ones against
+typedef struct Trace
+{
+  std::vector<uint32_t> times;
+  std::vector<int32_t> values;
+} Trace;
+
+static void appendSample(CHistoryRing &ring, Trace &trace, uint32_t nTimeMs, const int32_t *arrValues)
+{
+  ring.append(nTimeMs, arrValues);
+  trace.times.push_back(nTimeMs);
+  trace.values.insert(trace.values.end(), arrValues, arrValues + ring.getNumChannels());
+}
+
+// Decodes every block still in the ring and compares it with the end of
+// the trace. Returns the number of samples decoded; pbMatch is false on
+// the first sample that differs.
+static uint32_t decodeAndCompare(CHistoryRing &ring, const Trace &trace, bool *pbMatch)
+{
+  uint8_t nNumChannels = ring.getNumChannels();
+  HistoryBlockHeader header;
+  std::vector<uint8_t> block(ring.getBlockBytes());
+  CHistoryBlockDecoder decoder;
+  uint32_t nTimeMs = 0;
+  int32_t arrValues[HISTORY_MAX_CHANNELS];
+  std::vector<uint32_t> times;
+  std::vector<int32_t> values;
+
+  for (uint32_t nSeq = ring.getFirstSeq(); nSeq < ring.getNextSeq(); nSeq++)
+  {
+    ring.copyBlock(nSeq, &header, block.data(), block.size());
+    decoder.reset(&header, block.data(), nNumChannels);
+    while (decoder.next(&nTimeMs, arrValues))
+    {
+      times.push_back(nTimeMs);
+      values.insert(values.end(), arrValues, arrValues + nNumChannels);
+    }
+  }
+
+  // The oldest samples may have been evicted; what is left has to be the
+  // newest ones, contiguous
+  size_t nFirst = trace.times.size() - times.size();
+  *pbMatch = (times.size() <= trace.times.size());
+  for (size_t nIndex = 0; *pbMatch && (nIndex < times.size()); nIndex++)
+  {
+    *pbMatch = (times[nIndex] == trace.times[nFirst + nIndex]);
+    for (uint8_t nChannel = 0; *pbMatch && (nChannel < nNumChannels); nChannel++)
+    {
+      *pbMatch = (values[nIndex * nNumChannels + nChannel] == trace.values[(nFirst + nIndex) * nNumChannels + nChannel]);
+    }
+  }
+
+  return (uint32_t)times.size();
+}
+
+// Slow thermal drift with DS18B20 quantization, a PID driven duty and tach
+// readings with a little jitter, on the recorder's interval grid. Same
+// trace as tools/history_codec/bench_history.cpp.
+static void makeSample(uint32_t nIndex, uint32_t nIntervalMs, uint32_t *pnTimeMs, int32_t *arrValues)
+{
+  *pnTimeMs = 0xFFFF0000UL + nIndex * nIntervalMs; // crosses the millis() rollover
+  double fLoad = 0.5 + 0.5 * sin(nIndex / 900.0);
+  for (uint8_t nSensor = 0; nSensor < NUM_SENSORS; nSensor++)
+  {
+    double fTempC = 35.0 + 10.0 * fLoad + nSensor * 1.5;
+    arrValues[nSensor] = (int32_t)lround(fTempC * 128.0) & ~0x1F; // 11 bit resolution
+  }
+  for (uint8_t nFan = 0; nFan < NUM_FANS; nFan++)
+  {
+    int32_t nDutyMilli = (int32_t)lround(30000 + 70000 * fLoad) / 100 * 100;
+    arrValues[NUM_SENSORS + nFan * 2] = nDutyMilli;
+    arrValues[NUM_SENSORS + nFan * 2 + 1] = nDutyMilli / 50 + (rand() % 3) * 30;
+  }
+}
+
+void setUp()
+{
+  srand(1);
+}
+
+void tearDown()
+{
+}
+
+static void test_trace()
+{
+  CHistoryRing ring(NUM_CHANNELS, 1024, 512);
+  Trace trace;
+  uint32_t nTimeMs = 0;
+  int32_t arrValues[NUM_CHANNELS];
+
+  for (uint32_t nIndex = 0; nIndex < 20000; nIndex++)
+  {
+    makeSample(nIndex, 800, &nTimeMs, arrValues);
+    appendSample(ring, trace, nTimeMs, arrValues);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(ring.getFirstSeq() == 0, "ring holds the whole trace");
+
+  bool bMatch = false;
+  uint32_t nDecoded = decodeAndCompare(ring, trace, &bMatch);
+  TEST_ASSERT_TRUE_MESSAGE(nDecoded == 20000, "every sample decoded");
+  TEST_ASSERT_TRUE_MESSAGE(bMatch, "decoded samples match the appended ones");
+
+  char szWhat[80];
+  snprintf(szWhat, sizeof(szWhat), "%.2f bytes per sample", (double)ring.getBytesUsed() / 20000);
+  TEST_MESSAGE(szWhat);
+}
+
+// Late and early ticks, gaps of several minutes, sensors dropping to
+// -127 C and back, and a duty jumping between 0 and 100%
+static void test_irregular()
+{
+  CHistoryRing ring(NUM_CHANNELS, 1024, 512);
+  Trace trace;
+  uint32_t nTimeMs = 5000;
+  int32_t arrValues[NUM_CHANNELS] = {};
+
+  for (uint32_t nIndex = 0; nIndex < 5000; nIndex++)
+  {
+    int32_t nJitterMs = rand() % 121 - 60;
+    nTimeMs += 800 + nJitterMs;
+    if (rand() % 200 == 0)
+    {
+      nTimeMs += 1000 + rand() % 600000;
+    }
+
+    for (uint8_t nSensor = 0; nSensor < NUM_SENSORS; nSensor++)
+    {
+      arrValues[nSensor] = (rand() % 50 == 0) ? -127 * 128 : 4480 + (rand() % 64 - 32) * 32;
+    }
+    for (uint8_t nFan = 0; nFan < NUM_FANS; nFan++)
+    {
+      arrValues[NUM_SENSORS + nFan * 2] = (rand() % 10 == 0) ? 100000 * (rand() % 2) : rand() % 100001;
+      arrValues[NUM_SENSORS + nFan * 2 + 1] = (rand() % 30 == 0) ? 0 : 600 + rand() % 2400;
+    }
+    appendSample(ring, trace, nTimeMs, arrValues);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(ring.getFirstSeq() == 0, "ring holds the whole sequence");
+
+  bool bMatch = false;
+  uint32_t nDecoded = decodeAndCompare(ring, trace, &bMatch);
+  TEST_ASSERT_TRUE_MESSAGE(nDecoded == 5000, "every sample decoded");
+  TEST_ASSERT_TRUE_MESSAGE(bMatch, "gaps, jitter and value jumps round trip");
+}
+
+// A ring far smaller than the trace keeps its newest blocks
+static void test_eviction()
+{
+  CHistoryRing ring(NUM_CHANNELS, 8, 256);
+  Trace trace;
+  uint32_t nTimeMs = 0;
+  int32_t arrValues[NUM_CHANNELS];
+
+  for (uint32_t nIndex = 0; nIndex < 20000; nIndex++)
+  {
+    makeSample(nIndex, 1000, &nTimeMs, arrValues);
+    appendSample(ring, trace, nTimeMs, arrValues);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(ring.getFirstSeq() > 0, "oldest blocks evicted");
+  TEST_ASSERT_TRUE_MESSAGE(ring.getNextSeq() - ring.getFirstSeq() <= 8, "at most the ring's blocks remain");
+
+  bool bMatch = false;
+  uint32_t nDecoded = decodeAndCompare(ring, trace, &bMatch);
+  TEST_ASSERT_TRUE_MESSAGE((nDecoded > 0) && (nDecoded < 20000), "only part of the trace remains");
+  TEST_ASSERT_TRUE_MESSAGE(bMatch, "remaining samples are the newest ones, contiguous");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_trace);
+  RUN_TEST(test_irregular);
+  RUN_TEST(test_eviction);
+  return UNITY_END();
+}
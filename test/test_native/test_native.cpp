@@ -0,0 +1,446 @@
+// Host build of the control loop: the real CTempSensors, CFanScheduler,
+// CPidController and CPwmFanControl against simulated sensors, PWM outputs
+// and tachs, on a simulated clock. Runs in a fraction of a second. The
+// scenario tests run in order on one simulated clock and pick up where the
+// previous one left off.
+//
+//   pio test -e native -f test_native
+
+#include <Hal.h>
+#include <CFanScheduler.h>
+#include <CPeriodicTick.h>
+#include <CPwmFanControl.h>
+#include <CSimPwmChannel.h>
+#include <CSimTachCounter.h>
+#include <CSimTempBus.h>
+#include <CTempSensors.h>
+#include <unity.h>
+
+#define NUM_FANS 2
+#define SIM_STEP_MS 10
+#define TACH_SAMPLE_PERIOD_MS 250
+#define SIM_FAN_MAX_RPM 3000.0f
+
+// Same PWM setup as the firmware
+#define FAN_PWM_RESOLUTION 10
+#define FAN_PWM_FREQUENCY 25000
+
+typedef CPwmFanControlT<FAN_PWM_RESOLUTION, FAN_PWM_FREQUENCY> CFanPwmControl;
+
+static_assert(sizeof(CFanPwmControl::dutycycle_t) == 2, "10 bit duty cycles fit 16 bits");
+static_assert(CFanPwmControl::percentToDutyCycle(30.0f) == 307, "30% rounds to 307 of 1023");
+static_assert(CFanPwmControl::percentToDutyCycle(150.0f) == CFanPwmControl::MAX_DUTY_CYCLE, "over 100% clamps");
+static_assert(CFanPwmControl::percentToDutyCycle(-5.0f) == 0, "under 0% clamps");
+static_assert(CFanPwmControl::percentToDutyCycle(NAN) == 0, "NaN maps to 0");
+
+PersistentSettings persistentSettings;
+
+CSimPwmChannel arrPwmChannels[NUM_FANS];
+CSimTachCounter arrTachCounters[NUM_FANS];
+CFanPwmControl arrFanCtrl[NUM_FANS] = {
+    {0, 0, 0},
+    {1, 0, 0}};
+
+CSimTempBus tempBus(2);
+CTempSensors tempSensors(&tempBus, HIGH_RES);
+
+FanControlSettings arrFanControls[NUM_FANS] = {
+    {&persistentSettings.arrFans[0], &arrFanCtrl[0], &tempSensors, 0, 1},
+    {&persistentSettings.arrFans[1], &arrFanCtrl[1], &tempSensors, 1, 0}};
+
+CFanScheduler fanScheduler(arrFanControls, NUM_FANS, 2000);
+
+// The firmware's temperature task loop; the period is set once the sensors
+// know their conversion time
+CPeriodicTick tempTick("taskTempUpdate");
+
+static uint32_t s_nNextUpdateMs = 0;
+static uint32_t s_nNextTachMs = 0;
+
+// Does what the firmware's tasks do, in simulated time: temperature
+// updates when the pending conversion is due, a scheduler tick per new
+// sample, tach sampling at its fixed cadence. Fans follow their duty cycle
+// linearly.
+static void runFor(uint32_t nMs)
+{
+  for (uint32_t nElapsedMs = 0; nElapsedMs < nMs; nElapsedMs += SIM_STEP_MS)
+  {
+    halSimAdvanceMicros(SIM_STEP_MS * 1000);
+    uint32_t nNowMs = halMillis();
+
+    for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+    {
+      arrTachCounters[nIndex].setRpm(arrPwmChannels[nIndex].getDutyFraction() * SIM_FAN_MAX_RPM);
+    }
+
+    if ((int32_t)(nNowMs - s_nNextUpdateMs) >= 0)
+    {
+      uint32_t nGeneration = tempSensors.getGeneration();
+      s_nNextUpdateMs = nNowMs + max(tempSensors.update(), (uint32_t)SIM_STEP_MS);
+
+      if (tempSensors.getGeneration() != nGeneration)
+      {
+        fanScheduler.tick();
+      }
+    }
+
+    if ((int32_t)(nNowMs - s_nNextTachMs) >= 0)
+    {
+      for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+      {
+        arrFanCtrl[nIndex].sampleTach();
+      }
+      s_nNextTachMs = nNowMs + TACH_SAMPLE_PERIOD_MS;
+    }
+  }
+}
+
+// What the firmware's temperature task does on its CPeriodicTick, with a
+// scheduler tick per new sample. Each conversion request takes nRequestMs
+// on the bus and each sensor read nReadMs plus a pseudo random 0-nSpreadMs,
+// so the work per wakeup varies. Returns the number of samples; the
+// smallest and largest dt the scheduler passed its PIDs (first tick left
+// out) go to pnMinDtMicros and pnMaxDtMicros.
+static uint32_t runPeriodic(CPeriodicTick *pTick, uint32_t nTicks, uint32_t nRequestMs, uint32_t nReadMs, uint32_t nSpreadMs, uint32_t *pnMinDtMicros, uint32_t *pnMaxDtMicros)
+{
+  uint32_t nSamples = 0;
+  uint32_t nSeed = 1;
+
+  *pnMinDtMicros = 0xffffffff;
+  *pnMaxDtMicros = 0;
+
+  for (uint32_t nTick = 0; nTick < nTicks; nTick++)
+  {
+    pTick->wait();
+
+    nSeed = nSeed * 1103515245 + 12345;
+    tempBus.setBusLatencyMs(nRequestMs, nReadMs + (nSeed >> 16) % (nSpreadMs + 1));
+
+    uint32_t nGeneration = tempSensors.getGeneration();
+    tempSensors.update();
+
+    if (tempSensors.getGeneration() != nGeneration)
+    {
+      fanScheduler.tick();
+      if (nSamples > 0)
+      {
+        *pnMinDtMicros = min(*pnMinDtMicros, fanScheduler.getLastDtMicros());
+        *pnMaxDtMicros = max(*pnMaxDtMicros, fanScheduler.getLastDtMicros());
+      }
+      nSamples++;
+    }
+  }
+
+  tempBus.setBusLatencyMs(0, 0);
+
+  return nSamples;
+}
+
+// Ramps a standalone fan down to its min duty cycle and then off, asking
+// for the new duty once per fade segment as the scheduler does. Checks it
+// lands on the min exactly, leaves the channel alone once there, and
+// switches off without fading through the stall range.
+static void test_ramp_to_off()
+{
+  char szWhat[128];
+
+  CSimPwmChannel pwmChannel;
+  CSimTachCounter tachCounter;
+  CFanPwmControl fanCtrl(2, 0, 0);
+
+  fanCtrl.begin(&pwmChannel, &tachCounter);
+  fanCtrl.setMinFanDutyCyclePercent(30.0f);
+  fanCtrl.setFanMinRuntimeMs(0);
+  fanCtrl.setRampRates(50.0f, 20.0f);
+  fanCtrl.setFadeSegmentMs(750);
+
+  // The fan has only just started, so it can't have stalled yet
+  fanCtrl.setFanDutyCyclePercent(80.0f);
+  snprintf(szWhat, sizeof(szWhat), "start: %u ms runtime right after the start, stalled %u", fanCtrl.getRuntimeMs(), fanCtrl.isStalled());
+  TEST_ASSERT_TRUE_MESSAGE((fanCtrl.getRuntimeMs() == 0) && !fanCtrl.isStalled(), szWhat);
+
+  for (uint8_t nTick = 0; nTick < 8; nTick++)
+  {
+    halDelayMs(750);
+    fanCtrl.setFanDutyCyclePercent(30.0f);
+  }
+  halDelayMs(750);
+
+  uint32_t nMinDutyCycle = fanCtrl.getLastSpecDutyCycle();
+  snprintf(szWhat, sizeof(szWhat), "ramp down: lands on the min duty cycle (%u of %u)", pwmChannel.read(), nMinDutyCycle);
+  TEST_ASSERT_TRUE_MESSAGE(pwmChannel.read() == nMinDutyCycle, szWhat);
+
+  uint32_t nWrites = pwmChannel.getNumWrites();
+  uint32_t nFades = pwmChannel.getNumFades();
+  for (uint8_t nTick = 0; nTick < 10; nTick++)
+  {
+    fanCtrl.setFanDutyCyclePercent(30.0f);
+    halDelayMs(750);
+  }
+  snprintf(szWhat, sizeof(szWhat), "ramp down: no writes or fades while at min (%u writes, %u fades)", pwmChannel.getNumWrites() - nWrites, pwmChannel.getNumFades() - nFades);
+  TEST_ASSERT_TRUE_MESSAGE((pwmChannel.getNumWrites() == nWrites) && (pwmChannel.getNumFades() == nFades), szWhat);
+
+  fanCtrl.setFanDutyCyclePercent(0.0f);
+  snprintf(szWhat, sizeof(szWhat), "ramp down: off from min is immediate (%u, %u fades)", pwmChannel.read(), pwmChannel.getNumFades() - nFades);
+  TEST_ASSERT_TRUE_MESSAGE((pwmChannel.read() == 0) && (pwmChannel.getNumFades() == nFades), szWhat);
+
+  // Over temperature cuts a running fade short
+  fanCtrl.setFanDutyCyclePercent(80.0f);
+  halDelayMs(100);
+  bool bFading = fanCtrl.isFading();
+  uint32_t nFadeStops = pwmChannel.getNumFadeStops();
+  fanCtrl.setFullSpeed();
+  snprintf(szWhat, sizeof(szWhat), "full speed: stops the fade and writes %u of %u", pwmChannel.read(), CFanPwmControl::MAX_DUTY_CYCLE);
+  TEST_ASSERT_TRUE_MESSAGE(bFading && (pwmChannel.getNumFadeStops() == nFadeStops + 1) && (pwmChannel.read() == CFanPwmControl::MAX_DUTY_CYCLE) && !fanCtrl.isFading(), szWhat);
+}
+
+// Samples every 800 ms, as the firmware's temperature task delivers them.
+// Each tick's fade segment has to fill the whole tick or the ramp runs
+// slow by the gap.
+static void test_sample_period_ramp()
+{
+  char szWhat[128];
+
+  CSimPwmChannel pwmChannel;
+  CSimTachCounter tachCounter;
+  CFanPwmControl fanCtrl(2, 0, 0);
+  fanCtrl.begin(&pwmChannel, &tachCounter);
+
+  FanSettings settings;
+  settings.fMinFanDutyCyclePercent = 0.0;
+  settings.fRampUpPercentPerSec = 20.0;
+  FanControlSettings arrFanControls[1] = {{&settings, &fanCtrl, &tempSensors, 0, 0}};
+  CFanScheduler scheduler(arrFanControls, 1);
+  scheduler.setSamplePeriodMs(800);
+  scheduler.init();
+
+  for (uint8_t nTick = 0; nTick < 4; nTick++)
+  {
+    fanCtrl.setFanDutyCyclePercent(100.0f);
+    halDelayMs(800);
+  }
+
+  float fPercent = pwmChannel.getDutyFraction() * 100.0f;
+  snprintf(szWhat, sizeof(szWhat), "ramp: 20%%/s over four 800 ms samples reaches %.1f%%", fPercent);
+  TEST_ASSERT_TRUE_MESSAGE(fabsf(fPercent - 64.0f) < 0.5f, szWhat);
+}
+
+// A new setpoint mid run, with the input held, moves the output by no more
+// than the integral step it would have taken anyway
+static void test_pid_setpoint_change()
+{
+  char szWhat[128];
+
+  CPidController pid(1.57f, 0.78f, 0.39f, PID_DIRECTION_REVERSE, 800);
+  pid.setOutputLimits(0.0f, 100.0f);
+  pid.setSetpoint(100.0f);
+  pid.setAutomatic(true, 105.0f, 0.0f);
+  for (uint8_t nStep = 0; nStep < 20; nStep++)
+  {
+    pid.compute(105.0f, 0.8f);
+  }
+
+  float fBefore = pid.getOutput();
+  pid.setSetpoint(95.0f);
+  float fAfter = pid.compute(105.0f, 0.001f);
+  snprintf(szWhat, sizeof(szWhat), "pid: setpoint 100F -> 95F moves the output %.1f%% -> %.1f%%", fBefore, fAfter);
+  TEST_ASSERT_TRUE_MESSAGE((fBefore > 10.0f) && (fBefore < 90.0f) && (fabsf(fAfter - fBefore) < 0.05f), szWhat);
+
+  // The new setpoint is still reached: the larger error winds the output up
+  for (uint8_t nStep = 0; nStep < 10; nStep++)
+  {
+    pid.compute(105.0f, 0.8f);
+  }
+  snprintf(szWhat, sizeof(szWhat), "pid: then keeps rising toward the new setpoint (%.1f%%)", pid.getOutput());
+  TEST_ASSERT_TRUE_MESSAGE(pid.getOutput() > fAfter + 5.0f, szWhat);
+}
+
+static void setTempF(uint8_t nIndex, float fTempF)
+{
+  tempBus.setTempC(nIndex, (fTempF - 32.0f) / 1.8f);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_discovery()
+{
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    persistentSettings.arrFans[nIndex].fRampUpPercentPerSec = 50.0;
+    persistentSettings.arrFans[nIndex].fRampDownPercentPerSec = 20.0;
+    arrFanCtrl[nIndex].begin(&arrPwmChannels[nIndex], &arrTachCounters[nIndex]);
+  }
+
+  setTempF(0, 70.0f);
+  setTempF(1, 70.0f);
+
+  tempSensors.setAsyncConversion(true);
+  tempSensors.begin();
+  fanScheduler.init();
+
+  TEST_ASSERT_TRUE_MESSAGE(tempSensors.getNumSensors() == 2, "two simulated sensors discovered");
+}
+
+// Cool: the PID stays at 0 and the fans off
+static void test_cool()
+{
+  char szWhat[128];
+
+  runFor(30000);
+  snprintf(szWhat, sizeof(szWhat), "70F: sensor reads %.2fF", tempSensors.getTempF(0));
+  TEST_ASSERT_TRUE_MESSAGE(fabsf(tempSensors.getTempF(0) - 70.0f) < 0.1f, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "70F: fans off (%.1f%%, %.1f%%)", arrFanCtrl[0].getLastDutyCyclePercent(), arrFanCtrl[1].getLastDutyCyclePercent());
+  TEST_ASSERT_TRUE_MESSAGE((arrFanCtrl[0].getLastDutyCycle() == 0) && (arrFanCtrl[1].getLastDutyCycle() == 0), szWhat);
+
+  float fSamplesPerSec = tempSensors.getSamplesPerSec();
+  uint32_t nTicks = fanScheduler.getTickCount();
+  snprintf(szWhat, sizeof(szWhat), "one tick per 750 ms conversion (%u ticks in 30 s, %.2f samples/s)", nTicks, fSamplesPerSec);
+  TEST_ASSERT_TRUE_MESSAGE((nTicks >= 38) && (nTicks <= 41) && (fabsf(fSamplesPerSec - 1.333f) < 0.05f), szWhat);
+}
+
+// Over full speed on fan 0's sensor: straight to 100% with no ramp
+static void test_full_speed()
+{
+  char szWhat[128];
+
+  setTempF(0, 104.0f);
+  runFor(3000);
+  snprintf(szWhat, sizeof(szWhat), "104F: fan 0 at full speed (%.1f%%)", arrFanCtrl[0].getLastDutyCyclePercent());
+  TEST_ASSERT_TRUE_MESSAGE(arrFanCtrl[0].getLastDutyCycle() == CFanPwmControl::MAX_DUTY_CYCLE, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "104F: fan 0 tach reads %u rpm", arrFanCtrl[0].getFanRpms());
+  TEST_ASSERT_TRUE_MESSAGE(fabsf((float)arrFanCtrl[0].getFanRpms() - SIM_FAN_MAX_RPM) < 30.0f, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "104F: fan 1 (own sensor, 70F) still off (%.1f%%)", arrFanCtrl[1].getLastDutyCyclePercent());
+  TEST_ASSERT_TRUE_MESSAGE(arrFanCtrl[1].getLastDutyCycle() == 0, szWhat);
+}
+
+// Just over the setpoint: fan 1 comes on and ramps up at 50%/s from the
+// min duty cycle instead of jumping
+static void test_ramp_up()
+{
+  char szWhat[128];
+
+  setTempF(1, 90.0f);
+  runFor(800);
+  float fEarlyPercent = arrFanCtrl[1].getLastDutyCyclePercent();
+  runFor(60000);
+  float fLatePercent = arrFanCtrl[1].getLastDutyCyclePercent();
+  snprintf(szWhat, sizeof(szWhat), "90F: fan 1 starts at the min duty cycle and ramps (%.1f%% -> %.1f%%)", fEarlyPercent, fLatePercent);
+  TEST_ASSERT_TRUE_MESSAGE((fEarlyPercent >= 30.0f) && (fEarlyPercent < 60.0f) && (fLatePercent > fEarlyPercent), szWhat);
+  snprintf(szWhat, sizeof(szWhat), "90F: fan 1 used the fade (%u fades)", arrPwmChannels[1].getNumFades());
+  TEST_ASSERT_TRUE_MESSAGE(arrPwmChannels[1].getNumFades() > 0, szWhat);
+}
+
+// Settings published mid run are applied on the next tick
+static void test_publish_settings()
+{
+  char szWhat[128];
+
+  FanSettings settings;
+  fanScheduler.getFanSettings(1, &settings);
+  settings.fFullSpeedTemp = 88.0;
+  TEST_ASSERT_TRUE_MESSAGE(fanScheduler.publishFanSettings(1, settings), "publish new full speed temp for fan 1");
+  runFor(1000);
+  snprintf(szWhat, sizeof(szWhat), "settings applied (%u), fan 1 now at full speed (%.1f%%)", fanScheduler.getSettingsApplied(), arrFanCtrl[1].getLastDutyCyclePercent());
+  TEST_ASSERT_TRUE_MESSAGE((fanScheduler.getSettingsApplied() == 1) && (arrFanCtrl[1].getLastDutyCycle() == CFanPwmControl::MAX_DUTY_CYCLE), szWhat);
+}
+
+// A sensor that drops off reads as disconnected (-127C)
+static void test_disconnected_sensor()
+{
+  char szWhat[128];
+
+  tempBus.setConnected(1, false);
+  runFor(2000);
+  snprintf(szWhat, sizeof(szWhat), "disconnected sensor reads %.1fC", tempSensors.getTempC(1));
+  TEST_ASSERT_TRUE_MESSAGE(fabsf(tempSensors.getTempC(1) + 127.0f) < 0.1f, szWhat);
+  tempBus.setConnected(1, true);
+}
+
+// The conversion every PID output goes through
+static void test_duty_conversions()
+{
+  TEST_ASSERT_TRUE_MESSAGE((arrFanCtrl[0].percentToDuty(30.0f) == 307) && (arrFanCtrl[0].percentToDuty(150.0f) == CFanPwmControl::MAX_DUTY_CYCLE) && (arrFanCtrl[0].percentToDuty(-5.0f) == 0),
+                           "percent to duty rounds and clamps");
+  TEST_ASSERT_TRUE_MESSAGE(arrFanCtrl[0].percentToDuty(NAN) == 0, "percent to duty maps NaN to 0");
+
+  // The scheduler only sees CPwmFanControl pointers, and still gets the
+  // compile time conversions
+  CPwmFanControl *pFanCtrl = &arrFanCtrl[0];
+  bool bSameConversions = (pFanCtrl->getMaxDutyCycle() == CFanPwmControl::MAX_DUTY_CYCLE);
+  for (float fPercent = -1.0f; fPercent <= 101.0f; fPercent += 0.37f)
+  {
+    bSameConversions = bSameConversions &&
+                       (pFanCtrl->percentToDuty(fPercent) == CFanPwmControl::percentToDutyCycle(fPercent)) &&
+                       (fabsf(pFanCtrl->dutyToPercent(pFanCtrl->percentToDuty(fPercent)) - fminf(fmaxf(fPercent, 0.0f), 100.0f)) <= 50.0f / CFanPwmControl::MAX_DUTY_CYCLE + 0.001f);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(bSameConversions, "percent/duty conversions through the base class match the constexpr ones");
+}
+
+// The firmware's temperature task: one wakeup per conversion + 50 ms, with
+// reads that take 5-45 ms each. The rate holds exactly and every wakeup
+// yields a sample; the scheduler's dt only varies by the spread.
+static void test_periodic()
+{
+  char szWhat[128];
+
+  tempTick.setPeriodMs(tempSensors.getConversionTimeMs() + 50);
+  const uint32_t nPeriodMicros = tempTick.getPeriodMs() * 1000;
+  uint32_t nMinDtMicros = 0;
+  uint32_t nMaxDtMicros = 0;
+  uint32_t nSamples = runPeriodic(&tempTick, 100, 2, 5, 40, &nMinDtMicros, &nMaxDtMicros);
+  snprintf(szWhat, sizeof(szWhat), "periodic: %u wakeups %u-%u us apart, %u overruns", tempTick.getTickCount(), tempTick.getMinDtMicros(), tempTick.getMaxDtMicros(), tempTick.getOverruns());
+  TEST_ASSERT_TRUE_MESSAGE((tempTick.getMinDtMicros() == nPeriodMicros) && (tempTick.getMaxDtMicros() == nPeriodMicros) && (tempTick.getOverruns() == 0), szWhat);
+  snprintf(szWhat, sizeof(szWhat), "periodic: %u samples in %u wakeups", nSamples, tempTick.getTickCount());
+  TEST_ASSERT_TRUE_MESSAGE(nSamples >= tempTick.getTickCount() - 1, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "periodic: PID dt %u-%u us (period %u us, reads vary by 2 x 40 ms)", nMinDtMicros, nMaxDtMicros, nPeriodMicros);
+  TEST_ASSERT_TRUE_MESSAGE((nMinDtMicros + 80000 >= nPeriodMicros) && (nMaxDtMicros <= nPeriodMicros + 80000), szWhat);
+}
+
+// A bus slower than the period: each wakeup overruns, missed deadlines are
+// dropped instead of run back to back, and the PID gets the real dt
+static void test_overrun()
+{
+  char szWhat[128];
+
+  const uint32_t nPeriodMicros = tempTick.getPeriodMs() * 1000;
+  uint32_t nMinDtMicros = 0;
+  uint32_t nMaxDtMicros = 0;
+  uint32_t nTicksBefore = tempTick.getTickCount();
+  uint32_t nStartMicros = halMicros();
+  runPeriodic(&tempTick, 20, 100, 400, 0, &nMinDtMicros, &nMaxDtMicros);
+  uint32_t nElapsedMicros = halMicros() - nStartMicros;
+  snprintf(szWhat, sizeof(szWhat), "overrun: %u overruns, %u skipped, %u wakeups in %u ms", tempTick.getOverruns(), tempTick.getSkippedTicks(), tempTick.getTickCount() - nTicksBefore, nElapsedMicros / 1000);
+  TEST_ASSERT_TRUE_MESSAGE((tempTick.getOverruns() > 0) && (tempTick.getSkippedTicks() > 0) && ((tempTick.getTickCount() - nTicksBefore) * nPeriodMicros <= nElapsedMicros + nPeriodMicros), szWhat);
+  snprintf(szWhat, sizeof(szWhat), "overrun: PID dt %u-%u us, the 900 ms the work takes", nMinDtMicros, nMaxDtMicros);
+  TEST_ASSERT_TRUE_MESSAGE((nMinDtMicros >= 900000) && (nMaxDtMicros <= 900000 + 1000), szWhat);
+
+  snprintf(szWhat, sizeof(szWhat), "%.1f simulated seconds, %u scheduler ticks, %u conversions",
+           (double)halSimGetMicros() / 1000000.0,
+           fanScheduler.getTickCount(),
+           tempBus.getNumConversions());
+  TEST_MESSAGE(szWhat);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_discovery);
+  RUN_TEST(test_cool);
+  RUN_TEST(test_full_speed);
+  RUN_TEST(test_ramp_up);
+  RUN_TEST(test_publish_settings);
+  RUN_TEST(test_disconnected_sensor);
+  RUN_TEST(test_duty_conversions);
+  RUN_TEST(test_ramp_to_off);
+  RUN_TEST(test_sample_period_ramp);
+  RUN_TEST(test_pid_setpoint_change);
+  RUN_TEST(test_periodic);
+  RUN_TEST(test_overrun);
+  return UNITY_END();
+}
@@ -0,0 +1,237 @@
+#ifndef __PIDV1_H__
+#define __PIDV1_H__
+
+// Host port of the PID class from PID_v1 1.2.1 (Brett Beauregard, MIT
+// licence), the library CFanScheduler used before CPidController. The
+// arithmetic is unchanged, in double. The only change is that Compute()
+// takes the time in ms instead of calling millis().
+
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+#define P_ON_M 0
+#define P_ON_E 1
+
+class PID
+{
+public:
+  PID(double *Input, double *Output, double *Setpoint, double Kp, double Ki, double Kd, int POn, int ControllerDirection)
+  {
+    myOutput = Output;
+    myInput = Input;
+    mySetpoint = Setpoint;
+    inAuto = false;
+
+    SetOutputLimits(0, 255);
+
+    SampleTime = 100;
+
+    SetControllerDirection(ControllerDirection);
+    SetTunings(Kp, Ki, Kd, POn);
+
+    lastTime = 0 - SampleTime;
+  }
+
+  PID(double *Input, double *Output, double *Setpoint, double Kp, double Ki, double Kd, int ControllerDirection)
+      : PID(Input, Output, Setpoint, Kp, Ki, Kd, P_ON_E, ControllerDirection)
+  {
+  }
+
+  bool Compute(unsigned long now)
+  {
+    if (!inAuto)
+    {
+      return false;
+    }
+    unsigned long timeChange = (now - lastTime);
+    if (timeChange >= SampleTime)
+    {
+      double input = *myInput;
+      double error = *mySetpoint - input;
+      double dInput = (input - lastInput);
+      outputSum += (ki * error);
+
+      if (!pOnE)
+      {
+        outputSum -= kp * dInput;
+      }
+
+      if (outputSum > outMax)
+      {
+        outputSum = outMax;
+      }
+      else if (outputSum < outMin)
+      {
+        outputSum = outMin;
+      }
+
+      double output;
+      if (pOnE)
+      {
+        output = kp * error;
+      }
+      else
+      {
+        output = 0;
+      }
+
+      output += outputSum - kd * dInput;
+
+      if (output > outMax)
+      {
+        output = outMax;
+      }
+      else if (output < outMin)
+      {
+        output = outMin;
+      }
+      *myOutput = output;
+
+      lastInput = input;
+      lastTime = now;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  void SetTunings(double Kp, double Ki, double Kd, int POn)
+  {
+    if (Kp < 0 || Ki < 0 || Kd < 0)
+    {
+      return;
+    }
+
+    pOn = POn;
+    pOnE = POn == P_ON_E;
+
+    dispKp = Kp;
+    dispKi = Ki;
+    dispKd = Kd;
+
+    double SampleTimeInSec = ((double)SampleTime) / 1000;
+    kp = Kp;
+    ki = Ki * SampleTimeInSec;
+    kd = Kd / SampleTimeInSec;
+
+    if (controllerDirection == REVERSE)
+    {
+      kp = (0 - kp);
+      ki = (0 - ki);
+      kd = (0 - kd);
+    }
+  }
+
+  void SetTunings(double Kp, double Ki, double Kd)
+  {
+    SetTunings(Kp, Ki, Kd, pOn);
+  }
+
+  void SetSampleTime(int NewSampleTime)
+  {
+    if (NewSampleTime > 0)
+    {
+      double ratio = (double)NewSampleTime / (double)SampleTime;
+      ki *= ratio;
+      kd /= ratio;
+      SampleTime = (unsigned long)NewSampleTime;
+    }
+  }
+
+  void SetOutputLimits(double Min, double Max)
+  {
+    if (Min >= Max)
+    {
+      return;
+    }
+    outMin = Min;
+    outMax = Max;
+
+    if (inAuto)
+    {
+      if (*myOutput > outMax)
+      {
+        *myOutput = outMax;
+      }
+      else if (*myOutput < outMin)
+      {
+        *myOutput = outMin;
+      }
+
+      if (outputSum > outMax)
+      {
+        outputSum = outMax;
+      }
+      else if (outputSum < outMin)
+      {
+        outputSum = outMin;
+      }
+    }
+  }
+
+  void SetMode(int Mode)
+  {
+    bool newAuto = (Mode == AUTOMATIC);
+    if (newAuto && !inAuto)
+    {
+      Initialize();
+    }
+    inAuto = newAuto;
+  }
+
+  void SetControllerDirection(int Direction)
+  {
+    if (inAuto && Direction != controllerDirection)
+    {
+      kp = (0 - kp);
+      ki = (0 - ki);
+      kd = (0 - kd);
+    }
+    controllerDirection = Direction;
+  }
+
+private:
+  void Initialize()
+  {
+    outputSum = *myOutput;
+    lastInput = *myInput;
+    if (outputSum > outMax)
+    {
+      outputSum = outMax;
+    }
+    else if (outputSum < outMin)
+    {
+      outputSum = outMin;
+    }
+  }
+
+  double dispKp = 0;
+  double dispKi = 0;
+  double dispKd = 0;
+
+  double kp = 0;
+  double ki = 0;
+  double kd = 0;
+
+  int controllerDirection = DIRECT;
+  int pOn = P_ON_E;
+
+  double *myInput;
+  double *myOutput;
+  double *mySetpoint;
+
+  unsigned long lastTime;
+  double outputSum = 0;
+  double lastInput = 0;
+
+  unsigned long SampleTime;
+  double outMin = 0;
+  double outMax = 0;
+  bool inAuto;
+  bool pOnE = true;
+};
+
+#endif // #ifndef __PIDV1_H__
@@ -0,0 +1,235 @@
+// Runs PID_v1 (the PidV1.h port) and CPidController side by side with the
+// settings CFanScheduler uses: reverse direction, 0..100% output limits and
+// the conversion period as the sample time. First on a scripted input
+// sequence, then each closing the loop on its own copy of the thermal
+// plant from tools/plant_sim. The outputs have to match within float
+// rounding.
+//
+// Not compared: retuning or moving the setpoint while running.
+// CPidController folds both into the integral so the output doesn't jump;
+// PID_v1 doesn't.
+//
+//   pio test -e native -f test_pid_compare
+
+#include "PidV1.h"
+#include <ThermalPlant.h>
+#include <CPidController.h>
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+
+#define SAMPLE_TIME_MS 750
+#define SETPOINT_F 105.0
+#define KP 1.57
+#define KI 0.78
+#define KD 0.39
+
+// Percentage points of duty. float against double over a few thousand
+// steps stays well inside this.
+#define OUTPUT_TOLERANCE 0.01
+
+static float cToF(float fTempC)
+{
+  return fTempC * 1.8f + 32.0f;
+}
+
+// Both controllers set up the way the scheduler does it, switched to
+// automatic at fFirstInput with the output at 0
+class CPidPair
+{
+public:
+  CPidPair(const double fFirstInput)
+      : m_pidV1(&m_fInput, &m_fOutput, &m_fSetpoint, KP, KI, KD, REVERSE),
+        m_pid((float)KP, (float)KI, (float)KD, PID_DIRECTION_REVERSE, SAMPLE_TIME_MS)
+  {
+    m_pidV1.SetSampleTime(SAMPLE_TIME_MS);
+    m_pidV1.SetOutputLimits(0.0, 100.0);
+    m_fInput = fFirstInput;
+    m_pidV1.SetMode(AUTOMATIC);
+
+    m_pid.setOutputLimits(0.0f, 100.0f);
+    m_pid.setSetpoint((float)SETPOINT_F);
+    m_pid.setAutomatic(true, (float)fFirstInput, 0.0f);
+  }
+
+  // One sample period later; bExplicitDt uses compute(input, dt) like the
+  // scheduler's measured tick
+  void compute(const double fInputV1, const float fInput, const bool bExplicitDt)
+  {
+    m_nNowMs += SAMPLE_TIME_MS;
+    m_fInput = fInputV1;
+    m_pidV1.Compute(m_nNowMs);
+
+    if (bExplicitDt)
+    {
+      m_pid.compute(fInput, (float)SAMPLE_TIME_MS / 1000.0f);
+    }
+    else
+    {
+      m_pid.compute(fInput);
+    }
+
+    double fDiff = fabs(m_fOutput - (double)m_pid.getOutput());
+    if (fDiff > m_fMaxDiff)
+    {
+      m_fMaxDiff = fDiff;
+    }
+    m_bHitMin = m_bHitMin || (m_fOutput == 0.0);
+    m_bHitMax = m_bHitMax || (m_fOutput == 100.0);
+  }
+
+  double getOutputV1()
+  {
+    return m_fOutput;
+  }
+
+  float getOutput()
+  {
+    return m_pid.getOutput();
+  }
+
+  double getMaxDiff()
+  {
+    return m_fMaxDiff;
+  }
+
+  bool hitBothLimits()
+  {
+    return m_bHitMin && m_bHitMax;
+  }
+
+private:
+  double m_fInput = 0.0;
+  double m_fOutput = 0.0;
+  double m_fSetpoint = SETPOINT_F;
+  PID m_pidV1;
+  CPidController m_pid;
+  unsigned long m_nNowMs = 0;
+  double m_fMaxDiff = 0.0;
+  bool m_bHitMin = false;
+  bool m_bHitMax = false;
+};
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Scripted temperatures around the setpoint: a slow rise through it, a
+// plateau with sensor noise in 1/16 C steps, a step well above (the
+// output saturates and the integral has to unwind), then a fall below
+static double scriptedInputF(uint32_t nStep, uint32_t *pnSeed)
+{
+  double fTempF = 0.0;
+
+  if (nStep < 400)
+  {
+    fTempF = 98.0 + nStep * 0.025;
+  }
+  else if (nStep < 1200)
+  {
+    *pnSeed = *pnSeed * 1664525u + 1013904223u;
+    fTempF = 108.0 + (int32_t)((*pnSeed >> 16) % 5 - 2) * 0.1125;
+  }
+  else if (nStep < 1600)
+  {
+    fTempF = 125.0;
+  }
+  else
+  {
+    fTempF = 95.0 + (nStep % 40) * 0.05;
+  }
+
+  return fTempF;
+}
+
+static void runScripted(const bool bExplicitDt)
+{
+  char szWhat[160];
+  uint32_t nSeed = 1;
+  CPidPair pair(scriptedInputF(0, &nSeed));
+
+  for (uint32_t nStep = 1; nStep < 2000; nStep++)
+  {
+    double fTempF = scriptedInputF(nStep, &nSeed);
+    pair.compute(fTempF, (float)fTempF, bExplicitDt);
+  }
+
+  snprintf(szWhat, sizeof(szWhat), "scripted, %s: outputs match within %.2e%% (limit %.2f%%)", bExplicitDt ? "compute(input, dt)" : "compute(input)", pair.getMaxDiff(), OUTPUT_TOLERANCE);
+  TEST_ASSERT_TRUE_MESSAGE(pair.getMaxDiff() < OUTPUT_TOLERANCE, szWhat);
+  TEST_ASSERT_TRUE_MESSAGE(pair.hitBothLimits(), "scripted: the sequence drives the output to both limits");
+}
+
+static void test_scripted()
+{
+  runScripted(false);
+}
+
+static void test_scripted_explicit_dt()
+{
+  runScripted(true);
+}
+
+// Each controller drives its own plant, so any difference feeds back
+// through the temperature it sees next
+static void test_closed_loop()
+{
+  char szWhat[160];
+  PlantParams params;
+  CThermalPlant plantV1(params);
+  CThermalPlant plant(params);
+  const uint32_t nSubSteps = 15;
+  const float fSubStepSec = (float)SAMPLE_TIME_MS / 1000.0f / nSubSteps;
+  const uint32_t nNumSteps = 3600000 / SAMPLE_TIME_MS;
+  float fMaxTempDiffF = 0.0f;
+  float fLoadedTempF = 0.0f;
+  float fLoadedOutput = 0.0f;
+
+  // Start just under the setpoint (104 F)
+  plantV1.reset(40.0f);
+  plant.reset(40.0f);
+  CPidPair pair(cToF(plant.getSensorC()));
+
+  // 45 minutes at 60 W, which would settle near 126 F with the fan off,
+  // then 20 W, which the enclosure sheds on its own
+  for (uint32_t nStep = 0; nStep < nNumSteps; nStep++)
+  {
+    float fLoadWatts = (nStep < nNumSteps * 3 / 4) ? 60.0f : 20.0f;
+    if (nStep == nNumSteps * 3 / 4)
+    {
+      fLoadedTempF = cToF(plant.getSensorC());
+      fLoadedOutput = pair.getOutput();
+    }
+
+    for (uint32_t nSubStep = 0; nSubStep < nSubSteps; nSubStep++)
+    {
+      plantV1.step(fSubStepSec, fLoadWatts, (float)pair.getOutputV1() / 100.0f);
+      plant.step(fSubStepSec, fLoadWatts, pair.getOutput() / 100.0f);
+    }
+
+    pair.compute(cToF(plantV1.getSensorC()), cToF(plant.getSensorC()), true);
+    fMaxTempDiffF = fmaxf(fMaxTempDiffF, fabsf(cToF(plantV1.getSensorC()) - cToF(plant.getSensorC())));
+  }
+
+  snprintf(szWhat, sizeof(szWhat), "closed loop: outputs match within %.2e%% (limit %.2f%%)", pair.getMaxDiff(), OUTPUT_TOLERANCE);
+  TEST_ASSERT_TRUE_MESSAGE(pair.getMaxDiff() < OUTPUT_TOLERANCE, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "closed loop: sensor temperatures match within %.2e F", fMaxTempDiffF);
+  TEST_ASSERT_TRUE_MESSAGE(fMaxTempDiffF < 0.01f, szWhat);
+  snprintf(szWhat, sizeof(szWhat), "closed loop: under load it stays near the setpoint (%.2f F at %.1f%% duty)", fLoadedTempF, fLoadedOutput);
+  TEST_ASSERT_TRUE_MESSAGE((fabsf(fLoadedTempF - (float)SETPOINT_F) < 1.0f) && (fLoadedOutput > 0.0f) && (fLoadedOutput < 100.0f), szWhat);
+  snprintf(szWhat, sizeof(szWhat), "closed loop: the fan winds down with the load gone (%.1f%%)", pair.getOutput());
+  TEST_ASSERT_TRUE_MESSAGE(pair.getOutput() == 0.0f, szWhat);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_scripted);
+  RUN_TEST(test_scripted_explicit_dt);
+  RUN_TEST(test_closed_loop);
+  return UNITY_END();
+}
@@ -0,0 +1,199 @@
+// Exercises CSettingsStore on Linux through CFileSettingsBackend: round
+// trip, corruption and validation fallback, migration from the version 1 layout and
+// write coalescing.
+//
+//   pio test -e native -f test_settings_store
+
+#include <CSettingsStore.h>
+#include <CFileSettingsBackend.h>
+#include <Crc32.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define SETTINGS_PATH "/tmp/test_settings_store.bin"
+
+// Writes a version 1 blob by hand: the original firmware's fields for two
+// fans, gains in 8 bit duty steps
+static void writeV1Blob(CFileSettingsBackend &backend)
+{
+  uint8_t arrBlob[256];
+  size_t nPos = 12;
+  arrBlob[nPos++] = 2;
+  for (uint8_t nFan = 0; nFan < 2; nFan++)
+  {
+    double arrDoubles[7] = {105.0, 4.0, 2.0, 1.0, 110.0, 30.0, 0.0};
+    memcpy(arrBlob + nPos, arrDoubles, sizeof(arrDoubles));
+    nPos += sizeof(arrDoubles);
+    arrBlob[nPos++] = 1;
+    uint32_t nMinRuntimeMs = 60000;
+    memcpy(arrBlob + nPos, &nMinRuntimeMs, 4);
+    nPos += 4;
+  }
+
+  uint32_t nMagic = SETTINGS_MAGIC;
+  uint16_t nVersion = 1;
+  uint16_t nPayloadLen = (uint16_t)(nPos - 12);
+  uint32_t nCrc = computeCrc32(arrBlob + 12, nPayloadLen);
+  memcpy(arrBlob, &nMagic, 4);
+  memcpy(arrBlob + 4, &nVersion, 2);
+  memcpy(arrBlob + 6, &nPayloadLen, 2);
+  memcpy(arrBlob + 8, &nCrc, 4);
+  backend.write(arrBlob, nPos);
+}
+
+// Saves fan 1 with a setpoint of 97.5 F and a 12.5 %/s ramp up
+static void saveFan1()
+{
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  PersistentSettings settings;
+  CSettingsStore store(&backend, &settings);
+  store.load();
+  settings.arrFans[1].fPidSetpoint = 97.5;
+  settings.arrFans[1].fRampUpPercentPerSec = 12.5;
+  store.saveNow();
+}
+
+void setUp()
+{
+  remove(SETTINGS_PATH);
+}
+
+void tearDown()
+{
+}
+
+static void test_round_trip()
+{
+  {
+    CFileSettingsBackend backend(SETTINGS_PATH);
+    PersistentSettings settings;
+    CSettingsStore store(&backend, &settings);
+    TEST_ASSERT_TRUE_MESSAGE(store.load() == SETTINGS_DEFAULTS, "nothing stored gives defaults");
+    TEST_ASSERT_TRUE_MESSAGE(settings.arrFans[0].fPidSetpoint == FanSettings().fPidSetpoint, "defaults untouched");
+
+    settings.arrFans[1].fPidSetpoint = 97.5;
+    settings.arrFans[1].fRampUpPercentPerSec = 12.5;
+    TEST_ASSERT_TRUE_MESSAGE(store.saveNow() && (backend.getWriteCount() == 1), "save writes once");
+    TEST_ASSERT_TRUE_MESSAGE(store.saveNow() && (backend.getWriteCount() == 1), "saving unchanged settings skips the write");
+  }
+
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  PersistentSettings settings;
+  CSettingsStore store(&backend, &settings);
+
+  char szWhat[80];
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  SettingsLoadResult result = store.load();
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  snprintf(szWhat, sizeof(szWhat), "load %.1f us", elapsed.count());
+  TEST_MESSAGE(szWhat);
+
+  TEST_ASSERT_TRUE_MESSAGE((result == SETTINGS_LOADED) && (settings.arrFans[1].fPidSetpoint == 97.5) &&
+                               (settings.arrFans[1].fRampUpPercentPerSec == 12.5),
+                           "round trip");
+}
+
+static void test_crc_mismatch()
+{
+  saveFan1();
+
+  // Flip one payload byte
+  FILE *pFile = fopen(SETTINGS_PATH, "r+b");
+  TEST_ASSERT_TRUE_MESSAGE(pFile != NULL, "saved settings file exists");
+  fseek(pFile, 40, SEEK_SET);
+  int nByte = fgetc(pFile);
+  fseek(pFile, 40, SEEK_SET);
+  fputc(nByte ^ 0x01, pFile);
+  fclose(pFile);
+
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  PersistentSettings settings;
+  CSettingsStore store(&backend, &settings);
+  TEST_ASSERT_TRUE_MESSAGE((store.load() == SETTINGS_DEFAULTS_CORRUPT) && (settings.arrFans[1].fPidSetpoint == FanSettings().fPidSetpoint),
+                           "CRC mismatch falls back to defaults");
+}
+
+// A well formed blob carrying settings the controller must not run with
+static void test_validation()
+{
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  PersistentSettings settings;
+  settings.arrFans[0].fFullSpeedTemp = settings.arrFans[0].fPidSetpoint - 1.0;
+  uint8_t arrBlob[SETTINGS_MAX_BLOB];
+  backend.write(arrBlob, CSettingsStore::serialize(&settings, arrBlob, sizeof(arrBlob)));
+
+  PersistentSettings loaded;
+  CSettingsStore store(&backend, &loaded);
+  const char *pszError = NULL;
+  TEST_ASSERT_TRUE_MESSAGE(!CSettingsStore::validate(&settings.arrFans[0], &pszError) && (pszError != NULL), "full speed below setpoint fails validation");
+  TEST_ASSERT_TRUE_MESSAGE(CSettingsStore::validate(&loaded.arrFans[0]), "defaults pass validation");
+  TEST_ASSERT_TRUE_MESSAGE(store.load() == SETTINGS_DEFAULTS_CORRUPT, "blob with invalid settings falls back to defaults");
+}
+
+static void test_migration()
+{
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  writeV1Blob(backend);
+
+  PersistentSettings settings;
+  CSettingsStore store(&backend, &settings);
+  TEST_ASSERT_TRUE_MESSAGE(store.load() == SETTINGS_MIGRATED, "version 1 blob is migrated");
+  TEST_ASSERT_TRUE_MESSAGE(std::fabs(settings.arrFans[0].fPidKp - 4.0 * 100.0 / 255.0) < 1e-9, "gains converted to % per F");
+  TEST_ASSERT_TRUE_MESSAGE((settings.arrFans[1].nFanMinRuntimeMs == 60000) && (settings.arrFans[1].fRampDownPercentPerSec == 0.0), "other fields carried over");
+
+  PersistentSettings reloaded;
+  CSettingsStore reloadStore(&backend, &reloaded);
+  TEST_ASSERT_TRUE_MESSAGE((reloadStore.load() == SETTINGS_LOADED) && (reloadStore.getLoadedVersion() == SETTINGS_VERSION), "migrated blob rewritten in the current layout");
+}
+
+static void test_coalescing()
+{
+  CFileSettingsBackend backend(SETTINGS_PATH);
+  PersistentSettings settings;
+  CSettingsStore store(&backend, &settings, 5000, 60000);
+  store.load();
+  uint32_t nWritesBefore = backend.getWriteCount();
+
+  // 50 edits 100 ms apart, then quiet
+  uint32_t nNowMs = 0;
+  for (int nEdit = 0; nEdit < 50; nEdit++)
+  {
+    settings.arrFans[0].fPidSetpoint = 90.0 + nEdit;
+    store.markDirty(nNowMs);
+    store.service(nNowMs);
+    nNowMs += 100;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(backend.getWriteCount() == nWritesBefore, "no write while edits keep coming");
+  for (int nTick = 0; nTick < 10; nTick++)
+  {
+    nNowMs += 1000;
+    store.service(nNowMs);
+  }
+  TEST_ASSERT_TRUE_MESSAGE((backend.getWriteCount() == nWritesBefore + 1) && !store.isDirty(), "burst coalesced into one write");
+
+  // An edit every 2 s never goes quiet; the max delay still forces writes
+  nWritesBefore = backend.getWriteCount();
+  for (int nEdit = 0; nEdit < 90; nEdit++)
+  {
+    settings.arrFans[0].fPidSetpoint = 50.0 + nEdit;
+    store.markDirty(nNowMs);
+    store.service(nNowMs);
+    nNowMs += 2000;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(backend.getWriteCount() - nWritesBefore == 2, "continuous edits written once per max delay");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_crc_mismatch);
+  RUN_TEST(test_validation);
+  RUN_TEST(test_migration);
+  RUN_TEST(test_coalescing);
+  return UNITY_END();
+}
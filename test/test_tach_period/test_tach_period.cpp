@@ -0,0 +1,219 @@
+// Feeds synthetic tach edge streams to CTachEdgeRing and CTachPeriodEstimator
+// (src/CTachPeriodEstimator.h): steady speed with uneven pulse spacing, a
+// fan slowing down, a stall, micros() wrapping and a producer lapping a
+// reader mid-snapshot.
+//
+//   pio test -e native -f test_tach_period
+
+#include <CTachPeriodEstimator.h>
+#include <unity.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define PULSES_PER_REV 2
+#define STALL_TIMEOUT_MICROS 500000
+
+// Pushes nNumEdges edges of a fan at nRpm, starting at nFirstMicros. With
+// two pulses per revolution the first pulse of each revolution is followed
+// by fHighShare of the revolution, the second by the rest, like a rotor
+// with its magnets off center. Returns the time of the last edge.
+static uint32_t pushSteady(CTachEdgeRing &ring, uint32_t nFirstMicros, uint32_t nRpm, float fHighShare, uint32_t nNumEdges)
+{
+  uint32_t nRevMicros = 60000000 / nRpm;
+  uint32_t nFirstGapMicros = (uint32_t)(nRevMicros * fHighShare);
+  uint32_t nEdgeMicros = nFirstMicros;
+
+  for (uint32_t nEdge = 0; nEdge < nNumEdges; nEdge++)
+  {
+    if (nEdge > 0)
+    {
+      nEdgeMicros += (nEdge % 2 == 1) ? nFirstGapMicros : (nRevMicros - nFirstGapMicros);
+    }
+    ring.push(nEdgeMicros);
+  }
+
+  return nEdgeMicros;
+}
+
+static uint32_t estimate(const CTachEdgeRing &ring, uint8_t nMaxEdges, uint32_t nNowMicros, bool *pbStalled)
+{
+  uint32_t arrEdgeMicros[CTachEdgeRing::MAX_SNAPSHOT];
+  uint8_t nNumEdges = ring.snapshot(arrEdgeMicros, nMaxEdges);
+
+  return CTachPeriodEstimator::estimateRpm(arrEdgeMicros, nNumEdges, nNowMicros, STALL_TIMEOUT_MICROS, PULSES_PER_REV, pbStalled);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Steady 1500 rpm, pulses at 30/70 of a revolution. Whole revolutions
+// cancel the unevenness for any snapshot of three edges or more; a single
+// period is 30% or 70% of a revolution and reads far off.
+static void test_steady()
+{
+  char szWhat[160];
+  bool bStalled = false;
+
+  CTachEdgeRing ring;
+  uint32_t nLastMicros = pushSteady(ring, 1000, 1500, 0.3f, 12);
+  bool bAllExact = true;
+  for (uint8_t nMaxEdges = 3; nMaxEdges <= CTachEdgeRing::MAX_SNAPSHOT; nMaxEdges++)
+  {
+    uint32_t nRpm = estimate(ring, nMaxEdges, nLastMicros + 5000, &bStalled);
+    bAllExact = bAllExact && (nRpm == 1500) && !bStalled;
+  }
+  snprintf(szWhat, sizeof(szWhat), "steady: 1500 rpm from 3..%u edges, 30/70 pulse spacing", CTachEdgeRing::MAX_SNAPSHOT);
+  TEST_ASSERT_TRUE_MESSAGE(bAllExact, szWhat);
+
+  uint32_t nOnePeriodRpm = estimate(ring, 2, nLastMicros + 5000, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "steady: a single uneven period reads %u rpm", nOnePeriodRpm);
+  TEST_ASSERT_TRUE_MESSAGE(nOnePeriodRpm != 1500, szWhat);
+}
+
+// Slowing down: the last edge was a 3000 rpm pulse, but nothing has come
+// for 50 ms. The open interval bounds the estimate to one pulse in 50 ms.
+static void test_slowing()
+{
+  char szWhat[160];
+  bool bStalled = false;
+
+  CTachEdgeRing ring;
+  uint32_t nLastMicros = pushSteady(ring, 1000, 3000, 0.5f, 9);
+  uint32_t nFreshRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + 1000, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "slowing: 3000 rpm right after an edge (%u rpm)", nFreshRpm);
+  TEST_ASSERT_TRUE_MESSAGE((nFreshRpm == 3000) && !bStalled, szWhat);
+
+  uint32_t nBoundRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + 50000, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "slowing: 50 ms since the last edge bounds it to %u rpm", nBoundRpm);
+  TEST_ASSERT_TRUE_MESSAGE((nBoundRpm == 60000000 / (50000 * PULSES_PER_REV)) && !bStalled, szWhat);
+
+  // Just under the measured period the edges still decide
+  uint32_t nPeriodMicros = 60000000 / 3000 / PULSES_PER_REV;
+  uint32_t nEdgeRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + nPeriodMicros, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "slowing: one period since the last edge still reads %u rpm", nEdgeRpm);
+  TEST_ASSERT_TRUE_MESSAGE(nEdgeRpm == 3000, szWhat);
+}
+
+// Stall: no edge within the timeout reads 0 and stalled
+static void test_stall()
+{
+  char szWhat[160];
+  bool bStalled = false;
+
+  CTachEdgeRing ring;
+  TEST_ASSERT_TRUE_MESSAGE((estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, 1000, &bStalled) == 0) && bStalled, "stall: no edges at all");
+
+  uint32_t nLastMicros = pushSteady(ring, 1000, 600, 0.5f, 5);
+  uint32_t nRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + STALL_TIMEOUT_MICROS, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "stall: at the timeout still running (%u rpm)", nRpm);
+  TEST_ASSERT_TRUE_MESSAGE((nRpm > 0) && !bStalled, szWhat);
+
+  nRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + STALL_TIMEOUT_MICROS + 1, &bStalled);
+  TEST_ASSERT_TRUE_MESSAGE((nRpm == 0) && bStalled, "stall: past the timeout reads 0 and stalled");
+}
+
+// micros() wraps between the edges, and again between the last edge and now
+static void test_wrap()
+{
+  char szWhat[160];
+  bool bStalled = false;
+
+  CTachEdgeRing ring;
+  uint32_t nLastMicros = pushSteady(ring, 0xFFFFFFFFu - 100000, 1500, 0.3f, 8);
+  uint32_t nRpm = estimate(ring, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + 5000, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "wrap: edges straddling the wrap read %u rpm", nRpm);
+  TEST_ASSERT_TRUE_MESSAGE((nLastMicros < 100000) && (nRpm == 1500) && !bStalled, szWhat);
+
+  CTachEdgeRing ringBefore;
+  nLastMicros = pushSteady(ringBefore, 0xFFFFFFFFu - 90000, 1500, 0.3f, 5);
+  nRpm = estimate(ringBefore, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + 15000, &bStalled);
+  snprintf(szWhat, sizeof(szWhat), "wrap: now wrapped past the last edge reads %u rpm", nRpm);
+  TEST_ASSERT_TRUE_MESSAGE((nLastMicros > 0xFFFFFFFFu - 15000) && (nRpm == 1500) && !bStalled, szWhat);
+
+  nRpm = estimate(ringBefore, CTachEdgeRing::MAX_SNAPSHOT, nLastMicros + STALL_TIMEOUT_MICROS + 1, &bStalled);
+  TEST_ASSERT_TRUE_MESSAGE((nRpm == 0) && bStalled, "wrap: stall timeout across the wrap");
+}
+
+// A producer thread pushes consecutive values as fast as it can while the
+// reader snapshots. A torn copy would show a gap; a lapped reader retries
+// and, if lapped every time, returns nothing rather than a tear.
+static void test_lapping()
+{
+  char szWhat[160];
+
+  CTachEdgeRing ring;
+  std::atomic<bool> bStop(false);
+  std::thread producer([&ring, &bStop]()
+  {
+    uint32_t nValue = 0;
+    while (!bStop.load(std::memory_order_relaxed))
+    {
+      ring.push(++nValue);
+    }
+  });
+
+  uint32_t nSnapshots = 0;
+  uint32_t nEmpty = 0;
+  uint32_t nTorn = 0;
+  uint32_t nStale = 0;
+  uint32_t nLapped = 0;
+  uint32_t arrEdgeMicros[CTachEdgeRing::MAX_SNAPSHOT];
+  while ((nSnapshots < 2000000) || (ring.getEdgeCount() < 1000000))
+  {
+    uint32_t nCountBefore = ring.getEdgeCount();
+    uint8_t nNumEdges = ring.snapshot(arrEdgeMicros, CTachEdgeRing::MAX_SNAPSHOT);
+
+    // Enough pushes during the call to overwrite what a single pass copied
+    if ((ring.getEdgeCount() - nCountBefore) >= (uint32_t)(CTachEdgeRing::CAPACITY - CTachEdgeRing::MAX_SNAPSHOT))
+    {
+      nLapped++;
+    }
+
+    if (nNumEdges == 0)
+    {
+      nEmpty++;
+    }
+    else if (arrEdgeMicros[nNumEdges - 1] < nCountBefore)
+    {
+      nStale++;
+    }
+    for (uint8_t nIndex = 1; nIndex < nNumEdges; nIndex++)
+    {
+      if (arrEdgeMicros[nIndex] != arrEdgeMicros[nIndex - 1] + 1)
+      {
+        nTorn++;
+        break;
+      }
+    }
+    nSnapshots++;
+  }
+
+  bStop = true;
+  producer.join();
+
+  snprintf(szWhat, sizeof(szWhat), "lapping: %u snapshots against %u pushes, %u torn, %u stale (%u gave up)", nSnapshots, ring.getEdgeCount(), nTorn, nStale, nEmpty);
+  TEST_ASSERT_TRUE_MESSAGE((nTorn == 0) && (nStale == 0) && (nEmpty < nSnapshots), szWhat);
+
+  // On one core the producer rarely gets to run mid-copy
+  snprintf(szWhat, sizeof(szWhat), "lapping: producer lapped the reader during %u snapshots", nLapped);
+  TEST_ASSERT_TRUE_MESSAGE((nLapped > 0) || (std::thread::hardware_concurrency() < 2), szWhat);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_steady);
+  RUN_TEST(test_slowing);
+  RUN_TEST(test_stall);
+  RUN_TEST(test_wrap);
+  RUN_TEST(test_lapping);
+  return UNITY_END();
+}
@@ -0,0 +1,122 @@
+#ifndef __BINARYLOGFORMAT_H__
+#define __BINARYLOGFORMAT_H__
+
+// Host side of CBinaryLog: the format table gen_blog_table.py writes and
+// printf style rendering of a record's 32 bit arguments.
+
+#include <CBinaryLog.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+typedef std::map<uint32_t, std::string> BinaryLogFormatTable;
+
+static std::string unescapeTsv(const std::string &field)
+{
+  std::string result;
+  for (size_t nPos = 0; nPos < field.size(); nPos++)
+  {
+    if ((field[nPos] == '\\') && (nPos + 1 < field.size()))
+    {
+      char c = field[++nPos];
+      result += (c == 't') ? '\t' : (c == 'n') ? '\n' : (c == 'r') ? '\r' : c;
+    }
+    else
+    {
+      result += field[nPos];
+    }
+  }
+  return result;
+}
+
+// id <tab> location <tab> format, '#' lines are comments
+static bool loadFormatTable(const char *pszPath, BinaryLogFormatTable *pTable)
+{
+  std::ifstream file(pszPath);
+  std::string line;
+  while (file && std::getline(file, line))
+  {
+    size_t nTab1 = line.find('\t');
+    size_t nTab2 = (nTab1 == std::string::npos) ? std::string::npos : line.find('\t', nTab1 + 1);
+    if (!line.empty() && (line[0] != '#') && (nTab2 != std::string::npos))
+    {
+      (*pTable)[(uint32_t)strtoul(line.substr(0, nTab1).c_str(), NULL, 16)] = unescapeTsv(line.substr(nTab2 + 1));
+    }
+  }
+  return file.eof();
+}
+
+// Renders the format with the record's arguments, taking each argument's
+// type from its conversion: floating point ones were stored as float,
+// everything else as a 32 bit integer
+static std::string formatRecord(const std::string &format, const BinaryLogRecord &record)
+{
+  std::string result;
+  size_t nArg = 0;
+  char szPiece[64];
+
+  for (size_t nPos = 0; nPos < format.size(); nPos++)
+  {
+    if (format[nPos] != '%')
+    {
+      result += format[nPos];
+      continue;
+    }
+    if ((nPos + 1 < format.size()) && (format[nPos + 1] == '%'))
+    {
+      result += '%';
+      nPos++;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion, length dropped
+    std::string spec = "%";
+    size_t nEnd = nPos + 1;
+    while ((nEnd < format.size()) && strchr("-+ #0123456789.", format[nEnd]))
+    {
+      spec += format[nEnd++];
+    }
+    while ((nEnd < format.size()) && strchr("hlLqjzt", format[nEnd]))
+    {
+      nEnd++;
+    }
+    char cConversion = (nEnd < format.size()) ? format[nEnd] : 0;
+    spec += cConversion;
+    nPos = nEnd;
+
+    if (nArg >= record.nNumArgs)
+    {
+      result += "<missing>";
+      continue;
+    }
+
+    uint32_t nBits = record.arrArgs[nArg++];
+    float fValue = 0.0f;
+    memcpy(&fValue, &nBits, sizeof(fValue));
+
+    if (strchr("fFeEgGaA", cConversion))
+    {
+      snprintf(szPiece, sizeof(szPiece), spec.c_str(), (double)fValue);
+    }
+    else if (strchr("dic", cConversion))
+    {
+      snprintf(szPiece, sizeof(szPiece), spec.c_str(), (int)(int32_t)nBits);
+    }
+    else if (strchr("uoxX", cConversion))
+    {
+      snprintf(szPiece, sizeof(szPiece), spec.c_str(), (unsigned int)nBits);
+    }
+    else
+    {
+      snprintf(szPiece, sizeof(szPiece), "<%%%c 0x%08x>", cConversion, nBits);
+    }
+    result += szPiece;
+  }
+
+  return result;
+}
+
+#endif // #ifndef __BINARYLOGFORMAT_H__
@@ -0,0 +1,166 @@
+// Host benchmark and round trip check for src/CBinaryLog.
+//
+//   g++ -O2 -std=gnu++11 -pthread -I../../src bench_blog.cpp ../../src/CBinaryLog.cpp ../../src/HalNative.cpp -o bench_blog
+//   python3 gen_blog_table.py . /tmp/bench_blog_formats.tsv
+//   ./bench_blog /tmp/bench_blog_formats.tsv [dump.bin]
+//
+// The table comes from the Python generator run over this file, so the
+// round trip also checks that it hashes formats the way the compiler does.
+// With a dump path, writes the ring in the /blog format for blog_decode.
+
+#include "BinaryLogFormat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static bool check(bool bCondition, const char *pszWhat)
+{
+  printf("%s: %s\n", bCondition ? "ok  " : "FAIL", pszWhat);
+  return bCondition;
+}
+
+static double nsPerCall(std::chrono::steady_clock::time_point start, uint32_t nCalls)
+{
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / nCalls;
+}
+
+int main(int argc, char **argv)
+{
+  BinaryLogFormatTable table;
+  if ((argc < 2) || !loadFormatTable(argv[1], &table))
+  {
+    fprintf(stderr, "usage: bench_blog <formats.tsv from gen_blog_table.py> [dump.bin]\n");
+    return 2;
+  }
+
+  bool bOk = true;
+
+  // Round trip through the ring and the generated table
+  {
+    uint32_t nSeq = BinaryLog.getNextSeq();
+    BLOG("fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", 1U, 104.25f, 37.5, 40.0f, 0U);
+    BLOG("signed %d, hex %04x, char %c", -42, 0xbeefU, 'x');
+    BLOG("no arguments");
+
+    BinaryLogRecord arrRecords[3];
+    bOk &= check(BinaryLog.read(&nSeq, arrRecords, 3) == 3, "three records read back");
+
+    const char *arrExpected[] = {"fan 1: 104.25F pid 37.50% duty 40.00% full 0",
+                                 "signed -42, hex beef, char x",
+                                 "no arguments"};
+    for (int nIndex = 0; nIndex < 3; nIndex++)
+    {
+      BinaryLogFormatTable::const_iterator it = table.find(arrRecords[nIndex].nId);
+      std::string text = (it != table.end()) ? formatRecord(it->second, arrRecords[nIndex]) : "<not in table>";
+      bOk &= check(text == arrExpected[nIndex], arrExpected[nIndex]);
+    }
+  }
+
+  // Cost per call against formatting the same line
+  {
+    const uint32_t nCalls = 2000000;
+    char szLine[96];
+    volatile float fTemp = 104.25f;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t nIndex = 0; nIndex < nCalls; nIndex++)
+    {
+      BLOG("fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", nIndex & 1, fTemp, 37.5f, 40.0f, 0U);
+    }
+    double fLogNs = nsPerCall(start, nCalls);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t nIndex = 0; nIndex < nCalls; nIndex++)
+    {
+      snprintf(szLine, sizeof(szLine), "fan %u: %.2fF pid %.2f%% duty %.2f%% full %u", nIndex & 1, fTemp, 37.5f, 40.0f, 0U);
+    }
+    double fPrintfNs = nsPerCall(start, nCalls);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t nIndex = 0; nIndex < nCalls; nIndex++)
+    {
+      BinaryLog.getMicros();
+    }
+    double fClockNs = nsPerCall(start, nCalls);
+
+    printf("      BLOG() %.1f ns/call (%.1f ns of it the HAL clock), snprintf() %.1f ns/call\n", fLogNs, fClockNs, fPrintfNs);
+  }
+
+  // Writers on several threads while a reader drains: every record read
+  // must be one a writer wrote whole
+  {
+    const int nWriters = 4;
+    const uint32_t nPerWriter = 200000;
+    std::atomic<bool> bDone(false);
+    std::vector<std::thread> writers;
+    uint32_t nRead = 0;
+    uint32_t nLost = 0;
+    uint32_t nTorn = 0;
+
+    for (int nWriter = 0; nWriter < nWriters; nWriter++)
+    {
+      writers.push_back(std::thread([nWriter, nPerWriter]() {
+        for (uint32_t nIndex = 0; nIndex < nPerWriter; nIndex++)
+        {
+          BLOG("writer %u item %u check %x", (uint32_t)nWriter, nIndex, nIndex ^ 0x5a5a5a5aU);
+        }
+      }));
+    }
+    std::thread reader([&]() {
+      uint32_t nSeq = BinaryLog.getNextSeq();
+      BinaryLogRecord arrRecords[32];
+      while (!bDone)
+      {
+        uint32_t nBatchLost = 0;
+        size_t nCount = BinaryLog.read(&nSeq, arrRecords, 32, &nBatchLost);
+        nLost += nBatchLost;
+        for (size_t nIndex = 0; nIndex < nCount; nIndex++)
+        {
+          nRead++;
+          if ((arrRecords[nIndex].nNumArgs != 3) || (arrRecords[nIndex].arrArgs[2] != (arrRecords[nIndex].arrArgs[1] ^ 0x5a5a5a5aU)))
+          {
+            nTorn++;
+          }
+        }
+      }
+    });
+
+    for (size_t nIndex = 0; nIndex < writers.size(); nIndex++)
+    {
+      writers[nIndex].join();
+    }
+    bDone = true;
+    reader.join();
+
+    printf("      concurrent: %u read, %u lost to overwrite\n", nRead, nLost);
+    bOk &= check((nRead > 0) && (nTorn == 0), "no torn records under concurrent writers");
+  }
+
+  if (argc > 2)
+  {
+    FILE *pFile = fopen(argv[2], "wb");
+    uint32_t nMagic = BINARY_LOG_MAGIC;
+    uint16_t nVersion = BINARY_LOG_VERSION;
+    uint16_t nRecordSize = sizeof(BinaryLogRecord);
+    uint32_t nNextSeq = BinaryLog.getNextSeq();
+    uint32_t nSeq = 0;
+    BinaryLogRecord record;
+
+    BLOG("fan %u: settings generation %u applied", 0U, 7U);
+    fwrite(&nMagic, 4, 1, pFile);
+    fwrite(&nVersion, 2, 1, pFile);
+    fwrite(&nRecordSize, 2, 1, pFile);
+    fwrite(&nNextSeq, 4, 1, pFile);
+    while (BinaryLog.read(&nSeq, &record, 1) == 1)
+    {
+      fwrite(&record, sizeof(record), 1, pFile);
+    }
+    fclose(pFile);
+  }
+
+  return bOk ? 0 : 1;
+}
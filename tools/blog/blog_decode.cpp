@@ -0,0 +1,87 @@
+// Turns a binary log dump from the controller's /blog endpoint back into
+// text, using the format table gen_blog_table.py wrote at build time.
+//
+//   g++ -O2 -std=gnu++11 -I../../src blog_decode.cpp -o blog_decode
+//   curl -s http://<controller>/blog > blog.bin
+//   ./blog_decode .pio/build/esp32dev/blog_formats.tsv blog.bin
+//
+// With no dump file, reads stdin.
+
+#include "BinaryLogFormat.h"
+
+int main(int argc, char **argv)
+{
+  int nReturn = 0;
+  BinaryLogFormatTable table;
+
+  if ((argc < 2) || !loadFormatTable(argv[1], &table))
+  {
+    fprintf(stderr, "usage: blog_decode <blog_formats.tsv> [dump.bin]\n");
+    return 2;
+  }
+
+  FILE *pFile = (argc > 2) ? fopen(argv[2], "rb") : stdin;
+  uint8_t arrHeader[12];
+  uint32_t nMagic = 0;
+  uint16_t nVersion = 0;
+  uint16_t nRecordSize = 0;
+  uint32_t nNextSeq = 0;
+
+  if ((pFile == NULL) || (fread(arrHeader, 1, sizeof(arrHeader), pFile) != sizeof(arrHeader)))
+  {
+    fprintf(stderr, "can't read the dump header\n");
+    return 1;
+  }
+  memcpy(&nMagic, arrHeader, 4);
+  memcpy(&nVersion, arrHeader + 4, 2);
+  memcpy(&nRecordSize, arrHeader + 6, 2);
+  memcpy(&nNextSeq, arrHeader + 8, 4);
+  if ((nMagic != BINARY_LOG_MAGIC) || (nVersion != BINARY_LOG_VERSION) || (nRecordSize != sizeof(BinaryLogRecord)))
+  {
+    fprintf(stderr, "not a version %u binary log dump\n", BINARY_LOG_VERSION);
+    return 1;
+  }
+
+  BinaryLogRecord record;
+  bool bFirst = true;
+  uint32_t nExpectedSeq = 0;
+  uint32_t nLost = 0;
+  uint32_t nRecords = 0;
+
+  while (fread(&record, sizeof(record), 1, pFile) == 1)
+  {
+    if (!bFirst && (record.nSeq != nExpectedSeq))
+    {
+      printf("-- %u records lost --\n", record.nSeq - nExpectedSeq);
+      nLost += record.nSeq - nExpectedSeq;
+    }
+    bFirst = false;
+    nExpectedSeq = record.nSeq + 1;
+    nRecords++;
+
+    BinaryLogFormatTable::const_iterator it = table.find(record.nId);
+    if (it != table.end())
+    {
+      printf("[%12.6f] %s\n", record.nMicros / 1e6, formatRecord(it->second, record).c_str());
+    }
+    else
+    {
+      printf("[%12.6f] <unknown format %08x>", record.nMicros / 1e6, record.nId);
+      for (uint8_t nArg = 0; (nArg < record.nNumArgs) && (nArg < BINARY_LOG_MAX_ARGS); nArg++)
+      {
+        printf(" %08x", record.arrArgs[nArg]);
+      }
+      printf("\n");
+      nReturn = 1;
+    }
+  }
+
+  fprintf(stderr, "%u records, %u lost, next sequence %u\n", nRecords, nLost, nNextSeq);
+
+  if (pFile != stdin)
+  {
+    fclose(pFile);
+  }
+
+  return nReturn;
+}
@@ -0,0 +1,101 @@
+# Builds the BLOG() format table: every BLOG("...") string literal under
+# src/, keyed by the same FNV-1a hash CBinaryLog.h computes at compile
+# time. blog_decode turns binary log records back into text with it.
+#
+# Runs before every PlatformIO build (extra_scripts = pre:...) and writes
+# $BUILD_DIR/blog_formats.tsv. Standalone:
+#   python3 gen_blog_table.py <src dir> <output .tsv>
+
+import os
+import re
+import sys
+
+LITERAL = r'"(?:[^"\\\n]|\\.)*"'
+BLOG_CALL = re.compile(r'\bBLOG\(\s*(' + LITERAL + r'(?:\s*' + LITERAL + r')*)')
+SIMPLE_ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', 'a': '\a', 'b': '\b', 'f': '\f', 'v': '\v',
+                  '\\': '\\', '"': '"', "'": "'", '?': '?'}
+
+
+def unescape_c(body):
+    out = bytearray()
+    i = 0
+    while i < len(body):
+        c = body[i]
+        if c != '\\':
+            out += c.encode('utf-8')
+            i += 1
+            continue
+        e = body[i + 1]
+        if e in SIMPLE_ESCAPES:
+            out += SIMPLE_ESCAPES[e].encode('utf-8')
+            i += 2
+        elif e == 'x':
+            m = re.match(r'[0-9a-fA-F]+', body[i + 2:])
+            out.append(int(m.group(0), 16) & 0xff)
+            i += 2 + len(m.group(0))
+        else:
+            m = re.match(r'[0-7]{1,3}', body[i + 1:])
+            out.append(int(m.group(0), 8) & 0xff)
+            i += 1 + len(m.group(0))
+    return bytes(out)
+
+
+def literal_bytes(concatenated):
+    return b''.join(unescape_c(part[1:-1]) for part in re.findall(LITERAL, concatenated))
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+def escape_tsv(data):
+    text = data.decode('utf-8', 'replace')
+    return text.replace('\\', '\\\\').replace('\t', '\\t').replace('\n', '\\n').replace('\r', '\\r')
+
+
+def scan(src_dir):
+    formats = {}
+    for root, _, files in os.walk(src_dir):
+        for name in sorted(files):
+            if not name.endswith(('.cpp', '.h')):
+                continue
+            path = os.path.join(root, name)
+            with open(path, encoding='utf-8', errors='replace') as f:
+                text = f.read()
+            for m in BLOG_CALL.finditer(text):
+                line_start = text.rfind('\n', 0, m.start()) + 1
+                if text[line_start:m.start()].lstrip().startswith('//'):
+                    continue
+                fmt = literal_bytes(m.group(1))
+                location = '%s:%d' % (os.path.relpath(path, src_dir), text.count('\n', 0, m.start()) + 1)
+                nid = fnv1a(fmt)
+                if nid in formats and formats[nid][1] != fmt:
+                    raise SystemExit('BLOG format hash collision: %s and %s' % (formats[nid][0], location))
+                formats.setdefault(nid, (location, fmt))
+    return formats
+
+
+def write_table(src_dir, out_path):
+    formats = scan(src_dir)
+    out_dir = os.path.dirname(out_path)
+    if out_dir and not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    with open(out_path, 'w', encoding='utf-8') as f:
+        f.write('# id\tlocation\tformat\n')
+        for nid in sorted(formats):
+            location, fmt = formats[nid]
+            f.write('%08x\t%s\t%s\n' % (nid, location, escape_tsv(fmt)))
+    print('BLOG formats: %d -> %s' % (len(formats), out_path))
+
+
+try:
+    Import('env')  # noqa: F821 (provided by PlatformIO's SCons)
+    write_table(env.subst('$PROJECT_SRC_DIR'), os.path.join(env.subst('$BUILD_DIR'), 'blog_formats.tsv'))  # noqa: F821
+except NameError:
+    if __name__ == '__main__':
+        if len(sys.argv) != 3:
+            raise SystemExit('usage: gen_blog_table.py <src dir> <output .tsv>')
+        write_table(sys.argv[1], sys.argv[2])
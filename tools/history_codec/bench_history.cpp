@@ -0,0 +1,116 @@
+// Round trips a synthetic controller trace through CHistoryRing and
+// reports compression and encode/decode cost. The round trip tests are in
+// test/test_history_codec.
+//
+//   g++ -O2 -std=gnu++11 -I../../src bench_history.cpp ../../src/CHistoryRing.cpp -o bench_history
+//   ./bench_history [numSensors] [numFans] [intervalMs]
+
+#include <CHistoryRing.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Slow thermal drift with DS18B20 quantization, a PID driven duty and
+// tach readings with a little jitter. Timestamps are on the recorder's
+// interval grid, as CHistoryRecorder stores them
+static void makeSample(uint32_t nIndex, uint8_t nNumSensors, uint8_t nNumFans, uint32_t nIntervalMs, uint32_t *pnTimeMs, int32_t *arrValues)
+{
+  *pnTimeMs = 0xFFFF0000UL + nIndex * nIntervalMs; // crosses the millis() rollover
+  double fLoad = 0.5 + 0.5 * sin(nIndex / 900.0);
+  for (uint8_t nSensor = 0; nSensor < nNumSensors; nSensor++)
+  {
+    double fTempC = 35.0 + 10.0 * fLoad + nSensor * 1.5;
+    arrValues[nSensor] = (int32_t)lround(fTempC * 128.0) & ~0x1F; // 11 bit resolution
+  }
+  for (uint8_t nFan = 0; nFan < nNumFans; nFan++)
+  {
+    int32_t nDutyMilli = (int32_t)lround(30000 + 70000 * fLoad) / 100 * 100;
+    arrValues[nNumSensors + nFan * 2] = nDutyMilli;
+    arrValues[nNumSensors + nFan * 2 + 1] = nDutyMilli / 50 + (rand() % 3) * 30;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t nNumSensors = (argc > 1) ? (uint8_t)atoi(argv[1]) : 4;
+  uint8_t nNumFans = (argc > 2) ? (uint8_t)atoi(argv[2]) : 2;
+  uint32_t nIntervalMs = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1000;
+  uint8_t nNumChannels = nNumSensors + nNumFans * 2;
+  const uint32_t nNumSamples = 20000;
+
+  if (nNumChannels > HISTORY_MAX_CHANNELS)
+  {
+    fprintf(stderr, "at most %u channels\n", HISTORY_MAX_CHANNELS);
+    return 1;
+  }
+
+  // Large enough to keep everything so the whole trace can be verified
+  CHistoryRing ring(nNumChannels, 1024, 512);
+  std::vector<uint32_t> times(nNumSamples);
+  std::vector<int32_t> values((size_t)nNumSamples * nNumChannels);
+
+  srand(1);
+  for (uint32_t nIndex = 0; nIndex < nNumSamples; nIndex++)
+  {
+    makeSample(nIndex, nNumSensors, nNumFans, nIntervalMs, &times[nIndex], &values[(size_t)nIndex * nNumChannels]);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t nIndex = 0; nIndex < nNumSamples; nIndex++)
+  {
+    ring.append(times[nIndex], &values[(size_t)nIndex * nNumChannels]);
+  }
+  std::chrono::duration<double, std::nano> encodeTime = std::chrono::steady_clock::now() - start;
+
+  if (ring.getFirstSeq() != 0)
+  {
+    fprintf(stderr, "ring too small for the trace\n");
+    return 1;
+  }
+
+  HistoryBlockHeader header;
+  std::vector<uint8_t> block(ring.getBlockBytes());
+  CHistoryBlockDecoder decoder;
+  uint32_t nTimeMs = 0;
+  int32_t arrValues[HISTORY_MAX_CHANNELS];
+  uint32_t nDecoded = 0;
+  bool bMatch = true;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t nSeq = ring.getFirstSeq(); nSeq < ring.getNextSeq(); nSeq++)
+  {
+    ring.copyBlock(nSeq, &header, block.data(), block.size());
+    decoder.reset(&header, block.data(), nNumChannels);
+    while (decoder.next(&nTimeMs, arrValues))
+    {
+      bMatch = bMatch && (nTimeMs == times[nDecoded]);
+      for (uint8_t nChannel = 0; nChannel < nNumChannels; nChannel++)
+      {
+        bMatch = bMatch && (arrValues[nChannel] == values[(size_t)nDecoded * nNumChannels + nChannel]);
+      }
+      nDecoded++;
+    }
+  }
+  std::chrono::duration<double, std::nano> decodeTime = std::chrono::steady_clock::now() - start;
+
+  if (!bMatch || (nDecoded != nNumSamples))
+  {
+    fprintf(stderr, "round trip mismatch (%u of %u decoded)\n", nDecoded, nNumSamples);
+    return 1;
+  }
+
+  size_t nRawBytes = (size_t)nNumSamples * (4 + 4 * nNumChannels);
+  double fBytesPerSample = (double)ring.getBytesUsed() / nNumSamples;
+  printf("{\"channels\":%u,\"samples\":%u,\"rawBytes\":%zu,\"compressedBytes\":%zu,"
+         "\"ratio\":%.1f,\"bytesPerSample\":%.2f,\"hoursPer32KB\":%.1f,"
+         "\"encodeNsPerSample\":%.1f,\"decodeNsPerSample\":%.1f}\n",
+         nNumChannels, nNumSamples, nRawBytes, ring.getBytesUsed(),
+         (double)nRawBytes / ring.getBytesUsed(), fBytesPerSample,
+         32768.0 / fBytesPerSample * nIntervalMs / 3600000.0,
+         encodeTime.count() / nNumSamples, decodeTime.count() / nNumSamples);
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Runs the firmware's hot path suite (src/CHotPathBench) on the host,
+// against the simulated sensors, PWM outputs and tachs, and prints the
+// CMicroBench JSON. The device prints the same JSON when built with
+// -DMICRO_BENCHMARK, and serves it from /bench.
+//
+//   g++ -O2 -std=gnu++11 -pthread -I../../src bench_hotpaths.cpp ../../src/HalNative.cpp ../../src/CMicroBench.cpp ../../src/CHotPathBench.cpp ../../src/CTelemetry.cpp ../../src/CTempSensors.cpp ../../src/CPwmFanControl.cpp ../../src/CSimPwmChannel.cpp ../../src/CSimTachCounter.cpp ../../src/CSimTempBus.cpp ../../src/CTaskPerf.cpp ../../src/Appendf.cpp -o bench_hotpaths
+//   ./bench_hotpaths [--table]
+
+#include <CHotPathBench.h>
+#include <CMicroBench.h>
+#include <CSimPwmChannel.h>
+#include <CSimTachCounter.h>
+#include <CSimTempBus.h>
+
+#define NUM_FANS 2
+
+// Same PWM setup as the firmware
+#define FAN_PWM_RESOLUTION 10
+#define FAN_PWM_FREQUENCY 25000
+
+typedef CPwmFanControlT<FAN_PWM_RESOLUTION, FAN_PWM_FREQUENCY> CFanPwmControl;
+
+int main(int argc, char **argv)
+{
+  bool bTable = (argc > 1) && (strcmp(argv[1], "--table") == 0);
+
+  CSimTempBus tempBus(4);
+  CSimPwmChannel arrPwmChannels[NUM_FANS];
+  CSimTachCounter arrTachCounters[NUM_FANS];
+  CFanPwmControl arrFanCtrl[NUM_FANS] = {
+      {0, 0, 0},
+      {1, 0, 0}};
+  CTempSensors tempSensors(&tempBus, HIGH_RES);
+
+  CPwmFanControl *arrBenchFanCtrl[NUM_FANS] = {};
+  for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+  {
+    arrFanCtrl[nIndex].begin(&arrPwmChannels[nIndex], &arrTachCounters[nIndex]);
+    arrFanCtrl[nIndex].setFanDutyCyclePercent(50.0f);
+    arrTachCounters[nIndex].setRpm(1500.0f);
+    arrBenchFanCtrl[nIndex] = &arrFanCtrl[nIndex];
+  }
+
+  tempSensors.setAsyncConversion(true);
+  tempSensors.begin();
+
+  // A couple of samples in so the readers have something to read
+  for (uint8_t nSample = 0; nSample < 3; nSample++)
+  {
+    halDelayMs(tempSensors.update());
+    for (uint8_t nIndex = 0; nIndex < NUM_FANS; nIndex++)
+    {
+      arrFanCtrl[nIndex].sampleTach();
+    }
+  }
+
+  CHotPathBench hotPathBench;
+  hotPathBench.begin(arrBenchFanCtrl, NUM_FANS, &tempSensors);
+
+  static CMicroBench bench;
+  hotPathBench.runAll(&bench);
+
+  if (bTable)
+  {
+    printf("%-40s %8s %6s %10s %10s %10s\n", "operation", "samples", "batch", "min ns", "median ns", "p99 ns");
+    for (size_t nIndex = 0; nIndex < bench.getNumResults(); nIndex++)
+    {
+      const MicroBenchResult *pResult = bench.getResult(nIndex);
+      printf("%-40s %8u %6u %10.1f %10.1f %10.1f\n", pResult->pszName, pResult->nSamples, pResult->nBatch, pResult->fMinNs, pResult->fMedianNs, pResult->fP99Ns);
+    }
+  }
+  else
+  {
+    static char szJson[2048];
+    if (bench.writeJson(szJson, sizeof(szJson)) > 0)
+    {
+      printf("%s\n", szJson);
+    }
+  }
+
+  return 0;
+}
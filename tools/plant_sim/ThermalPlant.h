@@ -0,0 +1,98 @@
+#ifndef __THERMALPLANT_H__
+#define __THERMALPLANT_H__
+
+// Lumped thermal model of an enclosure cooled by one fan, for plant_sim.
+//
+//   C dT/dt = P_load - (G_passive + G_fan * airflow) * (T - T_ambient)
+//
+// Airflow is the fan's RPM over its max RPM. The fan heads for an RPM
+// proportional to duty (nothing below the stall duty) with first order
+// spin up and spin down lags. The sensor follows the air with its own
+// first order lag; quantization and conversion latency come from
+// CSimTempBus.
+
+#include <math.h>
+
+typedef struct PlantParams
+{
+  float fAmbientC = 22.0f;
+  float fHeatCapacityJPerK = 4000.0f;
+  float fPassiveWPerK = 2.0f; // conduction and natural convection
+  float fFanWPerK = 20.0f;    // added at full airflow
+  float fFanMaxRpm = 3000.0f;
+  float fFanStallPercent = 20.0f; // below this duty the fan doesn't turn
+  float fSpinUpSec = 2.0f;
+  float fSpinDownSec = 4.0f;
+  float fFanMaxWatts = 3.0f;  // electrical, scales with RPM cubed
+  float fSensorLagSec = 10.0f; // DS18B20 in free air
+} PlantParams;
+
+class CThermalPlant
+{
+public:
+  CThermalPlant(const PlantParams &params)
+      : m_params(params)
+  {
+    reset(params.fAmbientC);
+  }
+
+  void reset(const float fAirC)
+  {
+    m_fAirC = fAirC;
+    m_fSensorC = fAirC;
+    m_fRpm = 0.0f;
+  }
+
+  void step(const float fDtSec, const float fLoadWatts, const float fDutyFraction)
+  {
+    float fDutyPercent = fDutyFraction * 100.0f;
+    float fTargetRpm = (fDutyPercent < m_params.fFanStallPercent) ? 0.0f : fDutyFraction * m_params.fFanMaxRpm;
+    float fLagSec = (fTargetRpm > m_fRpm) ? m_params.fSpinUpSec : m_params.fSpinDownSec;
+    m_fRpm += (fTargetRpm - m_fRpm) * (1.0f - expf(-fDtSec / fLagSec));
+
+    float fConductance = m_params.fPassiveWPerK + m_params.fFanWPerK * getAirflow();
+    m_fAirC += (fLoadWatts - fConductance * (m_fAirC - m_params.fAmbientC)) * fDtSec / m_params.fHeatCapacityJPerK;
+
+    m_fSensorC += (m_fAirC - m_fSensorC) * (1.0f - expf(-fDtSec / m_params.fSensorLagSec));
+  }
+
+  // Where the air settles with the fan off under a constant load
+  float getPassiveEquilibriumC(const float fLoadWatts)
+  {
+    return m_params.fAmbientC + fLoadWatts / m_params.fPassiveWPerK;
+  }
+
+  float getAirC()
+  {
+    return m_fAirC;
+  }
+
+  float getSensorC()
+  {
+    return m_fSensorC;
+  }
+
+  float getRpm()
+  {
+    return m_fRpm;
+  }
+
+  float getAirflow()
+  {
+    return m_fRpm / m_params.fFanMaxRpm;
+  }
+
+  float getFanWatts()
+  {
+    float fAirflow = getAirflow();
+    return m_params.fFanMaxWatts * fAirflow * fAirflow * fAirflow;
+  }
+
+private:
+  PlantParams m_params;
+  float m_fAirC = 0.0f;
+  float m_fSensorC = 0.0f;
+  float m_fRpm = 0.0f;
+};
+
+#endif // #ifndef __THERMALPLANT_H__
@@ -0,0 +1,368 @@
+// Closed loop benchmark of the fan control: the real CTempSensors,
+// CFanScheduler, CPidController and CPwmFanControl drive a simulated
+// enclosure (ThermalPlant.h) through a set of heat load scenarios in
+// simulated time, and report how well each was controlled.
+//
+//   g++ -O2 -std=gnu++11 -pthread -I. -I../../src plant_sim.cpp ../../src/HalNative.cpp ../../src/CTempSensors.cpp ../../src/CFanScheduler.cpp ../../src/CTaskPerf.cpp ../../src/CPeriodicTick.cpp ../../src/CPidController.cpp ../../src/CPwmFanControl.cpp ../../src/CBinaryLog.cpp ../../src/CSimPwmChannel.cpp ../../src/CSimTachCounter.cpp ../../src/CSimTempBus.cpp -o plant_sim
+//   ./plant_sim [--json] [scenario ...] [setting=value ...]
+//
+// Settings override the firmware defaults from FanSettings.h: setpoint
+// and fullspeed (F), kp ki kd, minduty (%), minruntime (ms), rampup and
+// rampdown (%/s). band=F sets the settling band around the setpoint
+// (default 1 F).
+
+#include <Hal.h>
+#include <CFanScheduler.h>
+#include <CPwmFanControl.h>
+#include <CSimPwmChannel.h>
+#include <CSimTachCounter.h>
+#include <CSimTempBus.h>
+#include <CTempSensors.h>
+#include "ThermalPlant.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#define SIM_STEP_MS 10
+#define TACH_SAMPLE_PERIOD_MS 250
+
+// Same PWM setup as the firmware
+#define FAN_PWM_RESOLUTION 10
+#define FAN_PWM_FREQUENCY 25000
+
+typedef CPwmFanControlT<FAN_PWM_RESOLUTION, FAN_PWM_FREQUENCY> CFanPwmControl;
+
+typedef struct Scenario
+{
+  const char *pszName;
+  const char *pszDescription;
+  uint32_t nDurationSec;
+  uint32_t nEventSec; // settling and overshoot are measured from here
+  float fAmbientC;
+  float fStartWatts; // starts settled at this load with the fan off, < 0 at ambient
+  float (*pfnLoadWatts)(float fTimeSec);
+} Scenario;
+
+static float loadStep(float fTimeSec)
+{
+  return (fTimeSec < 120.0f) ? 10.0f : 80.0f;
+}
+
+// 4 minutes on, 6 off: shows short cycling and what min runtime does to it
+static float loadPulse(float fTimeSec)
+{
+  return (fmodf(fTimeSec, 600.0f) < 240.0f) ? 100.0f : 10.0f;
+}
+
+static float loadRamp(float fTimeSec)
+{
+  return 10.0f + 110.0f * fminf(fTimeSec / 1200.0f, 1.0f);
+}
+
+static float loadWarmup(float fTimeSec)
+{
+  return 30.0f;
+}
+
+static const Scenario s_arrScenarios[] = {
+    {"step", "10 W idle, 80 W from 2 min", 3600, 120, 22.0f, 10.0f, loadStep},
+    {"pulse", "100 W for 4 min every 10 min", 3600, 0, 22.0f, 10.0f, loadPulse},
+    {"ramp", "10 W to 120 W over 20 min", 3600, 0, 22.0f, 10.0f, loadRamp},
+    {"warmup", "30 W from cold at 27 C ambient", 3600, 0, 27.0f, -1.0f, loadWarmup}};
+
+typedef struct ScenarioResult
+{
+  float fSettleSec; // < 0 if it never stayed within the band
+  float fOvershootF;
+  float fMaxTempF;
+  float fIaeFSec; // integral of |error| after the event
+  uint32_t nFanStarts;
+  float fMeanDutyPercent;
+  float fFanWh;
+  float fMaxDutySec;
+  uint32_t nTicks;
+  float fSpeedup; // simulated time over wall time
+} ScenarioResult;
+
+static float cToF(float fTempC)
+{
+  return fTempC * 1.8f + 32.0f;
+}
+
+// One scenario from a clean start: fresh controller, sensors and scheduler,
+// and the simulated clock back at zero
+static void runScenario(const Scenario &scenario, const FanSettings &baseSettings, float fSettleBandF, ScenarioResult *pResult)
+{
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  halSimSetMicros(0);
+
+  PlantParams params;
+  params.fAmbientC = scenario.fAmbientC;
+  CThermalPlant plant(params);
+  if (scenario.fStartWatts >= 0.0f)
+  {
+    plant.reset(plant.getPassiveEquilibriumC(scenario.fStartWatts));
+  }
+
+  CSimTempBus tempBus(1);
+  CSimPwmChannel pwmChannel;
+  CSimTachCounter tachCounter;
+  CFanPwmControl fanCtrl(0, 0, 0);
+  CTempSensors tempSensors(&tempBus, HIGH_RES);
+
+  FanSettings settings = baseSettings;
+  FanControlSettings arrFanControls[1] = {{&settings, &fanCtrl, &tempSensors, 0, 0}};
+  CFanScheduler fanScheduler(arrFanControls, 1);
+
+  tempBus.setTempC(0, plant.getSensorC());
+  fanCtrl.begin(&pwmChannel, &tachCounter);
+  tempSensors.setAsyncConversion(true);
+  tempSensors.begin();
+  fanScheduler.init();
+
+  float fSetpointF = (float)settings.fPidSetpoint;
+  float fDtSec = SIM_STEP_MS / 1000.0f;
+  uint32_t nNumSteps = scenario.nDurationSec * 1000 / SIM_STEP_MS;
+  uint32_t nNextUpdateMs = 0;
+  uint32_t nNextTachMs = 0;
+  float fLastOutsideSec = -1.0f;
+  double fDutySum = 0.0;
+  double fFanJoules = 0.0;
+  bool bWasOn = false;
+
+  *pResult = ScenarioResult();
+  pResult->fMaxTempF = -999.0f;
+
+  for (uint32_t nStep = 0; nStep < nNumSteps; nStep++)
+  {
+    float fTimeSec = nStep * fDtSec;
+
+    plant.step(fDtSec, scenario.pfnLoadWatts(fTimeSec), pwmChannel.getDutyFraction());
+    tempBus.setTempC(0, plant.getSensorC());
+    tachCounter.setRpm(plant.getRpm());
+
+    halSimAdvanceMicros(SIM_STEP_MS * 1000);
+    uint32_t nNowMs = halMillis();
+
+    // What the firmware's tasks do: update when the conversion is due,
+    // tick on each new sample, sample the tach at its own cadence
+    if ((int32_t)(nNowMs - nNextUpdateMs) >= 0)
+    {
+      uint32_t nGeneration = tempSensors.getGeneration();
+      nNextUpdateMs = nNowMs + max(tempSensors.update(), (uint32_t)SIM_STEP_MS);
+
+      if (tempSensors.getGeneration() != nGeneration)
+      {
+        fanScheduler.tick();
+      }
+    }
+
+    if ((int32_t)(nNowMs - nNextTachMs) >= 0)
+    {
+      fanCtrl.sampleTach();
+      nNextTachMs = nNowMs + TACH_SAMPLE_PERIOD_MS;
+    }
+
+    // Scored on the air temperature, which is what the fan is for
+    float fAirF = cToF(plant.getAirC());
+    float fDutyPercent = fanCtrl.getLastDutyCyclePercent();
+    bool bOn = (fanCtrl.getTargetDutyCycle() > 0);
+
+    pResult->fMaxTempF = fmaxf(pResult->fMaxTempF, fAirF);
+    if (bOn && !bWasOn)
+    {
+      pResult->nFanStarts++;
+    }
+    bWasOn = bOn;
+
+    if (fanCtrl.getTargetDutyCycle() == CFanPwmControl::MAX_DUTY_CYCLE)
+    {
+      pResult->fMaxDutySec += fDtSec;
+    }
+
+    fDutySum += fDutyPercent;
+    fFanJoules += plant.getFanWatts() * fDtSec;
+
+    if (fTimeSec >= scenario.nEventSec)
+    {
+      float fErrorF = fAirF - fSetpointF;
+
+      pResult->fOvershootF = fmaxf(pResult->fOvershootF, fErrorF);
+      pResult->fIaeFSec += fabsf(fErrorF) * fDtSec;
+      if (fabsf(fErrorF) > fSettleBandF)
+      {
+        fLastOutsideSec = fTimeSec;
+      }
+    }
+  }
+
+  float fEndSec = nNumSteps * fDtSec;
+  if (fLastOutsideSec < 0.0f)
+  {
+    pResult->fSettleSec = 0.0f;
+  }
+  else if (fEndSec - fLastOutsideSec > 60.0f)
+  {
+    pResult->fSettleSec = fLastOutsideSec + fDtSec - scenario.nEventSec;
+  }
+  else
+  {
+    pResult->fSettleSec = -1.0f;
+  }
+
+  pResult->fMeanDutyPercent = (float)(fDutySum / nNumSteps);
+  pResult->fFanWh = (float)(fFanJoules / 3600.0);
+  pResult->nTicks = fanScheduler.getTickCount();
+
+  std::chrono::duration<double> wallSec = std::chrono::steady_clock::now() - wallStart;
+  pResult->fSpeedup = (float)(fEndSec / fmax(wallSec.count(), 1e-6));
+}
+
+static bool applySetting(const char *pszArg, FanSettings *pSettings)
+{
+  bool bReturn = true;
+
+  const char *pszValue = strchr(pszArg, '=');
+  size_t nKeyLen = pszValue - pszArg;
+  double fValue = atof(pszValue + 1);
+
+  if (strncmp(pszArg, "setpoint", nKeyLen) == 0)
+  {
+    pSettings->fPidSetpoint = fValue;
+  }
+  else if (strncmp(pszArg, "kp", nKeyLen) == 0)
+  {
+    pSettings->fPidKp = fValue;
+  }
+  else if (strncmp(pszArg, "ki", nKeyLen) == 0)
+  {
+    pSettings->fPidKi = fValue;
+  }
+  else if (strncmp(pszArg, "kd", nKeyLen) == 0)
+  {
+    pSettings->fPidKd = fValue;
+  }
+  else if (strncmp(pszArg, "fullspeed", nKeyLen) == 0)
+  {
+    pSettings->fFullSpeedTemp = fValue;
+  }
+  else if (strncmp(pszArg, "minduty", nKeyLen) == 0)
+  {
+    pSettings->fMinFanDutyCyclePercent = fValue;
+  }
+  else if (strncmp(pszArg, "minruntime", nKeyLen) == 0)
+  {
+    pSettings->nFanMinRuntimeMs = (uint32_t)fValue;
+  }
+  else if (strncmp(pszArg, "rampup", nKeyLen) == 0)
+  {
+    pSettings->fRampUpPercentPerSec = fValue;
+  }
+  else if (strncmp(pszArg, "rampdown", nKeyLen) == 0)
+  {
+    pSettings->fRampDownPercentPerSec = fValue;
+  }
+  else
+  {
+    bReturn = false;
+  }
+
+  return bReturn;
+}
+
+static bool isSelected(const char *pszName, int argc, char **argv)
+{
+  bool bAny = false;
+  bool bReturn = false;
+
+  for (int nArg = 1; nArg < argc; nArg++)
+  {
+    if ((argv[nArg][0] != '-') && (strchr(argv[nArg], '=') == NULL))
+    {
+      bAny = true;
+      bReturn = bReturn || (strcmp(argv[nArg], pszName) == 0);
+    }
+  }
+
+  return !bAny || bReturn;
+}
+
+int main(int argc, char **argv)
+{
+  FanSettings settings;
+  float fSettleBandF = 1.0f;
+  bool bJson = false;
+
+  for (int nArg = 1; nArg < argc; nArg++)
+  {
+    if (strcmp(argv[nArg], "--json") == 0)
+    {
+      bJson = true;
+    }
+    else if (strncmp(argv[nArg], "band=", 5) == 0)
+    {
+      fSettleBandF = (float)atof(argv[nArg] + 5);
+    }
+    else if ((strchr(argv[nArg], '=') != NULL) && !applySetting(argv[nArg], &settings))
+    {
+      fprintf(stderr, "unknown setting %s\n", argv[nArg]);
+      return 2;
+    }
+  }
+
+  if (bJson)
+  {
+    printf("{\"settings\":{\"band\":%.2f,\"setpoint\":%.2f,\"kp\":%.3f,\"ki\":%.3f,\"kd\":%.3f,\"fullspeed\":%.2f,\"minduty\":%.1f,\"minruntime\":%u,\"rampup\":%.1f,\"rampdown\":%.1f},\"scenarios\":[",
+           fSettleBandF, settings.fPidSetpoint, settings.fPidKp, settings.fPidKi, settings.fPidKd, settings.fFullSpeedTemp,
+           settings.fMinFanDutyCyclePercent, settings.nFanMinRuntimeMs, settings.fRampUpPercentPerSec, settings.fRampDownPercentPerSec);
+  }
+  else
+  {
+    printf("setpoint %.1fF  kp %.3f ki %.3f kd %.3f  full speed %.1fF  min duty %.0f%%  min runtime %u ms  ramp %.0f/%.0f %%/s  band %.1fF\n\n",
+           settings.fPidSetpoint, settings.fPidKp, settings.fPidKi, settings.fPidKd, settings.fFullSpeedTemp,
+           settings.fMinFanDutyCyclePercent, settings.nFanMinRuntimeMs, settings.fRampUpPercentPerSec, settings.fRampDownPercentPerSec, fSettleBandF);
+    printf("%-8s %9s %10s %8s %10s %7s %7s %7s %8s %8s\n", "scenario", "settle s", "overshoot", "max F", "IAE F*s", "starts", "duty %", "fan Wh", "100% s", "speedup");
+  }
+
+  bool bFirst = true;
+  for (size_t nIndex = 0; nIndex < sizeof(s_arrScenarios) / sizeof(s_arrScenarios[0]); nIndex++)
+  {
+    const Scenario &scenario = s_arrScenarios[nIndex];
+    if (isSelected(scenario.pszName, argc, argv))
+    {
+      ScenarioResult result;
+      runScenario(scenario, settings, fSettleBandF, &result);
+
+      if (bJson)
+      {
+        printf("%s{\"name\":\"%s\",\"description\":\"%s\",\"settleSec\":%.1f,\"overshootF\":%.2f,\"maxTempF\":%.2f,\"iaeFSec\":%.0f,\"fanStarts\":%u,\"meanDutyPercent\":%.2f,\"fanWh\":%.3f,\"maxDutySec\":%.1f,\"ticks\":%u,\"speedup\":%.0f}",
+               bFirst ? "" : ",", scenario.pszName, scenario.pszDescription, result.fSettleSec, result.fOvershootF, result.fMaxTempF,
+               result.fIaeFSec, result.nFanStarts, result.fMeanDutyPercent, result.fFanWh, result.fMaxDutySec, result.nTicks, result.fSpeedup);
+      }
+      else
+      {
+        char szSettle[16];
+        if (result.fSettleSec < 0.0f)
+        {
+          snprintf(szSettle, sizeof(szSettle), "never");
+        }
+        else
+        {
+          snprintf(szSettle, sizeof(szSettle), "%.0f", result.fSettleSec);
+        }
+
+        printf("%-8s %9s %10.2f %8.2f %10.0f %7u %7.1f %7.2f %8.0f %7.0fx\n",
+               scenario.pszName, szSettle, result.fOvershootF, result.fMaxTempF, result.fIaeFSec,
+               result.nFanStarts, result.fMeanDutyPercent, result.fFanWh, result.fMaxDutySec, result.fSpeedup);
+      }
+      bFirst = false;
+    }
+  }
+
+  if (bJson)
+  {
+    printf("]}\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,167 @@
+#ifndef __TELEMETRYCBORDECODER_H__
+#define __TELEMETRYCBORDECODER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Host side decoder for the /status CBOR frames produced by
+// CTelemetry::writeCbor (request with "Accept: application/cbor"):
+//   [version, gen, [[rpm, dutyMilliPercent], ...], maxTempRaw, [tempRaw, ...]]
+// Temperatures are DallasTemperature raw units, 1/128 C.
+
+#define TELEMETRY_CBOR_VERSION 1
+
+typedef struct DecodedFan
+{
+  uint32_t nRpm;
+  int32_t nDutyMilliPercent;
+
+  double getDutyPercent() const { return nDutyMilliPercent / 1000.0; }
+} DecodedFan;
+
+typedef struct DecodedTelemetry
+{
+  uint32_t nVersion;
+  uint32_t nGeneration;
+  std::vector<DecodedFan> fans;
+  int32_t nMaxTempRaw;
+  std::vector<int32_t> tempsRaw;
+
+  static double rawToCelsius(int32_t nRaw) { return nRaw / 128.0; }
+  static double rawToFahrenheit(int32_t nRaw) { return nRaw / 128.0 * 1.8 + 32.0; }
+} DecodedTelemetry;
+
+// Just enough CBOR to walk the fixed schema: integers and definite length
+// arrays. Anything else is rejected.
+class CCborReader
+{
+public:
+  CCborReader(const uint8_t *pBuf, size_t nLen)
+      : m_pBuf(pBuf),
+        m_nLen(nLen)
+  {
+  }
+
+  bool readInt(int64_t *pnValue)
+  {
+    bool bReturn = false;
+    uint8_t nMajor = 0;
+    uint64_t nArg = 0;
+
+    if (readHead(&nMajor, &nArg) && (nArg <= (uint64_t)INT64_MAX))
+    {
+      if (nMajor == 0)
+      {
+        *pnValue = (int64_t)nArg;
+        bReturn = true;
+      }
+      else if (nMajor == 1)
+      {
+        *pnValue = -1 - (int64_t)nArg;
+        bReturn = true;
+      }
+    }
+
+    return bReturn;
+  }
+
+  bool readArray(size_t *pnItems)
+  {
+    uint8_t nMajor = 0;
+    uint64_t nArg = 0;
+    bool bReturn = readHead(&nMajor, &nArg) && (nMajor == 4) && (nArg <= m_nLen - m_nPos);
+
+    if (bReturn)
+    {
+      *pnItems = (size_t)nArg;
+    }
+
+    return bReturn;
+  }
+
+  bool isAtEnd() const { return m_nPos == m_nLen; }
+
+private:
+  bool readHead(uint8_t *pnMajor, uint64_t *pnArg)
+  {
+    bool bReturn = false;
+
+    if (m_nPos < m_nLen)
+    {
+      uint8_t nInitial = m_pBuf[m_nPos++];
+      uint8_t nInfo = nInitial & 0x1F;
+      *pnMajor = nInitial >> 5;
+
+      if (nInfo < 24)
+      {
+        *pnArg = nInfo;
+        bReturn = true;
+      }
+      else if (nInfo <= 27)
+      {
+        size_t nBytes = (size_t)1 << (nInfo - 24);
+        if (nBytes <= m_nLen - m_nPos)
+        {
+          *pnArg = 0;
+          for (size_t nIndex = 0; nIndex < nBytes; nIndex++)
+          {
+            *pnArg = (*pnArg << 8) | m_pBuf[m_nPos++];
+          }
+          bReturn = true;
+        }
+      }
+    }
+
+    return bReturn;
+  }
+
+  const uint8_t *m_pBuf;
+  size_t m_nLen;
+  size_t m_nPos = 0;
+};
+
+// Returns false on malformed input or an unknown schema version
+inline bool decodeTelemetryCbor(const uint8_t *pBuf, size_t nLen, DecodedTelemetry *pTelemetry)
+{
+  CCborReader reader(pBuf, nLen);
+  size_t nItems = 0;
+  int64_t nValue = 0;
+  bool bOk = reader.readArray(&nItems) && (nItems == 5);
+
+  bOk = bOk && reader.readInt(&nValue) && (nValue == TELEMETRY_CBOR_VERSION);
+  pTelemetry->nVersion = (uint32_t)nValue;
+
+  bOk = bOk && reader.readInt(&nValue) && (nValue >= 0);
+  pTelemetry->nGeneration = (uint32_t)nValue;
+
+  size_t nFans = 0;
+  bOk = bOk && reader.readArray(&nFans);
+  pTelemetry->fans.clear();
+  for (size_t nIndex = 0; bOk && (nIndex < nFans); nIndex++)
+  {
+    DecodedFan fan = {};
+    int64_t nRpm = 0;
+    int64_t nDuty = 0;
+    bOk = reader.readArray(&nItems) && (nItems == 2) && reader.readInt(&nRpm) && reader.readInt(&nDuty);
+    fan.nRpm = (uint32_t)nRpm;
+    fan.nDutyMilliPercent = (int32_t)nDuty;
+    pTelemetry->fans.push_back(fan);
+  }
+
+  bOk = bOk && reader.readInt(&nValue);
+  pTelemetry->nMaxTempRaw = (int32_t)nValue;
+
+  size_t nSensors = 0;
+  bOk = bOk && reader.readArray(&nSensors);
+  pTelemetry->tempsRaw.clear();
+  for (size_t nIndex = 0; bOk && (nIndex < nSensors); nIndex++)
+  {
+    bOk = reader.readInt(&nValue);
+    pTelemetry->tempsRaw.push_back((int32_t)nValue);
+  }
+
+  return bOk && reader.isAtEnd();
+}
+
+#endif // #ifndef __TELEMETRYCBORDECODER_H__
@@ -0,0 +1,130 @@
+// Compares the /status JSON frame with the CBOR frame: encoded size,
+// device side encode time and host side decode time. The frames come from
+// the firmware's CTelemetry::writeFull() and writeCbor(), sampling
+// simulated fans and sensors.
+//
+//   g++ -O2 -std=gnu++11 -pthread -I../../src bench_telemetry.cpp ../../src/CTelemetry.cpp ../../src/Appendf.cpp ../../src/CTempSensors.cpp ../../src/CPwmFanControl.cpp ../../src/CSimPwmChannel.cpp ../../src/CSimTachCounter.cpp ../../src/CSimTempBus.cpp ../../src/HalNative.cpp -o bench_telemetry
+//   ./bench_telemetry [numFans] [numSensors]
+
+#include <CTelemetry.h>
+#include <CSimPwmChannel.h>
+#include <CSimTachCounter.h>
+#include <CSimTempBus.h>
+#include "TelemetryCborDecoder.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Same PWM setup as the firmware
+#define FAN_PWM_RESOLUTION 10
+#define FAN_PWM_FREQUENCY 25000
+
+typedef CPwmFanControlT<FAN_PWM_RESOLUTION, FAN_PWM_FREQUENCY> CFanPwmControl;
+
+template <typename F>
+static double nanosPerCall(F fn, int nIterations)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int nIndex = 0; nIndex < nIterations; nIndex++)
+  {
+    fn(nIndex);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / nIterations;
+}
+
+int main(int argc, char **argv)
+{
+  const int nIterations = 200000;
+  uint8_t nNumFans = (argc > 1) ? (uint8_t)atoi(argv[1]) : 2;
+  uint8_t nNumSensors = (argc > 2) ? (uint8_t)atoi(argv[2]) : 4;
+  if ((nNumFans < 1) || (nNumFans > MAX_FANS) || (nNumSensors < 1) || (nNumSensors > TEMP_SENSORS_MAX))
+  {
+    fprintf(stderr, "1-%u fans and 1-%u sensors\n", MAX_FANS, TEMP_SENSORS_MAX);
+    return 1;
+  }
+
+  CSimTempBus tempBus(nNumSensors);
+  CSimPwmChannel arrPwmChannels[MAX_FANS];
+  CSimTachCounter arrTachCounters[MAX_FANS];
+  CFanPwmControl *arrFanCtrl[MAX_FANS] = {};
+  CPwmFanControl *arrTelemetryFanCtrl[MAX_FANS] = {};
+  CTempSensors tempSensors(&tempBus, HIGH_RES, nNumSensors);
+
+  for (uint8_t nIndex = 0; nIndex < nNumFans; nIndex++)
+  {
+    arrFanCtrl[nIndex] = new CFanPwmControl(nIndex, 0, 0);
+    arrFanCtrl[nIndex]->begin(&arrPwmChannels[nIndex], &arrTachCounters[nIndex]);
+    arrFanCtrl[nIndex]->setFanDutyCyclePercent(43.217f + nIndex * 1.111f);
+    arrTachCounters[nIndex].setRpm(1180.0f + nIndex * 37.0f);
+    arrTelemetryFanCtrl[nIndex] = arrFanCtrl[nIndex];
+  }
+  for (uint8_t nIndex = 0; nIndex < nNumSensors; nIndex++)
+  {
+    tempBus.setTempC(nIndex, 40.75f + nIndex * 0.1f);
+  }
+
+  tempSensors.setAsyncConversion(true);
+  tempSensors.begin();
+
+  // A couple of samples in so every value is real
+  for (uint8_t nSample = 0; nSample < 3; nSample++)
+  {
+    halDelayMs(tempSensors.update());
+    for (uint8_t nIndex = 0; nIndex < nNumFans; nIndex++)
+    {
+      arrFanCtrl[nIndex]->sampleTach();
+    }
+  }
+
+  CTelemetry telemetry;
+  telemetry.begin(arrTelemetryFanCtrl, nNumFans, &tempSensors);
+  telemetry.sample();
+
+  char szJson[1024];
+  uint8_t arrCbor[512];
+  size_t nJsonLen = telemetry.writeFull(szJson, sizeof(szJson));
+  size_t nCborLen = telemetry.writeCbor(arrCbor, sizeof(arrCbor));
+
+  DecodedTelemetry decoded;
+  bool bRoundTrip = (nJsonLen > 0) && (nCborLen > 0) &&
+                    decodeTelemetryCbor(arrCbor, nCborLen, &decoded) &&
+                    (decoded.nGeneration == telemetry.getGeneration()) &&
+                    (decoded.fans.size() == nNumFans) &&
+                    (decoded.tempsRaw.size() == nNumSensors);
+  for (uint8_t nIndex = 0; bRoundTrip && (nIndex < nNumFans); nIndex++)
+  {
+    bRoundTrip = (decoded.fans[nIndex].nRpm == arrFanCtrl[nIndex]->getFanRpms()) &&
+                 (decoded.fans[nIndex].nDutyMilliPercent == lroundf(arrFanCtrl[nIndex]->getLastDutyCyclePercent() * 1000.0f));
+  }
+  for (uint8_t nIndex = 0; bRoundTrip && (nIndex < nNumSensors); nIndex++)
+  {
+    bRoundTrip = (fabs(DecodedTelemetry::rawToCelsius(decoded.tempsRaw[nIndex]) - tempSensors.getTempC(nIndex)) < 0.01);
+  }
+  if (!bRoundTrip)
+  {
+    fprintf(stderr, "CBOR round trip failed\n");
+    return 1;
+  }
+
+  volatile size_t nSink = 0;
+  double fJsonEncodeNs = nanosPerCall([&](int) { nSink = nSink + telemetry.writeFull(szJson, sizeof(szJson)); }, nIterations);
+  double fCborEncodeNs = nanosPerCall([&](int) { nSink = nSink + telemetry.writeCbor(arrCbor, sizeof(arrCbor)); }, nIterations);
+  double fCborDecodeNs = nanosPerCall([&](int) { nSink = nSink + decodeTelemetryCbor(arrCbor, nCborLen, &decoded); }, nIterations);
+
+  printf("{\"fans\":%u,\"sensors\":%u,"
+         "\"json\":{\"bytes\":%zu,\"encodeNs\":%.1f},"
+         "\"cbor\":{\"bytes\":%zu,\"encodeNs\":%.1f,\"decodeNs\":%.1f}}\n",
+         nNumFans, nNumSensors,
+         nJsonLen, fJsonEncodeNs,
+         nCborLen, fCborEncodeNs, fCborDecodeNs);
+
+  for (uint8_t nIndex = 0; nIndex < nNumFans; nIndex++)
+  {
+    delete arrFanCtrl[nIndex];
+  }
+
+  return 0;
+}